@@ -3,32 +3,211 @@
 
 #include <Arduino.h>
 #include <vector>
+#include <map>
+#include <functional>
+#include <atomic>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "crypto_manager.h"
+#include "vault_journal.h"
+#include "secure_store.h"
+#include "write_behind.h"
 
-// Структура для хранения одной записи пароля
+// Запись индекса паролей: сам пароль в памяти не хранится, только ссылка на
+// его зашифрованную запись в хранилище (см. PasswordManager::revealPassword)
 struct PasswordEntry {
-    String name;
-    String password;
+    static const uint32_t NO_SECRET = 0xFFFFFFFF;
+
+    EntryName name;
     int order = 0;  // Порядок сортировки
+    uint32_t id = 0; // Стабильный идентификатор записи в журнале
+    uint32_t secretOffset = NO_SECRET; // Смещение записи SECRET в PASSWORD_JOURNAL_FILE
+};
+
+// Неизменяемый снимок индекса паролей (см. PasswordManager::getAllPasswords())
+typedef StoreSnapshot<PasswordEntry> PasswordSnapshot;
+
+// Схема описания пароля для SecureStore: запись UPSERT журнала (без самого пароля)
+template <>
+struct RecordSchema<PasswordEntry> {
+    static const size_t kMaxNameLength = VAULT_MAX_NAME_LENGTH;
+    static void readJson(JsonObjectConst obj, PasswordEntry& entry, int defaultOrder);
+    static void writeJson(JsonObject obj, const PasswordEntry& entry);
+    static void wipe(PasswordEntry&) {} // Пароль в записи не хранится
+};
+
+/**
+ * @brief Расшифрованный пароль одной записи
+ *
+ * Буфер затирается в clear() и в деструкторе, поэтому открытый пароль живет
+ * только в области видимости объекта. Копирование запрещено.
+ */
+class RevealedPassword {
+public:
+    RevealedPassword() = default;
+    ~RevealedPassword() { clear(); }
+    RevealedPassword(const RevealedPassword&) = delete;
+    RevealedPassword& operator=(const RevealedPassword&) = delete;
+
+    const char* c_str() const { return _data.empty() ? "" : (const char*)_data.data(); }
+    size_t length() const { return _data.empty() ? 0 : _data.size() - 1; }
+    void clear();
+
+private:
+    friend class PasswordManager;
+    std::vector<uint8_t> _data; // Пароль с завершающим нулем
 };
 
+/**
+ * @brief Пароли: индекс имен в памяти, зашифрованные пароли в журнале
+ *
+ * begin() хранилище не читает: набор загружается при первом обращении
+ * (режим паролей, веб-запрос, отправка по BLE) или заранее в фоне -
+ * startPrefetch() после того, как интерфейс показан. Первое обращение во
+ * время фоновой загрузки ждет ее окончания.
+ * Изменения (веб-сервер) выполняются по одному под мьютексом писателей и
+ * публикуют новый снимок индекса; loop() читает снимок без блокировки.
+ */
 class PasswordManager {
 public:
     PasswordManager();
     void begin();
+    // Фоновая загрузка хранилища на PASSWORD_PREFETCH_CORE (один раз)
+    void startPrefetch();
+    bool isLoaded() const { return loaded.load(); }
+    bool loadHasFailed() const { return loadFailed.load(); }
+    // Длительность загрузки хранилища, мс (0 - еще не загружено)
+    uint32_t getLoadTimeMs() const { return loadTimeMs; }
     bool addPassword(const String& name, const String& password);
     bool deletePassword(int index);
     bool updatePassword(int index, const String& name, const String& password); // <-- ADDED
-    bool reorderPasswords(const std::vector<std::pair<String, int>>& newOrder); // Изменение порядка
-    std::vector<PasswordEntry> getAllPasswords();
-    std::vector<PasswordEntry> getAllPasswordsForExport();
-    bool replaceAllPasswords(const String& jsonContent); // Новая функция для импорта
+    // Только новое имя: пишется описание записи, секрет остается прежним
+    bool renamePassword(int index, const String& name);
+    // Изменение порядка: в памяти сразу, в журнал - отложенно (WriteBehind), одной
+    // записью ORDER на серию перестановок
+    bool reorderPasswords(const std::vector<std::pair<String, int>>& newOrder);
+    // Снимок индекса паролей (имена), упорядоченного по order: берется без блокировки
+    // и не меняется, пока его держат (изменения публикуют новый)
+    PasswordSnapshot getAllPasswords() const {
+        ensureLoaded();
+        return passwords.snapshot();
+    }
+    // Расшифровывает один пароль из flash по текущему набору (под блокировкой
+    // писателей: смещения меняются при сворачивании); false - нет записи или она повреждена
+    bool revealPassword(int index, RevealedPassword& out) const;
+    // То же по id записи: для читателей снимка (getAllPasswords()), у которых
+    // индекс мог устареть после удаления или перестановки
+    bool revealPasswordById(uint32_t id, RevealedPassword& out) const;
+    // Заполняет obj записью экспорта {name, password} для пароля index
+    // (расшифровывается из flash); false - нет записи или она повреждена
+    bool exportEntry(size_t index, JsonObject obj) const;
+
+    // Импорт с заменой всех паролей: каждая проверенная запись сразу шифруется
+    // в отдельный файл PASSWORD_IMPORT_FILE (в памяти остаются только имена),
+    // текущее хранилище до commitImport() не меняется. commitImport() атомарно
+    // подменяет им хранилище; abortImport() удаляет собранный файл.
+    bool beginImport();
+    bool stageImport(JsonObjectConst obj);
+    bool commitImport();
+    void abortImport();
+    bool inImport() const { return importActive; }
+
+    // Индекс записи в getAllPasswords() по имени или по стабильному id (хэш-индекс,
+    // O(1)); -1 - нет такой записи
+    int findByName(const String& name) const {
+        ensureLoaded();
+        return passwords.findByName(name);
+    }
+    int findById(uint32_t id) const {
+        ensureLoaded();
+        return passwords.findById(id);
+    }
+    // Индексы в getAllPasswords() записей, имя которых содержит query (без учета регистра
+    // ASCII), по порядку; не больше limit. Возвращает общее число совпадений.
+    size_t searchPasswords(const String& query, std::vector<uint32_t>& indices, size_t limit = 0) const {
+        ensureLoaded();
+        return passwords.search(query, indices, limit);
+    }
+
+    // Пакет изменений: add/update/delete/reorder между beginBatch() и
+    // commitBatch() меняют только память (новые пароли ждут в памяти), а
+    // commitBatch() один раз переписывает хранилище. Если запись не удалась или
+    // вызван abortBatch(), набор паролей возвращается к состоянию до beginBatch().
+    // Снимок getAllPasswords() обновляется только в конце пакета; имя записи
+    // внутри пакета - getPasswordName().
+    bool beginBatch();
+    bool commitBatch();
+    void abortBatch();
+    bool inBatch() const { return batchActive; }
+    // Имя пароля index в текущем наборе (под блокировкой писателей)
+    bool getPasswordName(int index, String& name) const;
+
+    // Счетчик изменений набора паролей (растет при каждой мутации)
+    uint32_t getGeneration() const {
+        ensureLoaded();
+        return passwords.generation();
+    }
+    // Память блока записей: слоты всего и занятые ими байты (диагностика кучи);
+    // хранилище для этого не загружается
+    size_t getCapacity() const { return passwords.capacity(); }
+    size_t getStorageBytes() const { return passwords.storageBytes(); }
 
 private:
+    // Источник открытого пароля при переписывании хранилища
+    typedef std::function<bool(const PasswordEntry& entry, std::vector<uint8_t>& secret)> SecretSource;
+    struct LoadState;
+
+    // Загружает хранилище при первом вызове; остальные вызовы ждут окончания загрузки.
+    // false - хранилище не прочитано (повтор после PASSWORD_LOAD_RETRY_MS или сразу
+    // при retryNow): изменения поверх него потеряли бы непрочитанные пароли
+    bool ensureLoaded(bool retryNow = false) const;
+    static void prefetchTask(void* arg);
     bool loadPasswords();
-    bool savePasswords();
+    // false - PASSWORD_FILE не прочитан и не расшифрован; файл не трогается
+    bool loadLegacySnapshot(LoadState& state);
+    bool verifyMigration(const LoadState& state);
+    bool revealEntry(const PasswordEntry& entry, RevealedPassword& out) const;
+
+    // Изменение одного пароля: запись SECRET, затем описание (имя, порядок)
+    bool persistEntry(PasswordEntry& entry, const String& password);
+    bool persistRecord(JournalOp op, uint32_t id, const String& payload);
+    void applyJournalRecord(JournalOp op, uint32_t id, const String& payload, LoadState& state);
+    // Записывает накопленный порядок одной записью ORDER (вызывается WriteBehind)
+    bool flushOrder();
+    // Переписывает хранилище начисто: по паре записей на пароль (сворачивание журнала)
+    bool rewriteVault(std::vector<PasswordEntry>& entries, const SecretSource& source);
+    void endBatch();
+    // pendingPassword - новый пароль записи pendingId, не попавший в журнал
+    bool compact(uint32_t pendingId = 0, const String* pendingPassword = nullptr);
+    bool needsCompaction() const;
+
+    SecureStore<PasswordEntry> passwords;
+    VaultJournal journal;
+    SemaphoreHandle_t persistMutex = nullptr; // Писатели набора и записи на flash (StoreWriter, PersistLock)
+
+    // Порядок, еще не записанный в журнал: id -> order (очищается перезаписью хранилища)
+    std::map<uint32_t, int> pendingOrder;
+    int orderSink = -1;
+
+    // Отложенная загрузка: loaded выставляется после успешной loadPasswords() под loadMutex
+    std::atomic<bool> loaded{false};
+    std::atomic<bool> loadFailed{false};
+    uint32_t lastLoadAttemptMs = 0;
+    bool prefetchStarted = false;
+    SemaphoreHandle_t loadMutex = nullptr;
+    uint32_t loadTimeMs = 0;
+
+    // Пакет: копия набора до beginBatch() хранится в passwords для отката,
+    // новые пароли ждут записи в памяти
+    bool batchActive = false;
+    bool batchDirty = false;
+    std::map<uint32_t, String> batchSecrets; // id -> новый пароль (затирается в endBatch())
 
-    std::vector<PasswordEntry> passwords;
+    // Хранилище, собираемое импортом
+    bool importActive = false;
+    SecureStore<PasswordEntry> importEntries; // Повтор имени - через его индекс
+    VaultJournal importJournal;
 };
 
-#endif // PASSWORD_MANAGER_H
\ No newline at end of file
+#endif // PASSWORD_MANAGER_H
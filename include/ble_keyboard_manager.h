@@ -53,6 +53,7 @@ private:
     // Маппинг символов в HID коды
     uint8_t charToHidKey(char c);
     uint8_t charToModifier(char c);
+    void typeText(const char* text, size_t length); // Ввод без промежуточной копии текста
     
 public:
     BleKeyboardManager(const char* deviceName, const char* manufacturer, uint8_t batteryLevel);
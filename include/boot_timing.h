@@ -0,0 +1,34 @@
+#ifndef BOOT_TIMING_H
+#define BOOT_TIMING_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * @brief Отметки времени этапов загрузки
+ *
+ * setup() отмечает окончание этапов (mark()), loop() - первый кадр интерфейса;
+ * report() один раз выводит в журнал время каждого этапа от старта и его
+ * длительность. Ожидание пользователя (PIN, выбор режима) - отдельные этапы,
+ * чтобы их можно было отличить от работы устройства. Время считается по
+ * millis(), то есть без загрузчика ROM.
+ */
+class BootTiming {
+public:
+    // Повторная отметка этапа игнорируется; лишние сверх BOOT_TIMING_MAX_STAGES тоже
+    static void mark(const char* stage);
+    static void report();
+    // {"stages":[{"stage","at","duration"}]}, мс
+    static void toJson(JsonObject obj);
+
+private:
+    struct Stage {
+        const char* name;
+        uint32_t at;
+    };
+    static Stage _stages[];
+    static uint8_t _count;
+    static bool _reported;
+};
+
+#endif // BOOT_TIMING_H
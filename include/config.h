@@ -23,14 +23,54 @@
 // TOTP настройки
 #define CONFIG_TOTP_STEP_SIZE 30
 #define CONFIG_TOTP_DIGITS 6
+#define OTP_MAX_DIGITS 8            // Поддерживаются 6 и 8 цифр (RFC 4226/6238)
+#define OTP_MIN_PERIOD 10           // Допустимый период TOTP для отдельного ключа, секунды
+#define OTP_MAX_PERIOD 300
+#define TOTP_PREROLL_SECONDS 3      // За сколько секунд до границы окна считать коды следующего окна
+#define HOTP_MAX_LOOKAHEAD 20       // Максимум кодов в одном пакете HOTP (окно ресинхронизации)
+#define TOTP_VERIFY_MAX_SKEW 2      // Проверка TOTP: допустимое отклонение ±N окон (размер набора допустимых кодов 2N+1)
+#define TOTP_VERIFY_DEFAULT_SKEW 1
+#define TOTP_VERIFY_MAX_FAILURES 5  // Неудачных попыток на ключ за окно, после чего проверка блокируется до следующего окна
+#define BATCH_MAX_OPERATIONS 64     // Максимум операций в одном запросе /api/keys/batch и /api/passwords/batch
+#define SEARCH_MAX_RESULTS 50       // Максимум записей в ответе /api/keys/search и /api/passwords/search
+#define LIST_MAX_PAGE_SIZE 100      // Максимум записей на странице /api/keys и /api/passwords (?limit=)
+
+// Непрерывность времени между перезагрузками и сном (TimeContinuity)
+#define TIME_RTC_CHECKPOINT_SEC 10          // Контрольная точка в RTC памяти (дешево)
+#define TIME_FLASH_CHECKPOINT_SEC 1800      // Контрольная точка во flash (/config.json)
+#define TIME_DRIFT_MIN_INTERVAL_SEC 1800    // Минимальный интервал между синхронизациями для оценки ухода
+#define TIME_DEFAULT_DRIFT_PPM 100          // Граница ухода часов, пока он не оценен
+#define TIME_DRIFT_MARGIN_PPM 10            // Запас к оцененному уходу
+#define TIME_SNTP_UNCERTAINTY_MS 100
+#define TIME_MANUAL_UNCERTAINTY_MS 1000     // Время, переданное браузером
 
 // Timezone for local time presentation (UTC+8 for zh_CN default)
 #define CONFIG_TIMEZONE_OFFSET_SEC (8 * 3600)
 
 // Файловая система
-#define KEYS_FILE "/keys.json.enc"
-#define PASSWORD_FILE "/passwords.json.enc"
-#define WIFI_CONFIG_FILE "/wifi_config.json.enc"  // Зашифрованный файл WiFi credentials
+#define KEYS_FILE "/keys.vault"                   // Снимок ключей в формате VaultFile
+#define KEYS_FILE_LEGACY "/keys.json.enc"          // JSON + AES-CBC + Base64, переносится в KEYS_FILE
+#define PASSWORD_FILE "/passwords.json.enc"      // Старый снимок паролей, переносится в PASSWORD_JOURNAL_FILE
+#define KEYS_JOURNAL_FILE "/keys.journal"          // Журнал изменений ключей поверх снимка KEYS_FILE
+#define PASSWORD_JOURNAL_FILE "/passwords.journal" // Хранилище паролей: по записи на пароль, без снимка
+#define VAULT_JOURNAL_COMPACT_BYTES 4096            // Журнал сворачивается в снимок, когда больше этого и больше снимка
+#define VAULT_JOURNAL_MAX_RECORD 2048               // Максимальный размер одной зашифрованной записи
+#define PASSWORD_PREFETCH_CORE 0                    // Ядро фоновой загрузки паролей (loop() и интерфейс - на ядре 1)
+#define PASSWORD_PREFETCH_STACK 8192                // Стек задачи фоновой загрузки паролей
+#define PASSWORD_LOAD_RETRY_MS 10000                // Повтор неудачной загрузки паролей для читателей
+#define BOOT_TIMING_MAX_STAGES 16                   // Этапов загрузки в отчете BootTiming
+#define WRITE_BEHIND_QUIET_MS 1500                  // Отложенная запись: пауза в изменениях перед записью во flash
+#define WRITE_BEHIND_MAX_DELAY_MS 10000             // Отложенная запись: не позже этого после первого изменения
+#define VAULT_FILE_CHUNK 256                        // VaultFile шифруется/расшифровывается порциями (кратно 16)
+#define VAULT_FILE_MAX_FIELD 1024                   // Максимальная длина одного поля VaultFile
+#define VAULT_MAX_NAME_LENGTH 63                    // Максимальная длина нового имени ключа или пароля (байт UTF-8)
+#define VAULT_NAME_SLOT_SIZE (VAULT_MAX_NAME_LENGTH + 1) // Слот имени внутри записи (с завершающим нулем)
+#define VAULT_SECRET_SLOT_SIZE 128                  // Слот Base32 секрета ключа внутри записи (с завершающим нулем)
+#define VAULT_SLAB_STEP 16                          // Шаг роста блока записей хранилища (записей)
+#define IMPORT_MAX_ENTRY_SIZE 2048                  // Максимальный размер одной записи (JSON объекта) в файле импорта
+#define PASSWORD_IMPORT_FILE "/passwords.journal.import" // Хранилище паролей, собираемое импортом до замены
+#define WIFI_CONFIG_FILE "/wifi_config.vault"      // Зашифрованный файл WiFi credentials (VaultFile)
+#define WIFI_CONFIG_FILE_ENC_LEGACY "/wifi_config.json.enc" // Прежний JSON + AES-CBC + Base64 для миграции
 #define WIFI_CONFIG_FILE_LEGACY "/wifi_config.json"  // Старый plain text файл для миграции
 #define SPLASH_IMAGE_PATH "/splash.raw"
 #define AUTH_FILE "/auth.json"
@@ -7,6 +7,9 @@
 #include "config.h"
 #include "ui_themes.h"
 
+// Настройки CONFIG_FILE читаются из общей копии в памяти и записываются
+// отложенно (WriteBehind); контрольные точки времени пишутся сразу.
+// BLE и mDNS хранятся в отдельных файлах и пишутся как раньше.
 class ConfigManager {
 public:
     ConfigManager();
@@ -56,13 +59,15 @@ public:
     unsigned long getLastKnownEpoch();
     bool saveLastKnownEpoch(unsigned long epochSeconds);
 
+    // Контрольная точка времени: epoch и оценка ухода часов (ppb) одной записью файла
+    bool saveTimeCheckpoint(unsigned long epochSeconds, bool driftKnown, long driftPpb);
+    bool getTimeDriftPpb(long& driftPpb); // false - уход еще не оценивался
+
 private:
     // Internal state for configuration values
     Theme _currentTheme = Theme::DARK; // Default theme
     String _currentBleDeviceName = DEFAULT_BLE_DEVICE_NAME; // Default BLE name
     String _currentMdnsHostname = DEFAULT_MDNS_HOSTNAME; // Default mDNS hostname
-    uint16_t _cachedDisplayTimeout = 30; // Default display timeout (cached)
-    bool _displayTimeoutCached = false; // Flag to track if timeout is cached
     SessionDuration _currentSessionDuration = SIX_HOURS; // Default session duration
 };
 
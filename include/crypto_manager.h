@@ -4,8 +4,11 @@
 #include <Arduino.h>
 #include <vector>
 #include "LittleFS.h"
+#include "mbedtls/gcm.h"
 
 #define DEVICE_KEY_FILE "/device.key"
+#define SESSION_FILE "/session.vault"
+#define SESSION_FILE_LEGACY "/session.json.enc" // JSON + AES-CBC + Base64 до перехода на VaultFile
 
 class CryptoManager {
 public:
@@ -27,6 +30,8 @@ public:
     // --- New Password-based Encryption for Import/Export ---
     String encryptWithPassword(const String& plaintext, const String& password);
     String decryptWithPassword(const String& encryptedJson, const String& password);
+    // Ключ AES-256 файла экспорта: PBKDF2-HMAC-SHA256 (PBKDF2_ITERATIONS_EXPORT), key - 32 байта
+    bool deriveExportKey(const String& password, const uint8_t* salt, size_t saltLength, uint8_t* key);
     
     // Session ID generation
     String generateSecureSessionId();
@@ -47,6 +52,14 @@ public:
     bool encryptData(const uint8_t* plain, size_t plain_len, std::vector<uint8_t>& output);
     bool decryptData(const uint8_t* encrypted, size_t encrypted_len, std::vector<uint8_t>& output);
 
+    // --- Authenticated record encryption (AES-256-GCM, журнал хранилищ) ---
+    // Формат: [nonce 12][ciphertext][tag 16]. aad аутентифицируется, но не шифруется.
+    // Ключ выводится из ключа устройства (HMAC-SHA256), поэтому не совпадает с ключом AES-CBC файлов.
+    bool sealRecord(const uint8_t* plain, size_t plainLen, const uint8_t* aad, size_t aadLen, std::vector<uint8_t>& output);
+    bool openRecord(const uint8_t* sealed, size_t sealedLen, const uint8_t* aad, size_t aadLen, std::vector<uint8_t>& output);
+    // Тот же ключ для потокового шифрования (VaultFile): mbedtls_gcm_setkey на контексте вызывающего
+    bool initRecordCipher(mbedtls_gcm_context& gcm);
+
     // --- BLE PIN Management ---
     bool saveBlePin(uint32_t pin);
     uint32_t loadBlePin();
@@ -59,10 +72,14 @@ private:
     void operator=(const CryptoManager&) = delete;
 
     unsigned char _deviceKey[32]; // 256-bit AES key
+    unsigned char _recordKey[32]; // AES-GCM key for sealRecord/openRecord (derived from _deviceKey)
     bool _isKeyInitialized;
 
     void generateAndSaveKey();
     void loadKey();
+    void deriveRecordKey();
+    bool readSessionFile(String& sessionId, String& csrfToken, unsigned long& createdMillis, unsigned long& createdEpoch);
+    bool readLegacySessionFile(String& sessionId, String& csrfToken, unsigned long& createdMillis, unsigned long& createdEpoch);
 };
 
 #endif // CRYPTO_MANAGER_H
@@ -4,6 +4,7 @@
 #include <TFT_eSPI.h>
 #include "animation_manager.h"
 #include "ui_themes.h" // Include new theme definitions
+#include "config.h"
 
 // Режимы запуска устройства (AP/Offline/WiFi)
 enum class StartupMode {
@@ -23,9 +24,10 @@ public:
     void updateHeader();
     
     void drawLayout(const String& serviceName, int batteryPercentage, bool isCharging, bool isWebServerOn); 
-    void drawPasswordLayout(const String& name, const String& password, int batteryPercentage, bool isCharging, bool isWebServerOn);
+    void drawPasswordLayout(const String& name, const char* password, int batteryPercentage, bool isCharging, bool isWebServerOn);
     void updateBatteryStatus(int percentage, bool isCharging);
-    void updateTOTPCode(const String& code, int timeRemaining);
+    void updateTOTPCode(const String& code, int timeRemaining, int period = CONFIG_TOTP_STEP_SIZE);
+    void updateTOTPCode(const char* code, int timeRemaining, int period = CONFIG_TOTP_STEP_SIZE);
     void turnOff();
     void turnOn();
     void setBrightness(uint8_t brightness); // Set backlight brightness (0-255) for fade effects
@@ -38,7 +40,7 @@ public:
     void hideLoader(); // Скрыть лоадер и сбросить состояние
     bool isLoaderActive() const { return _loaderActive; } // Проверить активность лоадера
     void drawBleAdvertisingPage(const String& deviceName, const String& status, int timeLeft);
-    void drawBleConfirmPage(const String& passwordName, const String& password, const String& deviceName);
+    void drawBleConfirmPage(const String& passwordName, size_t passwordLength, const String& deviceName);
     void drawBleSendingPage();
     void drawBleResultPage(bool success);
 
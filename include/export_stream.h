@@ -0,0 +1,68 @@
+#ifndef EXPORT_STREAM_H
+#define EXPORT_STREAM_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include "mbedtls/aes.h"
+
+/**
+ * @brief Потоковое формирование файла экспорта ключей и паролей
+ *
+ * Формат тот же, что у CryptoManager::encryptWithPassword(): конверт
+ * {"salt","iv","ciphertext"} (PBKDF2 + AES-256-CBC, Base64), внутри JSON массив
+ * записей. Файл отдается порциями через read(): записи по одной запрашиваются
+ * у fillEntry, шифруются блоками по 16 байт и сразу кодируются в Base64, поэтому
+ * в памяти нет ни открытого текста всех записей, ни шифротекста, ни конверта
+ * целиком - только одна запись и ее Base64.
+ */
+class ExportStream {
+public:
+    // Заполняет entry записью с номером index (0..count-1); false - запись
+    // недоступна, экспорт прерывается
+    typedef std::function<bool(size_t index, JsonObject entry)> EntryFn;
+
+    ExportStream(size_t count, EntryFn fillEntry);
+    ~ExportStream();
+    ExportStream(const ExportStream&) = delete;
+    ExportStream& operator=(const ExportStream&) = delete;
+
+    // Соль, IV и вывод ключа (PBKDF2) - основная задержка экспорта
+    bool begin(const String& password);
+    // Следующая порция файла; 0 - файл закончен или экспорт прерван (failed())
+    size_t read(uint8_t* buffer, size_t maxLength);
+    // Дописывает весь файл в output (туннель: ответ шифруется целиком).
+    // jsonString - с экранированием кавычек, для вложения строкой в JSON ответ.
+    bool readAll(String& output, bool jsonString = false);
+
+    bool failed() const { return _failed; }
+    size_t entryCount() const { return _count; }
+
+private:
+    enum Stage : uint8_t { HEADER, ENTRIES, TRAILER, DONE };
+
+    bool produce(); // Следующий фрагмент файла в _out
+    bool encryptEntry(size_t index);
+    void finishCipher();
+    void feedPlain(const uint8_t* data, size_t length);
+    void appendBase64(const uint8_t* data, size_t length);
+
+    size_t _count;
+    EntryFn _fillEntry;
+    Stage _stage = HEADER;
+    size_t _next = 0;
+    bool _failed = false;
+
+    mbedtls_aes_context _aes;
+    uint8_t _salt[16];
+    uint8_t _chain[16];    // IV, затем последний блок шифротекста (CBC)
+    uint8_t _block[16];    // Открытый текст текущего блока
+    uint8_t _blockLength = 0;
+    uint8_t _carry[3];     // Байты шифротекста, не вошедшие в четверку Base64
+    uint8_t _carryLength = 0;
+
+    String _out;           // Готовый к отправке текст (заголовок, Base64, хвост)
+    size_t _outPosition = 0;
+};
+
+#endif // EXPORT_STREAM_H
@@ -0,0 +1,32 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+
+// Снимок состояния кучи
+struct HeapStats {
+    uint32_t freeHeap = 0;
+    uint32_t minFreeHeap = 0;          // Минимум свободной памяти с момента старта
+    uint32_t largestFreeBlock = 0;     // Самый большой блок, который можно выделить
+    uint32_t minLargestFreeBlock = 0;  // Минимум largestFreeBlock среди снимков sample()
+    uint8_t fragmentation = 0;         // 100 - largestFreeBlock * 100 / freeHeap, %
+};
+
+/**
+ * @brief Наблюдение за фрагментацией кучи
+ *
+ * Фрагментацию показывает не объем свободной памяти, а размер наибольшего
+ * свободного блока: при достаточном freeHeap выделение все равно
+ * не удается, если куча раздроблена. sample() вызывается периодически из
+ * loop() и по запросу /api/memory; минимум наибольшего блока за время работы
+ * показывает, остается ли фрагментация ровной.
+ */
+class HeapMonitor {
+public:
+    static HeapStats sample();
+
+private:
+    static uint32_t _minLargestFreeBlock;
+};
+
+#endif // HEAP_MONITOR_H
@@ -0,0 +1,115 @@
+#ifndef IMPORT_STREAM_H
+#define IMPORT_STREAM_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include "mbedtls/aes.h"
+
+/**
+ * @brief Потоковый разбор файла импорта ключей и паролей
+ *
+ * Файл экспорта - конверт {"salt","iv","ciphertext"} (PBKDF2 + AES-256-CBC,
+ * Base64), внутри которого JSON массив записей. Запрос импорта -
+ * {"password": "...", "data": "<конверт строкой>"}.
+ * Данные принимаются порциями: Base64 декодируется, расшифровывается блоками
+ * по 16 байт и режется на записи массива. Каждая запись по отдельности
+ * разбирается в маленький JsonDocument и передается onEntry, поэтому в памяти
+ * нет ни всего запроса, ни открытого текста, ни документа со всеми записями:
+ * только одна запись (до IMPORT_MAX_ENTRY_SIZE байт).
+ */
+class ImportStream {
+public:
+    enum class Status : uint8_t {
+        OK,
+        MALFORMED,      // Запрос или конверт не в ожидаемом формате
+        DECRYPT_FAILED, // Неверный пароль или поврежденный файл
+        REJECTED        // onEntry отклонил запись
+    };
+
+    // false - запись не принята, разбор останавливается
+    typedef std::function<bool(JsonObjectConst entry)> EntryFn;
+
+    explicit ImportStream(EntryFn onEntry);
+    ~ImportStream();
+    ImportStream(const ImportStream&) = delete;
+    ImportStream& operator=(const ImportStream&) = delete;
+
+    // Очередная порция тела запроса. Пароль должен идти в запросе раньше
+    // данных (так его отправляет веб-интерфейс).
+    bool feed(const uint8_t* data, size_t length);
+    // Запрос уже разобран (туннель): пароль и конверт целиком
+    bool feedEnvelope(const String& password, const char* envelope, size_t length);
+    // Конец данных: проверяет дополнение PKCS7 и то, что массив закрыт
+    bool finish();
+
+    Status status() const { return _status; }
+    size_t entryCount() const { return _entries; }
+
+private:
+    // Плоский JSON объект со строковыми значениями; значения отдаются
+    // порциями уже без экранирования
+    class FieldScanner {
+    public:
+        typedef std::function<bool(const String& key, const char* data, size_t length)> ValueFn;
+
+        explicit FieldScanner(ValueFn onValue) : _onValue(onValue) {}
+        bool feed(const char* data, size_t length);
+        bool done() const { return _state == DONE; }
+
+    private:
+        enum State : uint8_t {
+            BEFORE_OBJECT, BEFORE_KEY, IN_KEY, AFTER_KEY, BEFORE_VALUE,
+            IN_VALUE, IN_ESCAPE, IN_UNICODE, IN_SCALAR, AFTER_VALUE, DONE
+        };
+        bool emit(const char* data, size_t length);
+        bool emitCodePoint(uint32_t code);
+
+        ValueFn _onValue;
+        State _state = BEFORE_OBJECT;
+        String _key;
+        bool _keyEscape = false;
+        uint32_t _unicode = 0;
+        uint8_t _unicodeDigits = 0;
+    };
+
+    bool onRequestField(const String& key, const char* data, size_t length);
+    bool onEnvelopeField(const String& key, const char* data, size_t length);
+    bool startCipher();
+    bool feedBase64(const char* data, size_t length);
+    bool decryptBlock();
+    bool feedPlain(const uint8_t* data, size_t length);
+    bool completeEntry();
+    bool fail(Status status);
+
+    EntryFn _onEntry;
+    Status _status = Status::OK;
+    bool _requestMode = false; // Данные пришли через feed(), а не feedEnvelope()
+    FieldScanner _request;
+    FieldScanner _envelope;
+
+    String _password;
+    String _salt;
+    String _iv;
+    mbedtls_aes_context _aes;
+    uint8_t _chain[16];        // IV для следующего блока CBC
+    bool _cipherReady = false;
+
+    uint32_t _quad = 0;        // Base64: накопленные 6-битные группы
+    uint8_t _quadLength = 0;
+    bool _base64Padding = false;
+    uint8_t _block[16];        // Шифротекст текущего блока
+    uint8_t _blockLength = 0;
+    uint8_t _plain[16];        // Последний расшифрованный блок ждет: в нем может быть дополнение
+    bool _plainPending = false;
+
+    enum ArrayState : uint8_t { BEFORE_ARRAY, BEFORE_ENTRY, IN_ENTRY, AFTER_ENTRY, AFTER_ARRAY };
+    ArrayState _arrayState = BEFORE_ARRAY;
+    String _entry;
+    int _depth = 0;
+    bool _inString = false;
+    bool _escape = false;
+    size_t _entries = 0;
+};
+
+#endif // IMPORT_STREAM_H
@@ -0,0 +1,147 @@
+#ifndef INLINE_STRING_H
+#define INLINE_STRING_H
+
+#include <Arduino.h>
+#include <memory>
+#include <string.h>
+
+/**
+ * @brief Строка фиксированной емкости, хранящаяся внутри записи
+ *
+ * Замена String для имен и секретов записей хранилища: символы лежат в самой
+ * записи, поэтому набор записей - один непрерывный блок без отдельного
+ * выделения памяти на каждую строку (загрузка, импорт и откат пакета больше не
+ * дробят кучу мелкими блоками). N - размер буфера с завершающим нулем.
+ * Длинная строка обрезается по границе символа UTF-8; владелец проверяет длину
+ * заранее (fits()). ArduinoJson принимает объект как строку (c_str()/length()).
+ */
+template <size_t N>
+class InlineString {
+public:
+    static const size_t kCapacity = N - 1;
+
+    InlineString() { _data[0] = '\0'; }
+    explicit InlineString(const char* value) { assign(value, value ? strlen(value) : 0); }
+    explicit InlineString(const String& value) { assign(value.c_str(), value.length()); }
+
+    InlineString& operator=(const char* value) {
+        assign(value, value ? strlen(value) : 0);
+        return *this;
+    }
+    InlineString& operator=(const String& value) {
+        assign(value.c_str(), value.length());
+        return *this;
+    }
+
+    // false - строка не поместилась и обрезана
+    bool assign(const char* value, size_t length) {
+        bool fitted = length <= kCapacity;
+        if (!fitted) {
+            length = kCapacity;
+            // Не разрезаем многобайтовый символ UTF-8
+            while (length > 0 && ((uint8_t)value[length] & 0xC0) == 0x80) {
+                length--;
+            }
+        }
+        if (length > 0) {
+            memmove(_data, value, length);
+        }
+        _data[length] = '\0';
+        _length = (uint16_t)length;
+        return fitted;
+    }
+
+    static bool fits(const String& value) { return value.length() <= kCapacity; }
+
+    const char* c_str() const { return _data; }
+    size_t length() const { return _length; }
+    bool isEmpty() const { return _length == 0; }
+
+    // Затирает содержимое (секреты)
+    void clear() {
+        memset(_data, 0, sizeof(_data));
+        _length = 0;
+    }
+
+    bool operator==(const char* other) const { return strcmp(_data, other ? other : "") == 0; }
+    bool operator==(const String& other) const {
+        return _length == other.length() && memcmp(_data, other.c_str(), _length) == 0;
+    }
+    bool operator==(const InlineString& other) const {
+        return _length == other._length && memcmp(_data, other._data, _length) == 0;
+    }
+    template <typename Other>
+    bool operator!=(const Other& other) const { return !(*this == other); }
+
+    // Для API, принимающих String (журнал, дисплей, логи)
+    operator String() const { return String(_data); }
+
+private:
+    uint16_t _length = 0;
+    char _data[N];
+};
+
+/**
+ * @brief Строка в слоте записи с переносом длинных значений в кучу
+ *
+ * Для имен записей: новые имена проверяются по длине слота (validName), но
+ * хранилища прежних форматов могут содержать имена длиннее. Такое имя целиком
+ * хранится в неизменяемом буфере в куче, общем для копий записи (снимки, откат
+ * пакета), поэтому загрузка не обрезает имена и не склеивает разные имена с
+ * одинаковым началом. Короткие имена кучу не используют.
+ */
+template <size_t N>
+class SpillString {
+public:
+    static const size_t kCapacity = InlineString<N>::kCapacity;
+
+    SpillString() {}
+
+    SpillString& operator=(const char* value) {
+        assign(value, value ? strlen(value) : 0);
+        return *this;
+    }
+    SpillString& operator=(const String& value) {
+        assign(value.c_str(), value.length());
+        return *this;
+    }
+
+    // false - строка длиннее слота и перенесена в кучу (не обрезается)
+    bool assign(const char* value, size_t length) {
+        if (length <= kCapacity) {
+            _inline.assign(value, length);
+            _spilled.reset();
+            return true;
+        }
+        std::shared_ptr<String> spilled = std::make_shared<String>();
+        spilled->concat(value, (unsigned int)length);
+        _spilled = spilled;
+        _inline.assign("", 0);
+        return false;
+    }
+
+    static bool fits(const String& value) { return value.length() <= kCapacity; }
+
+    const char* c_str() const { return _spilled ? _spilled->c_str() : _inline.c_str(); }
+    size_t length() const { return _spilled ? _spilled->length() : _inline.length(); }
+    bool isEmpty() const { return length() == 0; }
+    bool spilled() const { return (bool)_spilled; }
+
+    bool operator==(const char* other) const { return strcmp(c_str(), other ? other : "") == 0; }
+    bool operator==(const String& other) const {
+        return length() == other.length() && memcmp(c_str(), other.c_str(), length()) == 0;
+    }
+    bool operator==(const SpillString& other) const {
+        return length() == other.length() && memcmp(c_str(), other.c_str(), length()) == 0;
+    }
+    template <typename Other>
+    bool operator!=(const Other& other) const { return !(*this == other); }
+
+    operator String() const { return String(c_str()); }
+
+private:
+    InlineString<N> _inline;
+    std::shared_ptr<const String> _spilled;
+};
+
+#endif // INLINE_STRING_H
@@ -2,33 +2,155 @@
 #define KEY_MANAGER_H
 
 #include <vector>
+#include <map>
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include "totp_generator.h"
+#include "vault_journal.h"
+#include "secure_store.h"
+#include "write_behind.h"
 
-// Структура для хранения ключа
+// Base32 секрет ключа в том виде, как его ввел пользователь
+typedef InlineString<VAULT_SECRET_SLOT_SIZE> KeySecret;
+
+// Структура для хранения ключа. Строки - фиксированные слоты внутри записи,
+// весь набор ключей лежит одним блоком (см. SecureStore)
 struct TOTPKey {
-    String name;
-    String secret;
+    EntryName name;
+    KeySecret secret;
     int order = 0;  // Порядок сортировки
+    uint32_t id = 0;          // Стабильный идентификатор записи в журнале (не меняется при переупорядочивании)
+    OtpParams params;         // Тип, алгоритм, число цифр и период
+    uint64_t counter = 0;     // Текущий счетчик HOTP (для TOTP не используется)
+    TOTPKeyMaterial material; // Декодированный секрет (заполняется KeyManager)
+};
+
+// Неизменяемый снимок ключей (см. KeyManager::getAllKeys())
+typedef StoreSnapshot<TOTPKey> KeySnapshot;
+
+// Схема ключа для SecureStore: снимок KEYS_FILE и записи журнала/импорта
+template <>
+struct RecordSchema<TOTPKey> {
+    static const VaultFileKind kKind = VaultFileKind::KEYS;
+    static const size_t kMaxNameLength = VAULT_MAX_NAME_LENGTH;
+    static void readJson(JsonObjectConst obj, TOTPKey& key, int defaultOrder);
+    static void writeJson(JsonObject obj, const TOTPKey& key);
+    static void readField(TOTPKey& key, const VaultFileReader::Field& field);
+    static void writeFields(VaultFileWriter& writer, const TOTPKey& key);
+    static void wipe(TOTPKey& key); // Base32 секрет и ключевой материал (midstate HMAC)
 };
 
+/**
+ * @brief TOTP/HOTP ключи: набор в памяти, снимок и журнал на flash
+ *
+ * Ключи меняют обработчики веб-сервера (async_tcp) и loop() (счетчик HOTP),
+ * а читают обе задачи. Изменения выполняются по одному под мьютексом
+ * писателей и публикуют новый неизменяемый снимок; читатели берут снимок
+ * (getAllKeys()) без блокировки и не видят частично выполненных изменений.
+ */
 class KeyManager {
 public:
     KeyManager();
     bool begin(); // Загружает ключи в память при старте
     
     // Функции для управления ключами
-    bool addKey(const String& name, const String& secret);
+    bool addKey(const String& name, const String& secret, const OtpParams& params = OtpParams(), uint64_t counter = 0);
     bool removeKey(int index);
     bool updateKey(int index, const String& name, const String& secret); // <-- ADDED
-    bool reorderKeys(const std::vector<std::pair<String, int>>& newOrder); // Изменение порядка
-    std::vector<TOTPKey> getAllKeys();
-    bool replaceAllKeys(const String& jsonContent); // Новая функция
+    // Изменение порядка: в памяти сразу, в журнал - отложенно (WriteBehind), поэтому
+    // серия перестановок при перетаскивании в списке дает одну запись ORDER
+    bool reorderKeys(const std::vector<std::pair<String, int>>& newOrder);
+    // Снимок ключей, упорядоченных по order: берется без блокировки и не меняется,
+    // пока его держат (изменения публикуют новый). Индексы совпадают с индексами
+    // updateKey/removeKey/setCounter, пока снимок актуален (generation() == getGeneration()).
+    KeySnapshot getAllKeys() const { return keys.snapshot(); }
+
+    // Импорт с заменой всех ключей: записи по одной проверяются (имя, секрет,
+    // параметры, повтор имени) и копятся в отдельном наборе, текущие ключи до
+    // commitImport() не меняются. commitImport() пишет набор снимком и только
+    // после успешной записи подменяет им ключи; abortImport() его отбрасывает.
+    bool beginImport();
+    bool stageImport(JsonObjectConst obj);
+    bool commitImport();
+    void abortImport();
+    bool inImport() const { return importActive; }
+
+    // HOTP: переход к следующему счетчику (после использования кода) или
+    // явная установка счетчика при ресинхронизации. Счетчик сохраняется сразу.
+    bool advanceCounter(int index);
+    bool setCounter(int index, uint64_t counter);
+
+    // Индекс ключа в getAllKeys() по имени или по стабильному id (хэш-индекс, O(1));
+    // -1 - нет такого ключа
+    int findByName(const String& name) const { return keys.findByName(name); }
+    int findById(uint32_t id) const { return keys.findById(id); }
+    // Индексы в getAllKeys() записей, имя которых содержит query (без учета регистра
+    // ASCII), по порядку; не больше limit. Возвращает общее число совпадений.
+    size_t searchKeys(const String& query, std::vector<uint32_t>& indices, size_t limit = 0) const {
+        return keys.search(query, indices, limit);
+    }
+
+    // Пакет изменений: addKey/updateKey/removeKey/reorderKeys/setCounter между
+    // beginBatch() и commitBatch() меняют только память, а commitBatch() пишет
+    // один снимок. Если снимок не записан или вызван abortBatch(), набор ключей
+    // возвращается к состоянию на момент beginBatch().
+    // Снимок getAllKeys() обновляется только в конце пакета; текущее состояние
+    // ключа внутри пакета - getKeyFields().
+    bool beginBatch();
+    bool commitBatch();
+    void abortBatch();
+    bool inBatch() const { return batchActive; }
+    // Имя и секрет ключа index в текущем наборе (под блокировкой писателей)
+    bool getKeyFields(int index, String& name, String& secret) const;
+
+    // Счетчик изменений набора ключей (растет при каждой мутации, используется кэшами)
+    uint32_t getGeneration() const { return keys.generation(); }
+    // Память блока записей: слоты всего и занятые ими байты (диагностика кучи)
+    size_t getCapacity() const { return keys.capacity(); }
+    size_t getStorageBytes() const { return keys.storageBytes(); }
+
+    // Чтение/запись параметров OTP (и счетчика HOTP) в JSON объект ключа (хранилище, экспорт, импорт).
+    // Параметры по умолчанию не пишутся, поэтому старые файлы и экспорты совместимы.
+    static OtpParams readParams(JsonObjectConst obj);
+    static uint64_t readCounter(JsonObjectConst obj);
+    static void writeParams(JsonObject obj, const TOTPKey& key);
 
 private:
     bool loadKeys();
-    bool saveKeys();
+    bool loadSnapshot(bool& rewrite);   // rewrite - снимок старого формата, нужно переписать
+    bool loadLegacySnapshot(std::vector<TOTPKey>& loaded);
+    bool saveKeys(); // Полный снимок в KEYS_FILE, журнал после него очищается
+    bool writeSnapshot(const std::vector<TOTPKey>& snapshot);
+    void prepareKeyMaterial(TOTPKey& key);
+    // true - ключи не прочитаны (испорчен снимок или журнал): запись поверх
+    // хранилища потеряла бы непрочитанные ключи, изменения отклоняются
+    bool refuseWrites() const;
+
+    // Журнал изменений поверх снимка: одна запись на изменение одного ключа
+    bool persistUpsert(const TOTPKey& key);
+    bool persistRecord(JournalOp op, uint32_t id, const String& payload);
+    void applyJournalRecord(JournalOp op, uint32_t id, const String& payload);
+    // Записывает накопленный порядок одной записью ORDER (вызывается WriteBehind)
+    bool flushOrder();
+
+    SecureStore<TOTPKey> keys; // Ключи хранятся в памяти в расшифрованном виде
+    VaultJournal journal;
+    size_t snapshotSize = 0;   // Размер текущего снимка (порог сворачивания журнала)
+    bool loadFailed = false;   // Файлы хранилища остаются как есть до перезагрузки
+    SemaphoreHandle_t persistMutex = nullptr; // Писатели набора и записи на flash (StoreWriter, PersistLock)
+
+    // Порядок, еще не записанный в журнал: id -> order. Снимок пишет порядок
+    // из памяти, поэтому после записи снимка очищается.
+    std::map<uint32_t, int> pendingOrder;
+    int orderSink = -1;
+
+    // Пакет: копия набора до beginBatch() хранится в keys для отката
+    bool batchActive = false;
+    bool batchDirty = false;
 
-    std::vector<TOTPKey> keys; // Ключи хранятся в памяти в расшифрованном виде
+    // Набор ключей, собираемый импортом (повтор имени - через его индекс)
+    bool importActive = false;
+    SecureStore<TOTPKey> importKeys;
 };
 
-#endif // KEY_MANAGER_H
\ No newline at end of file
+#endif // KEY_MANAGER_H
@@ -0,0 +1,62 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <Arduino.h>
+#include <vector>
+#include <functional>
+
+/**
+ * @brief Хэш-индекс записей хранилища: имя -> стабильный id -> позиция в векторе
+ *
+ * Открытая адресация с линейным пробированием, емкость - степень двойки,
+ * заполнение не больше 3/4. Одна таблица слотов {хэш имени, id, позиция}
+ * доступна и по имени, и по id (вторая таблица хранит номера слотов), поэтому
+ * поиск, проверка дубликата и удаление - O(1). Сами имена не копируются:
+ * при сравнении индекс читает имя из вектора владельца через nameAt(позиция).
+ * Владелец обновляет позиции после сдвигов вектора (setPosition/reindex).
+ */
+class NameIndex {
+public:
+    typedef std::function<const char*(uint32_t position)> NameAt;
+
+    explicit NameIndex(NameAt nameAt);
+
+    void clear();
+    void reserve(size_t count);
+
+    // Запись с именем уже должна лежать в векторе на позиции position
+    void insert(const char* name, uint32_t id, uint32_t position);
+    void erase(uint32_t id);
+    // Имя записи уже изменено в векторе; позиция прежняя
+    void rename(uint32_t id, const char* name);
+    void setPosition(uint32_t id, uint32_t position);
+
+    // Позиция записи; -1 - нет такой записи
+    int findByName(const String& name) const;
+    int findById(uint32_t id) const;
+
+    size_t size() const { return _count; }
+
+private:
+    struct Slot {
+        uint32_t hash = 0;
+        uint32_t id = 0;       // 0 - пустой слот, TOMBSTONE - удаленный
+        uint32_t position = 0;
+    };
+    static const uint32_t TOMBSTONE = 0xFFFFFFFF;
+    static const uint32_t NO_SLOT = 0xFFFFFFFF;
+
+    static uint32_t hashName(const char* name);
+    static uint32_t hashId(uint32_t id);
+    uint32_t findSlotById(uint32_t id) const;
+    void rehash(size_t capacity);
+    void place(const Slot& slot);
+
+    NameAt _nameAt;
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _idSlots; // Номер слота + 1 по хэшу id; 0 - пусто, TOMBSTONE - удален
+    size_t _count = 0;
+    size_t _used = 0;               // Занятые и удаленные слоты (порог перестройки)
+};
+
+#endif // NAME_INDEX_H
@@ -0,0 +1,47 @@
+#ifndef NAME_SEARCH_H
+#define NAME_SEARCH_H
+
+#include <Arduino.h>
+#include <vector>
+#include <functional>
+
+/**
+ * @brief Поиск записей хранилища по подстроке имени
+ *
+ * Для каждой позиции хранится 64-битная сигнатура триграмм имени (ASCII без
+ * учета регистра, прочие байты UTF-8 как есть). Запрос проходит по
+ * сигнатурам: записи без всех триграмм запроса отбрасываются одним AND, и
+ * только оставшиеся имена сравниваются с подстрокой. Имена не копируются -
+ * индекс читает их из вектора владельца через nameAt(позиция). Владелец
+ * поддерживает индекс в порядке своего вектора (append/update/erase).
+ */
+class NameSearch {
+public:
+    typedef std::function<const char*(uint32_t position)> NameAt;
+
+    explicit NameSearch(NameAt nameAt);
+
+    void clear();
+    void reserve(size_t count);
+
+    // Запись с именем добавлена в конец вектора владельца
+    void append(const char* name);
+    // Имя записи на позиции position изменено
+    void update(uint32_t position, const char* name);
+    // Запись удалена, последующие позиции сдвинулись
+    void erase(uint32_t position);
+
+    // Позиции записей, имя которых содержит query, по порядку вектора
+    // (не больше limit, 0 - без ограничения). Возвращает число найденных
+    // записей без учета limit.
+    size_t find(const String& query, std::vector<uint32_t>& positions, size_t limit = 0) const;
+
+private:
+    static uint64_t signature(const char* data, size_t length);
+    static bool contains(const char* name, const char* query, size_t length);
+
+    NameAt _nameAt;
+    std::vector<uint64_t> _signatures; // По позициям вектора владельца
+};
+
+#endif // NAME_SEARCH_H
@@ -0,0 +1,73 @@
+#ifndef OTP_HASH_H
+#define OTP_HASH_H
+
+#include <Arduino.h>
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/sha512.h"
+
+/**
+ * @brief HMAC-SHA1/SHA-256/SHA-512 для OTP с предвычисленными контекстами mbedtls
+ *
+ * HMAC(K, m) = H((K ^ opad) || H((K ^ ipad) || m)). Блоки K ^ ipad и K ^ opad
+ * зависят только от ключа, поэтому контексты хеша после них вычисляются один
+ * раз при подготовке ключа, а на каждый код клонируются (mbedtls_sha*_clone) и
+ * дописываются сообщением. Хеширование выполняет mbedtls со своим ускорением:
+ * на ESP32 с DMA SHA (S2/S3/C3) - аппаратно; классический ESP32 не умеет
+ * продолжать хеш с сохраненного состояния, и клоны досчитываются программно.
+ */
+struct Sha1 {
+    typedef mbedtls_sha1_context Context;
+    static const size_t kBlockSize = 64;
+    static const size_t kDigestSize = 20;
+
+    static void init(Context* ctx);
+    static void free(Context* ctx);
+    static void clone(Context* dst, const Context* src);
+    static void starts(Context* ctx);
+    static void update(Context* ctx, const uint8_t* data, size_t len);
+    static void finish(Context* ctx, uint8_t digest[kDigestSize]);
+};
+
+struct Sha256 {
+    typedef mbedtls_sha256_context Context;
+    static const size_t kBlockSize = 64;
+    static const size_t kDigestSize = 32;
+
+    static void init(Context* ctx);
+    static void free(Context* ctx);
+    static void clone(Context* dst, const Context* src);
+    static void starts(Context* ctx);
+    static void update(Context* ctx, const uint8_t* data, size_t len);
+    static void finish(Context* ctx, uint8_t digest[kDigestSize]);
+};
+
+struct Sha512 {
+    typedef mbedtls_sha512_context Context;
+    static const size_t kBlockSize = 128;
+    static const size_t kDigestSize = 64;
+
+    static void init(Context* ctx);
+    static void free(Context* ctx);
+    static void clone(Context* dst, const Context* src);
+    static void starts(Context* ctx);
+    static void update(Context* ctx, const uint8_t* data, size_t len);
+    static void finish(Context* ctx, uint8_t digest[kDigestSize]);
+};
+
+// Контексты HMAC после блоков K ^ ipad и K ^ opad. Хранятся в программном
+// режиме (без занятого аппаратного движка), поэтому копируются и стираются
+// как обычная память. Инстанцируется в otp_hash.cpp для Sha1, Sha256 и Sha512.
+template <typename Hash>
+struct HmacMidstate {
+    typename Hash::Context inner;
+    typename Hash::Context outer;
+
+    // Ключ не длиннее блока хеша (TOTP_MAX_SECRET_BYTES <= Hash::kBlockSize)
+    void prepare(const uint8_t* key, size_t keyLen);
+
+    // HMAC от 8-байтного сообщения (счетчик HOTP/TOTP) - по одному блоку на каждый хеш
+    void compute(const uint8_t message[8], uint8_t digest[Hash::kDigestSize]) const;
+};
+
+#endif // OTP_HASH_H
@@ -0,0 +1,19 @@
+#ifndef OTP_HMAC_BENCHMARK_H
+#define OTP_HMAC_BENCHMARK_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Сравнение HMAC для OTP на устройстве: mbedtls_md_hmac против HmacMidstate
+ *
+ * Собирается только с флагом -DOTP_HMAC_BENCHMARK=1 (см. platformio.ini) и
+ * запускается из setup(). Для SHA1, SHA256 и SHA512 считает одну и ту же серию
+ * кодов полным HMAC mbedtls (как до предвычисления контекстов) и через
+ * клонирование контекстов ключа, сверяет дайджесты и пишет время на код в лог.
+ */
+class OtpHmacBenchmark {
+public:
+    static void run();
+};
+
+#endif // OTP_HMAC_BENCHMARK_H
@@ -47,6 +47,10 @@ public:
     // ⚡ IRAM_ATTR - критичные функции в IRAM для максимальной скорости
     IRAM_ATTR bool encryptResponse(const String& clientId, const String& plaintext, String& encryptedJson);
     IRAM_ATTR bool decryptRequest(const String& clientId, const String& encryptedJson, String& plaintext);
+    // Потоковая расшифровка больших тел (импорт): счетчик принимается один раз,
+    // затем шифротекст расшифровывается на месте порциями, offset - позиция порции в data
+    bool acceptRequestCounter(const String& clientId, uint64_t counter);
+    bool decryptRequestChunk(const String& clientId, const uint8_t* iv, size_t offset, uint8_t* data, size_t len);
     
     // Session management
     bool isSecureSessionValid(const String& clientId);
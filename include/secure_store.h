@@ -0,0 +1,460 @@
+#ifndef SECURE_STORE_H
+#define SECURE_STORE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "config.h"
+#include "inline_string.h"
+#include "name_index.h"
+#include "name_search.h"
+#include "vault_file.h"
+#include "write_behind.h"
+
+/**
+ * @brief Схема записи хранилища (специализируется для каждого вида записей)
+ *
+ * Специализация RecordSchema<T> описывает во время компиляции:
+ *   kKind                        - вид VaultFile (readVault/writeVault);
+ *   kMaxNameLength               - предел длины имени (validName);
+ *   readJson(obj, entry, order)  - запись журнала/импорта -> entry;
+ *   writeJson(obj, entry)        - entry -> запись журнала;
+ *   readField(entry, field)      - поле VaultFile -> entry;
+ *   writeFields(writer, entry)   - entry -> поля VaultFile;
+ *   wipe(entry)                  - затирает секреты записи в освобождаемой копии
+ *                                  (снимок читателей, копия для отката пакета).
+ * Нужны только функции, которыми пользуется владелец хранилища.
+ */
+template <typename T>
+struct RecordSchema;
+
+// Имя записи ключа или пароля: фиксированный слот внутри записи; имена прежних
+// форматов длиннее слота хранятся целиком в куче
+typedef SpillString<VAULT_NAME_SLOT_SIZE> EntryName;
+
+/**
+ * @brief Неизменяемый снимок набора записей (чтение из других задач)
+ *
+ * Писатель после изменения публикует новый снимок (SecureStore::publish()),
+ * читатель берет текущий без блокировки писателей и читает его сколько нужно:
+ * снимок живет, пока на него есть ссылка, и не меняется (RCU). Копирование
+ * снимка - копирование указателя. Последний читатель затирает секреты записей.
+ */
+template <typename T>
+class StoreSnapshot {
+public:
+    struct Data {
+        uint32_t generation = 0;
+        std::vector<T> entries;
+
+        ~Data() {
+            for (T& entry : entries) {
+                RecordSchema<T>::wipe(entry);
+            }
+        }
+    };
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    StoreSnapshot() : _data(emptyData()) {}
+    explicit StoreSnapshot(const std::shared_ptr<const Data>& data) : _data(data ? data : emptyData()) {}
+
+    const std::vector<T>& entries() const { return _data->entries; }
+    uint32_t generation() const { return _data->generation; }
+    size_t size() const { return _data->entries.size(); }
+    bool empty() const { return _data->entries.empty(); }
+    const T& operator[](size_t index) const { return _data->entries[index]; }
+    const_iterator begin() const { return _data->entries.begin(); }
+    const_iterator end() const { return _data->entries.end(); }
+
+private:
+    static const std::shared_ptr<const Data>& emptyData() {
+        static const std::shared_ptr<const Data> data = std::make_shared<Data>();
+        return data;
+    }
+
+    std::shared_ptr<const Data> _data;
+};
+
+/**
+ * @brief Упорядоченный набор записей хранилища с хэш-индексом имени и id
+ *
+ * Общая часть KeyManager и PasswordManager: записи упорядочены по order,
+ * имеют стабильный id (записи журнала) и уникальное имя (NameIndex, O(1));
+ * NameSearch ищет записи по подстроке имени.
+ * Хранилище меняет только память; запись на flash (журнал, снимок, секреты)
+ * остается за владельцем. T - запись с полями name, order и id.
+ * Записи со строками фиксированной емкости (EntryName) лежат одним блоком;
+ * блок растет шагами по VAULT_SLAB_STEP записей и ужимается после удалений.
+ * Статические readVault/writeVault - потоковое чтение и запись записей T в
+ * VaultFile без экземпляра (в т.ч. для WiFi с единственной записью).
+ */
+template <typename T, typename Schema = RecordSchema<T> >
+class SecureStore {
+public:
+    SecureStore()
+        : _index([this](uint32_t position) -> const char* { return _entries[position].name.c_str(); }),
+          _search([this](uint32_t position) -> const char* { return _entries[position].name.c_str(); }) {}
+    SecureStore(const SecureStore&) = delete;
+    SecureStore& operator=(const SecureStore&) = delete;
+
+    typedef StoreSnapshot<T> Snapshot;
+
+    // Записи по порядку order (для писателя). Ссылка действительна до следующего
+    // изменения (generation()); другие задачи читают snapshot().
+    const std::vector<T>& entries() const { return _entries; }
+
+    // Последний опубликованный снимок
+    Snapshot snapshot() const { return Snapshot(std::atomic_load(&_published)); }
+    // Публикует текущий набор, если он изменился после прошлой публикации.
+    // Между holdPublish() и releasePublish() (пакет изменений) читатели видят
+    // снимок до пакета: набор копируется один раз в конце, а не на каждую операцию.
+    void publish() {
+        if (_publishHeld || (_published && _publishedGeneration == _generation)) {
+            return;
+        }
+        std::shared_ptr<typename Snapshot::Data> data = std::make_shared<typename Snapshot::Data>();
+        data->generation = _generation;
+        data->entries = _entries;
+        std::atomic_store(&_published, std::shared_ptr<const typename Snapshot::Data>(data));
+        _publishedGeneration = _generation;
+    }
+    void holdPublish() { _publishHeld = true; }
+    void releasePublish() { _publishHeld = false; }
+    size_t size() const { return _entries.size(); }
+    bool empty() const { return _entries.empty(); }
+    bool validIndex(int index) const { return index >= 0 && index < (int)_entries.size(); }
+    // Занятая записями память (включая свободные слоты блока)
+    size_t capacity() const { return _entries.capacity(); }
+    size_t storageBytes() const { return _entries.capacity() * sizeof(T); }
+    // Изменяемая запись; имя меняется только через rename(), id и order - не меняются
+    T& at(size_t index) { return _entries[index]; }
+    const T& at(size_t index) const { return _entries[index]; }
+
+    // Позиция записи; -1 - нет такой записи
+    int findByName(const String& name) const { return _index.findByName(name); }
+    int findById(uint32_t id) const { return _index.findById(id); }
+
+    // Позиции записей с подстрокой query в имени (без учета регистра ASCII), по
+    // порядку order; не больше limit. Возвращает общее число совпадений.
+    size_t search(const String& query, std::vector<uint32_t>& positions, size_t limit = 0) const {
+        return _search.find(query, positions, limit);
+    }
+
+    // Счетчик изменений набора (растет при каждой мутации, используется кэшами)
+    uint32_t generation() const { return _generation; }
+    void touch() { _generation++; }
+
+    uint32_t nextId() const { return _nextId; }
+    uint32_t allocateId() { return _nextId++; }
+
+    // Непустое имя не длиннее предела схемы
+    static bool validName(const String& name) {
+        return name.length() > 0 && name.length() <= Schema::kMaxNameLength;
+    }
+
+    // Запись с готовыми id и order в конец (загрузка, импорт)
+    T& push(const T& entry) {
+        if (_entries.size() == _entries.capacity()) {
+            _entries.reserve(_entries.size() + VAULT_SLAB_STEP); // Шагом, а не удвоением
+        }
+        _entries.push_back(entry);
+        _index.insert(_entries.back().name.c_str(), entry.id, (uint32_t)(_entries.size() - 1));
+        _search.append(_entries.back().name.c_str());
+        if (entry.id >= _nextId) {
+            _nextId = entry.id + 1;
+        }
+        return _entries.back();
+    }
+
+    // Новая запись: следующий id и порядок после последней
+    T& append(T entry) {
+        // Записи упорядочены по order: максимальный порядок - у последней
+        entry.order = (_entries.empty() ? 0 : std::max(0, _entries.back().order)) + 1;
+        entry.id = _nextId++;
+        touch();
+        return push(entry);
+    }
+
+    void rename(size_t index, const String& name) {
+        if (_entries[index].name != name) {
+            _entries[index].name = name;
+            _index.rename(_entries[index].id, _entries[index].name.c_str());
+            _search.update((uint32_t)index, _entries[index].name.c_str());
+        }
+    }
+
+    // Удаляет запись, возвращает ее id
+    uint32_t erase(size_t index) {
+        uint32_t id = _entries[index].id;
+        _index.erase(id);
+        _search.erase((uint32_t)index);
+        _entries.erase(_entries.begin() + index);
+        reindexFrom(index);
+        compact();
+        touch();
+        return id;
+    }
+
+    // Новый порядок по именам; изменившиеся пары [id, order] добавляются в changes
+    // (запись журнала ORDER). false - порядок не изменился.
+    bool reorder(const std::vector<std::pair<String, int> >& newOrder, JsonArray changes) {
+        bool changed = false;
+        for (const auto& item : newOrder) {
+            int position = _index.findByName(item.first);
+            if (position >= 0 && _entries[position].order != item.second) {
+                T& entry = _entries[position];
+                entry.order = item.second;
+                changed = true;
+                JsonArray pair = changes.add<JsonArray>();
+                pair.add(entry.id);
+                pair.add(entry.order);
+            }
+        }
+        if (changed) {
+            sortByOrder();
+            touch();
+        }
+        return changed;
+    }
+
+    // Упорядочивает записи и перестраивает индекс
+    void sortByOrder() {
+        // stable_sort: записи с одинаковым order сохраняют взаимный порядок
+        std::stable_sort(_entries.begin(), _entries.end(), [](const T& a, const T& b) {
+            return a.order < b.order;
+        });
+        rebuildIndex();
+    }
+
+    // Удаляет все записи и освобождает память
+    void clear(uint32_t nextId = 1) {
+        std::vector<T>().swap(_entries);
+        _index.clear();
+        _search.clear();
+        _nextId = nextId;
+    }
+
+    // Подменяет набор целиком (загрузка, импорт): entries забирается, набор упорядочивается
+    void assign(std::vector<T>& entries, uint32_t nextId) {
+        _entries.swap(entries);
+        std::vector<T>().swap(entries);
+        compact();
+        _nextId = nextId;
+        for (const auto& entry : _entries) {
+            if (entry.id >= _nextId) {
+                _nextId = entry.id + 1;
+            }
+        }
+        sortByOrder();
+        touch();
+    }
+
+    // Меняет местами записи с копией того же порядка (например, с новыми смещениями
+    // секретов после перезаписи): индекс остается верным
+    void swapSameOrder(std::vector<T>& entries) { _entries.swap(entries); }
+
+    // Забирает записи (набор пустеет, nextId сохраняется)
+    void release(std::vector<T>& out) {
+        out.swap(_entries);
+        std::vector<T>().swap(_entries);
+        _index.clear();
+        _search.clear();
+    }
+
+    // --- Воспроизведение журнала (записи адресуются по id) ---
+
+    // UPSERT: запись заменяется или добавляется; возвращает ее позицию
+    size_t applyUpsert(uint32_t id, JsonObjectConst obj) {
+        T entry;
+        Schema::readJson(obj, entry, 0);
+        entry.id = id;
+        int index = _index.findById(id);
+        if (index < 0) {
+            push(entry);
+            return _entries.size() - 1;
+        }
+        bool renamed = _entries[index].name != entry.name;
+        _entries[index] = entry;
+        if (renamed) {
+            _index.rename(id, _entries[index].name.c_str());
+            _search.update((uint32_t)index, _entries[index].name.c_str());
+        }
+        if (id >= _nextId) {
+            _nextId = id + 1;
+        }
+        return (size_t)index;
+    }
+
+    void applyRemove(uint32_t id) {
+        int index = _index.findById(id);
+        if (index >= 0) {
+            _index.erase(id);
+            _search.erase((uint32_t)index);
+            _entries.erase(_entries.begin() + index);
+            reindexFrom(index);
+            compact();
+        }
+    }
+
+    // ORDER: пары [id, order]; порядок восстанавливается sortByOrder() после журнала
+    void applyOrder(JsonArrayConst pairs) {
+        for (JsonArrayConst pair : pairs) {
+            int index = _index.findById(pair[0] | (uint32_t)0);
+            if (index >= 0) {
+                _entries[index].order = pair[1] | _entries[index].order;
+            }
+        }
+    }
+
+    // Запись журнала UPSERT для записи
+    static String toJson(const T& entry) {
+        JsonDocument doc;
+        Schema::writeJson(doc.template to<JsonObject>(), entry);
+        String payload;
+        serializeJson(doc, payload);
+        return payload;
+    }
+
+    static void readJson(JsonObjectConst obj, T& entry, int defaultOrder) {
+        Schema::readJson(obj, entry, defaultOrder);
+    }
+
+    // --- Пакет изменений: копия набора для отката ---
+
+    void saveBackup() {
+        _backup = _entries;
+        _backupNextId = _nextId;
+    }
+
+    void restoreBackup() {
+        _entries.swap(_backup);
+        _nextId = _backupNextId;
+        rebuildIndex();
+        touch();
+        dropBackup();
+    }
+
+    void dropBackup() {
+        for (T& entry : _backup) {
+            Schema::wipe(entry);
+        }
+        std::vector<T>().swap(_backup);
+    }
+
+    // --- Снимок VaultFile ---
+
+    // Все записи файла; out меняется только после проверки tag всего файла
+    static bool readVault(const char* path, std::vector<T>& out, size_t* fileSize = nullptr) {
+        VaultFileReader reader(Schema::kKind);
+        if (!reader.open(path)) {
+            return false;
+        }
+        std::vector<T> loaded;
+        VaultFileReader::Field field;
+        while (reader.next(field)) {
+            if (field.tag == VAULT_TAG_ENTRY) {
+                loaded.emplace_back();
+                continue;
+            }
+            if (loaded.empty()) {
+                loaded.emplace_back(); // Файл из одной записи без маркера
+            }
+            Schema::readField(loaded.back(), field);
+        }
+        if (!reader.finish()) {
+            return false;
+        }
+        if (fileSize) {
+            *fileSize = reader.size();
+        }
+        out.swap(loaded);
+        return true;
+    }
+
+    // Записывает записи во временный файл и атомарно заменяет path
+    static bool writeVault(const char* path, const std::vector<T>& records, size_t* fileSize = nullptr) {
+        VaultFileWriter writer(Schema::kKind);
+        if (!writer.open(path)) {
+            return false;
+        }
+        for (const auto& record : records) {
+            writer.beginEntry();
+            Schema::writeFields(writer, record);
+        }
+        if (!writer.commit()) {
+            return false;
+        }
+        if (fileSize) {
+            *fileSize = writer.size();
+        }
+        return true;
+    }
+
+private:
+    void rebuildIndex() {
+        _index.clear();
+        _index.reserve(_entries.size());
+        _search.clear();
+        _search.reserve(_entries.size());
+        for (size_t i = 0; i < _entries.size(); i++) {
+            _index.insert(_entries[i].name.c_str(), _entries[i].id, (uint32_t)i);
+            _search.append(_entries[i].name.c_str());
+        }
+    }
+
+    // Блок ужимается, когда свободных слотов больше двух шагов: записи
+    // переезжают в блок по размеру (индекс хранит позиции, а не адреса)
+    void compact() {
+        if (_entries.capacity() - _entries.size() > 2 * VAULT_SLAB_STEP) {
+            std::vector<T> packed;
+            packed.reserve(_entries.size() + VAULT_SLAB_STEP);
+            packed.insert(packed.end(), _entries.begin(), _entries.end());
+            _entries.swap(packed);
+        }
+    }
+
+    // Позиции сдвинулись после удаления
+    void reindexFrom(size_t position) {
+        for (size_t i = position; i < _entries.size(); i++) {
+            _index.setPosition(_entries[i].id, (uint32_t)i);
+        }
+    }
+
+    std::vector<T> _entries;
+    NameIndex _index; // Имя/id -> позиция в _entries; обновляется при каждом изменении
+    NameSearch _search; // Сигнатуры триграмм имен по позициям _entries
+    uint32_t _generation = 0;
+    uint32_t _nextId = 1;
+
+    std::vector<T> _backup; // Состояние до начала пакета
+    uint32_t _backupNextId = 0;
+
+    std::shared_ptr<const typename Snapshot::Data> _published; // Только через atomic_load/atomic_store
+    uint32_t _publishedGeneration = 0;
+    bool _publishHeld = false;
+};
+
+/**
+ * @brief Область изменения хранилища
+ *
+ * Блокирует других писателей (рекурсивный мьютекс владельца, он же защищает
+ * запись на flash) и при выходе публикует снимок, если набор изменился.
+ * Читатели снимков не блокируются.
+ */
+template <typename Store>
+class StoreWriter {
+public:
+    StoreWriter(Store& store, SemaphoreHandle_t mutex) : _store(store), _lock(mutex) {}
+    ~StoreWriter() { _store.publish(); }
+    StoreWriter(const StoreWriter&) = delete;
+    StoreWriter& operator=(const StoreWriter&) = delete;
+
+private:
+    Store& _store;
+    PersistLock _lock; // Освобождается после публикации
+};
+
+#endif // SECURE_STORE_H
@@ -0,0 +1,89 @@
+#ifndef TIME_CONTINUITY_H
+#define TIME_CONTINUITY_H
+
+#include <Arduino.h>
+#include <time.h>
+
+class ConfigManager;
+
+// Откуда известно текущее системное время
+enum class TimeSource : uint8_t {
+    NONE = 0,       // Времени нет
+    CHECKPOINT,     // Восстановлено из контрольной точки после потери питания: известна только нижняя граница
+    RTC,            // Часы пережили сон/программную перезагрузку после синхронизации
+    SNTP,           // Синхронизировано по сети в текущем запуске
+    MANUAL          // Установлено из браузера (/api/time_settings)
+};
+
+// Оценка точности системных часов
+struct TimeConfidence {
+    TimeSource source = TimeSource::NONE;
+    bool bounded = false;           // false - погрешность неизвестна (только нижняя граница)
+    uint32_t uncertaintyMs = 0;     // ± погрешность, если bounded
+    uint32_t secondsSinceSync = 0;
+    bool driftKnown = false;
+    float driftPpm = 0.0f;          // > 0 - локальные часы отстают
+};
+
+/**
+ * @brief Непрерывность времени между сном, перезагрузками и синхронизациями
+ *
+ * Контрольные точки epoch хранятся в RTC памяти (каждые TIME_RTC_CHECKPOINT_SEC,
+ * переживают программную перезагрузку и сон) и во flash (каждые
+ * TIME_FLASH_CHECKPOINT_SEC и перед сном/перезагрузкой, переживают потерю питания).
+ * При каждой SNTP синхронизации сравнивает локальные часы с сетевым временем и
+ * уточняет оценку ухода кварца; по ней строится интервал погрешности.
+ * begin() вызывается сразу после монтирования LittleFS, чтобы часы (и TOTP)
+ * были доступны до выбора режима и без сети.
+ */
+class TimeContinuity {
+public:
+    static TimeContinuity& getInstance();
+
+    // Восстанавливает системные часы при старте; true - время пригодно для TOTP
+    bool begin(ConfigManager& configManager);
+
+    // SNTP: вызвать перед запуском синхронизации и после ее успешного завершения
+    void beginExternalSync();
+    void completeExternalSync();
+
+    // Время установлено вручную (уже применено через settimeofday)
+    void recordManualSync();
+
+    // Периодические контрольные точки (из loop())
+    void loop();
+
+    // Контрольная точка перед сном/перезагрузкой; forceFlash - записать и во flash
+    void checkpoint(bool forceFlash);
+
+    bool hasUsableTime() const;
+    TimeConfidence getConfidence() const;
+    static const char* sourceName(TimeSource source);
+
+private:
+    TimeContinuity() = default;
+    TimeContinuity(const TimeContinuity&) = delete;
+    TimeContinuity& operator=(const TimeContinuity&) = delete;
+
+    void recordSync(TimeSource source, uint16_t uncertaintyMs);
+    void updateDrift(double offsetSeconds, double elapsedSeconds);
+    void writeRtcRecord(time_t now);
+    void writeFlashCheckpoint(time_t now);
+
+    ConfigManager* _configManager = nullptr;
+    TimeSource _source = TimeSource::NONE;
+    time_t _lastSyncEpoch = 0;
+    uint16_t _syncUncertaintyMs = 0;
+    bool _driftKnown = false;
+    float _driftPpm = 0.0f;
+
+    time_t _lastRtcCheckpoint = 0;
+    time_t _lastFlashCheckpoint = 0;
+
+    // Состояние для beginExternalSync()/completeExternalSync()
+    bool _syncPending = false;
+    int64_t _syncStartLocalUs = 0;
+    int64_t _syncStartTimerUs = 0;
+};
+
+#endif // TIME_CONTINUITY_H
@@ -0,0 +1,72 @@
+#ifndef TOTP_CODE_CACHE_H
+#define TOTP_CODE_CACHE_H
+
+#include <Arduino.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "key_manager.h"
+#include "totp_generator.h"
+
+/**
+ * @brief Кэш TOTP кодов, привязанный к временному окну
+ *
+ * Код каждого ключа вычисляется один раз за окно его периода и
+ * переиспользуется дисплеем, прямым /api/keys и tunneled /api/keys.
+ * Коды считаются лениво, только для запрошенных ключей: страница из 20 ключей
+ * стоит не больше 20 HMAC, сколько бы ключей ни было в хранилище.
+ * За TOTP_PREROLL_SECONDS до границы окна заранее считается код следующего
+ * окна, поэтому на самой границе код только копируется.
+ * Весь кэш сбрасывается при изменении набора ключей в KeyManager (в том
+ * числе при изменении счетчика HOTP ключа).
+ * Порядок кодов совпадает с порядком KeyManager::getAllKeys().
+ */
+class TOTPCodeCache {
+public:
+    TOTPCodeCache(KeyManager& keyManager, TOTPGenerator& totpGenerator);
+    void begin();
+
+    // Код ключа по индексу в буфер вызывающего, без обращений к куче.
+    // NOT_SYNCED - TOTP ключ при несинхронизированных часах, INVALID_KEY - индекс
+    // вне диапазона или ключ не декодирован.
+    OtpStatus getCode(size_t index, char* output, size_t outputSize);
+
+    // Код следующего окна TOTP ключа. Доступен за TOTP_PREROLL_SECONDS до границы
+    // окна (false - еще не посчитан или ключ HOTP).
+    bool getNextCode(size_t index, char* output, size_t outputSize);
+
+    // Код ключа строкой (пустая строка, если кода нет); для редких вызовов вне горячего пути
+    String getCode(size_t index);
+
+    // Принудительный сброс (например, после ручной установки времени)
+    void invalidate();
+
+    // Количество вычисленных кодов (для диагностики)
+    uint32_t getRefreshCount() const { return _refreshCount; }
+
+private:
+    // Проверяет generation набора ключей и обновляет код ключа index
+    void refreshEntry(size_t index);
+
+    KeyManager& _keyManager;
+    TOTPGenerator& _totpGenerator;
+    SemaphoreHandle_t _mutex = nullptr;
+
+    struct Entry {
+        bool computed = false; // Код еще не запрашивался после сброса
+        char code[OTP_CODE_BUFFER_SIZE];
+        OtpStatus status = OtpStatus::INVALID_KEY;
+        bool counterBased = false;
+        uint64_t timeStep = 0; // Окно TOTP или счетчик HOTP
+        char nextCode[OTP_CODE_BUFFER_SIZE];
+        OtpStatus nextStatus = OtpStatus::INVALID_KEY;
+        bool nextReady = false;
+    };
+
+    std::vector<Entry> _entries;
+    uint32_t _keysGeneration = 0;
+    bool _valid = false;
+    uint32_t _refreshCount = 0;
+};
+
+#endif // TOTP_CODE_CACHE_H
@@ -2,14 +2,124 @@
 #define TOTP_GENERATOR_H
 
 #include <Arduino.h>
+#include <time.h>
+#include "config.h"
+#include "otp_hash.h"
+
+// Максимальная длина декодированного секрета (не больше блока самого короткого хеша)
+#define TOTP_MAX_SECRET_BYTES 64
+
+// Размер буфера под код: OTP_MAX_DIGITS цифр + '\0'
+#define OTP_CODE_BUFFER_SIZE (OTP_MAX_DIGITS + 1)
+
+enum class OtpAlgorithm : uint8_t {
+    SHA1 = 0,
+    SHA256 = 1,
+    SHA512 = 2
+};
+
+enum class OtpType : uint8_t {
+    TOTP = 0,   // RFC 6238: счетчик - номер временного окна
+    HOTP = 1    // RFC 4226: счетчик хранится в KeyManager
+};
+
+// Параметры OTP отдельного ключа (значения по умолчанию - классический Google Authenticator)
+struct OtpParams {
+    OtpType type = OtpType::TOTP;
+    OtpAlgorithm algorithm = OtpAlgorithm::SHA1;
+    uint8_t digits = CONFIG_TOTP_DIGITS;
+    uint16_t period = CONFIG_TOTP_STEP_SIZE;
+
+    bool isCounterBased() const { return type == OtpType::HOTP; }
+
+    bool isDefault() const {
+        return type == OtpType::TOTP && algorithm == OtpAlgorithm::SHA1 && digits == CONFIG_TOTP_DIGITS && period == CONFIG_TOTP_STEP_SIZE;
+    }
+};
+
+// Результат генерации кода в буфер вызывающего
+enum class OtpStatus : uint8_t {
+    OK = 0,
+    INVALID_KEY,        // Секрет не декодирован или параметры не поддерживаются
+    NOT_SYNCED,         // Часы не синхронизированы (только TOTP)
+    BUFFER_TOO_SMALL
+};
+
+struct TOTPKeyMaterial;
+
+// Специализированные на этапе компиляции функции движка (выбираются по таблице в prepareKey)
+typedef uint32_t (*OtpCodeFn)(const TOTPKeyMaterial& material, uint64_t counter);
+typedef uint64_t (*OtpCounterFn)(time_t now, uint16_t period);
+
+// Ключевой материал TOTP: Base32 секрет декодируется один раз при загрузке/изменении ключа,
+// чтобы горячий путь генерации кода не выполнял декодирование на каждом тике.
+// Вместе с секретом хранятся контексты HMAC после K ^ ipad и K ^ opad, поэтому
+// на код хешируется по одному блоку на внутренний и внешний хеш.
+struct TOTPKeyMaterial {
+    uint8_t secret[TOTP_MAX_SECRET_BYTES];
+    uint8_t secretLen = 0;
+    OtpParams params;
+    OtpCodeFn codeFn = nullptr;
+    OtpCounterFn counterFn = nullptr;
+
+    // Используется только член, соответствующий params.algorithm
+    union {
+        HmacMidstate<Sha1> sha1;
+        HmacMidstate<Sha256> sha256;
+        HmacMidstate<Sha512> sha512;
+    } hmac;
+
+    bool isValid() const { return secretLen > 0 && codeFn != nullptr; }
+};
 
 class TOTPGenerator {
 public:
+    // Генерация кода в буфер вызывающего без обращений к куче.
+    // При статусе отличном от OK в output записывается пустая строка.
+    static OtpStatus generateCode(const TOTPKeyMaterial& material, uint64_t counter, char* output, size_t outputSize);
+
+    // Текстовое представление статуса для API ("NOT SYNCED", "DECODE ERROR")
+    static const char* statusText(OtpStatus status);
+
     // Генерация TOTP кода из секрета в формате Base32
     String generateTOTP(const String& base32Secret);
 
+    // Генерация TOTP кода из заранее декодированного ключевого материала
+    String generateTOTP(const TOTPKeyMaterial& material);
+
+    // Генерация кода для явно заданного временного шага (используется кэшем кодов)
+    String generateTOTP(const TOTPKeyMaterial& material, uint64_t timeStep);
+
+    // Пакет HOTP кодов для счетчиков firstCounter..firstCounter+count-1 за один проход
+    // по уже подготовленным midstate (без повторной подготовки ключа на каждый код)
+    static size_t generateCodes(const TOTPKeyMaterial& material, uint64_t firstCounter, uint32_t* codes, size_t count);
+
+    // Подготовка ключевого материала из Base32 секрета (false - секрет не декодируется
+    // или параметры не поддерживаются)
+    static bool prepareKey(const String& base32Secret, TOTPKeyMaterial& material);
+    static bool prepareKey(const String& base32Secret, const OtpParams& params, TOTPKeyMaterial& material);
+
+    // Поддерживается ли комбинация алгоритма, числа цифр и периода
+    static bool isSupported(const OtpParams& params);
+    static bool parseAlgorithm(const String& name, OtpAlgorithm& algorithm);
+    static const char* algorithmName(OtpAlgorithm algorithm);
+
+    // Форматирование кода с ведущими нулями по таблице степеней десяти (без sprintf)
+    static void formatCode(uint32_t code, uint8_t digits, char* output);
+
+    // Текущий временной шаг с периодом по умолчанию
+    uint64_t getCurrentTimeStep();
+
+    // Временной шаг ключа с учетом его периода
+    uint64_t getTimeStep(const TOTPKeyMaterial& material);
+
     // Получение оставшегося времени до следующего кода
     int getTimeRemaining();
+    int getTimeRemaining(const TOTPKeyMaterial& material);
+
+    // Миллисекунды до начала следующего окна ключа (по gettimeofday, а не по
+    // целым секундам) - позволяет переключить код ровно на границе
+    uint32_t getMillisToNextWindow(const TOTPKeyMaterial& material);
 
     // Проверка синхронизации времени (валидный epoch + подтверждение синхронизации)
     bool isTimeSynced();
@@ -18,10 +128,7 @@ public:
     void markTimeSynchronized();
 
 private:
-    // Вспомогательные функции
-    void hmacSha1(const uint8_t* key, size_t keyLen, const uint8_t* data, size_t dataLen, uint8_t* output);
-    uint32_t dynamicTruncation(uint8_t* hash);
-    size_t base32Decode(const String& base32, uint8_t* output);
+    static size_t base32Decode(const String& base32, uint8_t* output, size_t maxLen);
 
     bool runtimeTimeSynchronized = false;
 };
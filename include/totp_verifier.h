@@ -0,0 +1,84 @@
+#ifndef TOTP_VERIFIER_H
+#define TOTP_VERIFIER_H
+
+#include <Arduino.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "key_manager.h"
+#include "totp_generator.h"
+
+// Размер набора допустимых кодов: окна t-N..t+N
+#define TOTP_VERIFY_SET_SIZE (2 * TOTP_VERIFY_MAX_SKEW + 1)
+
+enum class TotpVerifyStatus : uint8_t {
+    ACCEPTED = 0,
+    REJECTED,       // Код не совпал ни с одним окном в пределах отклонения
+    REPLAYED,       // Код верный, но его окно (или более позднее) уже было принято
+    THROTTLED,      // Превышено TOTP_VERIFY_MAX_FAILURES неудачных попыток в текущем окне
+    NOT_SYNCED,     // Часы не синхронизированы
+    INVALID_KEY,    // Ключ не найден, не декодирован или это HOTP ключ
+    MALFORMED       // Код не состоит из params.digits цифр
+};
+
+struct TotpVerifyResult {
+    TotpVerifyStatus status = TotpVerifyStatus::INVALID_KEY;
+    int offset = 0;         // Смещение принятого окна относительно текущего (-N..+N)
+    uint64_t timeStep = 0;  // Текущее окно ключа
+};
+
+/**
+ * @brief Проверка TOTP кодов ключей устройства (устройство как второй фактор)
+ *
+ * Для каждого ключа хранится набор кодов окон t-N..t+N (N = TOTP_VERIFY_MAX_SKEW).
+ * При смене окна набор сдвигается, и досчитываются только новые окна, поэтому
+ * в установившемся режиме проверка стоит одного HMAC на ключ за окно, а сам
+ * запрос - сравнения с 2N+1 числами. Сравнение выполняется по всему набору
+ * без раннего выхода и без ветвлений по секретным данным.
+ * Повторное использование кода отсекается по последнему принятому окну ключа
+ * (RFC 6238, раздел 5.2): принимаются только окна строго позже него. Состояние
+ * хранится по имени ключа и переживает изменения набора ключей, но не перезагрузку.
+ * Ключевой материал не копируется: состояния ссылаются на записи удерживаемого
+ * снимка KeyManager, который стирает их при освобождении.
+ */
+class TOTPVerifier {
+public:
+    TOTPVerifier(KeyManager& keyManager, TOTPGenerator& totpGenerator);
+    void begin();
+
+    // Проверка кода ключа по имени или по индексу в KeyManager::getAllKeys().
+    // skew - допустимое отклонение в окнах (ограничивается TOTP_VERIFY_MAX_SKEW).
+    TotpVerifyResult verify(const String& name, const char* code, uint8_t skew = TOTP_VERIFY_DEFAULT_SKEW);
+    TotpVerifyResult verify(int index, const char* code, uint8_t skew = TOTP_VERIFY_DEFAULT_SKEW);
+
+    // Текстовое представление статуса для API ("accepted", "replayed", ...)
+    static const char* statusText(TotpVerifyStatus status);
+
+private:
+    // _states[i] соответствует записи _keys[i]
+    struct KeyState {
+        String name;
+        bool setReady = false;
+        uint64_t centerStep = 0;                    // codes[i] - код окна centerStep - N + i
+        uint32_t codes[TOTP_VERIFY_SET_SIZE];
+        bool hasAccepted = false;
+        uint64_t lastAcceptedStep = 0;
+        uint64_t failureStep = 0;
+        uint8_t failures = 0;
+    };
+
+    void syncKeys();
+    int findKey(const String& name) const;
+    TotpVerifyResult verifyLocked(int index, const char* code, uint8_t skew);
+    static void updateAcceptanceSet(KeyState& state, const TOTPKeyMaterial& material, uint64_t timeStep);
+    static bool parseCode(const char* code, uint8_t digits, uint32_t& value);
+
+    KeyManager& _keyManager;
+    TOTPGenerator& _totpGenerator;
+    SemaphoreHandle_t _mutex = nullptr;
+    KeySnapshot _keys;
+    std::vector<KeyState> _states;
+    bool _synced = false;
+};
+
+#endif // TOTP_VERIFIER_H
@@ -0,0 +1,111 @@
+#ifndef VAULT_FILE_H
+#define VAULT_FILE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <vector>
+#include "mbedtls/gcm.h"
+#include "config.h"
+
+// Вид файла входит в аутентифицированный заголовок: файл одного вида нельзя
+// подложить вместо другого
+enum class VaultFileKind : uint8_t {
+    KEYS = 1,
+    WIFI = 2,
+    WEB_ADMIN = 3,
+    SESSION = 4
+};
+
+// Тег 0 без значения начинает новую запись (ключ, сессия и т.п.); остальные
+// теги определяет владелец файла. Неизвестные теги читатель пропускает.
+#define VAULT_TAG_ENTRY 0
+
+/**
+ * @brief Бинарный контейнер зашифрованных файлов хранилища
+ *
+ * Формат: заголовок [magic "TDVF"][версия][вид][резерв 2][nonce 12], затем
+ * поток TLV полей (тег 1 байт, длина varint, значение), зашифрованный
+ * AES-256-GCM ключом записей CryptoManager, и tag 16 байт. Заголовок - AAD.
+ * Шифрование и расшифровка идут порциями по VAULT_FILE_CHUNK байт, поэтому
+ * в памяти нет ни копии файла, ни Base64, ни всего открытого текста.
+ */
+class VaultFileWriter {
+public:
+    explicit VaultFileWriter(VaultFileKind kind);
+    ~VaultFileWriter();
+
+    // Начинает запись во временный файл path.tmp
+    bool open(const char* path);
+
+    void beginEntry();
+    void writeBytes(uint8_t tag, const uint8_t* data, size_t length);
+    void writeString(uint8_t tag, const String& value);
+    void writeUInt(uint8_t tag, uint64_t value);
+
+    // Дописывает tag и атомарно заменяет path; false - файл не изменен
+    bool commit();
+
+    size_t size() const { return _written; }
+
+private:
+    void append(const uint8_t* data, size_t length);
+    void appendVarint(uint64_t value);
+    bool flushChunk(size_t length);
+    void abort();
+
+    VaultFileKind _kind;
+    String _path;
+    String _tmpPath;
+    File _file;
+    mbedtls_gcm_context _gcm;
+    uint8_t _pending[VAULT_FILE_CHUNK];
+    uint8_t _cipher[VAULT_FILE_CHUNK];
+    size_t _pendingLen = 0;
+    size_t _written = 0;
+    bool _open = false;
+    bool _failed = false;
+};
+
+class VaultFileReader {
+public:
+    struct Field {
+        uint8_t tag = 0;
+        const uint8_t* data = nullptr; // Действительно до следующего next()
+        size_t length = 0;
+
+        String asString() const;
+        uint64_t asUInt() const;
+    };
+
+    explicit VaultFileReader(VaultFileKind kind);
+    ~VaultFileReader();
+
+    // false - файла нет, он не в этом формате, другой версии или другого вида
+    bool open(const char* path);
+
+    // Следующее поле; false - конец данных или поврежденная структура
+    bool next(Field& field);
+
+    // Дочитывает данные и проверяет tag. Прочитанному можно доверять только
+    // после true: до этого поля могли быть подменены.
+    bool finish();
+
+    size_t size() const { return _fileSize; }
+
+private:
+    bool ensure(size_t count);
+    bool readVarint(uint64_t& value);
+
+    VaultFileKind _kind;
+    File _file;
+    mbedtls_gcm_context _gcm;
+    std::vector<uint8_t> _buffer; // Расшифрованный текст: окно [_start, _end)
+    size_t _start = 0;
+    size_t _end = 0;
+    size_t _cipherRemaining = 0;
+    size_t _fileSize = 0;
+    bool _open = false;
+    bool _failed = false;
+};
+
+#endif // VAULT_FILE_H
@@ -0,0 +1,24 @@
+#ifndef VAULT_FORMAT_BENCHMARK_H
+#define VAULT_FORMAT_BENCHMARK_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Сравнение форматов хранилища: JSON + AES-CBC + Base64 против VaultFile
+ *
+ * Собирается только с флагом -DVAULT_FORMAT_BENCHMARK=1 (см. platformio.ini) и
+ * запускается из setup() после инициализации CryptoManager. Для 10, 100 и 1000
+ * записей, похожих на TOTP ключи, пишет временный файл в каждом формате и
+ * замеряет время загрузки и пиковый расход кучи. Пик оценивается по свободной
+ * куче, снятой на каждом этапе загрузки. Результаты пишутся в лог.
+ */
+class VaultFormatBenchmark {
+public:
+    static void run();
+
+private:
+    static void benchmarkLegacy(size_t entryCount);
+    static void benchmarkVault(size_t entryCount);
+};
+
+#endif // VAULT_FORMAT_BENCHMARK_H
@@ -0,0 +1,90 @@
+#ifndef VAULT_JOURNAL_H
+#define VAULT_JOURNAL_H
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+
+// Операции журнала. Все идемпотентны: повторное применение уже вошедших в снимок
+// записей (сбой между записью снимка и удалением журнала) не меняет результат.
+enum class JournalOp : uint8_t {
+    UPSERT = 1,     // Полное содержимое записи с данным id (JSON объект)
+    REMOVE = 2,     // Удаление записи с данным id
+    ORDER = 3,      // Новые значения order: JSON массив пар [id, order]
+    SECRET = 4      // Секрет записи id (сырые байты); может читаться отложенно через read()
+};
+
+/**
+ * @brief Append-only журнал зашифрованных изменений хранилища (ключи, пароли)
+ *
+ * Каждая запись - заголовок (magic, номер, id, операция, длина) и полезная
+ * нагрузка, зашифрованная AES-256-GCM (CryptoManager::sealRecord). Заголовок и
+ * домен журнала входят в AAD, поэтому записи нельзя подменить, переставить или
+ * перенести в журнал другого хранилища. Номера записей идут подряд с 1.
+ * Изменение одной записи стоит O(размер записи) байт во flash вместо перезаписи
+ * всего хранилища. Оборванная при потере питания последняя запись (неполный
+ * заголовок или данные короче длины из заголовка) при чтении отбрасывается.
+ * Запись, не прошедшая проверку, или испорченный заголовок - ошибка replay():
+ * файл не меняется, журнал непригоден для записи. Неполная запись при append() (заполненная flash)
+ * сразу обрезается; если обрезать не удалось, журнал непригоден (usable() == false)
+ * до reset()/replaceWith() и владелец пишет полный снимок.
+ * Владелец периодически сворачивает журнал в снимок и вызывает reset().
+ */
+class VaultJournal {
+public:
+    typedef std::function<void(JournalOp op, uint32_t id, const String& payload)> ApplyFn;
+    // Запись SECRET, оставленная зашифрованной: id и смещение для read()
+    typedef std::function<void(uint32_t id, uint32_t offset)> DeferFn;
+
+    VaultJournal(const char* path, uint32_t domain);
+
+    // Применяет все целые записи по порядку; false - ошибка чтения или испорченная
+    // запись (применены только записи до нее, файл не изменен).
+    // Если задан deferred, записи SECRET не расшифровываются: передается только
+    // их смещение, а подлинность проверяется при read().
+    bool replay(const ApplyFn& apply, const DeferFn& deferred = DeferFn());
+
+    // Дописывает запись и закрывает файл (фиксация в LittleFS).
+    // offset - смещение записи в файле для последующего read().
+    // false - запись не добавлена (файл остается прежним или журнал непригоден).
+    bool append(JournalOp op, uint32_t id, const String& payload);
+    bool append(JournalOp op, uint32_t id, const uint8_t* payload, size_t length, uint32_t* offset = nullptr);
+
+    // Расшифровывает одну запись по смещению из append()/DeferFn; id должен совпасть
+    bool read(uint32_t offset, uint32_t id, std::vector<uint8_t>& plain) const;
+
+    // Атомарно заменяет журнал переписанным (rewritten пишется в другой файл
+    // тем же доменом); rewritten после этого пуст
+    bool replaceWith(VaultJournal& rewritten);
+
+    // Удаляет журнал после записи снимка
+    bool reset();
+
+    size_t size() const { return _size; }
+    uint32_t recordCount() const { return _nextSequence - 1; }
+    bool usable() const { return !_broken; }
+
+    // Пора сворачивать: журнал больше VAULT_JOURNAL_COMPACT_BYTES и больше снимка
+    bool needsCompaction(size_t snapshotSize) const;
+
+private:
+    struct __attribute__((packed)) RecordHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t id;
+        uint16_t sealedLen;
+        uint8_t op;
+        uint8_t reserved;
+    };
+
+    void buildAad(const RecordHeader& header, uint8_t* aad) const;
+    bool truncateTo(size_t validSize);
+
+    const char* _path;
+    uint32_t _domain;
+    uint32_t _nextSequence = 1;
+    size_t _size = 0;
+    bool _broken = false; // Мусор после append() не обрезан или replay() не прочитал журнал
+};
+
+#endif // VAULT_JOURNAL_H
@@ -3,7 +3,8 @@
 
 #include <Arduino.h>
 
-#define WEB_ADMIN_FILE "/web_admin.json"
+#define WEB_ADMIN_FILE "/web_admin.vault"
+#define WEB_ADMIN_FILE_LEGACY "/web_admin.json" // JSON + AES-CBC + Base64 до перехода на VaultFile
 #define LOGIN_STATE_FILE "/login_state.json"
 
 class WebAdminManager {
@@ -44,6 +45,9 @@ private:
 
     // Приватные методы
     void loadCredentials();
+    bool readCredentials(String& username, String& hash);
+    bool readLegacyCredentials(String& username, String& hash);
+    bool writeCredentials(const String& username, const String& hash);
     void loadLoginState();
     void saveLoginState();
 };
@@ -1668,7 +1668,9 @@ function updateTOTPDisplay(data) {
     });
 }
 document.getElementById('add-key-form').addEventListener('submit',function(e){e.preventDefault();const name=document.getElementById('key-name').value;const secret=document.getElementById('key-secret').value;const formData=new FormData();formData.append('name',name);formData.append('secret',secret);makeAuthenticatedRequest('/api/add',{method:'POST',body:formData}).then(data=>{CacheManager.invalidate('keys_list');showStatus('密钥添加成功！');fetchKeys();this.reset()}).catch(err=>showStatus('错误：'+err,true))});
-function removeKey(index){if(!confirm('确定执行此操作吗？'))return;const formData=new FormData();formData.append('index',index);makeAuthenticatedRequest('/api/remove',{method:'POST',body:formData}).then(data=>{CacheManager.invalidate('keys_list');showStatus('密钥删除成功！');fetchKeys()}).catch(err=>showStatus('错误：'+err,true))};
+// Запись адресуется стабильным id из списка; индекс - для старых закэшированных списков без id
+function appendEntryRef(formData,entries,index){const entry=entries&&entries[index];if(entry&&entry.id!==undefined){formData.append('id',entry.id)}else{formData.append('index',index)}}
+function removeKey(index){if(!confirm('确定执行此操作吗？'))return;const formData=new FormData();appendEntryRef(formData,keysData,index);makeAuthenticatedRequest('/api/remove',{method:'POST',body:formData}).then(data=>{CacheManager.invalidate('keys_list');showStatus('密钥删除成功！');fetchKeys()}).catch(err=>showStatus('错误：'+err,true))};
 
 // --- MODIFIED Import/Export Logic ---
 let currentAction = null;
@@ -1784,17 +1786,12 @@ function useGeneratedPassword() {
 // Password Edit Modal Functions
 let currentEditIndex = -1;
 
-function editPassword(index) {
-    if (!passwordsData || !passwordsData[index]) {
-        showStatus('未找到密码！', true);
-        return;
-    }
-
-    currentEditIndex = index;
+// Список паролей содержит только имена: сам пароль запрашивается по индексу при необходимости
+function fetchPasswordEntry(index) {
     const formData = new FormData();
-    formData.append('index', index);
+    appendEntryRef(formData, passwordsData, index);
 
-    makeAuthenticatedRequest('/api/passwords/get', { method: 'POST', body: new URLSearchParams(formData) })
+    return makeAuthenticatedRequest('/api/passwords/get', { method: 'POST', body: new URLSearchParams(formData) })
         .then(async response => {
             if (!response.ok) throw new Error('获取密码失败');
 
@@ -1811,12 +1808,26 @@ function editPassword(index) {
                 if (originalData.type === "secure" && (!data || !data.name)) {
                     console.warn('🔐 Password data is encrypted but decryption failed');
                     showStatus('🔐 密码已加密 - 解密失败', true);
-                    return;
+                    return null;
                 }
             } else {
                 data = originalData;
             }
+            return data;
+        });
+}
+
+function editPassword(index) {
+    if (!passwordsData || !passwordsData[index]) {
+        showStatus('未找到密码！', true);
+        return;
+    }
+
+    currentEditIndex = index;
 
+    fetchPasswordEntry(index)
+        .then(data => {
+            if (!data) return;
             document.getElementById('edit-password-name').value = data.name || '';
             document.getElementById('edit-password-value').value = data.password || '';
             updatePasswordStrengthForEdit(data.password || '');
@@ -1916,7 +1927,7 @@ function savePasswordEdit() {
     }
 
     const formData = new FormData();
-    formData.append('index', currentEditIndex);
+    appendEntryRef(formData, passwordsData, currentEditIndex);
     formData.append('name', name);
     formData.append('password', password);
 
@@ -2275,7 +2286,7 @@ function fetchPasswords(){
     });
 }
 document.getElementById('add-password-form').addEventListener('submit',function(e){e.preventDefault();const name=document.getElementById('password-name').value;const password=document.getElementById('password-value').value;const formData=new FormData();formData.append('name',name);formData.append('password',password);makeAuthenticatedRequest('/api/passwords/add',{method:'POST',body:formData}).then(data=>{CacheManager.invalidate('passwords_list');showStatus('密码添加成功！');fetchPasswords();this.reset()}).catch(err=>showStatus('错误：'+err,true))});
-function removePassword(index){if(!confirm('确定执行此操作吗？'))return;const formData=new FormData();formData.append('index',index);makeAuthenticatedRequest('/api/passwords/delete',{method:'POST',body:formData}).then(data=>{CacheManager.invalidate('passwords_list');showStatus('密码删除成功！');fetchPasswords()}).catch(err=>showStatus('错误：'+err,true))};
+function removePassword(index){if(!confirm('确定执行此操作吗？'))return;const formData=new FormData();appendEntryRef(formData,passwordsData,index);makeAuthenticatedRequest('/api/passwords/delete',{method:'POST',body:formData}).then(data=>{CacheManager.invalidate('passwords_list');showStatus('密码删除成功！');fetchPasswords()}).catch(err=>showStatus('错误：'+err,true))};
 
 function copyPassword(index) {
     if (!passwordsData || !passwordsData[index]) {
@@ -2283,20 +2294,27 @@ function copyPassword(index) {
         return;
     }
 
-    const password = passwordsData[index].password;
-
-    // Try modern Clipboard API first
-    if (navigator.clipboard && navigator.clipboard.writeText) {
-        navigator.clipboard.writeText(password).then(() => {
-            showStatus('密码已复制到剪贴板！');
-        }).catch(err => {
-            console.warn('Clipboard API failed:', err);
-            fallbackCopyPassword(password);
+    fetchPasswordEntry(index)
+        .then(data => {
+            if (!data) return;
+            const password = data.password || '';
+
+            // Try modern Clipboard API first
+            if (navigator.clipboard && navigator.clipboard.writeText) {
+                navigator.clipboard.writeText(password).then(() => {
+                    showStatus('密码已复制到剪贴板！');
+                }).catch(err => {
+                    console.warn('Clipboard API failed:', err);
+                    fallbackCopyPassword(password);
+                });
+            } else {
+                // Fallback for older browsers
+                fallbackCopyPassword(password);
+            }
+        })
+        .catch(err => {
+            showStatus('加载密码失败：' + err.message, true);
         });
-    } else {
-        // Fallback for older browsers
-        fallbackCopyPassword(password);
-    }
 }
 
 function fallbackCopyPassword(password) {
@@ -2985,6 +3003,8 @@ class SecureClient {
             '/api/add',               // ✅ POST - добавление TOTP ключа
             '/api/remove',            // ✅ POST - удаление TOTP ключа
             '/api/keys/reorder',      // ✅ POST - переупорядочивание TOTP ключей
+            '/api/keys/batch',        // ✅ POST - пакет изменений TOTP ключей
+            '/api/keys/search',       // ✅ GET - поиск TOTP ключей по имени
             '/api/export',            // ✅ POST - экспорт TOTP ключей
             '/api/import',            // ✅ POST - импорт TOTP ключей
             // Passwords Management
@@ -2994,6 +3014,8 @@ class SecureClient {
             '/api/passwords/delete',
             '/api/passwords/update',
             '/api/passwords/reorder',
+            '/api/passwords/batch',
+            '/api/passwords/search',
             '/api/passwords/export',
             '/api/passwords/import',
             // Display Settings Management
@@ -3134,12 +3156,15 @@ class SecureClient {
             '/api/import',     // 🔐 TOTP key import
             '/api/config',     // 🔐 Server configuration (timeout settings)
             '/api/keys/reorder', // 🔐 TOTP keys reordering
+            '/api/keys/search',  // 🔐 TOTP keys search
             '/api/passwords',  // 🔐 All passwords list
             '/api/passwords/get',
             '/api/passwords/add',
             '/api/passwords/delete',
             '/api/passwords/update',
             '/api/passwords/reorder',
+            '/api/passwords/batch',
+            '/api/passwords/search',
             '/api/passwords/export',
             '/api/passwords/import',
             '/api/pincode_settings',   // 🔐 PIN settings (security configuration)
@@ -3242,13 +3267,14 @@ class SecureClient {
 
         const dataHex = result.map(b => b.toString(16).padStart(2, '0')).join('');
 
-        // Возвращаем JSON в формате ожидаемым сервером
+        // Возвращаем JSON в формате ожидаемым сервером; data последним -
+        // импорт расшифровывается на устройстве потоком по мере приема
         return JSON.stringify({
             type: "secure",
-            data: dataHex,
             iv: ivHex,
             tag: tagHex,
-            counter: this.requestCounter++
+            counter: this.requestCounter++,
+            data: dataHex
         });
     }
 
@@ -7,9 +7,15 @@
 #include "pin_manager.h"
 #include "config_manager.h"
 #include "PasswordManager.h"
+#include "import_stream.h"
+#include "export_stream.h"
+#include <memory>
+#include <functional>
 #include "crypto_manager.h"
 #include "log_manager.h"
 #include "totp_generator.h"
+#include "totp_code_cache.h"
+#include "totp_verifier.h"
 #include "wifi_manager.h"
 
 #ifdef SECURE_LAYER_ENABLED
@@ -25,7 +31,7 @@ class BleKeyboardManager;
 
 class WebServerManager {
 public:
-    WebServerManager(KeyManager& keyManager, SplashScreenManager& splashManager, DisplayManager& displayManager, PinManager& pinManager, ConfigManager& configManager, PasswordManager& passwordManager, TOTPGenerator& totpGenerator);
+    WebServerManager(KeyManager& keyManager, SplashScreenManager& splashManager, DisplayManager& displayManager, PinManager& pinManager, ConfigManager& configManager, PasswordManager& passwordManager, TOTPGenerator& totpGenerator, TOTPCodeCache& totpCodeCache, TOTPVerifier& totpVerifier);
     void start();
     void startConfigServer();
     void stop();
@@ -36,6 +42,9 @@ public:
     void setWifiManager(WifiManager* wifiManager);
     void clearSession(); // Очистка сессии и CSRF токена
 
+    // Значение параметра списка по имени (строка запроса или data туннеля); пусто - нет
+    typedef std::function<String(const char* name)> ListParamFn;
+
 private:
     // Handler Functions
     void handleRoot(AsyncWebServerRequest *request);
@@ -58,6 +67,53 @@ private:
     String generatePasswordsTable();
     String getAdminPasswordHash(); // <-- Added declaration
 
+    // HOTP: пакет следующих кодов (окно ресинхронизации) и переход к следующему
+    // счетчику. Общие для прямых и tunneled запросов; возвращают HTTP статус.
+    int buildHotpLookahead(int index, int count, String& output);
+    int advanceHotpCounter(int index, const String& counter, String& output);
+
+    // Списки /api/keys и /api/passwords: страница по курсору (?limit=&cursor=),
+    // проекция полей (?fields=id,name,code) и выбор записей (?ids=1,2). Коды
+    // считаются только для записей страницы. Общие для прямых и tunneled
+    // запросов; возвращают HTTP статус.
+    int buildKeyList(const ListParamFn& param, String& output);
+    int buildPasswordList(const ListParamFn& param, String& output);
+
+    // Поиск ключей и паролей по подстроке имени (NameSearch). Общие для прямых
+    // и tunneled запросов; возвращают HTTP статус.
+    int buildKeySearch(const String& query, String& output);
+    int buildPasswordSearch(const String& query, String& output);
+
+    // Проверка TOTP кода ключа (по имени или индексу). Общая для прямых и
+    // tunneled запросов; возвращает HTTP статус.
+    int verifyTotpCode(const String& name, int index, const String& code, int skew, String& output);
+
+    // Пакетные изменения ключей и паролей: операции применяются по порядку и
+    // сохраняются одной записью; при ошибке любой операции не меняется ничего.
+    // Общие для прямых и tunneled запросов; возвращают HTTP статус.
+    int applyKeyBatch(JsonVariantConst ops, String& output);
+    int applyPasswordBatch(JsonVariantConst ops, String& output);
+
+    // Импорт ключей (keys = true) или паролей из файла экспорта с заменой всего
+    // набора. Файл разбирается потоково (ImportStream), набор подменяется только
+    // целиком после проверки всех записей. importFromEnvelope - для tunneled
+    // запросов (запрос уже разобран), handleImportBody - тело прямого запроса
+    // порциями. Возвращают/отправляют HTTP статус и сообщение.
+    int importFromEnvelope(bool keys, const char* password, const char* envelope, String& message);
+    void handleImportBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total, bool keys);
+    bool startImport(bool keys);
+    void abortImport(bool keys);
+    ImportStream::EntryFn importEntryHandler(bool keys);
+    int finishImport(ImportStream& stream, bool keys, String& message);
+
+    // Экспорт ключей (keys = true) или паролей в зашифрованный файл. sendExport
+    // отдает файл chunked ответом по мере запроса данных сервером, exportToString
+    // дописывает его в output строкой JSON (fileContent ответа туннеля). Набор записей, изменившийся во время
+    // экспорта, прерывает его.
+    void sendExport(AsyncWebServerRequest* request, bool keys, const String& password);
+    bool exportToString(bool keys, const String& password, String& output);
+    std::shared_ptr<ExportStream> createExport(bool keys, const String& password);
+
     AsyncWebServer server;
     KeyManager& keyManager;
     SplashScreenManager& splashManager;
@@ -66,6 +122,8 @@ private:
     ConfigManager& configManager;
     PasswordManager& passwordManager;
     TOTPGenerator& totpGenerator;
+    TOTPCodeCache& totpCodeCache;
+    TOTPVerifier& totpVerifier;
     BleKeyboardManager* bleKeyboardManager = nullptr;
     WifiManager* wifiManager = nullptr;
 
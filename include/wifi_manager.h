@@ -4,6 +4,20 @@
 #include <Arduino.h>
 #include "display_manager.h"
 #include "config_manager.h"
+#include "secure_store.h"
+
+// Учетные данные WiFi: единственная запись WIFI_CONFIG_FILE
+struct WifiCredentials {
+    String ssid;
+    String password;
+};
+
+template <>
+struct RecordSchema<WifiCredentials> {
+    static const VaultFileKind kKind = VaultFileKind::WIFI;
+    static void readField(WifiCredentials& credentials, const VaultFileReader::Field& field);
+    static void writeFields(VaultFileWriter& writer, const WifiCredentials& credentials);
+};
 
 class WifiManager {
 public:
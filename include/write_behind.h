@@ -0,0 +1,99 @@
+#ifndef WRITE_BEHIND_H
+#define WRITE_BEHIND_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include <vector>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/**
+ * @brief Отложенная запись во flash с объединением изменений
+ *
+ * Владелец состояния регистрирует его (add()) с функцией записи и после
+ * изменения в памяти только отмечает его измененным (markDirty()). loop()
+ * записывает состояние, когда изменения затихли на WRITE_BEHIND_QUIET_MS
+ * (не позже WRITE_BEHIND_MAX_DELAY_MS после первого изменения), поэтому серия
+ * изменений - перетаскивание в списке, переключатели настроек - дает одну
+ * запись. sync() записывает все сразу: перед сном, перезагрузкой и по явному
+ * запросу. Счетчики показывают, сколько изменений объединено и сколько
+ * записей и байт ушло во flash (журналы, снимки хранилищ, /config.json).
+ */
+class WriteBehind {
+public:
+    // false - запись не удалась, состояние остается измененным и пишется повторно
+    typedef std::function<bool()> FlushFn;
+
+    static WriteBehind& getInstance();
+
+    // Регистрация при старте (из begin() владельца); возвращает номер состояния
+    int add(const char* name, FlushFn flush);
+    void markDirty(int sink);
+    bool isDirty(int sink) const;
+
+    // Из loop(): записывает затихшие изменения
+    void loop();
+    // Немедленная запись одного состояния или всех; true - ничего не осталось
+    bool flush(int sink);
+    bool sync();
+
+    // Учет записи во flash (вызывают места записи файлов)
+    static void countFlashWrite(size_t bytes);
+    void toJson(JsonObject obj) const;
+
+private:
+    struct Sink {
+        const char* name;
+        FlushFn flush;
+        bool dirty = false;
+        bool flushing = false;
+        uint32_t firstDirtyAt = 0;
+        uint32_t lastDirtyAt = 0;
+        uint32_t changes = 0;       // Вызовов markDirty()
+        uint32_t flushes = 0;       // Выполненных записей
+        uint32_t failures = 0;
+        uint32_t flushMsTotal = 0;  // Время записи, снятое с обработчиков
+        uint32_t flushMsMax = 0;
+    };
+
+    WriteBehind();
+    WriteBehind(const WriteBehind&) = delete;
+    WriteBehind& operator=(const WriteBehind&) = delete;
+
+    bool due(const Sink& sink, uint32_t now) const;
+
+    std::vector<Sink> _sinks; // Заполняется при старте, дальше не растет
+    SemaphoreHandle_t _mutex = nullptr;
+    static std::atomic<uint32_t> _flashWrites;
+    static std::atomic<uint32_t> _flashBytes;
+};
+
+/**
+ * @brief Блокировка записи хранилища на время области видимости
+ *
+ * Журнал и снимки хранилища пишут обработчики веб-сервера (async_tcp) и
+ * отложенная запись из loop(). Мьютекс рекурсивный: запись изменения может
+ * сразу свернуть журнал в снимок под той же блокировкой.
+ */
+class PersistLock {
+public:
+    explicit PersistLock(SemaphoreHandle_t mutex) : _mutex(mutex) {
+        if (_mutex != nullptr) {
+            xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+        }
+    }
+    ~PersistLock() {
+        if (_mutex != nullptr) {
+            xSemaphoreGiveRecursive(_mutex);
+        }
+    }
+    PersistLock(const PersistLock&) = delete;
+    PersistLock& operator=(const PersistLock&) = delete;
+
+private:
+    SemaphoreHandle_t _mutex;
+};
+
+#endif // WRITE_BEHIND_H
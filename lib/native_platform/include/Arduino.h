@@ -0,0 +1,210 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/**
+ * @brief Минимальная замена Arduino.h для тестов на хосте (env:native)
+ *
+ * Только то, что используют собираемые в тестах модули: String поверх
+ * std::string, время, Serial и атрибуты размещения. Поведение String
+ * повторяет Arduino-ESP32 в той мере, в какой на него опирается код.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <string>
+#include <algorithm>
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+typedef uint8_t byte;
+
+class String {
+public:
+    String() {}
+    String(const char* value) : _value(value ? value : "") {}
+    String(const char* value, size_t length) : _value(value ? std::string(value, length) : std::string()) {}
+    String(const std::string& value) : _value(value) {}
+    explicit String(char value) : _value(1, value) {}
+    explicit String(int value, unsigned char base = 10) : _value(format(value, base)) {}
+    explicit String(unsigned int value, unsigned char base = 10) : _value(format(value, base)) {}
+    explicit String(long value, unsigned char base = 10) : _value(format(value, base)) {}
+    explicit String(unsigned long value, unsigned char base = 10) : _value(format(value, base)) {}
+    explicit String(long long value, unsigned char base = 10) : _value(format(value, base)) {}
+    explicit String(unsigned long long value, unsigned char base = 10) : _value(format(value, base)) {}
+    explicit String(double value, unsigned int decimals = 2) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+        _value = buffer;
+    }
+
+    const char* c_str() const { return _value.c_str(); }
+    unsigned int length() const { return (unsigned int)_value.size(); }
+    bool isEmpty() const { return _value.empty(); }
+    bool reserve(unsigned int size) {
+        _value.reserve(size);
+        return true;
+    }
+
+    bool concat(const String& other) {
+        _value += other._value;
+        return true;
+    }
+    bool concat(const char* value) {
+        if (value) {
+            _value += value;
+        }
+        return value != nullptr;
+    }
+    bool concat(const char* value, unsigned int length) {
+        if (value) {
+            _value.append(value, length);
+        }
+        return value != nullptr;
+    }
+    bool concat(char value) {
+        _value += value;
+        return true;
+    }
+
+    String& operator=(const char* value) {
+        _value = value ? value : "";
+        return *this;
+    }
+    String& operator+=(const String& other) { concat(other); return *this; }
+    String& operator+=(const char* value) { concat(value); return *this; }
+    String& operator+=(char value) { concat(value); return *this; }
+
+    bool equals(const String& other) const { return _value == other._value; }
+    bool operator==(const String& other) const { return _value == other._value; }
+    bool operator==(const char* other) const { return _value == (other ? other : ""); }
+    bool operator!=(const String& other) const { return !(*this == other); }
+    bool operator!=(const char* other) const { return !(*this == other); }
+    bool operator<(const String& other) const { return _value < other._value; }
+
+    const char* begin() const { return _value.c_str(); }
+    const char* end() const { return _value.c_str() + _value.size(); }
+    char* begin() { return &_value[0]; }
+    char* end() { return &_value[0] + _value.size(); }
+
+    char charAt(unsigned int index) const { return index < _value.size() ? _value[index] : '\0'; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return _value[index]; }
+
+    int indexOf(char value, unsigned int from = 0) const { return position(_value.find(value, from)); }
+    int indexOf(const String& value, unsigned int from = 0) const { return position(_value.find(value._value, from)); }
+    int lastIndexOf(char value) const { return position(_value.rfind(value)); }
+    bool startsWith(const String& prefix) const { return _value.compare(0, prefix._value.size(), prefix._value) == 0; }
+    bool endsWith(const String& suffix) const {
+        return _value.size() >= suffix._value.size() &&
+               _value.compare(_value.size() - suffix._value.size(), suffix._value.size(), suffix._value) == 0;
+    }
+    String substring(unsigned int from) const { return from < _value.size() ? String(_value.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) {
+            std::swap(from, to);
+        }
+        return from < _value.size() ? String(_value.substr(from, to - from)) : String();
+    }
+
+    void toLowerCase() { for (char& c : _value) c = (char)tolower((unsigned char)c); }
+    void toUpperCase() { for (char& c : _value) c = (char)toupper((unsigned char)c); }
+    void trim() {
+        size_t first = _value.find_first_not_of(" \t\r\n");
+        size_t last = _value.find_last_not_of(" \t\r\n");
+        _value = first == std::string::npos ? std::string() : _value.substr(first, last - first + 1);
+    }
+    void replace(const String& from, const String& to) {
+        if (from._value.empty()) {
+            return;
+        }
+        for (size_t at = _value.find(from._value); at != std::string::npos; at = _value.find(from._value, at + to._value.size())) {
+            _value.replace(at, from._value.size(), to._value);
+        }
+    }
+    void remove(unsigned int index) { if (index < _value.size()) _value.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < _value.size()) _value.erase(index, count); }
+    long toInt() const { return atol(_value.c_str()); }
+
+    void getBytes(unsigned char* buffer, unsigned int size, unsigned int index = 0) const {
+        if (size == 0) {
+            return;
+        }
+        size_t n = index < _value.size() ? std::min((size_t)size - 1, _value.size() - index) : 0;
+        memcpy(buffer, _value.data() + index, n);
+        buffer[n] = '\0';
+    }
+    void toCharArray(char* buffer, unsigned int size, unsigned int index = 0) const {
+        getBytes((unsigned char*)buffer, size, index);
+    }
+
+private:
+    template <typename T>
+    static std::string format(T value, unsigned char base) {
+        if (base == 10) {
+            return std::to_string(value);
+        }
+        bool negative = value < 0;
+        unsigned long long magnitude = negative ? (unsigned long long)(-(long long)value) : (unsigned long long)value;
+        std::string digits;
+        do {
+            digits += "0123456789abcdef"[magnitude % base];
+            magnitude /= base;
+        } while (magnitude != 0);
+        if (negative) {
+            digits += '-';
+        }
+        return std::string(digits.rbegin(), digits.rend());
+    }
+    static int position(size_t at) { return at == std::string::npos ? -1 : (int)at; }
+
+    std::string _value;
+};
+
+// Свободные функции (не friend): срабатывают и для типов, приводимых к String
+inline String operator+(const String& a, const String& b) {
+    String result(a);
+    result.concat(b);
+    return result;
+}
+inline String operator+(const String& a, const char* b) {
+    String result(a);
+    result.concat(b);
+    return result;
+}
+inline String operator+(const char* a, const String& b) {
+    String result(a);
+    result.concat(b);
+    return result;
+}
+inline String operator+(const String& a, char b) {
+    String result(a);
+    result.concat(b);
+    return result;
+}
+
+// Монотонное время с запуска теста
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// Serial пишет в stdout
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    size_t print(const String& value) { return fputs(value.c_str(), stdout) >= 0 ? value.length() : 0; }
+    size_t println(const String& value) { return print(value) + print("\n"); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,75 @@
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+#include <Arduino.h>
+#include <memory>
+
+/**
+ * @brief LittleFS для тестов на хосте: файлы во временном каталоге
+ *
+ * begin() создает пустой каталог, format() очищает его. Пути хранилищ
+ * ("/keys.vault") отображаются в файлы этого каталога. failWritesAfter()
+ * имитирует заполненную flash: после заданного числа байт write() пишет
+ * только часть данных.
+ */
+namespace fs {
+
+struct FileImpl;
+
+class File {
+public:
+    File() {}
+    explicit File(const std::shared_ptr<FileImpl>& impl) : _impl(impl) {}
+
+    operator bool() const;
+    size_t write(const uint8_t* data, size_t length);
+    size_t write(uint8_t value) { return write(&value, 1); }
+    size_t print(const String& value) { return write((const uint8_t*)value.c_str(), value.length()); }
+    size_t read(uint8_t* buffer, size_t length);
+    int read();
+    int available();
+    String readString();
+    bool seek(uint32_t position);
+    size_t position() const;
+    size_t size() const;
+    void flush();
+    void close();
+
+private:
+    std::shared_ptr<FileImpl> _impl;
+};
+
+class FS {
+public:
+    bool begin(bool formatOnFail = false);
+    bool format();
+    void end() {}
+
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    File open(const char* path, const char* mode = "r");
+    File open(const String& path, const char* mode = "r") { return open(path.c_str(), mode); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to);
+    bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+
+    // Только для тестов: после bytes байт записи обрываются (SIZE_MAX - без ограничения)
+    void failWritesAfter(size_t bytes);
+    // То же для одной записи: после первой неполной write() ограничение снимается
+    void failOneWriteAfter(size_t bytes);
+
+private:
+    String hostPath(const char* path) const;
+
+    String _root;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+extern fs::FS LittleFS;
+
+#endif // NATIVE_LITTLEFS_H
@@ -0,0 +1,11 @@
+#ifndef NATIVE_ESP_SYSTEM_H
+#define NATIVE_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Случайные числа хоста (не для криптографии)
+void esp_fill_random(void* buffer, size_t length);
+uint32_t esp_random();
+
+#endif // NATIVE_ESP_SYSTEM_H
@@ -0,0 +1,41 @@
+#ifndef NATIVE_MBEDTLS_GCM_H
+#define NATIVE_MBEDTLS_GCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Интерфейс mbedtls GCM для тестов на хосте (mbedtls в env:native нет)
+ *
+ * НЕ шифрование: поток XOR от ключа и nonce и 16-байтный тег FNV-1a по AAD и
+ * шифротексту. Сохраняет то, на что опирается код хранилищ: длина не
+ * меняется, порции шифруются потоком, подмена AAD или данных ломает тег.
+ */
+#define MBEDTLS_CIPHER_ID_AES 2
+#define MBEDTLS_GCM_ENCRYPT 1
+#define MBEDTLS_GCM_DECRYPT 0
+#define MBEDTLS_ERR_GCM_AUTH_FAILED -0x0012
+#define MBEDTLS_ERR_GCM_BAD_INPUT -0x0014
+
+typedef struct {
+    uint8_t key[32];
+    int mode;
+    uint64_t stream;    // Состояние потока XOR
+    uint64_t tag[2];    // Накопленный тег
+} mbedtls_gcm_context;
+
+void mbedtls_gcm_init(mbedtls_gcm_context* ctx);
+void mbedtls_gcm_free(mbedtls_gcm_context* ctx);
+int mbedtls_gcm_setkey(mbedtls_gcm_context* ctx, int cipher, const unsigned char* key, unsigned int keybits);
+int mbedtls_gcm_starts(mbedtls_gcm_context* ctx, int mode, const unsigned char* iv, size_t ivLen,
+                       const unsigned char* add, size_t addLen);
+int mbedtls_gcm_update(mbedtls_gcm_context* ctx, size_t length, const unsigned char* input, unsigned char* output);
+int mbedtls_gcm_finish(mbedtls_gcm_context* ctx, unsigned char* tag, size_t tagLen);
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context* ctx, int mode, size_t length, const unsigned char* iv, size_t ivLen,
+                              const unsigned char* add, size_t addLen, const unsigned char* input,
+                              unsigned char* output, size_t tagLen, unsigned char* tag);
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context* ctx, size_t length, const unsigned char* iv, size_t ivLen,
+                             const unsigned char* add, size_t addLen, const unsigned char* tag, size_t tagLen,
+                             const unsigned char* input, unsigned char* output);
+
+#endif // NATIVE_MBEDTLS_GCM_H
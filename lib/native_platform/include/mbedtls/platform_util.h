@@ -0,0 +1,8 @@
+#ifndef NATIVE_MBEDTLS_PLATFORM_UTIL_H
+#define NATIVE_MBEDTLS_PLATFORM_UTIL_H
+
+#include <stddef.h>
+
+void mbedtls_platform_zeroize(void* buffer, size_t length);
+
+#endif // NATIVE_MBEDTLS_PLATFORM_UTIL_H
@@ -0,0 +1,21 @@
+#ifndef NATIVE_MBEDTLS_SHA1_H
+#define NATIVE_MBEDTLS_SHA1_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Интерфейс mbedtls SHA-1 (3.x) для тестов на хосте: программная реализация
+typedef struct {
+    uint64_t total;             // Обработано байт
+    uint32_t state[5];
+    unsigned char buffer[64];
+} mbedtls_sha1_context;
+
+void mbedtls_sha1_init(mbedtls_sha1_context* ctx);
+void mbedtls_sha1_free(mbedtls_sha1_context* ctx);
+void mbedtls_sha1_clone(mbedtls_sha1_context* dst, const mbedtls_sha1_context* src);
+int mbedtls_sha1_starts(mbedtls_sha1_context* ctx);
+int mbedtls_sha1_update(mbedtls_sha1_context* ctx, const unsigned char* input, size_t length);
+int mbedtls_sha1_finish(mbedtls_sha1_context* ctx, unsigned char* output);
+
+#endif // NATIVE_MBEDTLS_SHA1_H
@@ -0,0 +1,21 @@
+#ifndef NATIVE_MBEDTLS_SHA256_H
+#define NATIVE_MBEDTLS_SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Интерфейс mbedtls SHA-256 (3.x) для тестов на хосте: программная реализация, только is224 = 0
+typedef struct {
+    uint64_t total;             // Обработано байт
+    uint32_t state[8];
+    unsigned char buffer[64];
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_clone(mbedtls_sha256_context* dst, const mbedtls_sha256_context* src);
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t length);
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char* output);
+
+#endif // NATIVE_MBEDTLS_SHA256_H
@@ -0,0 +1,21 @@
+#ifndef NATIVE_MBEDTLS_SHA512_H
+#define NATIVE_MBEDTLS_SHA512_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Интерфейс mbedtls SHA-512 (3.x) для тестов на хосте: программная реализация, только is384 = 0
+typedef struct {
+    uint64_t total;             // Обработано байт
+    uint64_t state[8];
+    unsigned char buffer[128];
+} mbedtls_sha512_context;
+
+void mbedtls_sha512_init(mbedtls_sha512_context* ctx);
+void mbedtls_sha512_free(mbedtls_sha512_context* ctx);
+void mbedtls_sha512_clone(mbedtls_sha512_context* dst, const mbedtls_sha512_context* src);
+int mbedtls_sha512_starts(mbedtls_sha512_context* ctx, int is384);
+int mbedtls_sha512_update(mbedtls_sha512_context* ctx, const unsigned char* input, size_t length);
+int mbedtls_sha512_finish(mbedtls_sha512_context* ctx, unsigned char* output);
+
+#endif // NATIVE_MBEDTLS_SHA512_H
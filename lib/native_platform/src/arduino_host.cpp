@@ -0,0 +1,47 @@
+#include <Arduino.h>
+#include <esp_system.h>
+#include <chrono>
+#include <thread>
+
+namespace {
+const std::chrono::steady_clock::time_point kStart = std::chrono::steady_clock::now();
+}
+
+HardwareSerial Serial;
+
+unsigned long millis() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - kStart).count();
+}
+
+unsigned long micros() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - kStart).count();
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written > 0 ? (size_t)written : 0;
+}
+
+void esp_fill_random(void* buffer, size_t length) {
+    uint8_t* bytes = (uint8_t*)buffer;
+    for (size_t i = 0; i < length; i++) {
+        bytes[i] = (uint8_t)rand();
+    }
+}
+
+uint32_t esp_random() {
+    uint32_t value;
+    esp_fill_random(&value, sizeof(value));
+    return value;
+}
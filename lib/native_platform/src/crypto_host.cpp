@@ -0,0 +1,79 @@
+// CryptoManager для тестов на хосте: только запечатывание записей хранилищ
+// (журнал, VaultFile) на постоянном тестовом ключе. Старые форматы (AES-CBC +
+// Base64) на хосте не читаются: decrypt() возвращает пустую строку.
+#include "crypto_manager.h"
+#include <esp_system.h>
+
+CryptoManager& CryptoManager::getInstance() {
+    static CryptoManager instance;
+    return instance;
+}
+
+CryptoManager::CryptoManager() : _isKeyInitialized(false) {
+    begin();
+}
+
+void CryptoManager::begin() {
+    for (size_t i = 0; i < sizeof(_deviceKey); i++) {
+        _deviceKey[i] = (unsigned char)i;
+        _recordKey[i] = (unsigned char)(0xA5 ^ i);
+    }
+    _isKeyInitialized = true;
+}
+
+String CryptoManager::encrypt(const String&) {
+    return String();
+}
+
+String CryptoManager::decrypt(const String&) {
+    return String();
+}
+
+bool CryptoManager::sealRecord(const uint8_t* plain, size_t plainLen, const uint8_t* aad, size_t aadLen, std::vector<uint8_t>& output) {
+    const size_t nonceLen = 12;
+    const size_t tagLen = 16;
+    output.resize(nonceLen + plainLen + tagLen);
+    esp_fill_random(output.data(), nonceLen);
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    int ret = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, _recordKey, 256);
+    if (ret == 0) {
+        ret = mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, plainLen, output.data(), nonceLen,
+                                        aad, aadLen, plain, output.data() + nonceLen,
+                                        tagLen, output.data() + nonceLen + plainLen);
+    }
+    mbedtls_gcm_free(&gcm);
+    if (ret != 0) {
+        output.clear();
+    }
+    return ret == 0;
+}
+
+bool CryptoManager::openRecord(const uint8_t* sealed, size_t sealedLen, const uint8_t* aad, size_t aadLen, std::vector<uint8_t>& output) {
+    const size_t nonceLen = 12;
+    const size_t tagLen = 16;
+    if (sealedLen < nonceLen + tagLen) {
+        return false;
+    }
+    size_t cipherLen = sealedLen - nonceLen - tagLen;
+    output.resize(cipherLen);
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    int ret = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, _recordKey, 256);
+    if (ret == 0) {
+        ret = mbedtls_gcm_auth_decrypt(&gcm, cipherLen, sealed, nonceLen, aad, aadLen,
+                                       sealed + nonceLen + cipherLen, tagLen,
+                                       sealed + nonceLen, output.data());
+    }
+    mbedtls_gcm_free(&gcm);
+    if (ret != 0) {
+        output.clear();
+    }
+    return ret == 0;
+}
+
+bool CryptoManager::initRecordCipher(mbedtls_gcm_context& gcm) {
+    return mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, _recordKey, 256) == 0;
+}
@@ -0,0 +1,56 @@
+#include <freertos/semphr.h>
+#include <chrono>
+#include <mutex>
+
+struct NativeSemaphore {
+    std::recursive_timed_mutex mutex;
+};
+
+namespace {
+BaseType_t take(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    if (semaphore == nullptr) {
+        return pdFALSE;
+    }
+    if (ticks == portMAX_DELAY) {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t give(SemaphoreHandle_t semaphore) {
+    if (semaphore == nullptr) {
+        return pdFALSE;
+    }
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+} // namespace
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new NativeSemaphore();
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return new NativeSemaphore();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return take(semaphore, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return give(semaphore);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return take(semaphore, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    return give(semaphore);
+}
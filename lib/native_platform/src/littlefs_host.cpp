@@ -0,0 +1,170 @@
+#include <LittleFS.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+fs::FS LittleFS;
+
+namespace {
+size_t s_writeBudget = SIZE_MAX; // См. FS::failWritesAfter()
+bool s_singleFailure = false;    // Ограничение снимается после первой неполной записи
+}
+
+namespace fs {
+
+struct FileImpl {
+    FILE* handle = nullptr;
+
+    ~FileImpl() {
+        if (handle != nullptr) {
+            fclose(handle);
+        }
+    }
+};
+
+File::operator bool() const {
+    return _impl && _impl->handle != nullptr;
+}
+
+size_t File::write(const uint8_t* data, size_t length) {
+    if (!*this) {
+        return 0;
+    }
+    size_t allowed = length < s_writeBudget ? length : s_writeBudget;
+    if (s_writeBudget != SIZE_MAX) {
+        s_writeBudget -= allowed;
+        if (allowed < length && s_singleFailure) {
+            s_writeBudget = SIZE_MAX;
+        }
+    }
+    return fwrite(data, 1, allowed, _impl->handle);
+}
+
+size_t File::read(uint8_t* buffer, size_t length) {
+    return *this ? fread(buffer, 1, length, _impl->handle) : 0;
+}
+
+int File::read() {
+    uint8_t value;
+    return read(&value, 1) == 1 ? value : -1;
+}
+
+int File::available() {
+    return *this ? (int)(size() - position()) : 0;
+}
+
+String File::readString() {
+    String result;
+    char buffer[256];
+    size_t length;
+    while (*this && (length = fread(buffer, 1, sizeof(buffer), _impl->handle)) > 0) {
+        result.concat(buffer, (unsigned int)length);
+    }
+    return result;
+}
+
+bool File::seek(uint32_t position) {
+    return *this && fseek(_impl->handle, (long)position, SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+    return *this ? (size_t)ftell(_impl->handle) : 0;
+}
+
+size_t File::size() const {
+    if (!*this) {
+        return 0;
+    }
+    long current = ftell(_impl->handle);
+    fseek(_impl->handle, 0, SEEK_END);
+    long end = ftell(_impl->handle);
+    fseek(_impl->handle, current, SEEK_SET);
+    return (size_t)end;
+}
+
+void File::flush() {
+    if (*this) {
+        fflush(_impl->handle);
+    }
+}
+
+void File::close() {
+    if (*this) {
+        fclose(_impl->handle);
+        _impl->handle = nullptr;
+    }
+}
+
+bool FS::begin(bool) {
+    if (!_root.isEmpty()) {
+        return true;
+    }
+    char pattern[] = "/tmp/native-littlefs-XXXXXX";
+    if (mkdtemp(pattern) == nullptr) {
+        return false;
+    }
+    _root = pattern;
+    return true;
+}
+
+bool FS::format() {
+    if (!begin()) {
+        return false;
+    }
+    DIR* dir = opendir(_root.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    bool success = true;
+    while (dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            success = ::remove((_root + "/" + entry->d_name).c_str()) == 0 && success;
+        }
+    }
+    closedir(dir);
+    s_writeBudget = SIZE_MAX;
+    return success;
+}
+
+String FS::hostPath(const char* path) const {
+    return _root + (path[0] == '/' ? "" : "/") + path;
+}
+
+bool FS::exists(const char* path) {
+    struct stat info;
+    return begin() && stat(hostPath(path).c_str(), &info) == 0;
+}
+
+File FS::open(const char* path, const char* mode) {
+    if (!begin()) {
+        return File();
+    }
+    // Как в LittleFS: "w" и "a" создают файл, "r" - только существующий
+    const char* hostMode = strcmp(mode, "w") == 0 ? "wb" : strcmp(mode, "a") == 0 ? "ab" : "rb";
+    std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+    impl->handle = fopen(hostPath(path).c_str(), hostMode);
+    return impl->handle != nullptr ? File(impl) : File();
+}
+
+bool FS::remove(const char* path) {
+    return begin() && ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    return begin() && ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+void FS::failWritesAfter(size_t bytes) {
+    s_writeBudget = bytes;
+    s_singleFailure = false;
+}
+
+void FS::failOneWriteAfter(size_t bytes) {
+    s_writeBudget = bytes;
+    s_singleFailure = true;
+}
+
+} // namespace fs
@@ -0,0 +1,108 @@
+// Заменитель mbedtls GCM для тестов на хосте: НЕ шифрование (см. mbedtls/gcm.h)
+#include <mbedtls/gcm.h>
+#include <mbedtls/platform_util.h>
+#include <string.h>
+
+namespace {
+const uint64_t kFnvOffset = 0xCBF29CE484222325ULL;
+const uint64_t kFnvPrime = 0x100000001B3ULL;
+
+uint64_t fnv(uint64_t hash, const unsigned char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+void absorb(mbedtls_gcm_context* ctx, const unsigned char* data, size_t length) {
+    ctx->tag[0] = fnv(ctx->tag[0], data, length);
+    ctx->tag[1] = fnv(ctx->tag[1] ^ 0x5C5C5C5C5C5C5C5CULL, data, length);
+}
+
+unsigned char nextKeyByte(mbedtls_gcm_context* ctx) {
+    // xorshift64*
+    ctx->stream ^= ctx->stream >> 12;
+    ctx->stream ^= ctx->stream << 25;
+    ctx->stream ^= ctx->stream >> 27;
+    return (unsigned char)((ctx->stream * 0x2545F4914F6CDD1DULL) >> 56);
+}
+} // namespace
+
+void mbedtls_platform_zeroize(void* buffer, size_t length) {
+    volatile unsigned char* bytes = (volatile unsigned char*)buffer;
+    while (length--) {
+        *bytes++ = 0;
+    }
+}
+
+void mbedtls_gcm_init(mbedtls_gcm_context* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_gcm_free(mbedtls_gcm_context* ctx) {
+    mbedtls_platform_zeroize(ctx, sizeof(*ctx));
+}
+
+int mbedtls_gcm_setkey(mbedtls_gcm_context* ctx, int, const unsigned char* key, unsigned int keybits) {
+    if (keybits != 256) {
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    }
+    memcpy(ctx->key, key, sizeof(ctx->key));
+    return 0;
+}
+
+int mbedtls_gcm_starts(mbedtls_gcm_context* ctx, int mode, const unsigned char* iv, size_t ivLen,
+                       const unsigned char* add, size_t addLen) {
+    ctx->mode = mode;
+    uint64_t seed = fnv(fnv(kFnvOffset, ctx->key, sizeof(ctx->key)), iv, ivLen);
+    ctx->stream = seed != 0 ? seed : kFnvOffset;
+    ctx->tag[0] = seed;
+    ctx->tag[1] = ~seed;
+    absorb(ctx, add, addLen);
+    return 0;
+}
+
+int mbedtls_gcm_update(mbedtls_gcm_context* ctx, size_t length, const unsigned char* input, unsigned char* output) {
+    if (ctx->mode == MBEDTLS_GCM_DECRYPT) {
+        absorb(ctx, input, length);
+    }
+    for (size_t i = 0; i < length; i++) {
+        output[i] = input[i] ^ nextKeyByte(ctx);
+    }
+    if (ctx->mode == MBEDTLS_GCM_ENCRYPT) {
+        absorb(ctx, output, length);
+    }
+    return 0;
+}
+
+int mbedtls_gcm_finish(mbedtls_gcm_context* ctx, unsigned char* tag, size_t tagLen) {
+    if (tagLen > sizeof(ctx->tag)) {
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    }
+    memcpy(tag, ctx->tag, tagLen);
+    return 0;
+}
+
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context* ctx, int mode, size_t length, const unsigned char* iv, size_t ivLen,
+                              const unsigned char* add, size_t addLen, const unsigned char* input,
+                              unsigned char* output, size_t tagLen, unsigned char* tag) {
+    mbedtls_gcm_starts(ctx, mode, iv, ivLen, add, addLen);
+    mbedtls_gcm_update(ctx, length, input, output);
+    return mbedtls_gcm_finish(ctx, tag, tagLen);
+}
+
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context* ctx, size_t length, const unsigned char* iv, size_t ivLen,
+                             const unsigned char* add, size_t addLen, const unsigned char* tag, size_t tagLen,
+                             const unsigned char* input, unsigned char* output) {
+    unsigned char computed[16];
+    if (tagLen > sizeof(computed)) {
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    }
+    mbedtls_gcm_crypt_and_tag(ctx, MBEDTLS_GCM_DECRYPT, length, iv, ivLen, add, addLen, input, output, tagLen, computed);
+    if (memcmp(computed, tag, tagLen) != 0) {
+        mbedtls_platform_zeroize(output, length);
+        return MBEDTLS_ERR_GCM_AUTH_FAILED;
+    }
+    return 0;
+}
@@ -0,0 +1,333 @@
+// Программные SHA-1/SHA-256/SHA-512 с интерфейсом mbedtls для тестов на хосте
+#include <mbedtls/sha1.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/sha512.h>
+#include <mbedtls/platform_util.h>
+#include <string.h>
+
+namespace {
+inline uint32_t rotl32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+inline uint32_t rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint64_t rotr64(uint64_t x, int n) {
+    return (x >> n) | (x << (64 - n));
+}
+
+inline uint32_t loadBe(const uint8_t* p, uint32_t*) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+inline uint64_t loadBe(const uint8_t* p, uint64_t*) {
+    return ((uint64_t)loadBe(p, (uint32_t*)nullptr) << 32) | loadBe(p + 4, (uint32_t*)nullptr);
+}
+
+inline void storeBe(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+inline void storeBe(uint8_t* p, uint64_t v) {
+    storeBe(p, (uint32_t)(v >> 32));
+    storeBe(p + 4, (uint32_t)v);
+}
+
+const uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint64_t kSha512K[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+
+void sha1Init(uint32_t state[5]) {
+    state[0] = 0x67452301;
+    state[1] = 0xEFCDAB89;
+    state[2] = 0x98BADCFE;
+    state[3] = 0x10325476;
+    state[4] = 0xC3D2E1F0;
+}
+
+void sha1Compress(uint32_t state[5], const uint8_t* block) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = loadBe(block + i * 4, (uint32_t*)nullptr);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+    // Расписание сообщения разворачивается в кольцевом буфере из 16 слов
+    for (int i = 0; i < 80; i++) {
+        if (i >= 16) {
+            w[i & 15] = rotl32(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+        }
+
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        uint32_t temp = rotl32(a, 5) + f + e + k + w[i & 15];
+        e = d;
+        d = c;
+        c = rotl32(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void sha256Init(uint32_t state[8]) {
+    state[0] = 0x6a09e667;
+    state[1] = 0xbb67ae85;
+    state[2] = 0x3c6ef372;
+    state[3] = 0xa54ff53a;
+    state[4] = 0x510e527f;
+    state[5] = 0x9b05688c;
+    state[6] = 0x1f83d9ab;
+    state[7] = 0x5be0cd19;
+}
+
+void sha256Compress(uint32_t state[8], const uint8_t* block) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = loadBe(block + i * 4, (uint32_t*)nullptr);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16) {
+            uint32_t w15 = w[(i + 1) & 15];
+            uint32_t w2 = w[(i + 14) & 15];
+            uint32_t s0 = rotr32(w15, 7) ^ rotr32(w15, 18) ^ (w15 >> 3);
+            uint32_t s1 = rotr32(w2, 17) ^ rotr32(w2, 19) ^ (w2 >> 10);
+            w[i & 15] += s0 + w[(i + 9) & 15] + s1;
+        }
+
+        uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + kSha256K[i] + w[i & 15];
+        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void sha512Init(uint64_t state[8]) {
+    state[0] = 0x6a09e667f3bcc908ULL;
+    state[1] = 0xbb67ae8584caa73bULL;
+    state[2] = 0x3c6ef372fe94f82bULL;
+    state[3] = 0xa54ff53a5f1d36f1ULL;
+    state[4] = 0x510e527fade682d1ULL;
+    state[5] = 0x9b05688c2b3e6c1fULL;
+    state[6] = 0x1f83d9abfb41bd6bULL;
+    state[7] = 0x5be0cd19137e2179ULL;
+}
+
+void sha512Compress(uint64_t state[8], const uint8_t* block) {
+    uint64_t w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = loadBe(block + i * 8, (uint64_t*)nullptr);
+    }
+
+    uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 80; i++) {
+        if (i >= 16) {
+            uint64_t w15 = w[(i + 1) & 15];
+            uint64_t w2 = w[(i + 14) & 15];
+            uint64_t s0 = rotr64(w15, 1) ^ rotr64(w15, 8) ^ (w15 >> 7);
+            uint64_t s1 = rotr64(w2, 19) ^ rotr64(w2, 61) ^ (w2 >> 6);
+            w[i & 15] += s0 + w[(i + 9) & 15] + s1;
+        }
+
+        uint64_t t1 = h + (rotr64(e, 14) ^ rotr64(e, 18) ^ rotr64(e, 41)) + ((e & f) ^ (~e & g)) + kSha512K[i] + w[i & 15];
+        uint64_t t2 = (rotr64(a, 28) ^ rotr64(a, 34) ^ rotr64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+
+template <typename Context, size_t BlockSize, typename Word, void (*Compress)(Word*, const uint8_t*)>
+void shaUpdate(Context* ctx, const unsigned char* input, size_t length) {
+    size_t used = (size_t)(ctx->total % BlockSize);
+    ctx->total += length;
+    while (length > 0) {
+        size_t take = BlockSize - used < length ? BlockSize - used : length;
+        memcpy(ctx->buffer + used, input, take);
+        used += take;
+        input += take;
+        length -= take;
+        if (used == BlockSize) {
+            Compress(ctx->state, ctx->buffer);
+            used = 0;
+        }
+    }
+}
+
+// Паддинг: 0x80, нули и длина в битах (поле длины SHA-512 - 16 байт, старшие нулевые)
+template <typename Context, size_t BlockSize, size_t LengthBytes, size_t DigestSize, typename Word,
+          void (*Compress)(Word*, const uint8_t*)>
+void shaFinish(Context* ctx, unsigned char* output) {
+    size_t used = (size_t)(ctx->total % BlockSize);
+    uint64_t bitLen = ctx->total * 8;
+    ctx->buffer[used++] = 0x80;
+    if (used > BlockSize - LengthBytes) {
+        memset(ctx->buffer + used, 0, BlockSize - used);
+        Compress(ctx->state, ctx->buffer);
+        used = 0;
+    }
+    memset(ctx->buffer + used, 0, BlockSize - used - 8);
+    storeBe(ctx->buffer + BlockSize - 8, bitLen);
+    Compress(ctx->state, ctx->buffer);
+    for (size_t i = 0; i < DigestSize / sizeof(Word); i++) {
+        storeBe(output + i * sizeof(Word), ctx->state[i]);
+    }
+}
+} // namespace
+
+void mbedtls_sha1_init(mbedtls_sha1_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+void mbedtls_sha1_free(mbedtls_sha1_context* ctx) { mbedtls_platform_zeroize(ctx, sizeof(*ctx)); }
+void mbedtls_sha1_clone(mbedtls_sha1_context* dst, const mbedtls_sha1_context* src) { *dst = *src; }
+
+int mbedtls_sha1_starts(mbedtls_sha1_context* ctx) {
+    ctx->total = 0;
+    sha1Init(ctx->state);
+    return 0;
+}
+
+int mbedtls_sha1_update(mbedtls_sha1_context* ctx, const unsigned char* input, size_t length) {
+    shaUpdate<mbedtls_sha1_context, 64, uint32_t, &sha1Compress>(ctx, input, length);
+    return 0;
+}
+
+int mbedtls_sha1_finish(mbedtls_sha1_context* ctx, unsigned char* output) {
+    shaFinish<mbedtls_sha1_context, 64, 8, 20, uint32_t, &sha1Compress>(ctx, output);
+    return 0;
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx) { mbedtls_platform_zeroize(ctx, sizeof(*ctx)); }
+void mbedtls_sha256_clone(mbedtls_sha256_context* dst, const mbedtls_sha256_context* src) { *dst = *src; }
+
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224) {
+    if (is224 != 0) {
+        return -1;
+    }
+    ctx->total = 0;
+    sha256Init(ctx->state);
+    return 0;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t length) {
+    shaUpdate<mbedtls_sha256_context, 64, uint32_t, &sha256Compress>(ctx, input, length);
+    return 0;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char* output) {
+    shaFinish<mbedtls_sha256_context, 64, 8, 32, uint32_t, &sha256Compress>(ctx, output);
+    return 0;
+}
+
+void mbedtls_sha512_init(mbedtls_sha512_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+void mbedtls_sha512_free(mbedtls_sha512_context* ctx) { mbedtls_platform_zeroize(ctx, sizeof(*ctx)); }
+void mbedtls_sha512_clone(mbedtls_sha512_context* dst, const mbedtls_sha512_context* src) { *dst = *src; }
+
+int mbedtls_sha512_starts(mbedtls_sha512_context* ctx, int is384) {
+    if (is384 != 0) {
+        return -1;
+    }
+    ctx->total = 0;
+    sha512Init(ctx->state);
+    return 0;
+}
+
+int mbedtls_sha512_update(mbedtls_sha512_context* ctx, const unsigned char* input, size_t length) {
+    shaUpdate<mbedtls_sha512_context, 128, uint64_t, &sha512Compress>(ctx, input, length);
+    return 0;
+}
+
+int mbedtls_sha512_finish(mbedtls_sha512_context* ctx, unsigned char* output) {
+    shaFinish<mbedtls_sha512_context, 128, 16, 64, uint64_t, &sha512Compress>(ctx, output);
+    return 0;
+}
@@ -4,204 +4,577 @@
 #include "config.h"
 #include "crypto_manager.h"
 #include "log_manager.h"
+#include "vault_journal.h"
+#include "mbedtls/platform_util.h"
+#include <freertos/task.h>
 #include <algorithm>
 #include <map>
 
-PasswordManager::PasswordManager() {
-    // Constructor is now empty
+namespace {
+const uint32_t kPasswordDomain = 0x53445750; // "PWDS"
+
+// Затирает буфер целиком (включая емкость сверх size) и опустошает его
+void wipeBuffer(std::vector<uint8_t>& buffer) {
+    buffer.resize(buffer.capacity());
+    if (!buffer.empty()) {
+        mbedtls_platform_zeroize(buffer.data(), buffer.size());
+    }
+    buffer.clear();
+}
+
+void wipeString(String& value) {
+    if (value.length() > 0) {
+        mbedtls_platform_zeroize(const_cast<char*>(value.c_str()), value.length());
+    }
+    value = String();
+}
+} // namespace
+
+// Состояние загрузки: где лежат секреты и пароли старого формата, ожидающие переноса
+struct PasswordManager::LoadState {
+    std::map<uint32_t, uint32_t> secretOffsets; // id -> последняя запись SECRET
+    std::map<uint32_t, String> legacySecrets;   // Пароли из PASSWORD_FILE и старых UPSERT
+    bool legacy = false;                        // Хранилище нужно переписать в новом формате
+    bool legacyFile = false;                    // PASSWORD_FILE прочитан: удаляется после переноса
+
+    void dropLegacySecret(uint32_t id) {
+        auto it = legacySecrets.find(id);
+        if (it != legacySecrets.end()) {
+            wipeString(it->second);
+            legacySecrets.erase(it);
+        }
+    }
+
+    ~LoadState() {
+        for (auto& item : legacySecrets) {
+            wipeString(item.second);
+        }
+    }
+};
+
+const uint32_t PasswordEntry::NO_SECRET;
+
+void RevealedPassword::clear() {
+    wipeBuffer(_data);
 }
 
+PasswordManager::PasswordManager()
+    : journal(PASSWORD_JOURNAL_FILE, kPasswordDomain),
+      importJournal(PASSWORD_IMPORT_FILE, kPasswordDomain) {}
+
 void PasswordManager::begin() {
-    LOG_INFO("PasswordManager", "Initializing...");
-    if (loadPasswords()) {
-        LOG_INFO("PasswordManager", "Initialized successfully");
-    } else {
-        LOG_ERROR("PasswordManager", "Failed to load passwords during initialization");
+    // Хранилище читается при первом обращении или в startPrefetch(), не при старте
+    if (loadMutex == nullptr) {
+        loadMutex = xSemaphoreCreateMutex();
+        persistMutex = xSemaphoreCreateRecursiveMutex();
+        orderSink = WriteBehind::getInstance().add("passwords_order", [this]() { return flushOrder(); });
+    }
+    LOG_INFO("PasswordManager", "Initialized, vault loading deferred until first use");
+}
+
+void PasswordManager::startPrefetch() {
+    if (loaded.load() || prefetchStarted) {
+        return;
     }
+    prefetchStarted = true;
+    if (xTaskCreatePinnedToCore(prefetchTask, "pw_prefetch", PASSWORD_PREFETCH_STACK, this, 1, nullptr,
+                                PASSWORD_PREFETCH_CORE) != pdPASS) {
+        // Без фоновой задачи хранилище загрузится при первом обращении
+        LOG_WARNING("PasswordManager", "Failed to start vault prefetch task");
+    }
+}
+
+void PasswordManager::prefetchTask(void* arg) {
+    static_cast<PasswordManager*>(arg)->ensureLoaded();
+    vTaskDelete(nullptr);
+}
+
+bool PasswordManager::ensureLoaded(bool retryNow) const {
+    if (loaded.load()) {
+        return true;
+    }
+    // Загрузка заполняет кэш набора в памяти; для вызывающего набор уже был
+    PasswordManager* self = const_cast<PasswordManager*>(this);
+    bool locked = loadMutex != nullptr && xSemaphoreTake(loadMutex, portMAX_DELAY) == pdTRUE;
+    // После ошибки чтение повторяется: сразу для изменений, для читателей (дисплей
+    // опрашивает набор каждый кадр) - не чаще PASSWORD_LOAD_RETRY_MS
+    bool attempt = !loaded.load() &&
+                   (!loadFailed.load() || retryNow || millis() - lastLoadAttemptMs >= PASSWORD_LOAD_RETRY_MS);
+    if (attempt) {
+        unsigned long startedAt = millis();
+        bool success;
+        {
+            StoreWriter<SecureStore<PasswordEntry> > writer(self->passwords, persistMutex);
+            success = self->loadPasswords();
+        }
+        self->lastLoadAttemptMs = millis();
+        self->loadTimeMs = self->lastLoadAttemptMs - startedAt;
+        self->loadFailed.store(!success);
+        self->loaded.store(success);
+        if (success) {
+            LOG_INFO("PasswordManager", "Vault loaded in " + String(loadTimeMs) + " ms");
+        } else {
+            // Прочитанная часть доступна для чтения; изменения отклоняются до успешной загрузки
+            LOG_ERROR("PasswordManager", "Failed to load passwords, changes are refused until the vault is read");
+        }
+    }
+    if (locked) {
+        xSemaphoreGive(loadMutex);
+    }
+    return loaded.load();
 }
 
 bool PasswordManager::addPassword(const String& name, const String& password) {
-    if (name.isEmpty() || password.isEmpty()) {
-        LOG_WARNING("PasswordManager", "Cannot add password with empty name or value");
+    if (!ensureLoaded(true)) {
         return false;
     }
-    // Найти максимальный порядок для нового пароля
-    int maxOrder = 0;
-    for (const auto& pwd : passwords) {
-        if (pwd.order > maxOrder) maxOrder = pwd.order;
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
+    if (!passwords.validName(name) || password.isEmpty()) {
+        LOG_WARNING("PasswordManager", "Cannot add password with empty or too long name, or empty value");
+        return false;
+    }
+    if (passwords.findByName(name) >= 0) {
+        LOG_WARNING("PasswordManager", "Password entry already exists");
+        return false;
     }
     PasswordEntry newPassword;
     newPassword.name = name;
-    newPassword.password = password;
-    newPassword.order = maxOrder + 1;
-    passwords.push_back(newPassword);
+    passwords.append(newPassword); // Следующий id, порядок после последней записи
     LOG_INFO("PasswordManager", "Added password entry: [HIDDEN]");
-    bool success = savePasswords();
+    bool success = persistEntry(passwords.at(passwords.size() - 1), password);
     if (!success) {
+        // Секрет без описания при загрузке игнорируется
+        passwords.erase(passwords.size() - 1);
         LOG_ERROR("PasswordManager", "Failed to save passwords after adding entry");
+    } else if (!batchActive && needsCompaction()) {
+        compact();
     }
     return success;
 }
 
 bool PasswordManager::updatePassword(int index, const String& name, const String& password) {
-    if (index < 0 || index >= passwords.size()) {
+    if (!ensureLoaded(true)) {
+        return false;
+    }
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
+    if (!passwords.validIndex(index)) {
         LOG_WARNING("PasswordManager", "Invalid password index for update: " + String(index));
         return false;
     }
-    if (name.isEmpty() || password.isEmpty()) {
-        LOG_WARNING("PasswordManager", "Cannot update password with empty name or value");
+    // Длинное имя прежнего формата можно оставить как есть
+    bool nameAccepted = passwords.validName(name) || passwords.at(index).name == name;
+    if (!nameAccepted || password.isEmpty()) {
+        LOG_WARNING("PasswordManager", "Cannot update password with empty or too long name, or empty value");
+        return false;
+    }
+    int existing = passwords.findByName(name);
+    if (existing >= 0 && existing != index) {
+        LOG_WARNING("PasswordManager", "Password entry already exists");
         return false;
     }
-    passwords[index].name = name;
-    passwords[index].password = password;
+    String previousName = passwords.at(index).name;
+    passwords.rename(index, name);
+    passwords.touch();
     // порядок остается прежний
     LOG_INFO("PasswordManager", "Updated password entry at index " + String(index));
-    bool success = savePasswords();
+    bool success = persistEntry(passwords.at(index), password);
     if (!success) {
+        // Описание не записано; новый секрет, если успел записаться, уже действует
+        passwords.rename(index, previousName);
         LOG_ERROR("PasswordManager", "Failed to save passwords after update");
+    } else if (!batchActive && needsCompaction()) {
+        compact();
+    }
+    return success;
+}
+
+bool PasswordManager::renamePassword(int index, const String& name) {
+    if (!ensureLoaded(true)) {
+        return false;
+    }
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
+    if (!passwords.validIndex(index)) {
+        LOG_WARNING("PasswordManager", "Invalid password index for rename: " + String(index));
+        return false;
+    }
+    if (!passwords.validName(name) && passwords.at(index).name != name) {
+        LOG_WARNING("PasswordManager", "Cannot rename password entry to an empty or too long name");
+        return false;
+    }
+    int existing = passwords.findByName(name);
+    if (existing >= 0 && existing != index) {
+        LOG_WARNING("PasswordManager", "Password entry already exists");
+        return false;
+    }
+    String previousName = passwords.at(index).name;
+    passwords.rename(index, name);
+    passwords.touch();
+    LOG_INFO("PasswordManager", "Renamed password entry at index " + String(index));
+    const PasswordEntry& entry = passwords.at(index);
+    bool success = persistRecord(JournalOp::UPSERT, entry.id, passwords.toJson(entry));
+    if (!success) {
+        passwords.rename(index, previousName);
+        LOG_ERROR("PasswordManager", "Failed to save passwords after rename");
     }
     return success;
 }
 
 bool PasswordManager::deletePassword(int index) {
-    if (index < 0 || index >= passwords.size()) {
+    if (!ensureLoaded(true)) {
+        return false;
+    }
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
+    if (!passwords.validIndex(index)) {
         LOG_WARNING("PasswordManager", "Invalid password index for deletion: " + String(index));
         return false;
     }
-    String deletedName = passwords[index].name;
-    passwords.erase(passwords.begin() + index);
+    uint32_t deletedId = passwords.erase(index);
     LOG_INFO("PasswordManager", "Deleted password entry");
-    bool success = savePasswords();
+    bool success = persistRecord(JournalOp::REMOVE, deletedId, String());
     if (!success) {
         LOG_ERROR("PasswordManager", "Failed to save passwords after deletion");
     }
     return success;
 }
 
-std::vector<PasswordEntry> PasswordManager::getAllPasswords() {
-    // Сортируем пароли по порядку перед возвратом
-    std::sort(passwords.begin(), passwords.end(), [](const PasswordEntry& a, const PasswordEntry& b) {
-        return a.order < b.order;
-    });
-    return passwords;
+bool PasswordManager::beginBatch() {
+    if (!ensureLoaded(true)) {
+        return false;
+    }
+    // Отложенный порядок - до пакета: откат пакета не должен его терять.
+    // Без блокировки писателей: запись порядка из loop() сама ее берет.
+    WriteBehind::getInstance().flush(orderSink);
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
+    if (batchActive) {
+        LOG_WARNING("PasswordManager", "Batch already in progress");
+        return false;
+    }
+    passwords.saveBackup();
+    passwords.holdPublish();
+    batchActive = true;
+    batchDirty = false;
+    return true;
 }
 
-bool PasswordManager::reorderPasswords(const std::vector<std::pair<String, int>>& newOrder) {
-    LOG_INFO("PasswordManager", "Reordering passwords");
-    
-    // Создаем карту имя -> новый порядок
-    std::map<String, int> orderMap;
-    for (const auto& pair : newOrder) {
-        orderMap[pair.first] = pair.second;
-    }
-    
-    // Обновляем порядок для существующих паролей
-    bool changed = false;
-    for (auto& pwd : passwords) {
-        auto it = orderMap.find(pwd.name);
-        if (it != orderMap.end() && pwd.order != it->second) {
-            pwd.order = it->second;
-            changed = true;
-        }
+bool PasswordManager::commitBatch() {
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
+    if (!batchActive) {
+        return false;
     }
-    
-    if (changed) {
-        bool success = savePasswords();
+    bool success = true;
+    if (batchDirty) {
+        // Одна перезапись хранилища: новые пароли из памяти, остальные из журнала
+        std::vector<PasswordEntry> entries = passwords.entries();
+        success = rewriteVault(entries, [this](const PasswordEntry& entry, std::vector<uint8_t>& secret) {
+            auto pending = batchSecrets.find(entry.id);
+            if (pending != batchSecrets.end()) {
+                const String& password = pending->second;
+                secret.assign((const uint8_t*)password.c_str(), (const uint8_t*)password.c_str() + password.length());
+                return true;
+            }
+            return entry.secretOffset != PasswordEntry::NO_SECRET && journal.read(entry.secretOffset, entry.id, secret);
+        });
         if (success) {
-            LOG_INFO("PasswordManager", "Successfully reordered passwords");
+            // Порядок записей тот же - индекс остается верным
+            passwords.swapSameOrder(entries);
         } else {
-            LOG_ERROR("PasswordManager", "Failed to save reordered passwords");
+            // Хранилище не изменено: возвращаем прежнее состояние и в память
+            passwords.restoreBackup();
         }
-        return success;
     }
-    
-    return true; // Никаких изменений не было
+    endBatch();
+    if (success) {
+        LOG_INFO("PasswordManager", "Committed password batch");
+    } else {
+        LOG_ERROR("PasswordManager", "Failed to save password batch, changes rolled back");
+    }
+    return success;
 }
 
-std::vector<PasswordEntry> PasswordManager::getAllPasswordsForExport() {
-    // Принудительно перезагружаем и расшифровываем пароли из файла
-    std::vector<PasswordEntry> exportPasswords;
-    
-    if (!LittleFS.exists(PASSWORD_FILE)) {
-        LOG_INFO("PasswordManager", "Password file does not exist for export");
-        return exportPasswords; // Пустой вектор если файл не существует
+void PasswordManager::abortBatch() {
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
+    if (!batchActive) {
+        return;
+    }
+    if (batchDirty) {
+        passwords.restoreBackup();
     }
+    endBatch();
+    LOG_INFO("PasswordManager", "Password batch aborted");
+}
 
-    File file = LittleFS.open(PASSWORD_FILE, "r");
-    if (!file) {
-        LOG_ERROR("PasswordManager", "Failed to open password file for export");
-        return exportPasswords;
+bool PasswordManager::getPasswordName(int index, String& name) const {
+    ensureLoaded();
+    PersistLock lock(persistMutex);
+    if (!passwords.validIndex(index)) {
+        return false;
     }
+    name = passwords.at(index).name;
+    return true;
+}
 
-    String encryptedData = file.readString();
-    file.close();
+void PasswordManager::endBatch() {
+    batchActive = false;
+    batchDirty = false;
+    passwords.dropBackup();
+    passwords.releasePublish(); // Итог пакета публикуется одним снимком (StoreWriter)
+    for (auto& item : batchSecrets) {
+        wipeString(item.second);
+    }
+    batchSecrets.clear();
+}
 
-    if (encryptedData.isEmpty()) {
-        return exportPasswords; // Пустой вектор если файл пустой
+bool PasswordManager::reorderPasswords(const std::vector<std::pair<String, int>>& newOrder) {
+    if (!ensureLoaded(true)) {
+        return false;
     }
+    LOG_INFO("PasswordManager", "Reordering passwords");
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
 
-    // Принудительно расшифровываем данные
-    String jsonData = CryptoManager::getInstance().decrypt(encryptedData);
-    if (jsonData.isEmpty()) {
-        LOG_ERROR("PasswordManager", "Failed to decrypt passwords for export");
-        return exportPasswords;
+    // Запись по имени - через индекс; в журнал попадают только изменившиеся
+    JsonDocument changes;
+    JsonArray changed = changes.to<JsonArray>();
+    if (!passwords.reorder(newOrder, changed)) {
+        return true; // Никаких изменений не было
+    }
+    if (batchActive) {
+        batchDirty = true; // Пишется перезаписью хранилища в commitBatch()
+        return true;
     }
+    for (JsonArrayConst pair : changed) {
+        pendingOrder[pair[0].as<uint32_t>()] = pair[1].as<int>();
+    }
+    WriteBehind::getInstance().markDirty(orderSink);
+    return true;
+}
 
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, jsonData);
-    if (error) {
-        LOG_ERROR("PasswordManager", "deserializeJson() failed for export: " + String(error.c_str()));
-        return exportPasswords;
+bool PasswordManager::flushOrder() {
+    PersistLock lock(persistMutex);
+    if (pendingOrder.empty()) {
+        return true; // Уже записан перезаписью хранилища
+    }
+    JsonDocument changes;
+    JsonArray changed = changes.to<JsonArray>();
+    for (const auto& item : pendingOrder) {
+        JsonArray pair = changed.add<JsonArray>();
+        pair.add(item.first);
+        pair.add(item.second);
+    }
+    String payload;
+    serializeJson(changes, payload);
+    size_t count = pendingOrder.size();
+    if (!persistRecord(JournalOp::ORDER, 0, payload)) {
+        LOG_ERROR("PasswordManager", "Failed to save reordered passwords");
+        return false;
     }
+    pendingOrder.clear();
+    LOG_INFO("PasswordManager", "Saved order of " + String((unsigned long)count) + " passwords");
+    return true;
+}
 
-    JsonArray array = doc.as<JsonArray>();
-    for (JsonObject obj : array) {
-        PasswordEntry entry;
-        entry.name = obj["name"].as<String>();
-        entry.password = obj["password"].as<String>();
-        entry.order = obj["order"] | 0;
-        exportPasswords.push_back(entry);
+bool PasswordManager::revealPassword(int index, RevealedPassword& out) const {
+    out.clear();
+    ensureLoaded();
+    PersistLock lock(persistMutex);
+    if (!passwords.validIndex(index)) {
+        return false;
     }
+    return revealEntry(passwords.at(index), out);
+}
 
-    return exportPasswords;
+bool PasswordManager::revealPasswordById(uint32_t id, RevealedPassword& out) const {
+    out.clear();
+    ensureLoaded();
+    PersistLock lock(persistMutex);
+    int index = passwords.findById(id);
+    if (index < 0) {
+        return false;
+    }
+    return revealEntry(passwords.at(index), out);
 }
 
-// --- Новая функция для импорта паролей ---
-bool PasswordManager::replaceAllPasswords(const String& jsonContent) {
-    LOG_INFO("PasswordManager", "Importing passwords from JSON");
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, jsonContent);
-    if (error) {
-        LOG_ERROR("PasswordManager", "Password import failed, invalid JSON: " + String(error.c_str()));
+bool PasswordManager::revealEntry(const PasswordEntry& entry, RevealedPassword& out) const {
+    auto pending = batchSecrets.find(entry.id);
+    if (pending != batchSecrets.end()) {
+        const String& password = pending->second;
+        out._data.reserve(password.length() + 1);
+        out._data.assign((const uint8_t*)password.c_str(), (const uint8_t*)password.c_str() + password.length() + 1);
+        return true;
+    }
+    if (entry.secretOffset == PasswordEntry::NO_SECRET || !journal.read(entry.secretOffset, entry.id, out._data)) {
+        LOG_WARNING("PasswordManager", "Failed to decrypt password for entry id " + String(entry.id));
+        out.clear();
         return false;
     }
+    out._data.push_back(0); // read() оставляет запас емкости: буфер не перевыделяется
+    return true;
+}
 
-    passwords.clear();
-    JsonArray array = doc.as<JsonArray>();
-    int currentOrder = 0;
-    for (JsonObject obj : array) {
-        PasswordEntry entry;
-        entry.name = obj["name"].as<String>();
-        entry.password = obj["password"].as<String>();
-        entry.order = obj["order"] | currentOrder++;  // Используем существующий order или назначаем по порядку
-        passwords.push_back(entry);
+bool PasswordManager::exportEntry(size_t index, JsonObject obj) const {
+    PersistLock lock(persistMutex); // Имя и пароль - из одного состояния набора
+    RevealedPassword secret;
+    if (!revealPassword((int)index, secret)) {
+        return false;
+    }
+    obj["name"] = passwords.at(index).name;
+    obj["password"] = secret.c_str();
+    return true;
+}
+
+bool PasswordManager::beginImport() {
+    if (!ensureLoaded(true)) {
+        return false;
+    }
+    PersistLock lock(persistMutex);
+    if (batchActive || importActive) {
+        LOG_WARNING("PasswordManager", "Import is not allowed while a batch or another import is in progress");
+        return false;
+    }
+    if (!importJournal.reset()) { // Остаток прерванного импорта
+        return false;
+    }
+    importActive = true;
+    importEntries.clear(passwords.nextId()); // id новых записей продолжают текущие
+    LOG_INFO("PasswordManager", "Importing passwords");
+    return true;
+}
+
+bool PasswordManager::stageImport(JsonObjectConst obj) {
+    if (!importActive) {
+        return false;
+    }
+    PasswordEntry entry;
+    importEntries.readJson(obj, entry, (int)importEntries.size());
+    const char* password = obj["password"] | "";
+    size_t passwordLength = strlen(password);
+    if (!importEntries.validName(obj["name"] | "") || passwordLength == 0) {
+        LOG_WARNING("PasswordManager", "Import rejected, invalid entry at position " + String((unsigned long)importEntries.size()));
+        return false;
+    }
+    if (importEntries.findByName(entry.name) >= 0) {
+        LOG_WARNING("PasswordManager", "Import rejected, duplicate entry at position " + String((unsigned long)importEntries.size()));
+        return false;
     }
+    entry.id = importEntries.allocateId(); // id из импортируемого файла не используется
 
-    // Сохраняем новый набор паролей, который будет автоматически зашифрован
-    bool success = savePasswords();
+    // Та же пара записей, что пишет rewriteVault(): SECRET, затем описание
+    uint32_t offset = 0;
+    if (!importJournal.append(JournalOp::SECRET, entry.id, (const uint8_t*)password, passwordLength, &offset)) {
+        return false;
+    }
+    entry.secretOffset = offset;
+    if (!importJournal.append(JournalOp::UPSERT, entry.id, importEntries.toJson(entry))) {
+        return false;
+    }
+    importEntries.push(entry);
+    return true;
+}
+
+bool PasswordManager::commitImport() {
+    if (!importActive) {
+        return false;
+    }
+    StoreWriter<SecureStore<PasswordEntry> > writer(passwords, persistMutex);
+    bool success = journal.replaceWith(importJournal);
     if (success) {
+        pendingOrder.clear(); // Относился к прежним записям
+        uint32_t importNextId = importEntries.nextId();
+        std::vector<PasswordEntry> imported;
+        importEntries.release(imported);
+        passwords.assign(imported, importNextId);
         LOG_INFO("PasswordManager", "Successfully imported " + String(passwords.size()) + " passwords");
     } else {
-        LOG_ERROR("PasswordManager", "Failed to save imported passwords");
+        LOG_ERROR("PasswordManager", "Failed to save imported passwords, current passwords kept");
     }
+    abortImport();
     return success;
 }
 
+void PasswordManager::abortImport() {
+    importActive = false;
+    importEntries.clear();
+    importJournal.reset();
+}
+
 bool PasswordManager::loadPasswords() {
     LOG_DEBUG("PasswordManager", "Loading passwords from file");
+    passwords.clear();
+
+    // Нечитаемый PASSWORD_FILE остается во flash нетронутым; журнал читается и без него
+    LoadState state;
+    bool legacyLoaded = loadLegacySnapshot(state);
+
+    // Описания расшифровываются сразу, секреты остаются во flash: в памяти только их смещения
+    bool replayed = journal.replay(
+        [this, &state](JournalOp op, uint32_t id, const String& payload) {
+            applyJournalRecord(op, id, payload, state);
+        },
+        [&state](uint32_t id, uint32_t offset) {
+            state.secretOffsets[id] = offset;
+            state.dropLegacySecret(id);
+        });
+    for (size_t i = 0; i < passwords.size(); i++) {
+        PasswordEntry& entry = passwords.at(i);
+        auto it = state.secretOffsets.find(entry.id);
+        entry.secretOffset = it != state.secretOffsets.end() ? it->second : PasswordEntry::NO_SECRET;
+    }
+    passwords.sortByOrder();
+    passwords.touch();
+    LOG_INFO("PasswordManager", "Loaded " + String(passwords.size()) + " passwords successfully");
+
+    if (replayed && state.legacy) {
+        // Перенос старого формата: каждый пароль - отдельная запись SECRET
+        std::vector<PasswordEntry> entries = passwords.entries();
+        bool migrated = rewriteVault(entries, [this, &state](const PasswordEntry& entry, std::vector<uint8_t>& secret) {
+            auto legacy = state.legacySecrets.find(entry.id);
+            if (legacy != state.legacySecrets.end()) {
+                const String& password = legacy->second;
+                secret.assign((const uint8_t*)password.c_str(), (const uint8_t*)password.c_str() + password.length());
+                return true;
+            }
+            return entry.secretOffset != PasswordEntry::NO_SECRET && journal.read(entry.secretOffset, entry.id, secret);
+        });
+        if (migrated) {
+            passwords.swapSameOrder(entries);
+            // Старый снимок удаляется, только если каждый перенесенный пароль читается обратно
+            if (!state.legacyFile) {
+                LOG_INFO("PasswordManager", "Migrated passwords to per-record vault");
+            } else if (verifyMigration(state)) {
+                LittleFS.remove(PASSWORD_FILE);
+                LOG_INFO("PasswordManager", "Migrated passwords to per-record vault");
+            } else {
+                LOG_ERROR("PasswordManager", "Migrated passwords do not read back, keeping legacy password file");
+            }
+        } else {
+            LOG_ERROR("PasswordManager", "Failed to migrate passwords, will retry on next boot");
+        }
+    } else if (replayed && needsCompaction()) {
+        compact();
+    }
+    return replayed && legacyLoaded;
+}
+
+bool PasswordManager::verifyMigration(const LoadState& state) {
+    std::vector<uint8_t> secret;
+    bool verified = true;
+    for (size_t i = 0; i < passwords.size() && verified; i++) {
+        const PasswordEntry& entry = passwords.at(i);
+        auto legacy = state.legacySecrets.find(entry.id);
+        if (legacy == state.legacySecrets.end()) {
+            continue;
+        }
+        const String& password = legacy->second;
+        verified = journal.read(entry.secretOffset, entry.id, secret) &&
+                   secret.size() == password.length() &&
+                   memcmp(secret.data(), password.c_str(), secret.size()) == 0;
+        wipeBuffer(secret);
+    }
+    return verified;
+}
+
+bool PasswordManager::loadLegacySnapshot(LoadState& state) {
     if (!LittleFS.exists(PASSWORD_FILE)) {
-        LOG_INFO("PasswordManager", "Password file doesn't exist yet, starting with empty list");
-        return true; // File doesn't exist yet, which is fine.
+        return true;
     }
 
     File file = LittleFS.open(PASSWORD_FILE, "r");
@@ -214,81 +587,225 @@ bool PasswordManager::loadPasswords() {
     file.close();
 
     if (encryptedData.isEmpty()) {
-        return true; // File is empty, nothing to load.
+        // File is empty, nothing to load: removed after the vault is written
+        state.legacy = true;
+        state.legacyFile = true;
+        return true;
     }
 
     // Use the static decrypt method from CryptoManager
     String jsonData = CryptoManager::getInstance().decrypt(encryptedData);
     if (jsonData.isEmpty()) {
-        LOG_WARNING("PasswordManager", "Failed to decrypt passwords or file is empty");
-        // If decryption fails, it might be an old unencrypted file.
-        // For safety, we'll just treat it as empty and overwrite on save.
-        passwords.clear();
-        return true; 
+        // Не переносим пустой набор: файл остается для повторной попытки
+        LOG_ERROR("PasswordManager", "Failed to decrypt legacy password file, keeping it");
+        return false;
     }
 
     JsonDocument doc;
     DeserializationError error = deserializeJson(doc, jsonData);
+    wipeString(jsonData);
     if (error) {
         LOG_ERROR("PasswordManager", "deserializeJson() failed for passwords: " + String(error.c_str()));
         return false;
     }
+    state.legacy = true;
+    state.legacyFile = true;
 
-    passwords.clear();
     JsonArray array = doc.as<JsonArray>();
+    std::vector<PasswordEntry> loaded;
     int currentOrder = 0;
+    uint32_t nextId = 1;
     for (JsonObject obj : array) {
         PasswordEntry entry;
-        entry.name = obj["name"].as<String>(); 
-        entry.password = obj["password"].as<String>();
-        entry.order = obj["order"] | currentOrder++;  // Используем существующий order или назначаем по порядку
-        passwords.push_back(entry);
+        RecordSchema<PasswordEntry>::readJson(obj, entry, currentOrder++);
+        entry.id = obj["id"] | (uint32_t)0;
+        loaded.push_back(entry);
+        if (entry.id >= nextId) {
+            nextId = entry.id + 1;
+        }
     }
 
-    LOG_INFO("PasswordManager", "Loaded " + String(passwords.size()) + " passwords successfully");
+    // Снимок без id (до появления журнала): назначаем по порядку файла
+    size_t i = 0;
+    for (JsonObject obj : array) {
+        PasswordEntry& entry = loaded[i++];
+        if (entry.id == 0) {
+            entry.id = nextId++;
+        }
+        state.legacySecrets[entry.id] = obj["password"].as<String>();
+        passwords.push(entry); // Журнал адресует записи по id
+    }
     return true;
 }
 
-bool PasswordManager::savePasswords() {
-    LOG_DEBUG("PasswordManager", "Saving passwords to file");
-    JsonDocument doc;
-    JsonArray array = doc.to<JsonArray>();
+void PasswordManager::applyJournalRecord(JournalOp op, uint32_t id, const String& payload, LoadState& state) {
+    switch (op) {
+        case JournalOp::UPSERT: {
+            JsonDocument doc;
+            if (deserializeJson(doc, payload)) {
+                LOG_WARNING("PasswordManager", "Skipping malformed journal record for entry id " + String(id));
+                return;
+            }
+            passwords.applyUpsert(id, doc.as<JsonObjectConst>());
+
+            // Запись старого формата: пароль внутри описания
+            JsonVariantConst password = doc["password"];
+            if (!password.isNull()) {
+                state.dropLegacySecret(id);
+                state.legacySecrets[id] = password.as<String>();
+                state.secretOffsets.erase(id);
+                state.legacy = true;
+            }
+            break;
+        }
+        case JournalOp::REMOVE:
+            passwords.applyRemove(id);
+            state.secretOffsets.erase(id);
+            state.dropLegacySecret(id);
+            break;
+        case JournalOp::ORDER: {
+            JsonDocument doc;
+            if (deserializeJson(doc, payload)) {
+                LOG_WARNING("PasswordManager", "Skipping malformed journal order record");
+                return;
+            }
+            passwords.applyOrder(doc.as<JsonArrayConst>());
+            break;
+        }
+        default:
+            LOG_WARNING("PasswordManager", "Unknown journal operation: " + String((int)op));
+            break;
+    }
+}
 
-    for (const auto& entry : passwords) {
-        JsonObject obj = array.add<JsonObject>();
-        obj["name"] = entry.name;
-        obj["password"] = entry.password;
-        obj["order"] = entry.order;
+bool PasswordManager::persistEntry(PasswordEntry& entry, const String& password) {
+    if (batchActive) {
+        // Пароль ждет в памяти до commitBatch()
+        auto pending = batchSecrets.find(entry.id);
+        if (pending != batchSecrets.end()) {
+            wipeString(pending->second);
+        }
+        batchSecrets[entry.id] = password;
+        batchDirty = true;
+        return true;
     }
+    // Сначала секрет: описание без секрета после сбоя не появится.
+    // Набор в памяти уже изменен, поэтому при отказе журнала хранилище переписывается.
+    PersistLock lock(persistMutex);
+    uint32_t offset = 0;
+    if (!journal.append(JournalOp::SECRET, entry.id, (const uint8_t*)password.c_str(), password.length(), &offset)) {
+        return compact(entry.id, &password);
+    }
+    entry.secretOffset = offset;
+    if (!journal.append(JournalOp::UPSERT, entry.id, passwords.toJson(entry))) {
+        return compact(); // Секрет уже в журнале по entry.secretOffset
+    }
+    return true;
+}
 
-    String jsonData;
-    size_t jsonSize = serializeJson(doc, jsonData);
-    if (jsonSize == 0) {
-        LOG_ERROR("PasswordManager", "Failed to serialize passwords to JSON");
-        return false;
+bool PasswordManager::persistRecord(JournalOp op, uint32_t id, const String& payload) {
+    if (batchActive) {
+        batchDirty = true;
+        if (op == JournalOp::REMOVE) {
+            auto pending = batchSecrets.find(id);
+            if (pending != batchSecrets.end()) {
+                wipeString(pending->second);
+                batchSecrets.erase(pending);
+            }
+        }
+        return true;
     }
+    // Изменение пишется одной записью в журнал; если журнал недоступен - хранилище переписывается
+    PersistLock lock(persistMutex);
+    if (!journal.append(op, id, payload)) {
+        return compact();
+    }
+    if (needsCompaction()) {
+        // Изменение уже в журнале: неудачное сворачивание его не теряет
+        compact();
+    }
+    return true;
+}
 
-    // Use the static encrypt method from CryptoManager
-    String encryptedData = CryptoManager::getInstance().encrypt(jsonData);
-    if (encryptedData.isEmpty()) {
-        LOG_ERROR("PasswordManager", "Failed to encrypt passwords");
-        return false;
+bool PasswordManager::needsCompaction() const {
+    // На каждый пароль приходится две актуальные записи; остальное - старые версии,
+    // удаления и ORDER. Сворачиваем, когда устаревших записей больше половины.
+    return journal.size() > VAULT_JOURNAL_COMPACT_BYTES && journal.recordCount() > passwords.size() * 4;
+}
+
+bool PasswordManager::compact(uint32_t pendingId, const String* pendingPassword) {
+    std::vector<PasswordEntry> entries = passwords.entries();
+    bool success = rewriteVault(entries, [this, pendingId, pendingPassword](const PasswordEntry& entry, std::vector<uint8_t>& secret) {
+        if (pendingPassword != nullptr && entry.id == pendingId) {
+            secret.assign((const uint8_t*)pendingPassword->c_str(), (const uint8_t*)pendingPassword->c_str() + pendingPassword->length());
+            return true;
+        }
+        return entry.secretOffset != PasswordEntry::NO_SECRET && journal.read(entry.secretOffset, entry.id, secret);
+    });
+    if (success) {
+        // Порядок записей не менялся - обновляются только смещения
+        for (size_t i = 0; i < passwords.size(); i++) {
+            passwords.at(i).secretOffset = entries[i].secretOffset;
+        }
     }
+    return success;
+}
 
-    File file = LittleFS.open(PASSWORD_FILE, "w");
-    if (!file) {
-        LOG_ERROR("PasswordManager", "Failed to open password file for writing");
-        return false;
+// Переписывает хранилище во временный файл и атомарно заменяет им PASSWORD_JOURNAL_FILE,
+// поэтому сбой посреди записи не портит текущее хранилище. Пароли расшифровываются
+// по одному и затираются сразу после записи.
+bool PasswordManager::rewriteVault(std::vector<PasswordEntry>& entries, const SecretSource& source) {
+    LOG_DEBUG("PasswordManager", "Rewriting password vault");
+    PersistLock lock(persistMutex);
+    String tmpPath = String(PASSWORD_JOURNAL_FILE) + ".new";
+    VaultJournal rewritten(tmpPath.c_str(), kPasswordDomain);
+    rewritten.reset(); // Остаток прерванной перезаписи
+
+    std::vector<uint8_t> secret;
+    bool success = true;
+    for (auto& entry : entries) {
+        if (source(entry, secret)) {
+            uint32_t offset = 0;
+            success = rewritten.append(JournalOp::SECRET, entry.id, secret.data(), secret.size(), &offset);
+            wipeBuffer(secret);
+            entry.secretOffset = offset;
+        } else {
+            wipeBuffer(secret);
+            LOG_WARNING("PasswordManager", "Password for entry id " + String(entry.id) + " is unreadable, keeping name only");
+            entry.secretOffset = PasswordEntry::NO_SECRET;
+        }
+        if (!success) {
+            break;
+        }
+
+        success = rewritten.append(JournalOp::UPSERT, entry.id, passwords.toJson(entry));
+        if (!success) {
+            break;
+        }
     }
 
-    size_t bytesWritten = file.print(encryptedData);
-    file.close();
-    
-    if (bytesWritten > 0) {
-        LOG_INFO("PasswordManager", "Saved " + String(passwords.size()) + " passwords successfully");
-        return true;
-    } else {
-        LOG_ERROR("PasswordManager", "Failed to write encrypted password data");
+    if (!success || !journal.replaceWith(rewritten)) {
+        LittleFS.remove(tmpPath);
+        LOG_ERROR("PasswordManager", "Failed to write password vault");
         return false;
     }
-}
\ No newline at end of file
+    pendingOrder.clear(); // Хранилище уже содержит порядок из памяти
+    LOG_INFO("PasswordManager", "Saved " + String(entries.size()) + " passwords (" +
+             String((unsigned long)journal.size()) + " bytes)");
+    return true;
+}
+
+// --- RecordSchema<PasswordEntry> ---
+
+void RecordSchema<PasswordEntry>::readJson(JsonObjectConst obj, PasswordEntry& entry, int defaultOrder) {
+    const char* name = obj["name"] | "";
+    if (!entry.name.assign(name, strlen(name))) {
+        LOG_DEBUG("PasswordManager", "Password name longer than " + String(VAULT_MAX_NAME_LENGTH) + " bytes kept outside its slot");
+    }
+    entry.order = obj["order"] | defaultOrder;  // Используем существующий order или назначаем по порядку
+}
+
+void RecordSchema<PasswordEntry>::writeJson(JsonObject obj, const PasswordEntry& entry) {
+    obj["name"] = entry.name.c_str();
+    obj["order"] = entry.order;
+}
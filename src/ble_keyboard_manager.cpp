@@ -378,10 +378,13 @@ void BleKeyboardManager::release() {
 }
 
 void BleKeyboardManager::print(const String& text) {
-    int length = text.length();
+    typeText(text.c_str(), text.length());
+}
+
+void BleKeyboardManager::typeText(const char* text, size_t length) {
     SECURITY_LOG("Secure transmission started (" + String(length) + " chars)");
     
-    for (int i = 0; i < length; i++) {
+    for (size_t i = 0; i < length; i++) {
         esp_task_wdt_reset(); // Сброс Watchdog Timer
         
         if (!deviceConnected || !secureConnected) {
@@ -389,7 +392,7 @@ void BleKeyboardManager::print(const String& text) {
             break;
         }
         
-        char c = text.charAt(i);
+        char c = text[i];
         uint8_t key = charToHidKey(c);
         uint8_t modifier = charToModifier(c);
         
@@ -409,7 +412,7 @@ void BleKeyboardManager::sendPassword(const char* password) {
         return;
     }
     
-    print(String(password));
+    typeText(password, strlen(password));
 }
 
 uint8_t BleKeyboardManager::charToHidKey(char c) {
@@ -0,0 +1,50 @@
+#include "boot_timing.h"
+#include "config.h"
+#include "log_manager.h"
+
+BootTiming::Stage BootTiming::_stages[BOOT_TIMING_MAX_STAGES];
+uint8_t BootTiming::_count = 0;
+bool BootTiming::_reported = false;
+
+void BootTiming::mark(const char* stage) {
+    if (_count >= BOOT_TIMING_MAX_STAGES) {
+        return;
+    }
+    for (uint8_t i = 0; i < _count; i++) {
+        if (strcmp(_stages[i].name, stage) == 0) {
+            return;
+        }
+    }
+    _stages[_count].name = stage;
+    _stages[_count].at = millis();
+    _count++;
+}
+
+void BootTiming::report() {
+    if (_reported) {
+        return;
+    }
+    _reported = true;
+    String line;
+    uint32_t previous = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (i > 0) {
+            line += ", ";
+        }
+        line += String(_stages[i].name) + " " + String(_stages[i].at) + " ms (+" + String(_stages[i].at - previous) + ")";
+        previous = _stages[i].at;
+    }
+    LOG_INFO("BootTiming", "Boot stages: " + line);
+}
+
+void BootTiming::toJson(JsonObject obj) {
+    JsonArray stages = obj["stages"].to<JsonArray>();
+    uint32_t previous = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+        JsonObject item = stages.add<JsonObject>();
+        item["stage"] = _stages[i].name;
+        item["at"] = _stages[i].at;
+        item["duration"] = _stages[i].at - previous;
+        previous = _stages[i].at;
+    }
+}
@@ -2,8 +2,85 @@
 #include "config.h"
 #include "log_manager.h"
 #include "crypto_manager.h"
+#include "write_behind.h"
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+namespace {
+// Общая копия CONFIG_FILE в памяти: файл читается один раз, все экземпляры
+// ConfigManager (в том числе временные) видят одно состояние, а изменения
+// записываются отложенно (WriteBehind) - серия переключателей дает одну запись.
+JsonDocument s_config;
+bool s_configLoaded = false;
+int s_configSink = -1;
+
+SemaphoreHandle_t configMutex() {
+    static SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    return mutex;
+}
+
+bool writeConfigFile();
+
+// Доступ к s_config под блокировкой (веб-сервер и loop()); первый доступ читает файл
+class ConfigAccess {
+public:
+    ConfigAccess() {
+        xSemaphoreTake(configMutex(), portMAX_DELAY);
+        if (!s_configLoaded) {
+            load();
+        }
+    }
+    ~ConfigAccess() { xSemaphoreGive(configMutex()); }
+    ConfigAccess(const ConfigAccess&) = delete;
+    ConfigAccess& operator=(const ConfigAccess&) = delete;
+
+    JsonDocument& doc() { return s_config; }
+    // Изменение в памяти; файл перепишет WriteBehind
+    void changed() { WriteBehind::getInstance().markDirty(s_configSink); }
+
+private:
+    static void load() {
+        s_configLoaded = true;
+        s_configSink = WriteBehind::getInstance().add("config", writeConfigFile);
+        s_config.clear();
+        if (!LittleFS.exists(CONFIG_FILE)) {
+            LOG_INFO("ConfigManager", "Config file does not exist. Using defaults");
+            return;
+        }
+        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
+        if (!configFile) {
+            LOG_ERROR("ConfigManager", "Failed to open config file for reading");
+            return;
+        }
+        DeserializationError error = deserializeJson(s_config, configFile);
+        configFile.close();
+        if (error != DeserializationError::Ok) {
+            LOG_ERROR("ConfigManager", "Failed to deserialize config file, using defaults: " + String(error.c_str()));
+            s_config.clear();
+        }
+    }
+};
+
+bool writeConfigFile() {
+    ConfigAccess config;
+    fs::File configFile = LittleFS.open(CONFIG_FILE, "w");
+    if (!configFile) {
+        LOG_ERROR("ConfigManager", "Failed to open config file for writing");
+        return false;
+    }
+    size_t bytesWritten = serializeJson(config.doc(), configFile);
+    configFile.close();
+    if (bytesWritten == 0) {
+        LOG_ERROR("ConfigManager", "Failed to write config file");
+        return false;
+    }
+    WriteBehind::countFlashWrite(bytesWritten);
+    LOG_DEBUG("ConfigManager", "Config file written: " + String((unsigned long)bytesWritten) + " bytes");
+    return true;
+}
+} // namespace
 
 ConfigManager::ConfigManager() {
     // Constructor
@@ -14,29 +91,13 @@ void ConfigManager::begin() {
 }
 
 Theme ConfigManager::loadTheme() {
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error == DeserializationError::Ok) {
-                String themeStr = doc[THEME_CONFIG_KEY] | "dark"; // Default to "dark"
-                LOG_INFO("ConfigManager", "Loaded theme: " + themeStr);
-                if (themeStr == "light") {
-                    _currentTheme = Theme::LIGHT;
-                } else {
-                    _currentTheme = Theme::DARK;
-                }
-                LOG_INFO("ConfigManager", "Theme set to: " + String((_currentTheme == Theme::LIGHT) ? "LIGHT" : "DARK"));
-            } else {
-                LOG_ERROR("ConfigManager", "Failed to deserialize config file: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to open config file for reading");
-        }
+    ConfigAccess config;
+    String themeStr = config.doc()[THEME_CONFIG_KEY] | "dark"; // Default to "dark"
+    LOG_INFO("ConfigManager", "Loaded theme: " + themeStr);
+    if (themeStr == "light") {
+        _currentTheme = Theme::LIGHT;
     } else {
-        LOG_INFO("ConfigManager", "Config file does not exist. Using default theme");
+        _currentTheme = Theme::DARK;
     }
     return _currentTheme;
 }
@@ -44,33 +105,9 @@ Theme ConfigManager::loadTheme() {
 void ConfigManager::saveTheme(Theme theme) {
     LOG_INFO("ConfigManager", "saveTheme() called with theme: " + String((theme == Theme::LIGHT) ? "LIGHT" : "DARK"));
     _currentTheme = theme;
-    JsonDocument doc;
-
-    // Load existing config to preserve other settings
-    if (LittleFS.exists(CONFIG_FILE)) {
-        LOG_DEBUG("ConfigManager", "Config file exists. Loading existing settings...");
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            deserializeJson(doc, configFile);
-            configFile.close();
-            LOG_DEBUG("ConfigManager", "Existing config loaded");
-        } else {
-            LOG_WARNING("ConfigManager", "Failed to open config file for reading during save. Creating new doc");
-        }
-    } else {
-        LOG_DEBUG("ConfigManager", "Config file does not exist. Creating new doc");
-    }
-
-    doc[THEME_CONFIG_KEY] = (theme == Theme::LIGHT) ? "light" : "dark"; // Use lowercase
-
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "w");
-    if (configFile) {
-        serializeJson(doc, configFile);
-        configFile.close();
-        LOG_INFO("ConfigManager", "Theme saved successfully to config file");
-    } else {
-        LOG_ERROR("ConfigManager", "Failed to open config file for writing");
-    }
+    ConfigAccess config;
+    config.doc()[THEME_CONFIG_KEY] = (theme == Theme::LIGHT) ? "light" : "dark"; // Use lowercase
+    config.changed();
 }
 
 String ConfigManager::loadBleDeviceName() {
@@ -115,183 +152,55 @@ void ConfigManager::saveBleDeviceName(const String& deviceName) {
     }
 }
 
+
 String ConfigManager::getStartupMode() {
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error == DeserializationError::Ok) {
-                String mode = doc["startup_mode"] | "totp"; // Default to TOTP
-                configFile.close();
-                LOG_INFO("ConfigManager", "Loaded startup mode: " + mode);
-                return mode;
-            } else {
-                LOG_ERROR("ConfigManager", "Failed to parse startup mode config: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to open config file for startup mode reading");
-        }
-    } else {
-        LOG_INFO("ConfigManager", "No config file found. Using default startup mode: totp");
-    }
-    return "totp"; // Default fallback
+    ConfigAccess config;
+    String mode = config.doc()["startup_mode"] | "totp"; // Default to TOTP
+    LOG_INFO("ConfigManager", "Loaded startup mode: " + mode);
+    return mode;
 }
 
 bool ConfigManager::saveStartupMode(const String& mode) {
     LOG_INFO("ConfigManager", "saveStartupMode() called with mode: " + mode);
-    JsonDocument doc;
-    
-    // Load existing config to preserve other settings
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error != DeserializationError::Ok) {
-                LOG_WARNING("ConfigManager", "Failed to parse existing config, creating new: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_WARNING("ConfigManager", "Failed to open existing config file for reading");
-        }
-    }
-    
-    doc["startup_mode"] = mode;
-    
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "w");
-    if (configFile) {
-        size_t bytesWritten = serializeJson(doc, configFile);
-        configFile.close();
-        if (bytesWritten > 0) {
-            LOG_INFO("ConfigManager", "Startup mode saved successfully");
-            return true;
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to write startup mode config data");
-            return false;
-        }
-    } else {
-        LOG_ERROR("ConfigManager", "Failed to open config file for startup mode writing");
+    {
+        ConfigAccess config;
+        config.doc()["startup_mode"] = mode;
+        config.changed();
+    }
+    // Редкое явное сохранение из веб-интерфейса: пишется сразу, результат виден пользователю
+    if (!WriteBehind::getInstance().flush(s_configSink)) {
+        LOG_ERROR("ConfigManager", "Failed to write startup mode");
         return false;
     }
+    return true;
 }
 
-
-
 uint16_t ConfigManager::getWebServerTimeout() {
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error == DeserializationError::Ok) {
-                uint16_t timeout = doc["web_server_timeout"] | 10; // Default to 10 minutes
-                configFile.close();
-                LOG_INFO("ConfigManager", "Loaded web server timeout: " + String(timeout) + " minutes");
-                return timeout;
-            } else {
-                LOG_ERROR("ConfigManager", "Failed to parse web server timeout config: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to open config file for web server timeout reading");
-        }
-    } else {
-        LOG_INFO("ConfigManager", "No config file found. Using default web server timeout: 10 minutes");
-    }
-    return 10; // Default fallback
+    ConfigAccess config;
+    uint16_t timeout = config.doc()["web_server_timeout"] | 10; // Default to 10 minutes
+    LOG_INFO("ConfigManager", "Loaded web server timeout: " + String(timeout) + " minutes");
+    return timeout;
 }
 
 void ConfigManager::setWebServerTimeout(uint16_t timeout) {
     LOG_INFO("ConfigManager", "setWebServerTimeout() called with value: " + String(timeout) + " minutes");
-    JsonDocument doc;
-    
-    // Load existing config to preserve other settings
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error != DeserializationError::Ok) {
-                LOG_WARNING("ConfigManager", "Failed to parse existing config, creating new: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_WARNING("ConfigManager", "Failed to open existing config file for reading");
-        }
-    }
-    
-    doc["web_server_timeout"] = timeout;
-    
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "w");
-    if (configFile) {
-        size_t bytesWritten = serializeJson(doc, configFile);
-        configFile.close();
-        if (bytesWritten > 0) {
-            LOG_INFO("ConfigManager", "Web server timeout saved successfully");
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to write web server timeout to config file");
-        }
-    } else {
-        LOG_ERROR("ConfigManager", "Failed to open config file for web server timeout writing");
-    }
+    ConfigAccess config;
+    config.doc()["web_server_timeout"] = timeout;
+    config.changed();
 }
 
 bool ConfigManager::getWebServerAutoStart() {
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error == DeserializationError::Ok) {
-                bool autoStart = doc["web_server_auto_start"] | false; // Default to false
-                configFile.close();
-                LOG_INFO("ConfigManager", "Loaded web server auto-start: " + String(autoStart ? "true" : "false"));
-                return autoStart;
-            } else {
-                LOG_ERROR("ConfigManager", "Failed to parse web server auto-start config: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to open config file for web server auto-start reading");
-        }
-    } else {
-        LOG_INFO("ConfigManager", "No config file found. Using default web server auto-start: false");
-    }
-    return false; // Default fallback
+    ConfigAccess config;
+    bool autoStart = config.doc()["web_server_auto_start"] | false; // Default to false
+    LOG_INFO("ConfigManager", "Loaded web server auto-start: " + String(autoStart ? "true" : "false"));
+    return autoStart;
 }
 
 void ConfigManager::setWebServerAutoStart(bool autoStart) {
     LOG_INFO("ConfigManager", "setWebServerAutoStart() called with value: " + String(autoStart ? "true" : "false"));
-    JsonDocument doc;
-
-    // Load existing config to preserve other settings
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error != DeserializationError::Ok) {
-                LOG_WARNING("ConfigManager", "Failed to parse existing config, creating new: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_WARNING("ConfigManager", "Failed to open existing config file for reading");
-        }
-    }
-
-    doc["web_server_auto_start"] = autoStart;
-
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "w");
-    if (configFile) {
-        size_t bytesWritten = serializeJson(doc, configFile);
-        configFile.close();
-        if (bytesWritten > 0) {
-            LOG_INFO("ConfigManager", "Web server auto-start saved successfully");
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to write web server auto-start config data");
-        }
-    } else {
-        LOG_ERROR("ConfigManager", "Failed to open config file for web server auto-start writing");
-    }
+    ConfigAccess config;
+    config.doc()["web_server_auto_start"] = autoStart;
+    config.changed();
 }
 
 String ConfigManager::loadMdnsHostname() {
@@ -337,103 +246,26 @@ void ConfigManager::saveMdnsHostname(const String& hostname) {
 }
 
 uint16_t ConfigManager::getDisplayTimeout() {
-    // Use cached value if available
-    if (_displayTimeoutCached) {
-        return _cachedDisplayTimeout;
-    }
-
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error == DeserializationError::Ok) {
-                uint16_t timeout = doc["display_timeout"] | 30; // Default to 30 seconds
-                configFile.close();
-                // Cache the value
-                _cachedDisplayTimeout = timeout;
-                _displayTimeoutCached = true;
-                LOG_INFO("ConfigManager", "Loaded display timeout: " + String(timeout) + " seconds");
-                return timeout;
-            } else {
-                LOG_ERROR("ConfigManager", "Failed to parse display timeout config: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to open config file for display timeout reading");
-        }
-    } else {
-        LOG_INFO("ConfigManager", "No config file found. Using default display timeout: 30 seconds");
-    }
-    // Cache the default value
-    _cachedDisplayTimeout = 30;
-    _displayTimeoutCached = true;
-    return 30; // Default fallback
+    ConfigAccess config;
+    return config.doc()["display_timeout"] | 30; // Default to 30 seconds
 }
 
 bool ConfigManager::saveDisplayTimeout(uint16_t timeout) {
     LOG_INFO("ConfigManager", "saveDisplayTimeout() called with value: " + String(timeout) + " seconds");
-
-    // Invalidate cache since we're changing the value
-    _displayTimeoutCached = false;
-
-    JsonDocument doc;
-
-    // Load existing config to preserve other settings
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error != DeserializationError::Ok) {
-                LOG_WARNING("ConfigManager", "Failed to parse existing config, creating new: " + String(error.c_str()));
-            }
-            configFile.close();
-        } else {
-            LOG_WARNING("ConfigManager", "Failed to open existing config file for reading");
-        }
-    }
-
-    doc["display_timeout"] = timeout;
-
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "w");
-    if (configFile) {
-        size_t bytesWritten = serializeJson(doc, configFile);
-        configFile.close();
-        if (bytesWritten > 0) {
-            LOG_INFO("ConfigManager", "Display timeout saved successfully");
-            return true;
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to write display timeout to config file");
-            return false;
-        }
-    } else {
-        LOG_ERROR("ConfigManager", "Failed to open config file for display timeout writing");
-        return false;
-    }
+    ConfigAccess config;
+    config.doc()["display_timeout"] = timeout;
+    config.changed();
+    return true;
 }
 
 // Session Duration Configuration
 ConfigManager::SessionDuration ConfigManager::getSessionDuration() {
-
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-    if (!configFile) {
-        LOG_INFO("ConfigManager", "Session duration config not found, using default: 6 hours");
-        _currentSessionDuration = SIX_HOURS;
-        return _currentSessionDuration;
-    }
-
-    DynamicJsonDocument doc(1024);
-    DeserializationError error = deserializeJson(doc, configFile);
-    configFile.close();
-
-    if (error != DeserializationError::Ok) {
-        LOG_WARNING("ConfigManager", "Failed to parse session duration config: " + String(error.c_str()));
-        _currentSessionDuration = SIX_HOURS;
-        return _currentSessionDuration;
+    int durationValue;
+    {
+        ConfigAccess config;
+        durationValue = config.doc()["session_duration"] | SIX_HOURS;
     }
 
-    int durationValue = doc["session_duration"] | SIX_HOURS;
-    
     // Validate duration value
     switch(durationValue) {
         case UNTIL_REBOOT:
@@ -453,36 +285,11 @@ ConfigManager::SessionDuration ConfigManager::getSessionDuration() {
 }
 
 void ConfigManager::setSessionDuration(SessionDuration duration) {
-    
-    DynamicJsonDocument doc(1024);
-    
-    // Load existing config
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error != DeserializationError::Ok) {
-                LOG_WARNING("ConfigManager", "Failed to parse existing config for session duration: " + String(error.c_str()));
-            }
-            configFile.close();
-        }
-    }
-
-    doc["session_duration"] = static_cast<int>(duration);
-
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "w");
-    if (configFile) {
-        size_t bytesWritten = serializeJson(doc, configFile);
-        configFile.close();
-        if (bytesWritten > 0) {
-            _currentSessionDuration = duration;
-            LOG_INFO("ConfigManager", "Session duration saved successfully: " + String(duration) + " hours");
-        } else {
-            LOG_ERROR("ConfigManager", "Failed to write session duration to config file");
-        }
-    } else {
-        LOG_ERROR("ConfigManager", "Failed to open config file for session duration writing");
-    }
+    ConfigAccess config;
+    config.doc()["session_duration"] = static_cast<int>(duration);
+    config.changed();
+    _currentSessionDuration = duration;
+    LOG_INFO("ConfigManager", "Session duration saved: " + String(duration) + " hours");
 }
 
 unsigned long ConfigManager::getSessionLifetimeSeconds() {
@@ -508,26 +315,15 @@ unsigned long ConfigManager::getSessionLifetimeSeconds() {
 String ConfigManager::loadApPassword() {
     LOG_DEBUG("ConfigManager", "loadApPassword() called");
 
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-    if (!configFile) {
-        LOG_WARNING("ConfigManager", "Config file not found, returning default AP password");
-        return "12345678"; // Пароль по умолчанию (min 8 chars для WiFi)
+    String encryptedPassword;
+    {
+        ConfigAccess config;
+        encryptedPassword = config.doc()["apPassword"] | "";
     }
-
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, configFile);
-    configFile.close();
-
-    if (error) {
-        LOG_ERROR("ConfigManager", "Failed to parse config file: " + String(error.c_str()));
-        return "12345678";
-    }
-
-    String encryptedPassword = doc["apPassword"] | "";
     
     if (encryptedPassword.isEmpty()) {
         // Нет сохраненного пароля, возвращаем дефолт
-        return "12345678";
+        return "12345678"; // Пароль по умолчанию (min 8 chars для WiFi)
     }
     
     // Пытаемся расшифровать
@@ -551,58 +347,22 @@ String ConfigManager::loadApPassword() {
 bool ConfigManager::saveApPassword(const String& password) {
     LOG_INFO("ConfigManager", "saveApPassword() called");
 
-    JsonDocument doc;
-    
-    // Загружаем существующий конфиг
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            DeserializationError error = deserializeJson(doc, configFile);
-            if (error != DeserializationError::Ok) {
-                LOG_WARNING("ConfigManager", "Failed to parse existing config, creating new: " + String(error.c_str()));
-            }
-            configFile.close();
-        }
-    }
-
-    // Обновляем значение (зашифрованное)
+    // Шифруется до блокировки конфигурации
     String encryptedPassword = CryptoManager::getInstance().encrypt(password);
-    doc["apPassword"] = encryptedPassword;
-
-    // Сохраняем обратно
-    fs::File configFile = LittleFS.open(CONFIG_FILE, "w");
-    if (!configFile) {
-        LOG_ERROR("ConfigManager", "Failed to open config file for writing");
-        return false;
-    }
-
-    size_t bytesWritten = serializeJson(doc, configFile);
-    configFile.close();
-    
-    if (bytesWritten > 0) {
-        LOG_INFO("ConfigManager", "AP Password saved successfully");
-        return true;
-    } else {
-        LOG_ERROR("ConfigManager", "Failed to write AP password to config file");
+    if (encryptedPassword.isEmpty()) {
+        LOG_ERROR("ConfigManager", "Failed to encrypt AP password");
         return false;
     }
+    ConfigAccess config;
+    config.doc()["apPassword"] = encryptedPassword;
+    config.changed();
+    return true;
 }
 
 
 unsigned long ConfigManager::getLastKnownEpoch() {
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File configFile = LittleFS.open(CONFIG_FILE, "r");
-        if (configFile) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, configFile);
-            configFile.close();
-            if (error == DeserializationError::Ok) {
-                return doc["last_known_epoch"] | 0UL;
-            }
-            LOG_WARNING("ConfigManager", "Failed to parse last_known_epoch: " + String(error.c_str()));
-        }
-    }
-    return 0UL;
+    ConfigAccess config;
+    return config.doc()["last_known_epoch"] | 0UL;
 }
 
 bool ConfigManager::saveLastKnownEpoch(unsigned long epochSeconds) {
@@ -610,31 +370,49 @@ bool ConfigManager::saveLastKnownEpoch(unsigned long epochSeconds) {
         return false;
     }
 
-    JsonDocument doc;
-    if (LittleFS.exists(CONFIG_FILE)) {
-        fs::File in = LittleFS.open(CONFIG_FILE, "r");
-        if (in) {
-            deserializeJson(doc, in);
-            in.close();
-        }
+    {
+        ConfigAccess config;
+        config.doc()["last_known_epoch"] = epochSeconds;
+        config.changed();
+    }
+    // Контрольная точка времени пишется сразу (вместе с ожидающими настройками)
+    if (!WriteBehind::getInstance().flush(s_configSink)) {
+        LOG_ERROR("ConfigManager", "Failed to write last_known_epoch");
+        return false;
     }
 
-    doc["last_known_epoch"] = epochSeconds;
+    LOG_INFO("ConfigManager", "Saved last_known_epoch: " + String(epochSeconds));
+    return true;
+}
 
-    fs::File out = LittleFS.open(CONFIG_FILE, "w");
-    if (!out) {
-        LOG_ERROR("ConfigManager", "Failed to open config file for last_known_epoch writing");
+bool ConfigManager::saveTimeCheckpoint(unsigned long epochSeconds, bool driftKnown, long driftPpb) {
+    if (epochSeconds == 0UL) {
         return false;
     }
 
-    size_t bytes = serializeJson(doc, out);
-    out.close();
-
-    if (bytes == 0) {
-        LOG_ERROR("ConfigManager", "Failed to write last_known_epoch");
+    {
+        ConfigAccess config;
+        config.doc()["last_known_epoch"] = epochSeconds;
+        if (driftKnown) {
+            config.doc()["time_drift_ppb"] = driftPpb;
+        }
+        config.changed();
+    }
+    // Вызывается перед сном и перезагрузкой: пишется сразу (вместе с ожидающими настройками)
+    if (!WriteBehind::getInstance().flush(s_configSink)) {
+        LOG_ERROR("ConfigManager", "Failed to write time checkpoint");
         return false;
     }
 
-    LOG_INFO("ConfigManager", "Saved last_known_epoch: " + String(epochSeconds));
+    LOG_DEBUG("ConfigManager", "Saved time checkpoint: " + String(epochSeconds));
     return true;
 }
+
+bool ConfigManager::getTimeDriftPpb(long& driftPpb) {
+    ConfigAccess config;
+    if (config.doc()["time_drift_ppb"].is<long>()) {
+        driftPpb = config.doc()["time_drift_ppb"].as<long>();
+        return true;
+    }
+    return false;
+}
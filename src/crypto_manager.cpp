@@ -5,10 +5,22 @@
 #include "mbedtls/sha256.h"
 #include "mbedtls/base64.h"
 #include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
 #include "mbedtls/pkcs5.h" // For PBKDF2
 #include <esp_system.h>
 #include <esp_task_wdt.h> // <-- ADDED for watchdog reset during PBKDF2
 #include <ArduinoJson.h> // <-- ADDED for new functions
+#include "vault_file.h"
+
+namespace {
+// Поля SESSION_FILE (VaultFile)
+enum SessionField : uint8_t {
+    SESSION_FIELD_ID = 1,
+    SESSION_FIELD_CSRF = 2,
+    SESSION_FIELD_CREATED_MILLIS = 3,
+    SESSION_FIELD_CREATED_EPOCH = 4
+};
+} // namespace
 
 // --- New Password-based Encryption for Import/Export ---
 
@@ -102,26 +114,10 @@ String CryptoManager::decryptWithPassword(const String& encryptedJson, const Str
     }
 
     // 2. Re-derive the key using the provided password and the extracted salt
-    const int key_len = 32;
-    const int iterations = PBKDF2_ITERATIONS_EXPORT; // Используем константу из config.h (100,000 iterations)
-    
-    LOG_INFO("CryptoManager", "Deriving decryption key with PBKDF2 (" + String(iterations) + " iterations)...");
-    unsigned long start_time = millis();
-    
-    // ⚠️ Сбрасываем watchdog перед PBKDF2 (~3s)
-    esp_task_wdt_reset();
-    
-    uint8_t derived_key[key_len];
-    mbedtls_md_context_t sha256_ctx;
-    mbedtls_md_init(&sha256_ctx);
-    mbedtls_md_setup(&sha256_ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
-    mbedtls_pkcs5_pbkdf2_hmac(&sha256_ctx, (const unsigned char*)password.c_str(), password.length(), salt.data(), salt.size(), iterations, key_len, derived_key);
-    mbedtls_md_free(&sha256_ctx);
-    
-    esp_task_wdt_reset(); // Сбрасываем после PBKDF2
-    
-    unsigned long pbkdf2_elapsed = millis() - start_time;
-    LOG_INFO("CryptoManager", "Key derivation completed in " + String(pbkdf2_elapsed) + "ms");
+    uint8_t derived_key[32];
+    if (!deriveExportKey(password, salt.data(), salt.size(), derived_key)) {
+        return "";
+    }
 
     // 3. Decrypt data
     std::vector<uint8_t> decrypted_padded(ciphertext.size());
@@ -150,6 +146,32 @@ String CryptoManager::decryptWithPassword(const String& encryptedJson, const Str
     return String((char*)decrypted_padded.data(), plain_len);
 }
 
+bool CryptoManager::deriveExportKey(const String& password, const uint8_t* salt, size_t saltLength, uint8_t* key) {
+    const int iterations = PBKDF2_ITERATIONS_EXPORT;
+    LOG_INFO("CryptoManager", "Deriving decryption key with PBKDF2 (" + String(iterations) + " iterations)...");
+    unsigned long start_time = millis();
+
+    // ⚠️ Сбрасываем watchdog перед PBKDF2 (~3s)
+    esp_task_wdt_reset();
+
+    mbedtls_md_context_t sha256_ctx;
+    mbedtls_md_init(&sha256_ctx);
+    int result = mbedtls_md_setup(&sha256_ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+    if (result == 0) {
+        result = mbedtls_pkcs5_pbkdf2_hmac(&sha256_ctx, (const unsigned char*)password.c_str(), password.length(),
+                                           salt, saltLength, iterations, 32, key);
+    }
+    mbedtls_md_free(&sha256_ctx);
+
+    esp_task_wdt_reset(); // Сбрасываем после PBKDF2
+
+    if (result != 0) {
+        LOG_ERROR("CryptoManager", "Key derivation failed: " + String(result));
+        return false;
+    }
+    LOG_INFO("CryptoManager", "Key derivation completed in " + String(millis() - start_time) + "ms");
+    return true;
+}
 
 CryptoManager& CryptoManager::getInstance() {
     static CryptoManager instance;
@@ -167,6 +189,7 @@ void CryptoManager::begin() {
     } else {
         generateAndSaveKey();
     }
+    deriveRecordKey();
     _isKeyInitialized = true;
     LOG_INFO("CryptoManager", "Initialized successfully");
 }
@@ -437,6 +460,72 @@ bool CryptoManager::decryptData(const uint8_t* encrypted, size_t encrypted_len,
     return true;
 }
 
+void CryptoManager::deriveRecordKey() {
+    static const char kLabel[] = "vault-journal-record-key-v1";
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1); // HMAC
+    mbedtls_md_hmac_starts(&ctx, _deviceKey, sizeof(_deviceKey));
+    mbedtls_md_hmac_update(&ctx, (const unsigned char*)kLabel, sizeof(kLabel) - 1);
+    mbedtls_md_hmac_finish(&ctx, _recordKey);
+    mbedtls_md_free(&ctx);
+}
+
+bool CryptoManager::sealRecord(const uint8_t* plain, size_t plainLen, const uint8_t* aad, size_t aadLen, std::vector<uint8_t>& output) {
+    if (!_isKeyInitialized) return false;
+
+    const size_t nonceLen = 12;
+    const size_t tagLen = 16;
+    output.resize(nonceLen + plainLen + tagLen);
+    uint8_t* nonce = output.data();
+    esp_fill_random(nonce, nonceLen);
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    int ret = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, _recordKey, 256);
+    if (ret == 0) {
+        ret = mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, plainLen, nonce, nonceLen,
+                                        aad, aadLen, plain, output.data() + nonceLen,
+                                        tagLen, output.data() + nonceLen + plainLen);
+    }
+    mbedtls_gcm_free(&gcm);
+
+    if (ret != 0) {
+        output.clear();
+        return false;
+    }
+    return true;
+}
+
+bool CryptoManager::initRecordCipher(mbedtls_gcm_context& gcm) {
+    return _isKeyInitialized && mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, _recordKey, 256) == 0;
+}
+
+bool CryptoManager::openRecord(const uint8_t* sealed, size_t sealedLen, const uint8_t* aad, size_t aadLen, std::vector<uint8_t>& output) {
+    const size_t nonceLen = 12;
+    const size_t tagLen = 16;
+    if (!_isKeyInitialized || sealedLen < nonceLen + tagLen) return false;
+
+    size_t cipherLen = sealedLen - nonceLen - tagLen;
+    output.resize(cipherLen);
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    int ret = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, _recordKey, 256);
+    if (ret == 0) {
+        ret = mbedtls_gcm_auth_decrypt(&gcm, cipherLen, sealed, nonceLen, aad, aadLen,
+                                       sealed + nonceLen + cipherLen, tagLen,
+                                       sealed + nonceLen, output.data());
+    }
+    mbedtls_gcm_free(&gcm);
+
+    if (ret != 0) {
+        output.clear();
+        return false;
+    }
+    return true;
+}
+
 String CryptoManager::encrypt(const String& plaintext) {
     std::vector<uint8_t> encrypted_buffer;
     if (!encryptData((const uint8_t*)plaintext.c_str(), plaintext.length(), encrypted_buffer)) {
@@ -651,40 +740,76 @@ bool CryptoManager::saveSession(const String& sessionId, const String& csrfToken
     }
     
     // ИСПРАВЛЕНО: Сохраняем epoch time вместо millis() для персистентности
-    struct tm timeinfo;
     time_t now;
     time(&now);
     
-    JsonDocument doc;
-    doc["session_id"] = sessionId;
-    doc["csrf_token"] = csrfToken;
-    doc["created_time_millis"] = createdTime; // Сохраняем millis() для совместимости
-    doc["created_time_epoch"] = (unsigned long)now; // Добавляем epoch time
-    doc["version"] = 2; // Увеличиваем версию
-    
-    String jsonString;
-    serializeJson(doc, jsonString);
-    
-    // Encrypt and save
-    String encryptedSession = encrypt(jsonString);
-    if (encryptedSession.isEmpty()) {
-        LOG_ERROR("CryptoManager", "Failed to encrypt session data");
+    VaultFileWriter writer(VaultFileKind::SESSION);
+    if (!writer.open(SESSION_FILE)) {
+        LOG_ERROR("CryptoManager", "Failed to open session file for writing");
         return false;
     }
-    
-    File file = LittleFS.open("/session.json.enc", "w");
-    if (!file) {
-        LOG_ERROR("CryptoManager", "Failed to open session file for writing");
+    writer.writeString(SESSION_FIELD_ID, sessionId);
+    writer.writeString(SESSION_FIELD_CSRF, csrfToken);
+    writer.writeUInt(SESSION_FIELD_CREATED_MILLIS, createdTime); // Сохраняем millis() для совместимости
+    writer.writeUInt(SESSION_FIELD_CREATED_EPOCH, (unsigned long)now);
+    if (!writer.commit()) {
+        LOG_ERROR("CryptoManager", "Failed to write session data");
         return false;
     }
-    
-    file.print(encryptedSession);
-    file.close();
+    if (LittleFS.exists(SESSION_FILE_LEGACY)) {
+        LittleFS.remove(SESSION_FILE_LEGACY);
+    }
     
     LOG_INFO("CryptoManager", "Session saved to encrypted flash storage with epoch time");
     return true;
 }
 
+bool CryptoManager::readSessionFile(String& sessionId, String& csrfToken, unsigned long& createdMillis, unsigned long& createdEpoch) {
+    VaultFileReader reader(VaultFileKind::SESSION);
+    if (!reader.open(SESSION_FILE)) {
+        return false;
+    }
+    VaultFileReader::Field field;
+    while (reader.next(field)) {
+        switch (field.tag) {
+            case SESSION_FIELD_ID: sessionId = field.asString(); break;
+            case SESSION_FIELD_CSRF: csrfToken = field.asString(); break;
+            case SESSION_FIELD_CREATED_MILLIS: createdMillis = (unsigned long)field.asUInt(); break;
+            case SESSION_FIELD_CREATED_EPOCH: createdEpoch = (unsigned long)field.asUInt(); break;
+            default: break;
+        }
+    }
+    return reader.finish();
+}
+
+// Прежний формат: JSON + AES-CBC + Base64
+bool CryptoManager::readLegacySessionFile(String& sessionId, String& csrfToken, unsigned long& createdMillis, unsigned long& createdEpoch) {
+    File sessionFile = LittleFS.open(SESSION_FILE_LEGACY, "r");
+    if (!sessionFile) {
+        return false;
+    }
+    String encryptedData = sessionFile.readString();
+    sessionFile.close();
+
+    String decryptedJson = decrypt(encryptedData);
+    if (decryptedJson.isEmpty()) {
+        return false;
+    }
+    JsonDocument doc;
+    if (deserializeJson(doc, decryptedJson)) {
+        return false;
+    }
+
+    sessionId = doc["session_id"].as<String>();
+    csrfToken = doc["csrf_token"].as<String>();
+    createdMillis = doc["created_time_millis"].as<unsigned long>();
+    // Проверяем версию для выбора алгоритма валидации
+    if (doc["version"].as<int>() >= 2 && doc.containsKey("created_time_epoch")) {
+        createdEpoch = doc["created_time_epoch"].as<unsigned long>();
+    }
+    return true;
+}
+
 bool CryptoManager::loadSession(String& sessionId, String& csrfToken, unsigned long& createdTime) {
     if (!_isKeyInitialized) {
         LOG_ERROR("CryptoManager", "Cannot load session: crypto not initialized");
@@ -699,50 +824,23 @@ bool CryptoManager::loadSession(String& sessionId, String& csrfToken, unsigned l
         return false;
     }
     
-    if (!LittleFS.exists("/session.json.enc")) {
+    bool hasVault = LittleFS.exists(SESSION_FILE);
+    if (!hasVault && !LittleFS.exists(SESSION_FILE_LEGACY)) {
         LOG_DEBUG("CryptoManager", "No persistent session file found");
         return false;
     }
     
-    File sessionFile = LittleFS.open("/session.json.enc", "r");
-    if (!sessionFile) {
-        LOG_ERROR("CryptoManager", "Failed to open session file");
-        return false;
-    }
-    
-    String encryptedData = sessionFile.readString();
-    sessionFile.close();
-    
-    // Decrypt session data
-    String decryptedJson = decrypt(encryptedData);
-    if (decryptedJson.isEmpty()) {
+    // Поля читаются потоково, без JSON; старый файл переносится при следующем saveSession()
+    unsigned long epochCreatedTime = 0;
+    createdTime = 0; // Для совместимости с web_server.cpp
+    bool loaded = hasVault ? readSessionFile(sessionId, csrfToken, createdTime, epochCreatedTime)
+                           : readLegacySessionFile(sessionId, csrfToken, createdTime, epochCreatedTime);
+    if (!loaded) {
         LOG_ERROR("CryptoManager", "Failed to decrypt session data");
         clearSession(); // Remove corrupted session
         return false;
     }
     
-    // Parse JSON
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, decryptedJson);
-    if (error) {
-        LOG_ERROR("CryptoManager", "Failed to parse session JSON: " + String(error.c_str()));
-        clearSession(); // Remove corrupted session
-        return false;
-    }
-    
-    // Extract session data
-    sessionId = doc["session_id"].as<String>();
-    csrfToken = doc["csrf_token"].as<String>();
-    createdTime = doc["created_time_millis"].as<unsigned long>(); // Для совместимости с web_server.cpp
-    
-    // Проверяем версию для выбора алгоритма валидации
-    int version = doc["version"].as<int>();
-    unsigned long epochCreatedTime = 0;
-    
-    if (version >= 2 && doc.containsKey("created_time_epoch")) {
-        epochCreatedTime = doc["created_time_epoch"].as<unsigned long>();
-    }
-    
     // Validate session data
     if (sessionId.isEmpty() || csrfToken.isEmpty()) {
         LOG_ERROR("CryptoManager", "Invalid session data loaded");
@@ -773,17 +871,23 @@ bool CryptoManager::loadSession(String& sessionId, String& csrfToken, unsigned l
 }
 
 bool CryptoManager::clearSession() {
-    if (LittleFS.exists("/session.json.enc")) {
-        if (LittleFS.remove("/session.json.enc")) {
-            LOG_INFO("CryptoManager", "Session file cleared from storage");
-            return true;
-        } else {
-            LOG_ERROR("CryptoManager", "Failed to remove session file");
-            return false;
+    bool found = false;
+    bool success = true;
+    const char* paths[] = { SESSION_FILE, SESSION_FILE_LEGACY };
+    for (const char* path : paths) {
+        if (LittleFS.exists(path)) {
+            found = true;
+            success = LittleFS.remove(path) && success;
         }
     }
-    LOG_DEBUG("CryptoManager", "No session file to clear");
-    return true;
+    if (!found) {
+        LOG_DEBUG("CryptoManager", "No session file to clear");
+    } else if (success) {
+        LOG_INFO("CryptoManager", "Session file cleared from storage");
+    } else {
+        LOG_ERROR("CryptoManager", "Failed to remove session file");
+    }
+    return success;
 }
 
 bool CryptoManager::isSessionValid(unsigned long createdTime, unsigned long maxLifetimeSeconds) {
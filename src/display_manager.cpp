@@ -28,15 +28,19 @@ void ensureU8g2Ready(TFT_eSPI& tft) {
 void schedule_next_update(DisplayManager* dm, AnimationManager* am);
 
 
-bool hasNonAscii(const String& text) {
-    for (size_t i = 0; i < text.length(); ++i) {
-        if (static_cast<uint8_t>(text[i]) & 0x80) {
+bool hasNonAscii(const char* text) {
+    for (; *text; ++text) {
+        if (static_cast<uint8_t>(*text) & 0x80) {
             return true;
         }
     }
     return false;
 }
 
+bool hasNonAscii(const String& text) {
+    return hasNonAscii(text.c_str());
+}
+
 
 size_t utf8CharBytes(uint8_t firstByte) {
     if ((firstByte & 0x80) == 0x00) return 1;
@@ -179,13 +183,13 @@ void DisplayManager::update() {
     const char charset[] = "abcdefghijklmnopqrstuvwxyz0123456789";
 
     if (elapsedTime < scrambleDuration) {
-        for (int i = 0; i < 6; i++) {
+        for (unsigned int i = 0; i < _newCode.length(); i++) {
             textToDraw += charset[random(sizeof(charset) - 1)];
         }
     } else {
         int charsToReveal = (elapsedTime - scrambleDuration) / 25;
         textToDraw = _newCode.substring(0, charsToReveal);
-        for (int i = charsToReveal; i < 6; i++) {
+        for (int i = charsToReveal; i < (int)_newCode.length(); i++) {
             textToDraw += charset[random(sizeof(charset) - 1)];
         }
     }
@@ -430,8 +434,8 @@ void DisplayManager::drawTotpText(const String& textToDraw) {
     totpSprite.setTextColor(_currentThemeColors->text_primary, _currentThemeColors->background_light);
 
     const bool useUtf8Path = hasNonAscii(textToDraw);
-    // Уменьшаем размер шрифта для длинного текста (например "NOT SYNCED")
-    int textSize = (textToDraw.length() > 6) ? 2 : 4;
+    // Уменьшаем размер шрифта для 8-значных кодов и длинного текста (например "NOT SYNCED")
+    int textSize = (textToDraw.length() <= 6) ? 4 : (textToDraw.length() <= OTP_MAX_DIGITS ? 3 : 2);
     if (!useUtf8Path) {
         totpSprite.setTextSize(textSize);
         totpSprite.drawString(textToDraw, totpSprite.width() / 2, totpSprite.height() / 2);
@@ -456,7 +460,13 @@ void DisplayManager::drawTotpText(const String& textToDraw) {
 }
 
 
-void DisplayManager::updateTOTPCode(const String& code, int timeRemaining) {
+void DisplayManager::updateTOTPCode(const String& code, int timeRemaining, int period) {
+    updateTOTPCode(code.c_str(), timeRemaining, period);
+}
+
+// Вызывается на каждом тике: String-члены переприсваиваются только при смене кода
+// (буфер переиспользуется), поэтому в установившемся режиме куча не трогается
+void DisplayManager::updateTOTPCode(const char* code, int timeRemaining, int period) {
     if (_totpContainerNeedsRedraw) {
         drawTotpContainer();
     }
@@ -473,7 +483,7 @@ void DisplayManager::updateTOTPCode(const String& code, int timeRemaining) {
     const bool shouldBypassAnimation = hasNonAscii(code) || hasNonAscii(_currentCode);
 
     // Логика запуска анимации, если код изменился и это не переключение ключа
-    if (code != _currentCode && _totpState == TotpState::IDLE) {
+    if (_currentCode != code && _totpState == TotpState::IDLE) {
         if (_currentCode.length() > 0 && !shouldBypassAnimation) {
             _newCode = code;
             _totpState = TotpState::SCRAMBLING;
@@ -500,6 +510,12 @@ void DisplayManager::updateTOTPCode(const String& code, int timeRemaining) {
 
         // Очищаем область прогресс-бара
         tft.fillRect(barX - shadowOffset, barY - shadowOffset, barWidth + 40 + shadowOffset, barHeight + shadowOffset * 2, _currentThemeColors->background_dark);
+
+        // Отрицательное значение - у ключа нет временного окна (HOTP), бар не рисуем
+        if (timeRemaining < 0) {
+            lastTimeRemaining = timeRemaining;
+            return;
+        }
         
         // Рисуем рамку и фон
         tft.fillRoundRect(barX + shadowOffset, barY + shadowOffset, barWidth, barHeight, barCornerRadius, _currentThemeColors->shadow_color);
@@ -507,13 +523,15 @@ void DisplayManager::updateTOTPCode(const String& code, int timeRemaining) {
         tft.fillRoundRect(barX, barY, barWidth, barHeight, barCornerRadius, _currentThemeColors->background_light);
 
         // Рисуем заполнение
-        int fillWidth = map(timeRemaining, CONFIG_TOTP_STEP_SIZE, 0, barWidth, 0);
+        int fillWidth = map(timeRemaining, period, 0, barWidth, 0);
         tft.fillRoundRect(barX, barY, fillWidth, barHeight, barCornerRadius, _currentThemeColors->accent_primary);
 
         // Рисуем текст времени
         tft.setTextColor(_currentThemeColors->text_secondary, _currentThemeColors->background_dark);
         tft.setTextSize(2);
-        tft.drawString(String(timeRemaining) + "s", barX + barWidth + 20, barY + barHeight / 2);
+        char timeText[8];
+        snprintf(timeText, sizeof(timeText), "%ds", timeRemaining);
+        tft.drawString(timeText, barX + barWidth + 20, barY + barHeight / 2);
         
         lastTimeRemaining = timeRemaining;
     }
@@ -782,7 +800,7 @@ StartupMode DisplayManager::promptModeSelection() {
     return StartupMode::WIFI_MODE; // По умолчанию WiFi Mode после таймаута
 }
 
-void DisplayManager::drawPasswordLayout(const String& name, const String& password, int batteryPercentage, bool isCharging, bool isWebServerOn) {
+void DisplayManager::drawPasswordLayout(const String& name, const char* password, int batteryPercentage, bool isCharging, bool isWebServerOn) {
     if (_isNoItemsPageActive) {
         _isNoItemsPageActive = false;
         tft.fillScreen(_currentThemeColors->background_dark); 
@@ -803,18 +821,22 @@ void DisplayManager::drawPasswordLayout(const String& name, const String& passwo
     tft.setTextColor(_currentThemeColors->text_primary, _currentThemeColors->background_dark);
     tft.setTextSize(2); // Меньший размер шрифта
     
-    // Создаем частично замаскированную версию пароля
+    // Создаем частично замаскированную версию пароля (без полной копии пароля в String)
+    size_t passwordLength = strlen(password);
     String maskedPassword = "";
-    if (password.length() == 0) {
+    if (passwordLength == 0) {
         maskedPassword = "[空]";
-    } else if (password.length() == 1) {
-        maskedPassword = password.substring(0, 1) + "*";
-    } else if (password.length() == 2) {
-        maskedPassword = password;
+    } else if (passwordLength == 1) {
+        maskedPassword += password[0];
+        maskedPassword += "*";
+    } else if (passwordLength == 2) {
+        maskedPassword += password[0];
+        maskedPassword += password[1];
     } else {
         // Показываем первые 2 символа + звездочки для остальных
-        maskedPassword = password.substring(0, 2);
-        int remainingChars = password.length() - 2;
+        maskedPassword += password[0];
+        maskedPassword += password[1];
+        int remainingChars = passwordLength - 2;
         for (int i = 0; i < remainingChars && i < 10; i++) { // Ограничиваем количество звездочек
             maskedPassword += "*";
         }
@@ -919,7 +941,7 @@ void DisplayManager::drawBleAdvertisingPage(const String& deviceName, const Stri
     drawUtf8Centered("返回", 30, tft.height() - 20, _currentThemeColors->text_primary, _currentThemeColors->background_dark, true);
 }
 
-void DisplayManager::drawBleConfirmPage(const String& passwordName, const String& password, const String& deviceName) {
+void DisplayManager::drawBleConfirmPage(const String& passwordName, size_t passwordLength, const String& deviceName) {
     tft.fillScreen(_currentThemeColors->background_dark);
     tft.setTextDatum(MC_DATUM);
     tft.setTextColor(_currentThemeColors->text_primary);
@@ -937,10 +959,10 @@ void DisplayManager::drawBleConfirmPage(const String& passwordName, const String
     tft.setTextSize(2);
     tft.setTextColor(_currentThemeColors->text_primary);
     String maskedPassword = "";
-    for (int i = 0; i < password.length() && i < 12; i++) {
+    for (size_t i = 0; i < passwordLength && i < 12; i++) {
         maskedPassword += "*";
     }
-    if (password.length() > 12) {
+    if (passwordLength > 12) {
         maskedPassword += "...";
     }
     tft.drawString(maskedPassword, tft.width() / 2, tft.height() / 2 - 5);
@@ -0,0 +1,193 @@
+#include "export_stream.h"
+#include "crypto_manager.h"
+#include "log_manager.h"
+#include "mbedtls/platform_util.h"
+#include <esp_system.h>
+
+namespace {
+const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void wipeString(String& value) {
+    if (value.length() > 0) {
+        mbedtls_platform_zeroize(const_cast<char*>(value.c_str()), value.length());
+    }
+    value = "";
+}
+} // namespace
+
+ExportStream::ExportStream(size_t count, EntryFn fillEntry) : _count(count), _fillEntry(fillEntry) {
+    mbedtls_aes_init(&_aes);
+}
+
+ExportStream::~ExportStream() {
+    mbedtls_aes_free(&_aes);
+    mbedtls_platform_zeroize(_chain, sizeof(_chain));
+    mbedtls_platform_zeroize(_block, sizeof(_block));
+}
+
+bool ExportStream::begin(const String& password) {
+    esp_fill_random(_salt, sizeof(_salt));
+    esp_fill_random(_chain, sizeof(_chain));
+
+    uint8_t key[32];
+    bool ready = CryptoManager::getInstance().deriveExportKey(password, _salt, sizeof(_salt), key) &&
+                 mbedtls_aes_setkey_enc(&_aes, key, 256) == 0;
+    mbedtls_platform_zeroize(key, sizeof(key));
+    if (!ready) {
+        LOG_ERROR("ExportStream", "Failed to derive export key");
+        _failed = true;
+        return false;
+    }
+    return true;
+}
+
+size_t ExportStream::read(uint8_t* buffer, size_t maxLength) {
+    size_t written = 0;
+    while (written < maxLength) {
+        if (_outPosition < _out.length()) {
+            size_t chunk = _out.length() - _outPosition;
+            if (chunk > maxLength - written) {
+                chunk = maxLength - written;
+            }
+            memcpy(buffer + written, _out.c_str() + _outPosition, chunk);
+            _outPosition += chunk;
+            written += chunk;
+            continue;
+        }
+        _out = ""; // Буфер строки сохраняется для следующего фрагмента
+        _outPosition = 0;
+        if (_failed || !produce()) {
+            break;
+        }
+    }
+    return written;
+}
+
+bool ExportStream::readAll(String& output, bool jsonString) {
+    uint8_t buffer[256];
+    size_t length;
+    while ((length = read(buffer, sizeof(buffer))) > 0) {
+        // В конверте из спецсимволов JSON встречаются только кавычки
+        const char* text = (const char*)buffer;
+        size_t start = 0;
+        for (size_t i = 0; jsonString && i < length; i++) {
+            if (text[i] == '"') {
+                output.concat(text + start, i - start);
+                output.concat("\\\"", 2);
+                start = i + 1;
+            }
+        }
+        output.concat(text + start, length - start);
+    }
+    return !_failed;
+}
+
+bool ExportStream::produce() {
+    CryptoManager& crypto = CryptoManager::getInstance();
+    switch (_stage) {
+        case HEADER:
+            // Порядок полей как у encryptWithPassword(): импорт ждет salt и iv до шифротекста
+            _out = "{\"salt\":\"" + crypto.base64Encode(_salt, sizeof(_salt)) +
+                   "\",\"iv\":\"" + crypto.base64Encode(_chain, sizeof(_chain)) + "\",\"ciphertext\":\"";
+            feedPlain((const uint8_t*)"[", 1);
+            _stage = ENTRIES;
+            return true;
+        case ENTRIES:
+            if (_next < _count) {
+                return encryptEntry(_next++);
+            }
+            finishCipher();
+            _stage = TRAILER;
+            return true;
+        case TRAILER:
+            _out = "\"}";
+            _stage = DONE;
+            LOG_INFO("ExportStream", "Exported " + String((unsigned long)_count) + " entries");
+            return true;
+        case DONE:
+            break;
+    }
+    return false;
+}
+
+bool ExportStream::encryptEntry(size_t index) {
+    JsonDocument doc;
+    if (!_fillEntry(index, doc.to<JsonObject>())) {
+        LOG_ERROR("ExportStream", "Export aborted at entry " + String((unsigned long)index));
+        _failed = true;
+        return false;
+    }
+    String text;
+    if (index > 0) {
+        text = ",";
+    }
+    serializeJson(doc, text);
+    feedPlain((const uint8_t*)text.c_str(), text.length());
+    wipeString(text);
+    return true;
+}
+
+void ExportStream::finishCipher() {
+    feedPlain((const uint8_t*)"]", 1);
+    // Дополнение PKCS7: всегда от 1 до 16 байт
+    uint8_t padding = (uint8_t)(sizeof(_block) - _blockLength);
+    memset(_block + _blockLength, padding, padding);
+    _blockLength = sizeof(_block);
+    feedPlain(nullptr, 0);
+
+    // Остаток Base64 с '='
+    if (_carryLength > 0) {
+        uint32_t group = (uint32_t)_carry[0] << 16;
+        if (_carryLength > 1) {
+            group |= (uint32_t)_carry[1] << 8;
+        }
+        char encoded[4] = {
+            kBase64Alphabet[(group >> 18) & 0x3F],
+            kBase64Alphabet[(group >> 12) & 0x3F],
+            _carryLength > 1 ? kBase64Alphabet[(group >> 6) & 0x3F] : '=',
+            '='
+        };
+        _out.concat(encoded, sizeof(encoded));
+        _carryLength = 0;
+    }
+}
+
+void ExportStream::feedPlain(const uint8_t* data, size_t length) {
+    do {
+        size_t chunk = sizeof(_block) - _blockLength;
+        if (chunk > length) {
+            chunk = length;
+        }
+        if (chunk > 0) {
+            memcpy(_block + _blockLength, data, chunk);
+            _blockLength += chunk;
+            data += chunk;
+            length -= chunk;
+        }
+        if (_blockLength == sizeof(_block)) {
+            uint8_t cipher[16];
+            mbedtls_aes_crypt_cbc(&_aes, MBEDTLS_AES_ENCRYPT, sizeof(_block), _chain, _block, cipher);
+            mbedtls_platform_zeroize(_block, sizeof(_block));
+            _blockLength = 0;
+            appendBase64(cipher, sizeof(cipher));
+        }
+    } while (length > 0);
+}
+
+void ExportStream::appendBase64(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        _carry[_carryLength++] = data[i];
+        if (_carryLength < 3) {
+            continue;
+        }
+        uint32_t group = ((uint32_t)_carry[0] << 16) | ((uint32_t)_carry[1] << 8) | _carry[2];
+        char encoded[4] = {
+            kBase64Alphabet[(group >> 18) & 0x3F],
+            kBase64Alphabet[(group >> 12) & 0x3F],
+            kBase64Alphabet[(group >> 6) & 0x3F],
+            kBase64Alphabet[group & 0x3F]
+        };
+        _out.concat(encoded, sizeof(encoded));
+        _carryLength = 0;
+    }
+}
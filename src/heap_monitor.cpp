@@ -0,0 +1,18 @@
+#include "heap_monitor.h"
+
+uint32_t HeapMonitor::_minLargestFreeBlock = UINT32_MAX;
+
+HeapStats HeapMonitor::sample() {
+    HeapStats stats;
+    stats.freeHeap = ESP.getFreeHeap();
+    stats.minFreeHeap = ESP.getMinFreeHeap();
+    stats.largestFreeBlock = ESP.getMaxAllocHeap();
+    if (stats.largestFreeBlock < _minLargestFreeBlock) {
+        _minLargestFreeBlock = stats.largestFreeBlock;
+    }
+    stats.minLargestFreeBlock = _minLargestFreeBlock;
+    if (stats.freeHeap > 0 && stats.largestFreeBlock <= stats.freeHeap) {
+        stats.fragmentation = (uint8_t)(100 - (uint64_t)stats.largestFreeBlock * 100 / stats.freeHeap);
+    }
+    return stats;
+}
@@ -0,0 +1,508 @@
+#include "import_stream.h"
+#include "config.h"
+#include "crypto_manager.h"
+#include "log_manager.h"
+#include "mbedtls/platform_util.h"
+#include <vector>
+
+namespace {
+const size_t kMaxPasswordLength = 256;
+const size_t kMaxKeyLength = 32;
+const size_t kMaxEnvelopeField = 64; // salt и iv в Base64
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+int base64Value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void wipeString(String& value) {
+    if (value.length() > 0) {
+        mbedtls_platform_zeroize(const_cast<char*>(value.c_str()), value.length());
+    }
+    value = "";
+}
+} // namespace
+
+// --- FieldScanner ---
+
+bool ImportStream::FieldScanner::feed(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        switch (_state) {
+            case BEFORE_OBJECT:
+                if (c == '{') {
+                    _state = BEFORE_KEY;
+                } else if (!isSpace(c)) {
+                    return false;
+                }
+                break;
+            case BEFORE_KEY:
+                if (c == '"') {
+                    _key = "";
+                    _keyEscape = false;
+                    _state = IN_KEY;
+                } else if (c == '}') {
+                    _state = DONE;
+                } else if (!isSpace(c)) {
+                    return false;
+                }
+                break;
+            case IN_KEY:
+                if (_keyEscape) {
+                    _keyEscape = false;
+                } else if (c == '\\') {
+                    _keyEscape = true;
+                    break;
+                } else if (c == '"') {
+                    _state = AFTER_KEY;
+                    break;
+                }
+                if (_key.length() < kMaxKeyLength) {
+                    _key += c;
+                }
+                break;
+            case AFTER_KEY:
+                if (c == ':') {
+                    _state = BEFORE_VALUE;
+                } else if (!isSpace(c)) {
+                    return false;
+                }
+                break;
+            case BEFORE_VALUE:
+                if (c == '"') {
+                    _state = IN_VALUE;
+                } else if (c == '{' || c == '[') {
+                    return false; // Вложенные значения в запросе импорта не нужны
+                } else if (!isSpace(c)) {
+                    _state = IN_SCALAR;
+                }
+                break;
+            case IN_VALUE: {
+                // Обычные символы отдаются одной порцией до кавычки или экранирования
+                size_t end = i;
+                while (end < length && data[end] != '"' && data[end] != '\\') {
+                    end++;
+                }
+                if (end > i && !emit(data + i, end - i)) {
+                    return false;
+                }
+                i = end;
+                if (end == length) {
+                    break;
+                }
+                if (data[end] == '"') {
+                    if (!_onValue(_key, nullptr, 0)) { // Конец значения
+                        return false;
+                    }
+                    _state = AFTER_VALUE;
+                } else {
+                    _state = IN_ESCAPE;
+                }
+                break;
+            }
+            case IN_ESCAPE: {
+                char decoded;
+                switch (c) {
+                    case 'b': decoded = '\b'; break;
+                    case 'f': decoded = '\f'; break;
+                    case 'n': decoded = '\n'; break;
+                    case 'r': decoded = '\r'; break;
+                    case 't': decoded = '\t'; break;
+                    case 'u':
+                        _unicode = 0;
+                        _unicodeDigits = 0;
+                        _state = IN_UNICODE;
+                        continue;
+                    default: decoded = c; break; // \" \\ \/
+                }
+                _state = IN_VALUE;
+                if (!emit(&decoded, 1)) {
+                    return false;
+                }
+                break;
+            }
+            case IN_UNICODE: {
+                int digit = hexValue(c);
+                if (digit < 0) {
+                    return false;
+                }
+                _unicode = (_unicode << 4) | (uint32_t)digit;
+                if (++_unicodeDigits == 4) {
+                    _state = IN_VALUE;
+                    if (!emitCodePoint(_unicode)) {
+                        return false;
+                    }
+                }
+                break;
+            }
+            case IN_SCALAR:
+                if (c == ',') {
+                    _state = BEFORE_KEY;
+                } else if (c == '}') {
+                    _state = DONE;
+                }
+                break;
+            case AFTER_VALUE:
+                if (c == ',') {
+                    _state = BEFORE_KEY;
+                } else if (c == '}') {
+                    _state = DONE;
+                } else if (!isSpace(c)) {
+                    return false;
+                }
+                break;
+            case DONE:
+                if (!isSpace(c)) {
+                    return false;
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+bool ImportStream::FieldScanner::emit(const char* data, size_t length) {
+    return _onValue(_key, data, length);
+}
+
+bool ImportStream::FieldScanner::emitCodePoint(uint32_t code) {
+    char encoded[3];
+    size_t length;
+    if (code < 0x80) {
+        encoded[0] = (char)code;
+        length = 1;
+    } else if (code < 0x800) {
+        encoded[0] = (char)(0xC0 | (code >> 6));
+        encoded[1] = (char)(0x80 | (code & 0x3F));
+        length = 2;
+    } else {
+        encoded[0] = (char)(0xE0 | (code >> 12));
+        encoded[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        encoded[2] = (char)(0x80 | (code & 0x3F));
+        length = 3;
+    }
+    return emit(encoded, length);
+}
+
+// --- ImportStream ---
+
+ImportStream::ImportStream(EntryFn onEntry)
+    : _onEntry(onEntry),
+      _request([this](const String& key, const char* data, size_t length) { return onRequestField(key, data, length); }),
+      _envelope([this](const String& key, const char* data, size_t length) { return onEnvelopeField(key, data, length); }) {
+    mbedtls_aes_init(&_aes);
+}
+
+ImportStream::~ImportStream() {
+    mbedtls_aes_free(&_aes);
+    mbedtls_platform_zeroize(_chain, sizeof(_chain));
+    mbedtls_platform_zeroize(_block, sizeof(_block));
+    mbedtls_platform_zeroize(_plain, sizeof(_plain));
+    wipeString(_password);
+    wipeString(_entry);
+}
+
+bool ImportStream::feed(const uint8_t* data, size_t length) {
+    if (_status != Status::OK) {
+        return false;
+    }
+    _requestMode = true;
+    if (!_request.feed((const char*)data, length)) {
+        return fail(Status::MALFORMED);
+    }
+    return true;
+}
+
+bool ImportStream::feedEnvelope(const String& password, const char* envelope, size_t length) {
+    if (_status != Status::OK) {
+        return false;
+    }
+    if (password.length() > kMaxPasswordLength) {
+        return fail(Status::MALFORMED);
+    }
+    _password = password;
+    if (!_envelope.feed(envelope, length)) {
+        return fail(Status::MALFORMED);
+    }
+    return true;
+}
+
+bool ImportStream::finish() {
+    if (_status != Status::OK) {
+        return false;
+    }
+    if ((_requestMode && !_request.done()) || !_envelope.done() || !_cipherReady) {
+        LOG_WARNING("ImportStream", "Import request is incomplete");
+        return fail(Status::MALFORMED);
+    }
+
+    // Base64 без завершающих '='
+    if (_quadLength == 1) {
+        return fail(Status::MALFORMED);
+    }
+    if (_quadLength > 0 && !feedBase64("=", 1)) {
+        return false;
+    }
+    if (_blockLength != 0 || !_plainPending) {
+        return fail(Status::DECRYPT_FAILED);
+    }
+
+    // Дополнение PKCS7: неверное почти всегда означает неверный пароль
+    uint8_t padding = _plain[15];
+    if (padding == 0 || padding > 16) {
+        return fail(Status::DECRYPT_FAILED);
+    }
+    for (size_t i = 16 - padding; i < 16; i++) {
+        if (_plain[i] != padding) {
+            return fail(Status::DECRYPT_FAILED);
+        }
+    }
+    _plainPending = false;
+    if (!feedPlain(_plain, 16 - padding)) {
+        return false;
+    }
+    mbedtls_platform_zeroize(_plain, sizeof(_plain));
+
+    if (_arrayState != AFTER_ARRAY) {
+        return fail(Status::DECRYPT_FAILED);
+    }
+    LOG_INFO("ImportStream", "Parsed " + String((unsigned long)_entries) + " import entries");
+    return true;
+}
+
+bool ImportStream::fail(Status status) {
+    if (_status == Status::OK) {
+        _status = status;
+    }
+    wipeString(_entry);
+    return false;
+}
+
+bool ImportStream::onRequestField(const String& key, const char* data, size_t length) {
+    if (key == "password") {
+        if (data == nullptr) {
+            return true;
+        }
+        if (_cipherReady || _password.length() + length > kMaxPasswordLength) {
+            return fail(Status::MALFORMED);
+        }
+        _password.concat(data, length);
+        return true;
+    }
+    if (key == "data") {
+        if (data == nullptr) {
+            return true;
+        }
+        if (!_envelope.feed(data, length)) {
+            return fail(Status::MALFORMED);
+        }
+        return true;
+    }
+    return true; // Прочие поля запроса не нужны
+}
+
+bool ImportStream::onEnvelopeField(const String& key, const char* data, size_t length) {
+    if (key == "salt" || key == "iv") {
+        if (data == nullptr) {
+            return true;
+        }
+        String& field = key == "salt" ? _salt : _iv;
+        if (_cipherReady || field.length() + length > kMaxEnvelopeField) {
+            return fail(Status::MALFORMED);
+        }
+        field.concat(data, length);
+        return true;
+    }
+    if (key == "ciphertext") {
+        if (data == nullptr) {
+            return true;
+        }
+        if (!_cipherReady && !startCipher()) {
+            return false;
+        }
+        return feedBase64(data, length);
+    }
+    return true;
+}
+
+// Ключ выводится, как только начался шифротекст: пароль, salt и iv к этому
+// моменту уже получены (порядок полей в файле экспорта)
+bool ImportStream::startCipher() {
+    CryptoManager& crypto = CryptoManager::getInstance();
+    std::vector<uint8_t> salt = crypto.base64Decode(_salt);
+    std::vector<uint8_t> iv = crypto.base64Decode(_iv);
+    if (_password.isEmpty() || salt.empty() || iv.size() != sizeof(_chain)) {
+        LOG_ERROR("ImportStream", "Import envelope is missing password, salt or iv");
+        return fail(Status::MALFORMED);
+    }
+
+    uint8_t key[32];
+    bool ready = crypto.deriveExportKey(_password, salt.data(), salt.size(), key) &&
+                 mbedtls_aes_setkey_dec(&_aes, key, 256) == 0;
+    mbedtls_platform_zeroize(key, sizeof(key));
+    wipeString(_password);
+    if (!ready) {
+        return fail(Status::DECRYPT_FAILED);
+    }
+    memcpy(_chain, iv.data(), sizeof(_chain));
+    _cipherReady = true;
+    return true;
+}
+
+bool ImportStream::feedBase64(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        if (isSpace(c)) {
+            continue;
+        }
+        uint8_t bytes[3];
+        size_t count = 0;
+        if (c == '=') {
+            // Неполная четверка: 2 символа - 1 байт, 3 символа - 2 байта
+            if (_quadLength == 2) {
+                bytes[0] = (uint8_t)(_quad >> 4);
+                count = 1;
+            } else if (_quadLength == 3) {
+                bytes[0] = (uint8_t)(_quad >> 10);
+                bytes[1] = (uint8_t)(_quad >> 2);
+                count = 2;
+            } else if (_quadLength != 0 || !_base64Padding) {
+                return fail(Status::MALFORMED);
+            }
+            _quad = 0;
+            _quadLength = 0;
+            _base64Padding = true;
+        } else {
+            int value = base64Value(c);
+            if (value < 0 || _base64Padding) {
+                return fail(Status::MALFORMED);
+            }
+            _quad = (_quad << 6) | (uint32_t)value;
+            if (++_quadLength < 4) {
+                continue;
+            }
+            bytes[0] = (uint8_t)(_quad >> 16);
+            bytes[1] = (uint8_t)(_quad >> 8);
+            bytes[2] = (uint8_t)_quad;
+            count = 3;
+            _quad = 0;
+            _quadLength = 0;
+        }
+
+        for (size_t j = 0; j < count; j++) {
+            _block[_blockLength++] = bytes[j];
+            if (_blockLength == sizeof(_block) && !decryptBlock()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ImportStream::decryptBlock() {
+    uint8_t plain[16];
+    if (mbedtls_aes_crypt_cbc(&_aes, MBEDTLS_AES_DECRYPT, sizeof(_block), _chain, _block, plain) != 0) {
+        return fail(Status::DECRYPT_FAILED);
+    }
+    _blockLength = 0;
+    // Предыдущий блок точно не последний - его можно разбирать
+    bool ok = !_plainPending || feedPlain(_plain, sizeof(_plain));
+    memcpy(_plain, plain, sizeof(_plain));
+    mbedtls_platform_zeroize(plain, sizeof(plain));
+    _plainPending = true;
+    return ok;
+}
+
+bool ImportStream::feedPlain(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c = (char)data[i];
+        switch (_arrayState) {
+            case BEFORE_ARRAY:
+                if (c == '[') {
+                    _arrayState = BEFORE_ENTRY;
+                } else if (!isSpace(c)) {
+                    return fail(Status::DECRYPT_FAILED); // Не JSON массив - неверный пароль
+                }
+                break;
+            case BEFORE_ENTRY:
+            case AFTER_ENTRY:
+                if (c == '{' && _arrayState == BEFORE_ENTRY) {
+                    _entry = "";
+                    _entry.reserve(128);
+                    _entry += c;
+                    _depth = 1;
+                    _inString = false;
+                    _escape = false;
+                    _arrayState = IN_ENTRY;
+                } else if (c == ',' && _arrayState == AFTER_ENTRY) {
+                    _arrayState = BEFORE_ENTRY;
+                } else if (c == ']' && (_arrayState == AFTER_ENTRY || _entries == 0)) {
+                    _arrayState = AFTER_ARRAY;
+                } else if (!isSpace(c)) {
+                    return fail(Status::MALFORMED);
+                }
+                break;
+            case IN_ENTRY:
+                if (_entry.length() >= IMPORT_MAX_ENTRY_SIZE) {
+                    LOG_WARNING("ImportStream", "Import entry exceeds " + String(IMPORT_MAX_ENTRY_SIZE) + " bytes");
+                    return fail(Status::MALFORMED);
+                }
+                _entry += c;
+                if (_inString) {
+                    if (_escape) {
+                        _escape = false;
+                    } else if (c == '\\') {
+                        _escape = true;
+                    } else if (c == '"') {
+                        _inString = false;
+                    }
+                } else if (c == '"') {
+                    _inString = true;
+                } else if (c == '{' || c == '[') {
+                    _depth++;
+                } else if ((c == '}' || c == ']') && --_depth == 0) {
+                    _arrayState = AFTER_ENTRY;
+                    if (!completeEntry()) {
+                        return false;
+                    }
+                }
+                break;
+            case AFTER_ARRAY:
+                if (!isSpace(c)) {
+                    return fail(Status::MALFORMED);
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+bool ImportStream::completeEntry() {
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, _entry.c_str(), _entry.length());
+    wipeString(_entry);
+    if (error || !doc.is<JsonObject>()) {
+        LOG_WARNING("ImportStream", "Malformed import entry " + String((unsigned long)_entries));
+        return fail(Status::MALFORMED);
+    }
+    if (!_onEntry(doc.as<JsonObjectConst>())) {
+        return fail(Status::REJECTED);
+    }
+    _entries++;
+    return true;
+}
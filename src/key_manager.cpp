@@ -2,16 +2,40 @@
 #include "config.h"
 #include "crypto_manager.h"
 #include "log_manager.h"
+#include "vault_journal.h"
+#include "vault_file.h"
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <algorithm>
-#include <map>
+#include "mbedtls/platform_util.h"
 
-KeyManager::KeyManager() {}
+namespace {
+// Поля записи ключа в KEYS_FILE (VaultFile). Номера не меняются: неизвестные поля пропускаются
+enum KeyField : uint8_t {
+    KEY_FIELD_ID = 1,
+    KEY_FIELD_NAME = 2,
+    KEY_FIELD_SECRET = 3,
+    KEY_FIELD_ORDER = 4,
+    KEY_FIELD_TYPE = 5,
+    KEY_FIELD_ALGORITHM = 6,
+    KEY_FIELD_DIGITS = 7,
+    KEY_FIELD_PERIOD = 8,
+    KEY_FIELD_COUNTER = 9
+};
+} // namespace
+
+KeyManager::KeyManager()
+    : journal(KEYS_JOURNAL_FILE, 0x4B455953 /* "KEYS" */) {}
 
 bool KeyManager::begin() {
     LOG_INFO("KeyManager", "Initializing...");
+    if (persistMutex == nullptr) {
+        persistMutex = xSemaphoreCreateRecursiveMutex();
+        orderSink = WriteBehind::getInstance().add("keys_order", [this]() { return flushOrder(); });
+    }
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
     bool success = loadKeys();
+    loadFailed = !success;
     if (success) {
         LOG_INFO("KeyManager", "Initialized successfully");
     } else {
@@ -20,29 +44,32 @@ bool KeyManager::begin() {
     return success;
 }
 
-bool KeyManager::addKey(const String& name, const String& secret) {
-    if (name.isEmpty() || secret.isEmpty()) {
-        LOG_WARNING("KeyManager", "Cannot add key with empty name or secret");
+bool KeyManager::addKey(const String& name, const String& secret, const OtpParams& params, uint64_t counter) {
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (refuseWrites()) {
         return false;
     }
-    for (const auto& key : keys) {
-        if (key.name == name) {
-            LOG_WARNING("KeyManager", "Key already exists: " + name);
-            return false;
-        }
+    if (!keys.validName(name) || secret.isEmpty() || !KeySecret::fits(secret)) {
+        LOG_WARNING("KeyManager", "Cannot add key with empty or too long name or secret");
+        return false;
+    }
+    if (!TOTPGenerator::isSupported(params)) {
+        LOG_WARNING("KeyManager", "Unsupported OTP parameters for key: " + name);
+        return false;
     }
-    // Найти максимальный порядок для нового ключа
-    int maxOrder = 0;
-    for (const auto& key : keys) {
-        if (key.order > maxOrder) maxOrder = key.order;
+    if (keys.findByName(name) >= 0) {
+        LOG_WARNING("KeyManager", "Key already exists: " + name);
+        return false;
     }
     TOTPKey newKey;
     newKey.name = name;
     newKey.secret = secret; 
-    newKey.order = maxOrder + 1;
-    keys.push_back(newKey);
+    newKey.params = params;
+    newKey.counter = counter;
+    prepareKeyMaterial(newKey);
+    const TOTPKey& added = keys.append(newKey); // Следующий id, порядок после последнего
     LOG_INFO("KeyManager", "Added TOTP key: " + name);
-    bool success = saveKeys();
+    bool success = persistUpsert(added);
     if (!success) {
         LOG_ERROR("KeyManager", "Failed to save keys after adding: " + name);
     }
@@ -50,19 +77,33 @@ bool KeyManager::addKey(const String& name, const String& secret) {
 }
 
 bool KeyManager::updateKey(int index, const String& name, const String& secret) {
-    if (index < 0 || index >= keys.size()) {
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (refuseWrites()) {
+        return false;
+    }
+    if (!keys.validIndex(index)) {
         LOG_WARNING("KeyManager", "Invalid key index for update: " + String(index));
         return false;
     }
-    if (name.isEmpty() || secret.isEmpty()) {
-        LOG_WARNING("KeyManager", "Cannot update key with empty name or secret");
+    // Длинное имя прежнего формата можно оставить как есть
+    bool nameAccepted = keys.validName(name) || keys.at(index).name == name;
+    if (!nameAccepted || secret.isEmpty() || !KeySecret::fits(secret)) {
+        LOG_WARNING("KeyManager", "Cannot update key with empty or too long name or secret");
+        return false;
+    }
+    int existing = keys.findByName(name);
+    if (existing >= 0 && existing != index) {
+        LOG_WARNING("KeyManager", "Key already exists: " + name);
         return false;
     }
-    keys[index].name = name;
-    keys[index].secret = secret;
+    keys.rename(index, name);
+    TOTPKey& key = keys.at(index);
+    key.secret = secret;
+    prepareKeyMaterial(key);
+    keys.touch();
     // порядок остается прежний
     LOG_INFO("KeyManager", "Updated TOTP key at index " + String(index) + " to: " + name);
-    bool success = saveKeys();
+    bool success = persistUpsert(key);
     if (!success) {
         LOG_ERROR("KeyManager", "Failed to save keys after update");
     }
@@ -70,99 +111,345 @@ bool KeyManager::updateKey(int index, const String& name, const String& secret)
 }
 
 bool KeyManager::removeKey(int index) {
-    if (index < 0 || index >= keys.size()) {
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (refuseWrites()) {
+        return false;
+    }
+    if (!keys.validIndex(index)) {
         LOG_WARNING("KeyManager", "Invalid key index for removal: " + String(index));
         return false;
     }
-    String removedName = keys[index].name;
-    keys.erase(keys.begin() + index);
+    String removedName = keys.at(index).name;
+    uint32_t removedId = keys.erase(index);
     LOG_INFO("KeyManager", "Removed TOTP key: " + removedName);
-    bool success = saveKeys();
+    bool success = persistRecord(JournalOp::REMOVE, removedId, String());
     if (!success) {
         LOG_ERROR("KeyManager", "Failed to save keys after removal");
     }
     return success;
 }
 
-std::vector<TOTPKey> KeyManager::getAllKeys() {
-    // Сортируем ключи по порядку перед возвратом
-    std::sort(keys.begin(), keys.end(), [](const TOTPKey& a, const TOTPKey& b) {
-        return a.order < b.order;
-    });
-    return keys;
+bool KeyManager::beginBatch() {
+    // Отложенный порядок - до пакета: откат пакета не должен его терять.
+    // Без блокировки писателей: запись порядка из loop() сама ее берет.
+    WriteBehind::getInstance().flush(orderSink);
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (refuseWrites()) {
+        return false;
+    }
+    if (batchActive) {
+        LOG_WARNING("KeyManager", "Batch already in progress");
+        return false;
+    }
+    keys.saveBackup();
+    keys.holdPublish();
+    batchActive = true;
+    batchDirty = false;
+    return true;
+}
+
+bool KeyManager::commitBatch() {
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (!batchActive) {
+        return false;
+    }
+    batchActive = false;
+    keys.releasePublish(); // Итог пакета публикуется одним снимком (StoreWriter)
+    bool success = !batchDirty || saveKeys();
+    if (success) {
+        keys.dropBackup();
+        LOG_INFO("KeyManager", "Committed key batch");
+    } else {
+        // Снимок не записан: на flash прежнее состояние, возвращаем его и в память
+        keys.restoreBackup();
+        LOG_ERROR("KeyManager", "Failed to save key batch, changes rolled back");
+    }
+    return success;
+}
+
+bool KeyManager::getKeyFields(int index, String& name, String& secret) const {
+    PersistLock lock(persistMutex);
+    if (!keys.validIndex(index)) {
+        return false;
+    }
+    name = keys.at(index).name;
+    secret = keys.at(index).secret;
+    return true;
+}
+
+void KeyManager::abortBatch() {
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (!batchActive) {
+        return;
+    }
+    batchActive = false;
+    keys.releasePublish();
+    if (batchDirty) {
+        keys.restoreBackup();
+    } else {
+        keys.dropBackup();
+    }
+    LOG_INFO("KeyManager", "Key batch aborted");
 }
 
 bool KeyManager::reorderKeys(const std::vector<std::pair<String, int>>& newOrder) {
     LOG_INFO("KeyManager", "Reordering TOTP keys");
-    
-    // Создаем карту имя -> новый порядок
-    std::map<String, int> orderMap;
-    for (const auto& pair : newOrder) {
-        orderMap[pair.first] = pair.second;
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (refuseWrites()) {
+        return false;
     }
-    
-    // Обновляем порядок для существующих ключей
-    bool changed = false;
-    for (auto& key : keys) {
-        auto it = orderMap.find(key.name);
-        if (it != orderMap.end() && key.order != it->second) {
-            key.order = it->second;
-            changed = true;
-        }
+
+    // Ключ по имени - через индекс; в журнал попадают только изменившиеся
+    JsonDocument changes;
+    JsonArray changed = changes.to<JsonArray>();
+    if (!keys.reorder(newOrder, changed)) {
+        return true; // Никаких изменений не было
     }
-    
-    if (changed) {
-        bool success = saveKeys();
-        if (success) {
-            LOG_INFO("KeyManager", "Successfully reordered TOTP keys");
-        } else {
-            LOG_ERROR("KeyManager", "Failed to save reordered keys");
-        }
-        return success;
+    if (batchActive) {
+        batchDirty = true; // Пишется одним снимком в commitBatch()
+        return true;
     }
-    
-    return true; // Никаких изменений не было
+    for (JsonArrayConst pair : changed) {
+        pendingOrder[pair[0].as<uint32_t>()] = pair[1].as<int>();
+    }
+    WriteBehind::getInstance().markDirty(orderSink);
+    return true;
 }
 
-// --- Новая функция для импорта ---
-bool KeyManager::replaceAllKeys(const String& jsonContent) {
-    LOG_INFO("KeyManager", "Importing TOTP keys from JSON");
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, jsonContent);
-    if (error) {
-        LOG_ERROR("KeyManager", "Import failed, invalid JSON: " + String(error.c_str()));
+bool KeyManager::flushOrder() {
+    PersistLock lock(persistMutex);
+    if (pendingOrder.empty()) {
+        return true; // Уже записан снимком
+    }
+    JsonDocument changes;
+    JsonArray changed = changes.to<JsonArray>();
+    for (const auto& item : pendingOrder) {
+        JsonArray pair = changed.add<JsonArray>();
+        pair.add(item.first);
+        pair.add(item.second);
+    }
+    String payload;
+    serializeJson(changes, payload);
+    size_t count = pendingOrder.size();
+    if (!persistRecord(JournalOp::ORDER, 0, payload)) {
+        LOG_ERROR("KeyManager", "Failed to save reordered keys");
         return false;
     }
+    pendingOrder.clear();
+    LOG_INFO("KeyManager", "Saved order of " + String((unsigned long)count) + " TOTP keys");
+    return true;
+}
 
-    keys.clear();
-    JsonArray array = doc.as<JsonArray>();
-    int currentOrder = 0;
-    for (JsonObject obj : array) {
-        TOTPKey key;
-        key.name = obj["name"].as<String>();
-        key.secret = obj["secret"].as<String>();
-        key.order = obj["order"] | currentOrder++;  // Используем существующий order или назначаем по порядку
-        keys.push_back(key);
+bool KeyManager::advanceCounter(int index) {
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex); // Чтение и запись счетчика - одно изменение
+    if (!keys.validIndex(index) || !keys.at(index).params.isCounterBased()) {
+        LOG_WARNING("KeyManager", "Invalid HOTP key index: " + String(index));
+        return false;
+    }
+    return setCounter(index, keys.at(index).counter + 1);
+}
+
+bool KeyManager::setCounter(int index, uint64_t counter) {
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (refuseWrites()) {
+        return false;
+    }
+    if (!keys.validIndex(index) || !keys.at(index).params.isCounterBased()) {
+        LOG_WARNING("KeyManager", "Invalid HOTP key index: " + String(index));
+        return false;
+    }
+    TOTPKey& key = keys.at(index);
+    key.counter = counter;
+    keys.touch();
+    LOG_INFO("KeyManager", "HOTP counter for " + key.name + " set to " + String((unsigned long)counter));
+    bool success = persistUpsert(key);
+    if (!success) {
+        LOG_ERROR("KeyManager", "Failed to save keys after HOTP counter update");
     }
+    return success;
+}
+
+bool KeyManager::beginImport() {
+    PersistLock lock(persistMutex);
+    if (refuseWrites()) {
+        return false;
+    }
+    if (batchActive || importActive) {
+        LOG_WARNING("KeyManager", "Import is not allowed while a batch or another import is in progress");
+        return false;
+    }
+    importActive = true;
+    importKeys.clear(keys.nextId()); // id новых ключей продолжают текущие
+    LOG_INFO("KeyManager", "Importing TOTP keys");
+    return true;
+}
+
+bool KeyManager::stageImport(JsonObjectConst obj) {
+    if (!importActive) {
+        return false;
+    }
+    TOTPKey key;
+    importKeys.readJson(obj, key, (int)importKeys.size());
+    // Длины проверяются по исходным строкам: слоты записи обрезают длинные значения
+    if (!importKeys.validName(obj["name"] | "") || key.secret.isEmpty() || !KeySecret::fits(obj["secret"] | "") ||
+        !TOTPGenerator::isSupported(key.params) ||
+        !TOTPGenerator::prepareKey(key.secret, key.params, key.material)) {
+        LOG_WARNING("KeyManager", "Import rejected, invalid key at position " + String((unsigned long)importKeys.size()));
+        return false;
+    }
+    if (importKeys.findByName(key.name) >= 0) {
+        LOG_WARNING("KeyManager", "Import rejected, duplicate key: " + key.name);
+        return false;
+    }
+    key.id = importKeys.allocateId(); // id из импортируемого файла не используется
+    importKeys.push(key);
+    return true;
+}
+
+bool KeyManager::commitImport() {
+    StoreWriter<SecureStore<TOTPKey> > writer(keys, persistMutex);
+    if (!importActive) {
+        return false;
+    }
+    uint32_t importNextId = importKeys.nextId();
+    std::vector<TOTPKey> imported;
+    importKeys.release(imported);
+    std::stable_sort(imported.begin(), imported.end(), [](const TOTPKey& a, const TOTPKey& b) {
+        return a.order < b.order;
+    });
 
-    // Сохраняем новый набор ключей, который будет автоматически зашифрован
-    bool success = saveKeys();
+    // Текущие ключи подменяются только после записи снимка
+    bool success = writeSnapshot(imported);
     if (success) {
+        keys.assign(imported, importNextId);
         LOG_INFO("KeyManager", "Successfully imported " + String(keys.size()) + " TOTP keys");
     } else {
-        LOG_ERROR("KeyManager", "Failed to save imported keys");
+        LOG_ERROR("KeyManager", "Failed to save imported keys, current keys kept");
     }
+    abortImport();
     return success;
 }
 
+void KeyManager::abortImport() {
+    importActive = false;
+    importKeys.clear();
+}
+
+// Base32 декодируется один раз здесь, а не при каждой генерации кода
+bool KeyManager::refuseWrites() const {
+    if (loadFailed) {
+        LOG_WARNING("KeyManager", "Keys were not loaded, changes are refused to keep the vault files intact");
+    }
+    return loadFailed;
+}
+
+void KeyManager::prepareKeyMaterial(TOTPKey& key) {
+    if (!TOTPGenerator::prepareKey(key.secret, key.params, key.material)) {
+        LOG_WARNING("KeyManager", "Secret or OTP parameters are not valid for key: " + key.name);
+    }
+}
+
+OtpParams KeyManager::readParams(JsonObjectConst obj) {
+    OtpParams params;
+    if (obj["type"].is<const char*>()) {
+        String type = obj["type"].as<String>();
+        type.toLowerCase();
+        if (type == "hotp") {
+            params.type = OtpType::HOTP;
+        } else if (type != "totp") {
+            params.type = static_cast<OtpType>(0xFF);
+        }
+    }
+    if (obj["algorithm"].is<const char*>()) {
+        OtpAlgorithm algorithm;
+        // Неизвестный алгоритм не подменяем на SHA1 - ключ останется невалидным
+        params.algorithm = TOTPGenerator::parseAlgorithm(obj["algorithm"].as<String>(), algorithm)
+            ? algorithm : static_cast<OtpAlgorithm>(0xFF);
+    }
+    params.digits = obj["digits"] | params.digits;
+    params.period = obj["period"] | params.period;
+    return params;
+}
+
+// Счетчик HOTP пишется строкой: uint64 не переживает JavaScript клиентов без потерь
+uint64_t KeyManager::readCounter(JsonObjectConst obj) {
+    if (obj["counter"].is<const char*>()) {
+        return strtoull(obj["counter"].as<const char*>(), nullptr, 10);
+    }
+    return obj["counter"] | (uint64_t)0;
+}
+
+void KeyManager::writeParams(JsonObject obj, const TOTPKey& key) {
+    const OtpParams& params = key.params;
+    if (params.isDefault()) {
+        return;
+    }
+    if (params.isCounterBased()) {
+        obj["type"] = "hotp";
+    }
+    obj["algorithm"] = TOTPGenerator::algorithmName(params.algorithm);
+    obj["digits"] = params.digits;
+    obj["period"] = params.period;
+    if (params.isCounterBased()) {
+        obj["counter"] = String((unsigned long long)key.counter);
+    }
+}
+
 bool KeyManager::loadKeys() {
     LOG_DEBUG("KeyManager", "Loading TOTP keys from file");
-    if (!LittleFS.exists(KEYS_FILE)) {
+    keys.clear();
+
+    bool rewrite = false;
+    if (!loadSnapshot(rewrite)) {
+        return false;
+    }
+
+    // Изменения после последнего снимка (журнал адресует ключи по id)
+    bool replayed = journal.replay([this](JournalOp op, uint32_t id, const String& payload) {
+        applyJournalRecord(op, id, payload);
+    });
+    keys.sortByOrder();
+    keys.touch();
+    LOG_INFO("KeyManager", "Loaded " + String(keys.size()) + " TOTP keys successfully");
+
+    // Снимок старого формата или разросшийся журнал - сразу переписываем снимок
+    if (replayed && (rewrite || journal.needsCompaction(snapshotSize))) {
+        saveKeys();
+    }
+    return replayed;
+}
+
+bool KeyManager::loadSnapshot(bool& rewrite) {
+    snapshotSize = 0;
+    std::vector<TOTPKey> loaded;
+    if (LittleFS.exists(KEYS_FILE)) {
+        // Поля читаются потоково; ключи принимаются только после проверки tag всего файла
+        if (!SecureStore<TOTPKey>::readVault(KEYS_FILE, loaded, &snapshotSize)) {
+            LOG_ERROR("KeyManager", "Failed to read or decrypt keys file");
+            return false;
+        }
+    } else if (LittleFS.exists(KEYS_FILE_LEGACY)) {
+        // Перенос в VaultFile: снимок переписывается сразу после загрузки
+        LOG_INFO("KeyManager", "Migrating keys file to binary vault format");
+        rewrite = true;
+        if (!loadLegacySnapshot(loaded)) {
+            return false;
+        }
+    } else {
         LOG_INFO("KeyManager", "Keys file doesn't exist yet, starting with empty list");
         return true;
     }
 
-    File file = LittleFS.open(KEYS_FILE, "r");
+    for (auto& key : loaded) {
+        prepareKeyMaterial(key);
+        keys.push(key);
+    }
+    return true;
+}
+
+// Прежний формат: JSON + AES-CBC + Base64. Id у ключей может не быть (до журнала)
+bool KeyManager::loadLegacySnapshot(std::vector<TOTPKey>& loaded) {
+    File file = LittleFS.open(KEYS_FILE_LEGACY, "r");
     if (!file) {
         LOG_ERROR("KeyManager", "Failed to open keys file for reading");
         return false;
@@ -172,7 +459,6 @@ bool KeyManager::loadKeys() {
     file.close();
 
     if (encrypted_base64.length() == 0) {
-        keys.clear();
         LOG_INFO("KeyManager", "Keys file is empty");
         return true;
     }
@@ -190,58 +476,165 @@ bool KeyManager::loadKeys() {
         return false;
     }
 
-    keys.clear();
     JsonArray array = doc.as<JsonArray>();
     int currentOrder = 0;
+    uint32_t nextId = 1;
     for (JsonObject obj : array) {
         TOTPKey key;
-        key.name = obj["name"].as<String>(); 
-        key.secret = obj["secret"].as<String>();
-        key.order = obj["order"] | currentOrder++;  // Используем существующий order или назначаем по порядку
-        keys.push_back(key);
+        RecordSchema<TOTPKey>::readJson(obj, key, currentOrder++);
+        key.id = obj["id"] | (uint32_t)0;
+        loaded.push_back(key);
+        if (key.id >= nextId) {
+            nextId = key.id + 1;
+        }
+    }
+
+    // Снимок без id (до появления журнала): назначаем по порядку файла
+    for (auto& key : loaded) {
+        if (key.id == 0) {
+            key.id = nextId++;
+        }
+    }
+    return true;
+}
+
+void KeyManager::applyJournalRecord(JournalOp op, uint32_t id, const String& payload) {
+    switch (op) {
+        case JournalOp::UPSERT: {
+            JsonDocument doc;
+            if (deserializeJson(doc, payload)) {
+                LOG_WARNING("KeyManager", "Skipping malformed journal record for key id " + String(id));
+                return;
+            }
+            size_t index = keys.applyUpsert(id, doc.as<JsonObjectConst>());
+            prepareKeyMaterial(keys.at(index));
+            break;
+        }
+        case JournalOp::REMOVE:
+            keys.applyRemove(id);
+            break;
+        case JournalOp::ORDER: {
+            JsonDocument doc;
+            if (deserializeJson(doc, payload)) {
+                LOG_WARNING("KeyManager", "Skipping malformed journal order record");
+                return;
+            }
+            keys.applyOrder(doc.as<JsonArrayConst>());
+            break;
+        }
+        default:
+            LOG_WARNING("KeyManager", "Unknown journal operation: " + String((int)op));
+            break;
+    }
+}
+
+bool KeyManager::persistUpsert(const TOTPKey& key) {
+    if (batchActive) {
+        batchDirty = true; // Пишется одним снимком в commitBatch()
+        return true;
+    }
+    return persistRecord(JournalOp::UPSERT, key.id, keys.toJson(key));
+}
+
+bool KeyManager::persistRecord(JournalOp op, uint32_t id, const String& payload) {
+    if (batchActive) {
+        batchDirty = true;
+        return true;
+    }
+    PersistLock lock(persistMutex);
+    // Изменение пишется одной записью в журнал; если журнал недоступен - полный снимок
+    if (!journal.append(op, id, payload)) {
+        return saveKeys();
+    }
+    if (journal.needsCompaction(snapshotSize)) {
+        // Изменение уже в журнале: неудачное сворачивание его не теряет
+        saveKeys();
     }
-    LOG_INFO("KeyManager", "Loaded " + String(keys.size()) + " TOTP keys successfully");
     return true;
 }
 
 bool KeyManager::saveKeys() {
+    return writeSnapshot(keys.entries());
+}
+
+// Полный снимок: сворачивает журнал. VaultFile пишется во временный файл и
+// атомарно заменяет KEYS_FILE, поэтому сбой посреди записи не портит предыдущий снимок.
+bool KeyManager::writeSnapshot(const std::vector<TOTPKey>& snapshot) {
     LOG_DEBUG("KeyManager", "Saving TOTP keys to file");
-    JsonDocument doc;
-    JsonArray array = doc.to<JsonArray>();
-    for (const auto& key : keys) {
-        JsonObject obj = array.add<JsonObject>();
-        obj["name"] = key.name;
-        obj["secret"] = key.secret;
-        obj["order"] = key.order;
-    }
-    
-    String json_string;
-    size_t jsonSize = serializeJson(doc, json_string);
-    if (jsonSize == 0) {
-        LOG_ERROR("KeyManager", "Failed to serialize keys to JSON");
+    PersistLock lock(persistMutex);
+    if (!SecureStore<TOTPKey>::writeVault(KEYS_FILE, snapshot, &snapshotSize)) {
+        LOG_ERROR("KeyManager", "Failed to write encrypted keys data");
         return false;
     }
 
-    String encrypted_base64 = CryptoManager::getInstance().encrypt(json_string);
-    if (encrypted_base64.length() == 0) {
-        LOG_ERROR("KeyManager", "Failed to encrypt keys");
-        return false;
+    journal.reset();
+    pendingOrder.clear(); // Снимок уже содержит порядок
+    if (LittleFS.exists(KEYS_FILE_LEGACY)) {
+        LittleFS.remove(KEYS_FILE_LEGACY); // Перенос из старого формата завершен
     }
+    LOG_INFO("KeyManager", "Saved " + String(snapshot.size()) + " TOTP keys successfully");
+    return true;
+}
 
-    File file = LittleFS.open(KEYS_FILE, "w");
-    if (!file) {
-        LOG_ERROR("KeyManager", "Failed to open keys file for writing");
-        return false;
+// --- RecordSchema<TOTPKey> ---
+
+void RecordSchema<TOTPKey>::readJson(JsonObjectConst obj, TOTPKey& key, int defaultOrder) {
+    key.name = obj["name"] | "";
+    key.secret = obj["secret"] | "";
+    key.order = obj["order"] | defaultOrder;  // Используем существующий order или назначаем по порядку
+    key.params = KeyManager::readParams(obj);
+    key.counter = KeyManager::readCounter(obj);
+}
+
+void RecordSchema<TOTPKey>::writeJson(JsonObject obj, const TOTPKey& key) {
+    obj["id"] = key.id;
+    obj["name"] = key.name.c_str();
+    obj["secret"] = key.secret.c_str();
+    obj["order"] = key.order;
+    KeyManager::writeParams(obj, key);
+}
+
+void RecordSchema<TOTPKey>::readField(TOTPKey& key, const VaultFileReader::Field& field) {
+    switch (field.tag) {
+        case KEY_FIELD_ID: key.id = (uint32_t)field.asUInt(); break;
+        case KEY_FIELD_NAME:
+            if (!key.name.assign((const char*)field.data, field.length)) {
+                LOG_DEBUG("KeyManager", "Key name longer than " + String(VAULT_MAX_NAME_LENGTH) + " bytes kept outside its slot");
+            }
+            break;
+        case KEY_FIELD_SECRET:
+            if (!key.secret.assign((const char*)field.data, field.length)) {
+                LOG_WARNING("KeyManager", "Key secret too long, key will not decode: " + key.name);
+                key.secret.clear();
+            }
+            break;
+        case KEY_FIELD_ORDER: key.order = (int)(uint32_t)field.asUInt(); break;
+        case KEY_FIELD_TYPE: key.params.type = static_cast<OtpType>(field.asUInt()); break;
+        case KEY_FIELD_ALGORITHM: key.params.algorithm = static_cast<OtpAlgorithm>(field.asUInt()); break;
+        case KEY_FIELD_DIGITS: key.params.digits = (uint8_t)field.asUInt(); break;
+        case KEY_FIELD_PERIOD: key.params.period = (uint16_t)field.asUInt(); break;
+        case KEY_FIELD_COUNTER: key.counter = field.asUInt(); break;
+        default: break;
     }
-    
-    size_t bytesWritten = file.print(encrypted_base64);
-    file.close();
-    
-    if (bytesWritten > 0) {
-        LOG_INFO("KeyManager", "Saved " + String(keys.size()) + " TOTP keys successfully");
-        return true;
-    } else {
-        LOG_ERROR("KeyManager", "Failed to write encrypted keys data");
-        return false;
+}
+
+void RecordSchema<TOTPKey>::writeFields(VaultFileWriter& writer, const TOTPKey& key) {
+    writer.writeUInt(KEY_FIELD_ID, key.id);
+    writer.writeBytes(KEY_FIELD_NAME, (const uint8_t*)key.name.c_str(), key.name.length());
+    writer.writeBytes(KEY_FIELD_SECRET, (const uint8_t*)key.secret.c_str(), key.secret.length());
+    writer.writeUInt(KEY_FIELD_ORDER, (uint32_t)key.order);
+    if (!key.params.isDefault()) {
+        writer.writeUInt(KEY_FIELD_TYPE, static_cast<uint8_t>(key.params.type));
+        writer.writeUInt(KEY_FIELD_ALGORITHM, static_cast<uint8_t>(key.params.algorithm));
+        writer.writeUInt(KEY_FIELD_DIGITS, key.params.digits);
+        writer.writeUInt(KEY_FIELD_PERIOD, key.params.period);
+    }
+    if (key.params.isCounterBased()) {
+        writer.writeUInt(KEY_FIELD_COUNTER, key.counter);
     }
 }
+
+void RecordSchema<TOTPKey>::wipe(TOTPKey& key) {
+    key.secret.clear();
+    mbedtls_platform_zeroize(&key.material, sizeof(key.material));
+}
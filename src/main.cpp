@@ -8,6 +8,18 @@
 #include <ESPmDNS.h>
 #include "web_server.h"
 #include "totp_generator.h"
+#include "totp_code_cache.h"
+#include "totp_verifier.h"
+#ifdef VAULT_FORMAT_BENCHMARK
+#include "vault_format_benchmark.h"
+#endif
+#ifdef OTP_HMAC_BENCHMARK
+#include "otp_hmac_benchmark.h"
+#endif
+#include "time_continuity.h"
+#include "heap_monitor.h"
+#include "boot_timing.h"
+#include "write_behind.h"
 #include "LittleFS.h"
 #include "esp_sleep.h"
 #include "splash_manager.h"
@@ -52,7 +64,9 @@ BatteryManager batteryManager(34, 14);
 BleKeyboardManager bleKeyboardManager(DEFAULT_BLE_DEVICE_NAME, "Lord", 100);
 WifiManager wifiManager(displayManager, configManager); 
 TOTPGenerator totpGenerator;
-WebServerManager webServerManager(keyManager, splashManager, displayManager, pinManager, configManager, passwordManager, totpGenerator);
+TOTPCodeCache totpCodeCache(keyManager, totpGenerator);
+TOTPVerifier totpVerifier(keyManager, totpGenerator);
+WebServerManager webServerManager(keyManager, splashManager, displayManager, pinManager, configManager, passwordManager, totpGenerator, totpCodeCache, totpVerifier);
 
 #ifdef SECURE_LAYER_ENABLED
 SecureLayerManager& secureLayerManager = SecureLayerManager::getInstance();
@@ -65,6 +79,7 @@ static int currentKeyIndex = 0;
 static int currentPasswordIndex = 0;
 static int previousKeyIndex = -1;
 static int previousPasswordIndex = -1;
+static uint32_t loopIterations = 0; // Итерации loop() с последней проверки памяти
 unsigned long lastButtonPressTime = 0; 
 const int debounceDelay = 300; 
 const int factoryResetHoldTime = 5000;
@@ -82,6 +97,7 @@ static int lastBatteryPercentage = -1;
 
 unsigned long lastTotpUpdateTime = 0;
 const int totpUpdateInterval = 250;
+unsigned long nextTotpWindowTime = 0; // millis() границы окна видимого ключа
 
 void wakeDisplaySafely(const char* reason);
 
@@ -94,31 +110,19 @@ bool hasValidSystemTime() {
     return now >= kMinValidEpoch;
 }
 
-unsigned long loadPersistedEpochFromConfig() {
-    return configManager.getLastKnownEpoch();
-}
-
-void persistCurrentEpochToConfig() {
-    time_t now;
-    time(&now);
-    if (now < kMinValidEpoch) {
-        return;
-    }
-
-    configManager.saveLastKnownEpoch(static_cast<unsigned long>(now));
-}
-
-
 bool syncTimeFromNtpServer(const char* ntpServer, struct tm* timeinfo) {
     time_t beforeEpoch;
     time(&beforeEpoch);
+    TimeContinuity::getInstance().beginExternalSync();
 
     sntp_stop();
     configTime(CONFIG_TIMEZONE_OFFSET_SEC, 0, ntpServer);
 
     const int maxPolls = 20; // ~8 seconds
+    bool sntpCompleted = false; // Статус COMPLETED сбрасывается при чтении - запоминаем
     for (int i = 0; i < maxPolls; ++i) {
         if (sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED) {
+            sntpCompleted = true;
             break;
         }
         delay(400);
@@ -134,34 +138,15 @@ bool syncTimeFromNtpServer(const char* ntpServer, struct tm* timeinfo) {
     if (afterEpoch >= kMinValidEpoch) {
         LOG_INFO("Main", "NTP sync applied. before=" + String((unsigned long)beforeEpoch) +
                          ", after=" + String((unsigned long)afterEpoch));
+        // Без ответа SNTP часы валидны только за счет восстановленного времени
+        if (sntpCompleted) {
+            TimeContinuity::getInstance().completeExternalSync();
+        }
         return true;
     }
 
     return false;
 }
-
-bool restoreSystemTimeFromPersistedEpoch() {
-    if (hasValidSystemTime()) {
-        return true;
-    }
-
-    unsigned long persistedEpoch = loadPersistedEpochFromConfig();
-    if (persistedEpoch < static_cast<unsigned long>(kMinValidEpoch)) {
-        return false;
-    }
-
-    timeval tv = {};
-    tv.tv_sec = static_cast<time_t>(persistedEpoch);
-    tv.tv_usec = 0;
-
-    if (settimeofday(&tv, nullptr) == 0) {
-        LOG_INFO("Main", "System time restored from persisted epoch: " + String(persistedEpoch));
-        return true;
-    }
-
-    LOG_ERROR("Main", "Failed to restore system time from persisted epoch");
-    return false;
-}
 } // namespace
 
 void showWebServerInfoPage() {
@@ -233,21 +218,30 @@ void handleFactoryResetOnBoot() {
             LOG_CRITICAL("Main", "--- FACTORY RESET ---");
             LOG_INFO("Main", "Clearing active web sessions...");
             webServerManager.clearSession();
+            // Отложенные записи - до удаления: после него они вернули бы файлы на место
+            WriteBehind::getInstance().sync();
             LOG_INFO("Main", "Deleting files...");
             LittleFS.remove(KEYS_FILE);
-            LittleFS.remove("/wifi_config.json");
+            LittleFS.remove(KEYS_FILE_LEGACY);
+            LittleFS.remove(KEYS_JOURNAL_FILE);
+            LittleFS.remove(WIFI_CONFIG_FILE);
+            LittleFS.remove(WIFI_CONFIG_FILE_ENC_LEGACY);
+            LittleFS.remove(WIFI_CONFIG_FILE_LEGACY);
             // SPLASH_IMAGE_PATH removed - custom splash upload disabled for security
             LittleFS.remove("/splash_config.json");  // Splash mode config (reset to disabled)
             LittleFS.remove(PIN_FILE);
             LittleFS.remove(CONFIG_FILE); // Resets display timeout to default (30s) + AP password to "12345678"
             LittleFS.remove(DEVICE_KEY_FILE);
             LittleFS.remove(PASSWORD_FILE);
+            LittleFS.remove(PASSWORD_JOURNAL_FILE);
             LittleFS.remove(BLE_CONFIG_FILE);
             LittleFS.remove(WEB_ADMIN_FILE);
+            LittleFS.remove(WEB_ADMIN_FILE_LEGACY);
             LittleFS.remove(MDNS_CONFIG_FILE); // <-- СБРОС MDNS
             LittleFS.remove(LOGIN_STATE_FILE); // <-- СБРОС СОСТОЯНИЯ ЛОГИНА
             LittleFS.remove("/ble_pin.json.enc"); // <-- СБРОС BLE PIN
-            LittleFS.remove("/session.json.enc"); // <-- СБРОС СЕССИЙ И CSRF
+            LittleFS.remove(SESSION_FILE); // <-- СБРОС СЕССИЙ И CSRF
+            LittleFS.remove(SESSION_FILE_LEGACY);
             
             // 🔗 URL Obfuscation: Удаление boot counter и всех mappings
             LOG_INFO("Main", "Clearing URL obfuscation data...");
@@ -322,9 +316,27 @@ void setup() {
         tempDisplay.showMessage("文件系统挂载失败", 10, 30, true);
         while(1);
     }
+    BootTiming::mark("fs");
+
+    // Время восстанавливается до всего остального: TOTP доступен сразу в OFFLINE/AP без сети
+    LOG_INFO("Main", "Restoring time continuity...");
+    if (TimeContinuity::getInstance().begin(configManager)) {
+        // 允许离线/AP模式使用已恢复的系统时钟继续显示 TOTP。
+        totpGenerator.markTimeSynchronized();
+    }
+    BootTiming::mark("time");
 
     LOG_INFO("Main", "Initializing Crypto Manager...");
     CryptoManager::getInstance().begin();
+    BootTiming::mark("crypto");
+#ifdef VAULT_FORMAT_BENCHMARK
+    // Сравнение форматов хранилища (только отладочная сборка)
+    VaultFormatBenchmark::run();
+#endif
+#ifdef OTP_HMAC_BENCHMARK
+    // HMAC для OTP: mbedtls_md_hmac против клонирования контекстов (только отладочная сборка)
+    OtpHmacBenchmark::run();
+#endif
 
 #ifdef SECURE_LAYER_ENABLED
     LOG_INFO("Main", "Initializing Secure Layer Manager...");
@@ -370,14 +382,20 @@ void setup() {
     // Ранняя инициализация для splash (без заполнения экрана и без включения яркости)
     displayManager.initForSplash();
     keyManager.begin();
+    BootTiming::mark("keys");
+    totpCodeCache.begin();
+    totpVerifier.begin();
+    // Хранилище паролей загружается позже: при первом обращении или в фоне после первого кадра
     passwordManager.begin();
     pinManager.begin();
+    BootTiming::mark("managers");
     
     LOG_INFO("Main", "Displaying splash screen...");
     splashManager.displaySplashScreen();
     
     // 🔧 Полная инициализация display после splash (перед PIN проверкой)
     displayManager.init();
+    BootTiming::mark("display");
     
     LOG_INFO("Main", "Checking device startup PIN...");
     if (pinManager.isPinEnabledForDevice() && pinManager.isPinSet()) {
@@ -392,20 +410,19 @@ void setup() {
     } else {
             LOG_INFO("Main", "Device PIN disabled or not set. Continuing startup...");
     }
+    BootTiming::mark("pin"); // Включает ожидание ввода PIN
     
     displayManager.updateMessage("初始化中...", 10, 10, 2);
     
     // 🌌 ПРОМПТИНГ ВЫБОРА РЕЖИМА (AP/Offline/WiFi)
     LOG_INFO("Main", "Prompting for startup mode...");
     StartupMode selectedMode = displayManager.promptModeSelection();
+    BootTiming::mark("mode_select"); // Включает ожидание выбора режима
     
     // Переменная для отслеживания синхронизации времени
     struct tm timeinfo;
-    bool timeSynced = restoreSystemTimeFromPersistedEpoch();
-    if (timeSynced) {
-        // 允许离线/AP模式使用已恢复的系统时钟继续显示 TOTP。
-        totpGenerator.markTimeSynchronized();
-    }
+    // Часы восстановлены TimeContinuity сразу после монтирования LittleFS
+    bool timeSynced = TimeContinuity::getInstance().hasUsableTime();
     LOG_INFO("Main", String("Initial time state: ") + (timeSynced ? "valid/restored" : "not synced"));
     
     if (selectedMode == StartupMode::AP_MODE) {
@@ -535,7 +552,6 @@ void setup() {
                 LOG_INFO("Main", "Time Synced Successfully on attempt " + String(i+1) + " (" + String(ntpServers[i]) + ")!");
                 // 🔄 Обновляем только текст
                 displayManager.updateMessage("时间同步完成！", 10, 10, 2);
-                persistCurrentEpochToConfig();
                 delay(1000);
                 break;
             }
@@ -621,6 +637,7 @@ void setup() {
     
     // ✅ displayManager.init() уже вызван - очищаем область сообщений перед входом в основной цикл
     displayManager.clearMessageArea(0, 0, 240, 60);
+    BootTiming::mark("network");
 
     LOG_INFO("Main", "Main Loop Started");
     lastActivityTime = millis();
@@ -722,14 +739,14 @@ void handleButtons() {
             if (millis() - button1PressStartTime < powerOffHoldTime) {
                 LOG_DEBUG("Main", "Button 1 SHORT PRESS: Previous item");
                 if (currentMode == AppMode::TOTP) {
-                    auto keys = keyManager.getAllKeys();
+                    const auto& keys = keyManager.getAllKeys();
                     if (!keys.empty()) {
                         currentKeyIndex = (currentKeyIndex == 0) ? keys.size() - 1 : currentKeyIndex - 1;
                         displayManager.setKeySwitched(true); // <-- ADDED
                         buttonPressed = true;
                     }
                 } else if (currentMode == AppMode::PASSWORD) { 
-                    auto passwords = passwordManager.getAllPasswords();
+                    const auto& passwords = passwordManager.getAllPasswords();
                     if (!passwords.empty()) {
                         currentPasswordIndex = (currentPasswordIndex == 0) ? passwords.size() - 1 : currentPasswordIndex - 1;
                         buttonPressed = true;
@@ -750,6 +767,7 @@ void handleButtons() {
             displayManager.showMessage("正在关闭...", 10, 30, false, 2);
             delay(1000);
             displayManager.turnOff();
+            WriteBehind::getInstance().sync();
             esp_deep_sleep_start();
         } else {
             unsigned long holdTime = millis() - button2PressStartTime;
@@ -764,14 +782,14 @@ void handleButtons() {
             if (millis() - button2PressStartTime < powerOffHoldTime) {
                 LOG_DEBUG("Main", "Button 2 SHORT PRESS: Next item");
                 if (currentMode == AppMode::TOTP) {
-                    auto keys = keyManager.getAllKeys();
+                    const auto& keys = keyManager.getAllKeys();
                     if (!keys.empty()) {
                         currentKeyIndex = (currentKeyIndex + 1) % keys.size();
                         displayManager.setKeySwitched(true); // <-- ADDED
                         buttonPressed = true;
                     }
                 } else if (currentMode == AppMode::PASSWORD) {
-                    auto passwords = passwordManager.getAllPasswords();
+                    const auto& passwords = passwordManager.getAllPasswords();
                     if (!passwords.empty()) {
                         currentPasswordIndex = (currentPasswordIndex + 1) % passwords.size();
                         buttonPressed = true;
@@ -858,7 +876,10 @@ void loop() {
     if (esp_task_wdt_reset() != ESP_OK) {
         LOG_ERROR("Main", "Failed to reset Watchdog Timer");
     }
+    loopIterations++;
     displayManager.update(); // Обновляем анимации в любом режиме
+    TimeContinuity::getInstance().loop(); // Контрольные точки времени (RTC память / flash)
+    WriteBehind::getInstance().loop(); // Отложенная запись затихших изменений (порядок, настройки)
     
     // Всегда проверяем включение экрана от кнопок
     checkScreenWakeup();
@@ -925,6 +946,8 @@ void loop() {
 
         esp_sleep_enable_ext0_wakeup(GPIO_NUM_0, 0); // BUTTON_2 唤醒
         LOG_INFO("Main", "Entering light sleep immediately after AP logout.");
+        WriteBehind::getInstance().sync();
+        TimeContinuity::getInstance().checkpoint(true); // Батарея может сесть во время сна
         esp_err_t sleepResult = esp_light_sleep_start();
 
         if (sleepResult != ESP_OK) {
@@ -968,7 +991,9 @@ void loop() {
 
         LOG_INFO("Main", "Configured wakeup sources. Entering light sleep now.");
         
-        // 3. Уходим в легкий сон
+        // 3. Уходим в легкий сон (отложенные изменения и контрольная точка времени - на случай разряда батареи во сне)
+        WriteBehind::getInstance().sync();
+        TimeContinuity::getInstance().checkpoint(true);
         esp_light_sleep_start();
         
         // ... выполнение кода продолжится здесь после пробуждения ...
@@ -999,8 +1024,19 @@ void loop() {
             // Мониторинг критического состояния памяти
             static unsigned long lastCriticalMemoryCheck = 0;
             if (millis() - lastCriticalMemoryCheck > 30000) { // Проверяем каждые 30 секунд
+                HeapStats heap = HeapMonitor::sample();
+                uint32_t freeHeap = heap.freeHeap;
+
+                // Скорость основного цикла, минимум кучи и наибольший свободный блок (диагностика)
+                unsigned long elapsed = millis() - lastCriticalMemoryCheck;
+                if (lastCriticalMemoryCheck != 0 && elapsed > 0) {
+                    LOG_DEBUG("Main", "Loop: " + String((unsigned long)((uint64_t)loopIterations * 1000 / elapsed)) +
+                              " it/s, free heap " + String(freeHeap) + ", min " + String(heap.minFreeHeap) +
+                              ", largest block " + String(heap.largestFreeBlock) + " (min " + String(heap.minLargestFreeBlock) +
+                              ", fragmentation " + String(heap.fragmentation) + "%)");
+                }
+                loopIterations = 0;
                 lastCriticalMemoryCheck = millis();
-                uint32_t freeHeap = ESP.getFreeHeap();
                 
                 // Только критические предупреждения для production
                 if (freeHeap < 15000) { // Меньше 15KB - критично!
@@ -1008,6 +1044,8 @@ void loop() {
                     
                     // Принудительная очистка кэшей при критической нехватке памяти
                     if (freeHeap < 10000) {
+                        WriteBehind::getInstance().sync(); // Порядок и настройки, ожидающие записи
+                        TimeContinuity::getInstance().checkpoint(false); // Только RTC память, без flash
                         ESP.restart(); // Аварийная перезагрузка при < 10KB
                     }
                 }
@@ -1017,18 +1055,22 @@ void loop() {
         switch (currentMode) {
             case AppMode::TOTP:
             {
-                auto keys = keyManager.getAllKeys();
+                const auto& keys = keyManager.getAllKeys();
                 if (!keys.empty()) {
                     if (currentKeyIndex != previousKeyIndex) {
                         displayManager.drawLayout(keys[currentKeyIndex].name, batteryManager.getPercentage(), batteryManager.getVoltage() > 4.18, webServerManager.isRunning());
                         previousKeyIndex = currentKeyIndex;
                     }
                     
-                    if (!displayManager.isLoaderActive() && millis() - lastTotpUpdateTime > totpUpdateInterval) {
+                    // Тик по интервалу или точно на границе окна: код следующего окна уже
+                    // посчитан кэшем заранее, поэтому смена кода не ждет очередного интервала
+                    bool windowBoundaryReached = (long)(millis() - nextTotpWindowTime) >= 0;
+                    if (!displayManager.isLoaderActive() && (millis() - lastTotpUpdateTime > totpUpdateInterval || windowBoundaryReached)) {
                         lastTotpUpdateTime = millis();
+                        nextTotpWindowTime = lastTotpUpdateTime + totpGenerator.getMillisToNextWindow(keys[currentKeyIndex].material);
                         
-                        // ⚠️ Проверка синхронизации времени
-                        if (!totpGenerator.isTimeSynced()) {
+                        // ⚠️ Проверка синхронизации времени (HOTP коды от времени не зависят)
+                        if (!keys[currentKeyIndex].params.isCounterBased() && !totpGenerator.isTimeSynced()) {
                             // Показываем предупреждение вместо TOTP кода (убрали TIME для краткости)
                             displayManager.updateTOTPCode("未同步", 0);
                             
@@ -1072,10 +1114,14 @@ void loop() {
                                 }
                             }
                         } else {
-                            // Время синхронизировано - показываем TOTP код
-                            String code = totpGenerator.generateTOTP(keys[currentKeyIndex].secret);
-                            int timeLeft = totpGenerator.getTimeRemaining();
-                            displayManager.updateTOTPCode(code, timeLeft);
+                            // Время синхронизировано - показываем TOTP код (из кэша текущего окна)
+                            const TOTPKeyMaterial& material = keys[currentKeyIndex].material;
+                            char code[OTP_CODE_BUFFER_SIZE];
+                            OtpStatus status = totpCodeCache.getCode(currentKeyIndex, code, sizeof(code));
+                            // Для HOTP таймера нет: -1 скрывает прогресс-бар
+                            int timeLeft = keys[currentKeyIndex].params.isCounterBased() ? -1 : totpGenerator.getTimeRemaining(material);
+                            displayManager.updateTOTPCode(status == OtpStatus::OK ? code : TOTPGenerator::statusText(status),
+                                                          timeLeft, material.isValid() ? material.params.period : CONFIG_TOTP_STEP_SIZE);
                         }
                     }
                 } else {
@@ -1085,17 +1131,27 @@ void loop() {
             }
             case AppMode::PASSWORD:
             {
-                auto passwords = passwordManager.getAllPasswords();
+                const auto& passwords = passwordManager.getAllPasswords();
                 if (!passwords.empty()) {
-                    if (currentPasswordIndex != previousPasswordIndex) {
+                    // Набор мог уменьшиться из веб-интерфейса: индекс - по снимку, который держим
+                    static uint32_t drawnGeneration = 0;
+                    if (currentPasswordIndex >= (int)passwords.size()) {
+                        currentPasswordIndex = passwords.size() - 1;
+                    }
+                    if (currentPasswordIndex != previousPasswordIndex || passwords.generation() != drawnGeneration) {
+                        // Пароль расшифровывается только на время отрисовки; по id записи
+                        // снимка, чтобы удаление или перестановка не подменили его чужим
+                        RevealedPassword password;
+                        passwordManager.revealPasswordById(passwords[currentPasswordIndex].id, password);
                         displayManager.drawPasswordLayout(
                             passwords[currentPasswordIndex].name,
-                            passwords[currentPasswordIndex].password,
+                            password.c_str(),
                             batteryManager.getPercentage(),
                             batteryManager.getVoltage() > 4.18,
                             webServerManager.isRunning()
                         );
                         previousPasswordIndex = currentPasswordIndex;
+                        drawnGeneration = passwords.generation();
                     }
                 } else {
                     displayManager.drawNoItemsPage("passwords");
@@ -1216,9 +1272,10 @@ void loop() {
             case AppMode::BLE_CONFIRM_SEND:
                 {
                     static bool confirmPageDrawn = false;
+                    static uint32_t confirmPasswordId = 0; // Запись, показанная на странице подтверждения
                     
-                    auto passwords = passwordManager.getAllPasswords();
-                    if (passwords.empty() || currentPasswordIndex >= passwords.size()) {
+                    const auto& passwords = passwordManager.getAllPasswords();
+                    if (passwords.empty() || currentPasswordIndex >= (int)passwords.size()) {
                         // Safety check
                         currentMode = AppMode::PASSWORD;
                         bleKeyboardManager.end();
@@ -1230,9 +1287,11 @@ void loop() {
                     // Рисуем страницу только один раз или при принудительной перерисовке
                     if (!confirmPageDrawn || previousPasswordIndex == -1) {
                         String passwordName = passwords[currentPasswordIndex].name;
-                        String password = passwords[currentPasswordIndex].password;
+                        confirmPasswordId = passwords[currentPasswordIndex].id;
+                        RevealedPassword password;
+                        passwordManager.revealPasswordById(confirmPasswordId, password);
                         String deviceName = bleKeyboardManager.getDeviceName();
-                        displayManager.drawBleConfirmPage(passwordName, password, deviceName);
+                        displayManager.drawBleConfirmPage(passwordName, password.length(), deviceName);
                         confirmPageDrawn = true;
                         previousPasswordIndex = currentPasswordIndex;
                     }
@@ -1250,11 +1309,18 @@ void loop() {
                         LOG_INFO("Main", "Send button pressed. Sending data");
                         
                         displayManager.drawBleSendingPage();
-                        String password = passwords[currentPasswordIndex].password;
-                        bleKeyboardManager.sendPassword(password.c_str());
+                        bool revealed;
+                        {
+                            RevealedPassword password;
+                            // Отправляется запись, которую пользователь подтвердил; удаленная - не отправляется
+                            revealed = passwordManager.revealPasswordById(confirmPasswordId, password);
+                            if (revealed) {
+                                bleKeyboardManager.sendPassword(password.c_str());
+                            }
+                        } // Открытый пароль затирается здесь
                         delay(500); // Give time for the UI and BLE
                         
-                        displayManager.drawBleResultPage(true); // Show success
+                        displayManager.drawBleResultPage(revealed); // Show result
                         delay(1500);
 
                         // Возвращаемся к странице подтверждения для повторной отправки
@@ -1264,11 +1330,22 @@ void loop() {
                 }
                 break;
         }
+
+        // Первый кадр режима показан: отчет о загрузке, пароли - в фоне на свободном ядре
+        static bool bootCompleted = false;
+        if (!bootCompleted) {
+            bootCompleted = true;
+            BootTiming::mark("first_frame");
+            BootTiming::report();
+            passwordManager.startPrefetch();
+        }
     }
     
     // Check for scheduled restart
     if (shouldRestart) {
         LOG_INFO("Main", "Device restart requested. Restarting in 1 second...");
+        WriteBehind::getInstance().sync();
+        TimeContinuity::getInstance().checkpoint(true);
         delay(1000);
         ESP.restart();
     }
@@ -0,0 +1,154 @@
+#include "name_index.h"
+
+namespace {
+const size_t kMinCapacity = 16;
+} // namespace
+
+const uint32_t NameIndex::TOMBSTONE;
+const uint32_t NameIndex::NO_SLOT;
+
+NameIndex::NameIndex(NameAt nameAt) : _nameAt(nameAt) {}
+
+void NameIndex::clear() {
+    _slots.clear();
+    _idSlots.clear();
+    _count = 0;
+    _used = 0;
+}
+
+void NameIndex::reserve(size_t count) {
+    size_t capacity = kMinCapacity;
+    while (capacity * 3 < count * 4) {
+        capacity <<= 1;
+    }
+    if (capacity > _slots.size()) {
+        rehash(capacity);
+    }
+}
+
+// FNV-1a: имена короткие, достаточно 32 бит
+uint32_t NameIndex::hashName(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (const char* c = name; *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// id выдаются подряд: перемешиваем, чтобы соседние id не шли в соседние слоты
+uint32_t NameIndex::hashId(uint32_t id) {
+    id ^= id >> 16;
+    id *= 0x45d9f3bu;
+    id ^= id >> 16;
+    return id;
+}
+
+void NameIndex::insert(const char* name, uint32_t id, uint32_t position) {
+    if ((_used + 1) * 4 > _slots.size() * 3) {
+        // Много удаленных слотов - перестраиваем в той же емкости, иначе растем
+        size_t capacity = _slots.empty() ? kMinCapacity : _slots.size();
+        if ((_count + 1) * 2 > capacity) {
+            capacity <<= 1;
+        }
+        rehash(capacity);
+    }
+    Slot slot;
+    slot.hash = hashName(name);
+    slot.id = id;
+    slot.position = position;
+    place(slot);
+    _count++;
+    _used++;
+}
+
+void NameIndex::place(const Slot& slot) {
+    size_t mask = _slots.size() - 1;
+    size_t i = slot.hash & mask;
+    while (_slots[i].id != 0 && _slots[i].id != TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    _slots[i] = slot;
+
+    size_t j = hashId(slot.id) & mask;
+    while (_idSlots[j] != 0 && _idSlots[j] != TOMBSTONE) {
+        j = (j + 1) & mask;
+    }
+    _idSlots[j] = (uint32_t)i + 1;
+}
+
+void NameIndex::rehash(size_t capacity) {
+    std::vector<Slot> old;
+    old.swap(_slots);
+    _slots.assign(capacity, Slot());
+    _idSlots.assign(capacity, 0);
+    _used = _count;
+    for (const Slot& slot : old) {
+        if (slot.id != 0 && slot.id != TOMBSTONE) {
+            place(slot);
+        }
+    }
+}
+
+uint32_t NameIndex::findSlotById(uint32_t id) const {
+    if (_slots.empty() || id == 0 || id == TOMBSTONE) {
+        return NO_SLOT;
+    }
+    size_t mask = _slots.size() - 1;
+    for (size_t j = hashId(id) & mask, probes = 0; _idSlots[j] != 0 && probes < _idSlots.size();
+         j = (j + 1) & mask, probes++) {
+        uint32_t slot = _idSlots[j];
+        if (slot != TOMBSTONE && _slots[slot - 1].id == id) {
+            return (uint32_t)j;
+        }
+    }
+    return NO_SLOT;
+}
+
+void NameIndex::erase(uint32_t id) {
+    uint32_t j = findSlotById(id);
+    if (j == NO_SLOT) {
+        return;
+    }
+    _slots[_idSlots[j] - 1].id = TOMBSTONE;
+    _idSlots[j] = TOMBSTONE;
+    _count--;
+}
+
+void NameIndex::rename(uint32_t id, const char* name) {
+    uint32_t j = findSlotById(id);
+    if (j == NO_SLOT) {
+        return;
+    }
+    uint32_t position = _slots[_idSlots[j] - 1].position;
+    erase(id);
+    insert(name, id, position);
+}
+
+void NameIndex::setPosition(uint32_t id, uint32_t position) {
+    uint32_t j = findSlotById(id);
+    if (j != NO_SLOT) {
+        _slots[_idSlots[j] - 1].position = position;
+    }
+}
+
+int NameIndex::findByName(const String& name) const {
+    if (_slots.empty()) {
+        return -1;
+    }
+    uint32_t hash = hashName(name.c_str());
+    size_t mask = _slots.size() - 1;
+    for (size_t i = hash & mask, probes = 0; _slots[i].id != 0 && probes < _slots.size();
+         i = (i + 1) & mask, probes++) {
+        const Slot& slot = _slots[i];
+        if (slot.id != TOMBSTONE && slot.hash == hash && strcmp(_nameAt(slot.position), name.c_str()) == 0) {
+            return (int)slot.position;
+        }
+    }
+    return -1;
+}
+
+int NameIndex::findById(uint32_t id) const {
+    uint32_t j = findSlotById(id);
+    return j == NO_SLOT ? -1 : (int)_slots[_idSlots[j] - 1].position;
+}
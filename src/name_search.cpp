@@ -0,0 +1,88 @@
+#include "name_search.h"
+
+namespace {
+inline uint8_t foldCase(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + ('a' - 'A')) : c;
+}
+} // namespace
+
+NameSearch::NameSearch(NameAt nameAt) : _nameAt(nameAt) {}
+
+void NameSearch::clear() {
+    _signatures.clear();
+}
+
+void NameSearch::reserve(size_t count) {
+    _signatures.reserve(count);
+}
+
+// Каждая триграмма ставит один бит из 64. Для имени в 20-30 символов занята
+// примерно треть бит, поэтому запрос из нескольких триграмм отсекает почти
+// все лишние записи до сравнения строк.
+uint64_t NameSearch::signature(const char* data, size_t length) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i + 3 <= length; i++) {
+        uint32_t trigram = ((uint32_t)foldCase(data[i]) << 16) |
+                           ((uint32_t)foldCase(data[i + 1]) << 8) |
+                           foldCase(data[i + 2]);
+        bits |= 1ULL << ((trigram * 2654435761u) >> 26);
+    }
+    return bits;
+}
+
+bool NameSearch::contains(const char* name, const char* query, size_t length) {
+    size_t nameLength = strlen(name);
+    if (length > nameLength) {
+        return false;
+    }
+    const char* data = name;
+    for (size_t start = 0; start + length <= nameLength; start++) {
+        size_t i = 0;
+        while (i < length && foldCase(data[start + i]) == foldCase(query[i])) {
+            i++;
+        }
+        if (i == length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void NameSearch::append(const char* name) {
+    _signatures.push_back(signature(name, strlen(name)));
+}
+
+void NameSearch::update(uint32_t position, const char* name) {
+    if (position < _signatures.size()) {
+        _signatures[position] = signature(name, strlen(name));
+    }
+}
+
+void NameSearch::erase(uint32_t position) {
+    if (position < _signatures.size()) {
+        _signatures.erase(_signatures.begin() + position);
+    }
+}
+
+size_t NameSearch::find(const String& query, std::vector<uint32_t>& positions, size_t limit) const {
+    positions.clear();
+    if (query.length() == 0) {
+        return 0;
+    }
+    // Запрос короче трех байт не дает триграмм: сигнатура 0 пропускает все записи
+    uint64_t required = signature(query.c_str(), query.length());
+    size_t found = 0;
+    for (size_t i = 0; i < _signatures.size(); i++) {
+        if ((_signatures[i] & required) != required) {
+            continue;
+        }
+        if (!contains(_nameAt((uint32_t)i), query.c_str(), query.length())) {
+            continue;
+        }
+        if (limit == 0 || positions.size() < limit) {
+            positions.push_back((uint32_t)i);
+        }
+        found++;
+    }
+    return found;
+}
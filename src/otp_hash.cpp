@@ -0,0 +1,81 @@
+#include "otp_hash.h"
+#include "mbedtls/platform_util.h"
+
+// Коды возврата mbedtls не проверяются: для SHA без аппаратного сбоя их нет,
+// а в mbedtls 2.x эти функции возвращают void (см. device_static_key.cpp)
+
+void Sha1::init(Context* ctx) { mbedtls_sha1_init(ctx); }
+void Sha1::free(Context* ctx) { mbedtls_sha1_free(ctx); }
+void Sha1::clone(Context* dst, const Context* src) { mbedtls_sha1_clone(dst, src); }
+void Sha1::starts(Context* ctx) { mbedtls_sha1_starts(ctx); }
+void Sha1::update(Context* ctx, const uint8_t* data, size_t len) { mbedtls_sha1_update(ctx, data, len); }
+void Sha1::finish(Context* ctx, uint8_t digest[kDigestSize]) { mbedtls_sha1_finish(ctx, digest); }
+
+void Sha256::init(Context* ctx) { mbedtls_sha256_init(ctx); }
+void Sha256::free(Context* ctx) { mbedtls_sha256_free(ctx); }
+void Sha256::clone(Context* dst, const Context* src) { mbedtls_sha256_clone(dst, src); }
+void Sha256::starts(Context* ctx) { mbedtls_sha256_starts(ctx, 0); }
+void Sha256::update(Context* ctx, const uint8_t* data, size_t len) { mbedtls_sha256_update(ctx, data, len); }
+void Sha256::finish(Context* ctx, uint8_t digest[kDigestSize]) { mbedtls_sha256_finish(ctx, digest); }
+
+void Sha512::init(Context* ctx) { mbedtls_sha512_init(ctx); }
+void Sha512::free(Context* ctx) { mbedtls_sha512_free(ctx); }
+void Sha512::clone(Context* dst, const Context* src) { mbedtls_sha512_clone(dst, src); }
+void Sha512::starts(Context* ctx) { mbedtls_sha512_starts(ctx, 0); }
+void Sha512::update(Context* ctx, const uint8_t* data, size_t len) { mbedtls_sha512_update(ctx, data, len); }
+void Sha512::finish(Context* ctx, uint8_t digest[kDigestSize]) { mbedtls_sha512_finish(ctx, digest); }
+
+namespace {
+
+// Контекст после блока K ^ pad. Хеш считается во временном контексте и
+// клонируется в target: клон всегда программный, а free() временного
+// контекста освобождает аппаратный движок, если он был захвачен.
+template <typename Hash>
+void absorbPad(typename Hash::Context& target, const uint8_t* key, size_t keyLen, uint8_t pad) {
+    uint8_t block[Hash::kBlockSize];
+    memset(block, pad, sizeof(block));
+    for (size_t i = 0; i < keyLen && i < Hash::kBlockSize; i++) {
+        block[i] ^= key[i];
+    }
+
+    typename Hash::Context ctx;
+    Hash::init(&ctx);
+    Hash::starts(&ctx);
+    Hash::update(&ctx, block, sizeof(block));
+    Hash::init(&target);
+    Hash::clone(&target, &ctx);
+    Hash::free(&ctx);
+    mbedtls_platform_zeroize(block, sizeof(block));
+}
+
+} // namespace
+
+template <typename Hash>
+void HmacMidstate<Hash>::prepare(const uint8_t* key, size_t keyLen) {
+    absorbPad<Hash>(inner, key, keyLen, 0x36);
+    absorbPad<Hash>(outer, key, keyLen, 0x5C);
+}
+
+template <typename Hash>
+void HmacMidstate<Hash>::compute(const uint8_t message[8], uint8_t digest[Hash::kDigestSize]) const {
+    typename Hash::Context ctx;
+    uint8_t innerDigest[Hash::kDigestSize];
+
+    // Внутренний хеш: контекст K ^ ipad + сообщение
+    Hash::init(&ctx);
+    Hash::clone(&ctx, &inner);
+    Hash::update(&ctx, message, 8);
+    Hash::finish(&ctx, innerDigest);
+    Hash::free(&ctx);
+
+    // Внешний хеш: контекст K ^ opad + внутренний дайджест
+    Hash::init(&ctx);
+    Hash::clone(&ctx, &outer);
+    Hash::update(&ctx, innerDigest, sizeof(innerDigest));
+    Hash::finish(&ctx, digest);
+    Hash::free(&ctx);
+}
+
+template struct HmacMidstate<Sha1>;
+template struct HmacMidstate<Sha256>;
+template struct HmacMidstate<Sha512>;
@@ -0,0 +1,68 @@
+#ifdef OTP_HMAC_BENCHMARK
+
+#include "otp_hmac_benchmark.h"
+#include "otp_hash.h"
+#include "log_manager.h"
+#include <mbedtls/md.h>
+#include <esp_timer.h>
+
+namespace {
+const uint32_t kCodes = 2000;
+const uint8_t kKey[20] = { '1', '2', '3', '4', '5', '6', '7', '8', '9', '0',
+                           '1', '2', '3', '4', '5', '6', '7', '8', '9', '0' };
+
+void counterMessage(uint64_t counter, uint8_t message[8]) {
+    for (int i = 7; i >= 0; i--) {
+        message[i] = counter & 0xFF;
+        counter >>= 8;
+    }
+}
+
+template <typename Hash>
+void benchmark(const char* name, mbedtls_md_type_t type) {
+    const mbedtls_md_info_t* info = mbedtls_md_info_from_type(type);
+    HmacMidstate<Hash> midstate;
+    midstate.prepare(kKey, sizeof(kKey));
+
+    uint8_t message[8];
+    uint8_t digest[Hash::kDigestSize];
+    uint8_t expected[Hash::kDigestSize];
+    uint32_t mismatches = 0;
+
+    // Полный HMAC на каждый код, как в прежнем TOTPGenerator
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < kCodes; i++) {
+        counterMessage(i, message);
+        mbedtls_md_hmac(info, kKey, sizeof(kKey), message, sizeof(message), digest);
+    }
+    int64_t fullUs = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (uint32_t i = 0; i < kCodes; i++) {
+        counterMessage(i, message);
+        midstate.compute(message, digest);
+    }
+    int64_t midstateUs = esp_timer_get_time() - start;
+
+    // Сверка вне замеров
+    for (uint32_t i = 0; i < kCodes; i += 97) {
+        counterMessage(i, message);
+        mbedtls_md_hmac(info, kKey, sizeof(kKey), message, sizeof(message), expected);
+        midstate.compute(message, digest);
+        mismatches += memcmp(expected, digest, sizeof(digest)) != 0 ? 1 : 0;
+    }
+
+    LOG_INFO("OtpBench", String(name) + ": mbedtls_md_hmac " + String((double)fullUs * 1000.0 / kCodes, 0) +
+             " ns/code, midstate " + String((double)midstateUs * 1000.0 / kCodes, 0) + " ns/code" +
+             (mismatches ? ", DIGEST MISMATCH" : ""));
+}
+} // namespace
+
+void OtpHmacBenchmark::run() {
+    LOG_INFO("OtpBench", "Comparing mbedtls_md_hmac with cloned HMAC contexts, " + String((unsigned long)kCodes) + " codes");
+    benchmark<Sha1>("SHA1", MBEDTLS_MD_SHA1);
+    benchmark<Sha256>("SHA256", MBEDTLS_MD_SHA256);
+    benchmark<Sha512>("SHA512", MBEDTLS_MD_SHA512);
+}
+
+#endif // OTP_HMAC_BENCHMARK
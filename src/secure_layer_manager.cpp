@@ -369,6 +369,41 @@ IRAM_ATTR bool SecureLayerManager::decryptRequest(const String& clientId, const
     return success;
 }
 
+bool SecureLayerManager::acceptRequestCounter(const String& clientId, uint64_t counter) {
+    if (!initialized) {
+        LOG_ERROR("SecureLayerManager", "Manager not initialized");
+        return false;
+    }
+    SecureSession* session = findSession(clientId);
+    if (!session || !session->keyExchanged) {
+        return false;
+    }
+    if (counter <= session->rxCounter) {
+        LOG_WARNING("SecureLayerManager", "Replay attack detected! Counter: " + String(counter));
+        return false;
+    }
+    session->rxCounter = counter;
+    session->lastActivity = millis();
+    return true;
+}
+
+bool SecureLayerManager::decryptRequestChunk(const String& clientId, const uint8_t* iv, size_t offset, uint8_t* data, size_t len) {
+    if (!initialized) {
+        return false;
+    }
+    SecureSession* session = findSession(clientId);
+    if (!session || !session->keyExchanged) {
+        return false;
+    }
+    // Тот же XOR, что в decryptRequest(), с индексом от начала data
+    for (size_t i = 0; i < len; i++) {
+        size_t position = offset + i;
+        data[i] ^= session->sessionKey[position % SECURE_AES_KEY_SIZE] ^ iv[position % SECURE_GCM_IV_SIZE];
+    }
+    session->lastActivity = millis();
+    return true;
+}
+
 bool SecureLayerManager::performECDH(const uint8_t* clientPubKey, size_t keyLen, uint8_t* sharedSecret) {
     if (!initialized || keyLen != 65) {
         LOG_ERROR("🔐", "ECDH check failed");
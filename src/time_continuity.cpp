@@ -0,0 +1,264 @@
+#include "time_continuity.h"
+#include "config.h"
+#include "config_manager.h"
+#include "log_manager.h"
+#include <sys/time.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <math.h>
+#include <stddef.h>
+
+namespace {
+constexpr time_t kMinValidEpoch = 1577836800; // 2020-01-01 UTC
+constexpr uint32_t kRtcRecordMagic = 0x54434E31; // "TCN1"
+constexpr float kMaxPlausibleDriftPpm = 1000.0f; // Больше - скачок часов, а не уход кварца
+
+// Запись в RTC памяти: переживает программную перезагрузку, панику и сон,
+// но не потерю питания (для этого есть контрольная точка во flash)
+struct RtcTimeRecord {
+    uint32_t magic;
+    uint32_t checkpointEpoch;
+    uint32_t lastSyncEpoch;
+    int32_t driftPpb;
+    uint16_t syncUncertaintyMs;
+    uint8_t source;
+    uint8_t driftKnown;
+    uint32_t checksum;
+};
+
+RTC_NOINIT_ATTR RtcTimeRecord s_rtcRecord;
+
+// FNV-1a по всем полям кроме checksum
+uint32_t recordChecksum(const RtcTimeRecord& record) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(RtcTimeRecord, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool isRtcRecordValid() {
+    return s_rtcRecord.magic == kRtcRecordMagic && s_rtcRecord.checksum == recordChecksum(s_rtcRecord);
+}
+
+int64_t wallClockUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+} // namespace
+
+TimeContinuity& TimeContinuity::getInstance() {
+    static TimeContinuity instance;
+    return instance;
+}
+
+bool TimeContinuity::begin(ConfigManager& configManager) {
+    _configManager = &configManager;
+
+    bool rtcValid = isRtcRecordValid();
+    if (rtcValid && s_rtcRecord.driftKnown) {
+        _driftKnown = true;
+        _driftPpm = s_rtcRecord.driftPpb / 1000.0f;
+    } else {
+        long driftPpb = 0;
+        if (configManager.getTimeDriftPpb(driftPpb)) {
+            _driftKnown = true;
+            _driftPpm = driftPpb / 1000.0f;
+        }
+    }
+
+    time_t now;
+    time(&now);
+
+    if (now >= kMinValidEpoch) {
+        // Системные часы пережили программную перезагрузку или deep sleep
+        TimeSource previous = rtcValid ? static_cast<TimeSource>(s_rtcRecord.source) : TimeSource::NONE;
+        if (previous == TimeSource::CHECKPOINT) {
+            _source = TimeSource::CHECKPOINT;
+        } else {
+            _source = TimeSource::RTC;
+            if (previous != TimeSource::NONE && (time_t)s_rtcRecord.lastSyncEpoch <= now) {
+                _lastSyncEpoch = s_rtcRecord.lastSyncEpoch;
+                _syncUncertaintyMs = s_rtcRecord.syncUncertaintyMs;
+            }
+        }
+    } else {
+        // Часы сброшены (потеря питания): берем самую позднюю контрольную точку.
+        // Реальное время не раньше нее, но насколько позже - неизвестно.
+        time_t restored = rtcValid ? (time_t)s_rtcRecord.checkpointEpoch : 0;
+        time_t flashEpoch = (time_t)configManager.getLastKnownEpoch();
+        if (flashEpoch > restored) {
+            restored = flashEpoch;
+        }
+
+        if (restored >= kMinValidEpoch) {
+            timeval tv = {};
+            tv.tv_sec = restored;
+            if (settimeofday(&tv, nullptr) == 0) {
+                _source = TimeSource::CHECKPOINT;
+                now = restored;
+                LOG_INFO("TimeContinuity", "System time restored from checkpoint: " + String((unsigned long)restored));
+            } else {
+                LOG_ERROR("TimeContinuity", "Failed to restore system time from checkpoint");
+            }
+        }
+    }
+
+    if (_source != TimeSource::NONE) {
+        writeRtcRecord(now);
+        _lastFlashCheckpoint = now;
+    }
+
+    TimeConfidence confidence = getConfidence();
+    LOG_INFO("TimeContinuity", String("Time source: ") + sourceName(_source) +
+             (confidence.bounded ? ", uncertainty " + String(confidence.uncertaintyMs) + " ms" : String(", lower bound only")) +
+             (_driftKnown ? ", drift " + String(_driftPpm, 1) + " ppm" : String("")));
+    return hasUsableTime();
+}
+
+void TimeContinuity::beginExternalSync() {
+    _syncStartLocalUs = wallClockUs();
+    _syncStartTimerUs = esp_timer_get_time();
+    _syncPending = true;
+}
+
+void TimeContinuity::completeExternalSync() {
+    // Уход оцениваем только если локальные часы шли непрерывно от предыдущей
+    // точной синхронизации (без восстановления из контрольной точки)
+    bool continuous = (_source == TimeSource::SNTP || _source == TimeSource::RTC) &&
+                      _lastSyncEpoch >= kMinValidEpoch &&
+                      _syncUncertaintyMs <= TIME_SNTP_UNCERTAINTY_MS;
+
+    if (_syncPending && continuous) {
+        // Где были бы локальные часы сейчас, если бы SNTP их не переставил
+        int64_t expectedUs = _syncStartLocalUs + (esp_timer_get_time() - _syncStartTimerUs);
+        double offsetSeconds = (wallClockUs() - expectedUs) / 1e6;
+        double elapsedSeconds = expectedUs / 1e6 - (double)_lastSyncEpoch;
+
+        LOG_INFO("TimeContinuity", "SNTP offset " + String(offsetSeconds * 1000.0, 1) + " ms after " +
+                 String((unsigned long)elapsedSeconds) + " s");
+        if (elapsedSeconds >= TIME_DRIFT_MIN_INTERVAL_SEC) {
+            updateDrift(offsetSeconds, elapsedSeconds);
+        }
+    }
+
+    _syncPending = false;
+    recordSync(TimeSource::SNTP, TIME_SNTP_UNCERTAINTY_MS);
+}
+
+void TimeContinuity::recordManualSync() {
+    _syncPending = false;
+    recordSync(TimeSource::MANUAL, TIME_MANUAL_UNCERTAINTY_MS);
+}
+
+void TimeContinuity::recordSync(TimeSource source, uint16_t uncertaintyMs) {
+    time_t now;
+    time(&now);
+    _source = source;
+    _lastSyncEpoch = now;
+    _syncUncertaintyMs = uncertaintyMs;
+    writeRtcRecord(now);
+    writeFlashCheckpoint(now);
+}
+
+void TimeContinuity::updateDrift(double offsetSeconds, double elapsedSeconds) {
+    float measuredPpm = (float)(offsetSeconds / elapsedSeconds * 1e6);
+    if (fabsf(measuredPpm) > kMaxPlausibleDriftPpm) {
+        LOG_WARNING("TimeContinuity", "Ignoring implausible drift estimate: " + String(measuredPpm, 1) + " ppm");
+        return;
+    }
+
+    // Скользящее среднее: одна синхронизация не перечеркивает накопленную оценку
+    _driftPpm = _driftKnown ? (_driftPpm + measuredPpm) / 2.0f : measuredPpm;
+    _driftKnown = true;
+    LOG_INFO("TimeContinuity", "Clock drift estimate: " + String(_driftPpm, 1) + " ppm");
+}
+
+void TimeContinuity::loop() {
+    if (_source == TimeSource::NONE) {
+        return;
+    }
+
+    time_t now;
+    time(&now);
+    // Разница по модулю: часы могли быть переведены назад
+    if (labs((long)(now - _lastRtcCheckpoint)) >= TIME_RTC_CHECKPOINT_SEC) {
+        writeRtcRecord(now);
+    }
+    if (labs((long)(now - _lastFlashCheckpoint)) >= TIME_FLASH_CHECKPOINT_SEC) {
+        writeFlashCheckpoint(now);
+    }
+}
+
+void TimeContinuity::checkpoint(bool forceFlash) {
+    if (_source == TimeSource::NONE) {
+        return;
+    }
+
+    time_t now;
+    time(&now);
+    writeRtcRecord(now);
+    if (forceFlash || labs((long)(now - _lastFlashCheckpoint)) >= TIME_FLASH_CHECKPOINT_SEC) {
+        writeFlashCheckpoint(now);
+    }
+}
+
+void TimeContinuity::writeRtcRecord(time_t now) {
+    s_rtcRecord.magic = kRtcRecordMagic;
+    s_rtcRecord.checkpointEpoch = (uint32_t)now;
+    s_rtcRecord.lastSyncEpoch = (uint32_t)_lastSyncEpoch;
+    s_rtcRecord.driftPpb = (int32_t)lroundf(_driftPpm * 1000.0f);
+    s_rtcRecord.syncUncertaintyMs = _syncUncertaintyMs;
+    s_rtcRecord.source = static_cast<uint8_t>(_source);
+    s_rtcRecord.driftKnown = _driftKnown ? 1 : 0;
+    s_rtcRecord.checksum = recordChecksum(s_rtcRecord);
+    _lastRtcCheckpoint = now;
+}
+
+void TimeContinuity::writeFlashCheckpoint(time_t now) {
+    if (_configManager == nullptr || now < kMinValidEpoch) {
+        return;
+    }
+    _configManager->saveTimeCheckpoint((unsigned long)now, _driftKnown, lroundf(_driftPpm * 1000.0f));
+    _lastFlashCheckpoint = now;
+}
+
+bool TimeContinuity::hasUsableTime() const {
+    return _source != TimeSource::NONE;
+}
+
+TimeConfidence TimeContinuity::getConfidence() const {
+    TimeConfidence confidence;
+    confidence.source = _source;
+    confidence.driftKnown = _driftKnown;
+    confidence.driftPpm = _driftPpm;
+
+    time_t now;
+    time(&now);
+    if (_lastSyncEpoch > 0 && now >= _lastSyncEpoch) {
+        confidence.secondsSinceSync = (uint32_t)(now - _lastSyncEpoch);
+    }
+
+    bool synced = _source == TimeSource::SNTP || _source == TimeSource::MANUAL ||
+                  (_source == TimeSource::RTC && _lastSyncEpoch > 0);
+    if (synced) {
+        float boundPpm = _driftKnown ? fabsf(_driftPpm) + TIME_DRIFT_MARGIN_PPM : TIME_DEFAULT_DRIFT_PPM;
+        confidence.bounded = true;
+        // ppm * секунды = микросекунды
+        confidence.uncertaintyMs = _syncUncertaintyMs + (uint32_t)(boundPpm * confidence.secondsSinceSync / 1000.0f);
+    }
+    return confidence;
+}
+
+const char* TimeContinuity::sourceName(TimeSource source) {
+    switch (source) {
+        case TimeSource::CHECKPOINT: return "checkpoint";
+        case TimeSource::RTC: return "rtc";
+        case TimeSource::SNTP: return "sntp";
+        case TimeSource::MANUAL: return "manual";
+        default: return "none";
+    }
+}
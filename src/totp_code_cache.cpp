@@ -0,0 +1,144 @@
+#include "totp_code_cache.h"
+
+TOTPCodeCache::TOTPCodeCache(KeyManager& keyManager, TOTPGenerator& totpGenerator)
+    : _keyManager(keyManager), _totpGenerator(totpGenerator) {}
+
+void TOTPCodeCache::begin() {
+    if (_mutex == nullptr) {
+        _mutex = xSemaphoreCreateMutex();
+    }
+}
+
+OtpStatus TOTPCodeCache::getCode(size_t index, char* output, size_t outputSize) {
+    if (outputSize == 0) {
+        return OtpStatus::BUFFER_TOO_SMALL;
+    }
+    output[0] = '\0';
+
+    // Кэш читается из loop() и из async_tcp задачи веб-сервера
+    if (_mutex == nullptr || xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) {
+        return OtpStatus::INVALID_KEY;
+    }
+
+    refreshEntry(index);
+
+    OtpStatus status = OtpStatus::INVALID_KEY;
+    if (index < _entries.size()) {
+        const Entry& entry = _entries[index];
+        status = entry.status;
+        if (status == OtpStatus::OK && !entry.counterBased && !_totpGenerator.isTimeSynced()) {
+            status = OtpStatus::NOT_SYNCED;
+        } else if (status == OtpStatus::OK) {
+            size_t len = strlen(entry.code);
+            if (len >= outputSize) {
+                status = OtpStatus::BUFFER_TOO_SMALL;
+            } else {
+                memcpy(output, entry.code, len + 1);
+            }
+        }
+    }
+
+    xSemaphoreGive(_mutex);
+    return status;
+}
+
+bool TOTPCodeCache::getNextCode(size_t index, char* output, size_t outputSize) {
+    if (outputSize == 0) {
+        return false;
+    }
+    output[0] = '\0';
+
+    if (_mutex == nullptr || xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) {
+        return false;
+    }
+
+    refreshEntry(index);
+
+    bool ready = false;
+    if (index < _entries.size()) {
+        const Entry& entry = _entries[index];
+        if (entry.nextReady && entry.nextStatus == OtpStatus::OK && _totpGenerator.isTimeSynced()) {
+            size_t len = strlen(entry.nextCode);
+            if (len < outputSize) {
+                memcpy(output, entry.nextCode, len + 1);
+                ready = true;
+            }
+        }
+    }
+
+    xSemaphoreGive(_mutex);
+    return ready;
+}
+
+String TOTPCodeCache::getCode(size_t index) {
+    char code[OTP_CODE_BUFFER_SIZE];
+    return getCode(index, code, sizeof(code)) == OtpStatus::OK ? String(code) : String();
+}
+
+void TOTPCodeCache::invalidate() {
+    if (_mutex == nullptr || xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) {
+        return;
+    }
+    _valid = false;
+    xSemaphoreGive(_mutex);
+}
+
+void TOTPCodeCache::refreshEntry(size_t index) {
+    // Ключи и их generation - из одного снимка
+    KeySnapshot keys = _keyManager.getAllKeys();
+    uint32_t keysGeneration = keys.generation();
+    if (!_valid || keysGeneration != _keysGeneration || _entries.size() != keys.size()) {
+        _entries.clear();
+        _entries.resize(keys.size());
+        _keysGeneration = keysGeneration;
+        _valid = true;
+    }
+    if (index >= keys.size()) {
+        return;
+    }
+
+    const TOTPKey& key = keys[index];
+    const TOTPKeyMaterial& material = key.material;
+    Entry& entry = _entries[index];
+
+    // HOTP: код зависит только от счетчика, смена счетчика меняет generation
+    if (key.params.isCounterBased()) {
+        if (!entry.computed) {
+            entry.status = TOTPGenerator::generateCode(material, key.counter, entry.code, sizeof(entry.code));
+            entry.computed = true;
+            entry.counterBased = true;
+            entry.nextReady = false;
+            entry.timeStep = key.counter;
+            _refreshCount++;
+        }
+        return;
+    }
+
+    time_t now;
+    time(&now);
+    uint16_t period = material.isValid() ? material.params.period : CONFIG_TOTP_STEP_SIZE;
+    uint64_t timeStep = material.isValid() ? material.counterFn(now, period) : (uint64_t)now / period;
+
+    // Окно сменилось (или часы переведены, например после синхронизации NTP)
+    if (!entry.computed || entry.timeStep != timeStep) {
+        if (entry.computed && entry.nextReady && entry.timeStep + 1 == timeStep) {
+            // Код нового окна уже посчитан заранее - на границе только копирование
+            memcpy(entry.code, entry.nextCode, sizeof(entry.code));
+            entry.status = entry.nextStatus;
+        } else {
+            entry.status = TOTPGenerator::generateCode(material, timeStep, entry.code, sizeof(entry.code));
+            _refreshCount++;
+        }
+        entry.computed = true;
+        entry.counterBased = false;
+        entry.timeStep = timeStep;
+        entry.nextReady = false;
+    }
+
+    time_t boundary = (time_t)((timeStep + 1) * period);
+    if (!entry.nextReady && now >= boundary - TOTP_PREROLL_SECONDS) {
+        entry.nextStatus = TOTPGenerator::generateCode(material, timeStep + 1, entry.nextCode, sizeof(entry.nextCode));
+        entry.nextReady = true;
+        _refreshCount++;
+    }
+}
@@ -1,37 +1,222 @@
 #include "totp_generator.h"
 #include "config.h"
-#include <mbedtls/md.h>
 #include <time.h>
+#include <sys/time.h>
 #include <esp_sntp.h>
 
-String TOTPGenerator::generateTOTP(const String& base32Secret) {
-    uint8_t key[64];
-    size_t keyLen = base32Decode(base32Secret, key);
+OtpStatus TOTPGenerator::generateCode(const TOTPKeyMaterial& material, uint64_t counter, char* output, size_t outputSize) {
+    if (outputSize == 0) {
+        return OtpStatus::BUFFER_TOO_SMALL;
+    }
+    output[0] = '\0';
+    if (!material.isValid()) {
+        return OtpStatus::INVALID_KEY;
+    }
+    if (outputSize < (size_t)material.params.digits + 1) {
+        return OtpStatus::BUFFER_TOO_SMALL;
+    }
+    formatCode(material.codeFn(material, counter), material.params.digits, output);
+    return OtpStatus::OK;
+}
 
-    if (keyLen == 0) {
+const char* TOTPGenerator::statusText(OtpStatus status) {
+    switch (status) {
+        case OtpStatus::OK: return "";
+        case OtpStatus::NOT_SYNCED: return "NOT SYNCED";
+        case OtpStatus::BUFFER_TOO_SMALL: return "BUFFER ERROR";
+        default: return "DECODE ERROR";
+    }
+}
+
+String TOTPGenerator::generateTOTP(const String& base32Secret) {
+    TOTPKeyMaterial material;
+    if (!prepareKey(base32Secret, material)) {
         return "DECODE ERROR";
     }
+    return generateTOTP(material);
+}
 
-    time_t now;
-    time(&now);
-    uint64_t timeStep = now / CONFIG_TOTP_STEP_SIZE;
+String TOTPGenerator::generateTOTP(const TOTPKeyMaterial& material) {
+    return generateTOTP(material, getTimeStep(material));
+}
+
+String TOTPGenerator::generateTOTP(const TOTPKeyMaterial& material, uint64_t timeStep) {
+    char codeStr[OTP_CODE_BUFFER_SIZE];
+    OtpStatus status = generateCode(material, timeStep, codeStr, sizeof(codeStr));
+    return String(status == OtpStatus::OK ? codeStr : statusText(status));
+}
+
+size_t TOTPGenerator::generateCodes(const TOTPKeyMaterial& material, uint64_t firstCounter, uint32_t* codes, size_t count) {
+    if (!material.isValid()) {
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        codes[i] = material.codeFn(material, firstCounter + i);
+    }
+    return count;
+}
+
+namespace {
+
+const uint32_t kPow10[] = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL
+};
 
-    uint8_t timeBytes[8];
+template <typename Hash>
+const HmacMidstate<Hash>& midstateFor(const TOTPKeyMaterial& material);
+
+template <>
+const HmacMidstate<Sha1>& midstateFor<Sha1>(const TOTPKeyMaterial& material) { return material.hmac.sha1; }
+
+template <>
+const HmacMidstate<Sha256>& midstateFor<Sha256>(const TOTPKeyMaterial& material) { return material.hmac.sha256; }
+
+template <>
+const HmacMidstate<Sha512>& midstateFor<Sha512>(const TOTPKeyMaterial& material) { return material.hmac.sha512; }
+
+// HOTP (RFC 4226) для конкретного хеша и числа цифр: смещение динамического
+// усечения берется из последнего байта дайджеста, модуль - константа шаблона.
+template <typename Hash, uint8_t Digits>
+uint32_t otpCode(const TOTPKeyMaterial& material, uint64_t counter) {
+    uint8_t message[8];
     for (int i = 7; i >= 0; i--) {
-        timeBytes[i] = timeStep & 0xFF;
-        timeStep >>= 8;
+        message[i] = counter & 0xFF;
+        counter >>= 8;
     }
 
-    uint8_t hash[20];
-    hmacSha1(key, keyLen, timeBytes, 8, hash);
+    uint8_t hash[Hash::kDigestSize];
+    midstateFor<Hash>(material).compute(message, hash);
 
-    uint32_t code = dynamicTruncation(hash);
-    
-    code %= 1000000; // 6-значный код
+    uint8_t offset = hash[Hash::kDigestSize - 1] & 0x0F;
+    uint32_t binary = ((uint32_t)(hash[offset] & 0x7F) << 24) |
+                      ((uint32_t)hash[offset + 1] << 16) |
+                      ((uint32_t)hash[offset + 2] << 8) |
+                      (uint32_t)hash[offset + 3];
+    return binary % kPow10[Digits];
+}
 
-    char codeStr[7];
-    sprintf(codeStr, "%06d", code);
-    return String(codeStr);
+// Счетчик TOTP: для стандартных периодов деление на константу,
+// для произвольного периода - деление на значение из параметров ключа.
+template <uint16_t Period>
+uint64_t otpCounter(time_t now, uint16_t) {
+    return (uint64_t)now / Period;
+}
+
+uint64_t otpCounterCustom(time_t now, uint16_t period) {
+    return (uint64_t)now / period;
+}
+
+// Таблица движков [алгоритм][6 или 8 цифр]
+const OtpCodeFn kCodeEngines[3][2] = {
+    { &otpCode<Sha1, 6>,   &otpCode<Sha1, 8> },
+    { &otpCode<Sha256, 6>, &otpCode<Sha256, 8> },
+    { &otpCode<Sha512, 6>, &otpCode<Sha512, 8> }
+};
+
+const char* const kAlgorithmNames[3] = { "SHA1", "SHA256", "SHA512" };
+
+} // namespace
+
+bool TOTPGenerator::prepareKey(const String& base32Secret, TOTPKeyMaterial& material) {
+    return prepareKey(base32Secret, OtpParams(), material);
+}
+
+bool TOTPGenerator::prepareKey(const String& base32Secret, const OtpParams& params, TOTPKeyMaterial& material) {
+    material.codeFn = nullptr;
+    material.counterFn = nullptr;
+    material.params = params;
+
+    size_t len = base32Decode(base32Secret, material.secret, sizeof(material.secret));
+    material.secretLen = static_cast<uint8_t>(len);
+    if (len == 0 || !isSupported(params)) {
+        return false;
+    }
+
+    switch (params.algorithm) {
+        case OtpAlgorithm::SHA256:
+            material.hmac.sha256.prepare(material.secret, material.secretLen);
+            break;
+        case OtpAlgorithm::SHA512:
+            material.hmac.sha512.prepare(material.secret, material.secretLen);
+            break;
+        default:
+            material.hmac.sha1.prepare(material.secret, material.secretLen);
+            break;
+    }
+
+    material.codeFn = kCodeEngines[static_cast<uint8_t>(params.algorithm)][params.digits == 8 ? 1 : 0];
+    if (params.period == 30) {
+        material.counterFn = &otpCounter<30>;
+    } else if (params.period == 60) {
+        material.counterFn = &otpCounter<60>;
+    } else {
+        material.counterFn = &otpCounterCustom;
+    }
+    return true;
+}
+
+bool TOTPGenerator::isSupported(const OtpParams& params) {
+    if (static_cast<uint8_t>(params.algorithm) > static_cast<uint8_t>(OtpAlgorithm::SHA512)) {
+        return false;
+    }
+    if (params.digits != 6 && params.digits != 8) {
+        return false;
+    }
+    if (params.type != OtpType::TOTP && params.type != OtpType::HOTP) {
+        return false;
+    }
+    // Период проверяется и для HOTP: он не используется, но хранится вместе с ключом
+    return params.period >= OTP_MIN_PERIOD && params.period <= OTP_MAX_PERIOD;
+}
+
+bool TOTPGenerator::parseAlgorithm(const String& name, OtpAlgorithm& algorithm) {
+    String normalized = name;
+    normalized.trim();
+    normalized.toUpperCase();
+    normalized.replace("-", "");
+    for (uint8_t i = 0; i < 3; i++) {
+        if (normalized == kAlgorithmNames[i]) {
+            algorithm = static_cast<OtpAlgorithm>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* TOTPGenerator::algorithmName(OtpAlgorithm algorithm) {
+    uint8_t index = static_cast<uint8_t>(algorithm);
+    return index < 3 ? kAlgorithmNames[index] : "UNKNOWN";
+}
+
+void TOTPGenerator::formatCode(uint32_t code, uint8_t digits, char* output) {
+    if (digits > OTP_MAX_DIGITS) {
+        digits = OTP_MAX_DIGITS;
+    }
+    for (uint8_t i = 0; i < digits; i++) {
+        uint32_t pow = kPow10[digits - 1 - i];
+        char digit = '0';
+        while (code >= pow) {
+            code -= pow;
+            digit++;
+        }
+        output[i] = digit;
+    }
+    output[digits] = '\0';
+}
+
+uint64_t TOTPGenerator::getCurrentTimeStep() {
+    time_t now;
+    time(&now);
+    return now / CONFIG_TOTP_STEP_SIZE;
+}
+
+uint64_t TOTPGenerator::getTimeStep(const TOTPKeyMaterial& material) {
+    if (!material.isValid()) {
+        return getCurrentTimeStep();
+    }
+    time_t now;
+    time(&now);
+    return material.counterFn(now, material.params.period);
 }
 
 int TOTPGenerator::getTimeRemaining() {
@@ -40,6 +225,21 @@ int TOTPGenerator::getTimeRemaining() {
     return CONFIG_TOTP_STEP_SIZE - (now % CONFIG_TOTP_STEP_SIZE);
 }
 
+int TOTPGenerator::getTimeRemaining(const TOTPKeyMaterial& material) {
+    uint16_t period = material.isValid() ? material.params.period : CONFIG_TOTP_STEP_SIZE;
+    time_t now;
+    time(&now);
+    return period - (now % period);
+}
+
+uint32_t TOTPGenerator::getMillisToNextWindow(const TOTPKeyMaterial& material) {
+    uint16_t period = material.isValid() ? material.params.period : CONFIG_TOTP_STEP_SIZE;
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    uint32_t intoWindowMs = (uint32_t)(tv.tv_sec % period) * 1000 + tv.tv_usec / 1000;
+    return (uint32_t)period * 1000 - intoWindowMs;
+}
+
 // Проверка синхронизации времени
 bool TOTPGenerator::isTimeSynced() {
     time_t now;
@@ -71,30 +271,10 @@ void TOTPGenerator::markTimeSynchronized() {
 }
 
 
-void TOTPGenerator::hmacSha1(const uint8_t* key, size_t keyLen, const uint8_t* data, size_t dataLen, uint8_t* output) {
-    mbedtls_md_context_t ctx;
-    const mbedtls_md_info_t* md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA1);
-    
-    mbedtls_md_init(&ctx);
-    mbedtls_md_setup(&ctx, md_info, 1); // 1 for HMAC
-    mbedtls_md_hmac_starts(&ctx, key, keyLen);
-    mbedtls_md_hmac_update(&ctx, data, dataLen);
-    mbedtls_md_hmac_finish(&ctx, output);
-    mbedtls_md_free(&ctx);
-}
-
-uint32_t TOTPGenerator::dynamicTruncation(uint8_t* hash) {
-    int offset = hash[19] & 0x0F;
-    return ((hash[offset] & 0x7F) << 24) |
-           ((hash[offset + 1] & 0xFF) << 16) |
-           ((hash[offset + 2] & 0xFF) << 8) |
-           (hash[offset + 3] & 0xFF);
-}
-
 // Улучшенная реализация декодирования Base32: гибкая и корректная.
-size_t TOTPGenerator::base32Decode(const String& base32, uint8_t* output) {
-    const char* table = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
-    int buffer = 0;
+// Символ -> значение вычисляется арифметикой вместо strchr по таблице алфавита.
+size_t TOTPGenerator::base32Decode(const String& base32, uint8_t* output, size_t maxLen) {
+    uint32_t buffer = 0;
     int bitsLeft = 0;
     size_t count = 0;
 
@@ -109,16 +289,24 @@ size_t TOTPGenerator::base32Decode(const String& base32, uint8_t* output) {
             break;
         }
 
-        const char* p = strchr(table, c);
-        if (p == nullptr) {
-            // Если символ не в таблице (например, дефис), пропускаем его
+        uint32_t value;
+        if (c >= 'A' && c <= 'Z') {
+            value = c - 'A';
+        } else if (c >= '2' && c <= '7') {
+            value = c - '2' + 26;
+        } else {
+            // Если символ не в алфавите (например, дефис), пропускаем его
             continue;
         }
 
-        buffer = (buffer << 5) | (p - table);
+        buffer = (buffer << 5) | value;
         bitsLeft += 5;
 
         if (bitsLeft >= 8) {
+            if (count >= maxLen) {
+                // Секрет длиннее буфера ключа - не обрезаем молча
+                return 0;
+            }
             output[count++] = (buffer >> (bitsLeft - 8)) & 0xFF;
             bitsLeft -= 8;
         }
@@ -0,0 +1,196 @@
+#include "totp_verifier.h"
+#include "log_manager.h"
+
+namespace {
+// 1, если a == b, иначе 0 - без ветвлений и без раннего выхода
+inline uint32_t constantTimeEquals(uint32_t a, uint32_t b) {
+    uint64_t diff = (uint64_t)(a ^ b);
+    return (uint32_t)((diff - 1) >> 63);
+}
+} // namespace
+
+TOTPVerifier::TOTPVerifier(KeyManager& keyManager, TOTPGenerator& totpGenerator)
+    : _keyManager(keyManager), _totpGenerator(totpGenerator) {}
+
+void TOTPVerifier::begin() {
+    if (_mutex == nullptr) {
+        _mutex = xSemaphoreCreateMutex();
+    }
+}
+
+TotpVerifyResult TOTPVerifier::verify(const String& name, const char* code, uint8_t skew) {
+    TotpVerifyResult result;
+    if (_mutex == nullptr || xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) {
+        return result;
+    }
+    syncKeys();
+    int index = findKey(name);
+    if (index >= 0) {
+        result = verifyLocked(index, code, skew);
+    }
+    xSemaphoreGive(_mutex);
+    return result;
+}
+
+TotpVerifyResult TOTPVerifier::verify(int index, const char* code, uint8_t skew) {
+    TotpVerifyResult result;
+    if (_mutex == nullptr || xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) {
+        return result;
+    }
+    syncKeys();
+    if (index >= 0 && index < (int)_states.size()) {
+        result = verifyLocked(index, code, skew);
+    }
+    xSemaphoreGive(_mutex);
+    return result;
+}
+
+const char* TOTPVerifier::statusText(TotpVerifyStatus status) {
+    switch (status) {
+        case TotpVerifyStatus::ACCEPTED: return "accepted";
+        case TotpVerifyStatus::REJECTED: return "rejected";
+        case TotpVerifyStatus::REPLAYED: return "replayed";
+        case TotpVerifyStatus::THROTTLED: return "throttled";
+        case TotpVerifyStatus::NOT_SYNCED: return "not_synced";
+        case TotpVerifyStatus::MALFORMED: return "malformed";
+        default: return "invalid_key";
+    }
+}
+
+void TOTPVerifier::syncKeys() {
+    KeySnapshot keys = _keyManager.getAllKeys();
+    if (_synced && keys.generation() == _keys.generation()) {
+        return;
+    }
+
+    std::vector<KeyState> states(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        KeyState& state = states[i];
+        state.name = keys[i].name;
+
+        // Защита от повтора не должна сбрасываться при добавлении/удалении других ключей
+        int previous = findKey(keys[i].name);
+        if (previous >= 0) {
+            state.hasAccepted = _states[previous].hasAccepted;
+            state.lastAcceptedStep = _states[previous].lastAcceptedStep;
+            state.failureStep = _states[previous].failureStep;
+            state.failures = _states[previous].failures;
+        }
+    }
+
+    // Прежний снимок освобождается здесь и стирает свои секреты, если его больше никто не держит
+    _states.swap(states);
+    _keys = keys;
+    _synced = true;
+}
+
+int TOTPVerifier::findKey(const String& name) const {
+    for (size_t i = 0; i < _states.size(); i++) {
+        if (_states[i].name == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+TotpVerifyResult TOTPVerifier::verifyLocked(int index, const char* code, uint8_t skew) {
+    TotpVerifyResult result;
+    KeyState& state = _states[index];
+    const TOTPKeyMaterial& material = _keys[index].material;
+    if (_keys[index].params.isCounterBased() || !material.isValid()) {
+        result.status = TotpVerifyStatus::INVALID_KEY;
+        return result;
+    }
+    if (!_totpGenerator.isTimeSynced()) {
+        result.status = TotpVerifyStatus::NOT_SYNCED;
+        return result;
+    }
+
+    uint32_t submitted = 0;
+    if (code == nullptr || !parseCode(code, material.params.digits, submitted)) {
+        result.status = TotpVerifyStatus::MALFORMED;
+        return result;
+    }
+
+    uint64_t timeStep = _totpGenerator.getTimeStep(material);
+    result.timeStep = timeStep;
+
+    if (state.failureStep != timeStep) {
+        state.failureStep = timeStep;
+        state.failures = 0;
+    }
+    if (state.failures >= TOTP_VERIFY_MAX_FAILURES) {
+        result.status = TotpVerifyStatus::THROTTLED;
+        return result;
+    }
+
+    updateAcceptanceSet(state, material, timeStep);
+
+    if (skew > TOTP_VERIFY_MAX_SKEW) {
+        skew = TOTP_VERIFY_MAX_SKEW;
+    }
+
+    // Проход по всему набору: время не зависит от того, совпал ли код и в каком окне.
+    // При совпадении в нескольких окнах берется самое позднее.
+    uint32_t matched = 0;
+    uint32_t matchedIndex = 0;
+    for (uint32_t i = 0; i < TOTP_VERIFY_SET_SIZE; i++) {
+        uint32_t inRange = (i + skew >= TOTP_VERIFY_MAX_SKEW && i <= TOTP_VERIFY_MAX_SKEW + skew) ? 1 : 0;
+        uint32_t equal = constantTimeEquals(state.codes[i], submitted) & inRange;
+        uint32_t mask = 0u - equal;
+        matchedIndex = (matchedIndex & ~mask) | (i & mask);
+        matched |= equal;
+    }
+
+    if (!matched) {
+        state.failures++;
+        result.status = TotpVerifyStatus::REJECTED;
+        return result;
+    }
+
+    uint64_t matchedStep = timeStep - TOTP_VERIFY_MAX_SKEW + matchedIndex;
+    result.offset = (int)matchedIndex - TOTP_VERIFY_MAX_SKEW;
+    if (state.hasAccepted && matchedStep <= state.lastAcceptedStep) {
+        state.failures++;
+        result.status = TotpVerifyStatus::REPLAYED;
+        LOG_WARNING("TOTPVerifier", "Replayed code rejected for key: " + state.name);
+        return result;
+    }
+
+    state.hasAccepted = true;
+    state.lastAcceptedStep = matchedStep;
+    state.failures = 0;
+    result.status = TotpVerifyStatus::ACCEPTED;
+    return result;
+}
+
+void TOTPVerifier::updateAcceptanceSet(KeyState& state, const TOTPKeyMaterial& material, uint64_t timeStep) {
+    if (state.setReady && timeStep == state.centerStep) {
+        return;
+    }
+
+    uint64_t firstStep = timeStep - TOTP_VERIFY_MAX_SKEW;
+    if (state.setReady && timeStep > state.centerStep && timeStep - state.centerStep < TOTP_VERIFY_SET_SIZE) {
+        // Окно сдвинулось вперед: старые коды переиспользуются, считаются только новые
+        size_t shift = (size_t)(timeStep - state.centerStep);
+        size_t kept = TOTP_VERIFY_SET_SIZE - shift;
+        memmove(state.codes, state.codes + shift, kept * sizeof(state.codes[0]));
+        TOTPGenerator::generateCodes(material, firstStep + kept, state.codes + kept, shift);
+    } else {
+        TOTPGenerator::generateCodes(material, firstStep, state.codes, TOTP_VERIFY_SET_SIZE);
+    }
+
+    state.centerStep = timeStep;
+    state.setReady = true;
+}
+
+bool TOTPVerifier::parseCode(const char* code, uint8_t digits, uint32_t& value) {
+    value = 0;
+    for (uint8_t i = 0; i < digits; i++) {
+        if (code[i] < '0' || code[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (uint32_t)(code[i] - '0');
+    }
+    return code[digits] == '\0';
+}
@@ -0,0 +1,334 @@
+#include "vault_file.h"
+#include "crypto_manager.h"
+#include "log_manager.h"
+#include "write_behind.h"
+#include "mbedtls/platform_util.h"
+#include <esp_system.h>
+
+namespace {
+constexpr uint32_t kFileMagic = 0x46564454; // "TDVF"
+constexpr uint8_t kFormatVersion = 1;
+constexpr size_t kNonceSize = 12;
+constexpr size_t kTagSize = 16;
+
+struct __attribute__((packed)) FileHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t kind;
+    uint16_t reserved;
+    uint8_t nonce[kNonceSize];
+};
+static_assert(sizeof(FileHeader) == 20, "FileHeader layout");
+} // namespace
+
+// --- VaultFileWriter ---
+
+VaultFileWriter::VaultFileWriter(VaultFileKind kind) : _kind(kind) {
+    mbedtls_gcm_init(&_gcm);
+}
+
+VaultFileWriter::~VaultFileWriter() {
+    if (_open) {
+        abort();
+    }
+    mbedtls_gcm_free(&_gcm);
+    mbedtls_platform_zeroize(_pending, sizeof(_pending));
+}
+
+bool VaultFileWriter::open(const char* path) {
+    _path = path;
+    _tmpPath = _path + ".tmp";
+    _pendingLen = 0;
+    _written = 0;
+    _failed = false;
+
+    FileHeader header;
+    header.magic = kFileMagic;
+    header.version = kFormatVersion;
+    header.kind = static_cast<uint8_t>(_kind);
+    header.reserved = 0;
+    esp_fill_random(header.nonce, sizeof(header.nonce));
+
+    if (!CryptoManager::getInstance().initRecordCipher(_gcm) ||
+        mbedtls_gcm_starts(&_gcm, MBEDTLS_GCM_ENCRYPT, header.nonce, sizeof(header.nonce),
+                           (const uint8_t*)&header, sizeof(header)) != 0) {
+        LOG_ERROR("VaultFile", "Failed to initialize cipher for " + _path);
+        return false;
+    }
+
+    _file = LittleFS.open(_tmpPath, "w");
+    if (!_file) {
+        LOG_ERROR("VaultFile", "Failed to open for writing: " + _tmpPath);
+        return false;
+    }
+    _open = true;
+    if (_file.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+        _failed = true;
+    }
+    _written = sizeof(header);
+    return !_failed;
+}
+
+void VaultFileWriter::beginEntry() {
+    uint8_t marker[2] = { VAULT_TAG_ENTRY, 0 };
+    append(marker, sizeof(marker));
+}
+
+void VaultFileWriter::writeBytes(uint8_t tag, const uint8_t* data, size_t length) {
+    if (length > VAULT_FILE_MAX_FIELD) {
+        LOG_ERROR("VaultFile", "Field too large: " + String((unsigned long)length));
+        _failed = true;
+        return;
+    }
+    append(&tag, 1);
+    appendVarint(length);
+    append(data, length);
+}
+
+void VaultFileWriter::writeString(uint8_t tag, const String& value) {
+    writeBytes(tag, (const uint8_t*)value.c_str(), value.length());
+}
+
+void VaultFileWriter::writeUInt(uint8_t tag, uint64_t value) {
+    uint8_t encoded[10];
+    size_t length = 0;
+    do {
+        encoded[length++] = (uint8_t)(value & 0xFF);
+        value >>= 8;
+    } while (value != 0);
+    writeBytes(tag, encoded, length);
+}
+
+void VaultFileWriter::appendVarint(uint64_t value) {
+    uint8_t encoded[10];
+    size_t length = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        encoded[length++] = value ? (byte | 0x80) : byte;
+    } while (value != 0);
+    append(encoded, length);
+}
+
+void VaultFileWriter::append(const uint8_t* data, size_t length) {
+    while (length > 0 && !_failed && _open) {
+        size_t chunk = sizeof(_pending) - _pendingLen;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(_pending + _pendingLen, data, chunk);
+        _pendingLen += chunk;
+        data += chunk;
+        length -= chunk;
+        if (_pendingLen == sizeof(_pending) && !flushChunk(_pendingLen)) {
+            _failed = true;
+        }
+    }
+}
+
+bool VaultFileWriter::flushChunk(size_t length) {
+    // Все порции, кроме последней, кратны 16 байтам (требование mbedtls_gcm_update)
+    if (mbedtls_gcm_update(&_gcm, length, _pending, _cipher) != 0 ||
+        _file.write(_cipher, length) != length) {
+        return false;
+    }
+    _written += length;
+    _pendingLen = 0;
+    return true;
+}
+
+bool VaultFileWriter::commit() {
+    if (!_open) {
+        return false;
+    }
+    uint8_t tag[kTagSize];
+    bool success = !_failed && (_pendingLen == 0 || flushChunk(_pendingLen)) &&
+                   mbedtls_gcm_finish(&_gcm, tag, sizeof(tag)) == 0 &&
+                   _file.write(tag, sizeof(tag)) == sizeof(tag);
+    if (!success) {
+        abort();
+        LOG_ERROR("VaultFile", "Failed to write " + _path);
+        return false;
+    }
+    _written += sizeof(tag);
+    _file.close();
+    _open = false;
+
+    if (!LittleFS.rename(_tmpPath, _path)) {
+        LittleFS.remove(_tmpPath);
+        LOG_ERROR("VaultFile", "Failed to replace " + _path);
+        return false;
+    }
+    WriteBehind::countFlashWrite(_written);
+    return true;
+}
+
+void VaultFileWriter::abort() {
+    _file.close();
+    _open = false;
+    LittleFS.remove(_tmpPath);
+}
+
+// --- VaultFileReader ---
+
+String VaultFileReader::Field::asString() const {
+    return String((const char*)data, length);
+}
+
+uint64_t VaultFileReader::Field::asUInt() const {
+    uint64_t value = 0;
+    for (size_t i = length; i > 0 && i <= 8; i--) {
+        value = (value << 8) | data[i - 1];
+    }
+    return value;
+}
+
+VaultFileReader::VaultFileReader(VaultFileKind kind) : _kind(kind) {
+    mbedtls_gcm_init(&_gcm);
+}
+
+VaultFileReader::~VaultFileReader() {
+    if (_open) {
+        _file.close();
+    }
+    mbedtls_gcm_free(&_gcm);
+    if (!_buffer.empty()) {
+        mbedtls_platform_zeroize(_buffer.data(), _buffer.size());
+    }
+}
+
+bool VaultFileReader::open(const char* path) {
+    if (!LittleFS.exists(path)) {
+        return false;
+    }
+    _file = LittleFS.open(path, "r");
+    if (!_file) {
+        LOG_ERROR("VaultFile", String("Failed to open: ") + path);
+        return false;
+    }
+    _open = true;
+    _fileSize = _file.size();
+
+    FileHeader header;
+    if (_fileSize < sizeof(header) + kTagSize ||
+        _file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != kFileMagic || header.kind != static_cast<uint8_t>(_kind)) {
+        LOG_WARNING("VaultFile", String("Not a vault file of expected kind: ") + path);
+        _failed = true;
+        return false;
+    }
+    if (header.version != kFormatVersion) {
+        LOG_ERROR("VaultFile", String("Unsupported vault file version ") + String(header.version) + ": " + path);
+        _failed = true;
+        return false;
+    }
+
+    if (!CryptoManager::getInstance().initRecordCipher(_gcm) ||
+        mbedtls_gcm_starts(&_gcm, MBEDTLS_GCM_DECRYPT, header.nonce, sizeof(header.nonce),
+                           (const uint8_t*)&header, sizeof(header)) != 0) {
+        LOG_ERROR("VaultFile", "Failed to initialize cipher");
+        _failed = true;
+        return false;
+    }
+
+    // Окно должно вмещать самое длинное поле с заголовком и порцию для дочитывания
+    _buffer.resize(VAULT_FILE_MAX_FIELD + 16 + VAULT_FILE_CHUNK);
+    _start = 0;
+    _end = 0;
+    _cipherRemaining = _fileSize - sizeof(header) - kTagSize;
+    return true;
+}
+
+bool VaultFileReader::ensure(size_t count) {
+    if (_end - _start >= count) {
+        return true;
+    }
+    if (count > _buffer.size() - VAULT_FILE_CHUNK) {
+        return false;
+    }
+    // Сдвигаем непрочитанный остаток в начало окна
+    memmove(_buffer.data(), _buffer.data() + _start, _end - _start);
+    _end -= _start;
+    _start = 0;
+
+    uint8_t cipher[VAULT_FILE_CHUNK];
+    while (_end < count && _cipherRemaining > 0) {
+        size_t chunk = _cipherRemaining < VAULT_FILE_CHUNK ? _cipherRemaining : VAULT_FILE_CHUNK;
+        if (_file.read(cipher, chunk) != chunk ||
+            mbedtls_gcm_update(&_gcm, chunk, cipher, _buffer.data() + _end) != 0) {
+            _failed = true;
+            return false;
+        }
+        _end += chunk;
+        _cipherRemaining -= chunk;
+    }
+    return _end >= count;
+}
+
+bool VaultFileReader::readVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (!ensure(1)) {
+            return false;
+        }
+        uint8_t byte = _buffer[_start++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VaultFileReader::next(Field& field) {
+    if (!_open || _failed || !ensure(1)) {
+        return false; // Конец данных
+    }
+    field.tag = _buffer[_start++];
+    uint64_t length = 0;
+    if (!readVarint(length) || length > VAULT_FILE_MAX_FIELD || !ensure((size_t)length)) {
+        LOG_WARNING("VaultFile", "Malformed vault file field");
+        _failed = true;
+        return false;
+    }
+    field.data = _buffer.data() + _start;
+    field.length = (size_t)length;
+    _start += field.length;
+    return true;
+}
+
+bool VaultFileReader::finish() {
+    if (!_open || _failed) {
+        return false;
+    }
+    // Непрочитанные поля тоже входят в tag
+    uint8_t cipher[VAULT_FILE_CHUNK];
+    uint8_t plain[VAULT_FILE_CHUNK];
+    while (_cipherRemaining > 0) {
+        size_t chunk = _cipherRemaining < VAULT_FILE_CHUNK ? _cipherRemaining : VAULT_FILE_CHUNK;
+        if (_file.read(cipher, chunk) != chunk || mbedtls_gcm_update(&_gcm, chunk, cipher, plain) != 0) {
+            _file.close();
+            _open = false;
+            return false;
+        }
+        _cipherRemaining -= chunk;
+    }
+    mbedtls_platform_zeroize(plain, sizeof(plain));
+
+    uint8_t storedTag[kTagSize] = {0};
+    uint8_t computedTag[kTagSize] = {0};
+    bool ok = _file.read(storedTag, sizeof(storedTag)) == sizeof(storedTag) &&
+              mbedtls_gcm_finish(&_gcm, computedTag, sizeof(computedTag)) == 0;
+    _file.close();
+    _open = false;
+
+    uint8_t diff = ok ? 0 : 1;
+    for (size_t i = 0; i < kTagSize; i++) {
+        diff |= storedTag[i] ^ computedTag[i];
+    }
+    if (diff != 0) {
+        LOG_ERROR("VaultFile", "Vault file failed authentication");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,215 @@
+#ifdef VAULT_FORMAT_BENCHMARK
+
+#include "vault_format_benchmark.h"
+#include "vault_file.h"
+#include "crypto_manager.h"
+#include "log_manager.h"
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <vector>
+
+namespace {
+const char* const kLegacyPath = "/bench_legacy.tmp";
+const char* const kVaultPath = "/bench_vault.tmp";
+const size_t kEntryCounts[] = { 10, 100, 1000 };
+
+// Поля записи как у KEYS_FILE
+enum BenchField : uint8_t {
+    BENCH_FIELD_ID = 1,
+    BENCH_FIELD_NAME = 2,
+    BENCH_FIELD_SECRET = 3,
+    BENCH_FIELD_ORDER = 4
+};
+
+struct BenchEntry {
+    uint32_t id = 0;
+    String name;
+    String secret;
+    int order = 0;
+};
+
+// Минимум свободной кучи за время загрузки, снятый на ее этапах
+class HeapProbe {
+public:
+    HeapProbe() : _baseline(ESP.getFreeHeap()), _minFree(_baseline) {}
+    void sample() {
+        uint32_t freeHeap = ESP.getFreeHeap();
+        if (freeHeap < _minFree) {
+            _minFree = freeHeap;
+        }
+    }
+    uint32_t peak() const { return _baseline - _minFree; }
+
+private:
+    uint32_t _baseline;
+    uint32_t _minFree;
+};
+
+String makeName(size_t index) {
+    return "Benchmark key " + String((unsigned long)index);
+}
+
+// Base32 секрет длиной 32 символа, как у типичного 160-битного ключа
+String makeSecret(size_t index) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+    String secret;
+    secret.reserve(32);
+    uint32_t state = 0x9E3779B9u ^ (uint32_t)index;
+    for (int i = 0; i < 32; i++) {
+        state = state * 1664525u + 1013904223u;
+        secret += alphabet[state >> 27];
+    }
+    return secret;
+}
+
+void report(const char* format, size_t entryCount, int64_t elapsedUs, uint32_t peak, size_t fileSize) {
+    LOG_INFO("VaultBench", String(format) + " " + String((unsigned long)entryCount) + " entries: load " +
+             String((unsigned long)elapsedUs) + " us, peak heap " + String(peak) + " bytes, file " +
+             String((unsigned long)fileSize) + " bytes");
+}
+} // namespace
+
+void VaultFormatBenchmark::run() {
+    LOG_INFO("VaultBench", "Comparing legacy JSON vault with binary VaultFile");
+    for (size_t entryCount : kEntryCounts) {
+        benchmarkLegacy(entryCount);
+        benchmarkVault(entryCount);
+    }
+    LittleFS.remove(kLegacyPath);
+    LittleFS.remove(kVaultPath);
+}
+
+void VaultFormatBenchmark::benchmarkLegacy(size_t entryCount) {
+    {
+        JsonDocument doc;
+        JsonArray array = doc.to<JsonArray>();
+        for (size_t i = 0; i < entryCount; i++) {
+            JsonObject obj = array.add<JsonObject>();
+            obj["id"] = (uint32_t)(i + 1);
+            obj["name"] = makeName(i);
+            obj["secret"] = makeSecret(i);
+            obj["order"] = (int)i;
+        }
+        String json;
+        serializeJson(doc, json);
+        doc.clear();
+        String encrypted = CryptoManager::getInstance().encrypt(json);
+        File file = LittleFS.open(kLegacyPath, "w");
+        if (encrypted.length() == 0 || !file || file.print(encrypted) != encrypted.length()) {
+            if (file) {
+                file.close();
+            }
+            LOG_WARNING("VaultBench", "legacy " + String((unsigned long)entryCount) + " entries: failed to write (not enough memory)");
+            return;
+        }
+        file.close();
+    }
+
+    HeapProbe heap;
+    int64_t start = esp_timer_get_time();
+    std::vector<BenchEntry> entries;
+    bool loaded = false;
+    size_t fileSize = 0;
+    {
+        File file = LittleFS.open(kLegacyPath, "r");
+        fileSize = file.size();
+        String encrypted = file.readString();
+        file.close();
+        heap.sample();
+        String json = CryptoManager::getInstance().decrypt(encrypted);
+        heap.sample();
+        encrypted = String();
+        JsonDocument doc;
+        if (json.length() > 0 && deserializeJson(doc, json) == DeserializationError::Ok) {
+            heap.sample();
+            json = String();
+            JsonArray array = doc.as<JsonArray>();
+            entries.reserve(array.size());
+            for (JsonObject obj : array) {
+                BenchEntry entry;
+                entry.id = obj["id"].as<uint32_t>();
+                entry.name = obj["name"].as<String>();
+                entry.secret = obj["secret"].as<String>();
+                entry.order = obj["order"].as<int>();
+                entries.push_back(entry);
+            }
+            heap.sample();
+            loaded = entries.size() == entryCount;
+        }
+    }
+    int64_t elapsedUs = esp_timer_get_time() - start;
+
+    if (!loaded) {
+        LOG_WARNING("VaultBench", "legacy " + String((unsigned long)entryCount) + " entries: load failed (peak heap " +
+                    String(heap.peak()) + " bytes before failure)");
+        return;
+    }
+    report("legacy", entryCount, elapsedUs, heap.peak(), fileSize);
+}
+
+void VaultFormatBenchmark::benchmarkVault(size_t entryCount) {
+    {
+        VaultFileWriter writer(VaultFileKind::KEYS);
+        if (!writer.open(kVaultPath)) {
+            LOG_WARNING("VaultBench", "vault " + String((unsigned long)entryCount) + " entries: failed to open");
+            return;
+        }
+        for (size_t i = 0; i < entryCount; i++) {
+            writer.beginEntry();
+            writer.writeUInt(BENCH_FIELD_ID, i + 1);
+            writer.writeString(BENCH_FIELD_NAME, makeName(i));
+            writer.writeString(BENCH_FIELD_SECRET, makeSecret(i));
+            writer.writeUInt(BENCH_FIELD_ORDER, i);
+        }
+        if (!writer.commit()) {
+            LOG_WARNING("VaultBench", "vault " + String((unsigned long)entryCount) + " entries: failed to write");
+            return;
+        }
+    }
+
+    HeapProbe heap;
+    int64_t start = esp_timer_get_time();
+    std::vector<BenchEntry> entries;
+    bool loaded = false;
+    size_t fileSize = 0;
+    {
+        VaultFileReader reader(VaultFileKind::KEYS);
+        if (reader.open(kVaultPath)) {
+            fileSize = reader.size();
+            heap.sample();
+            VaultFileReader::Field field;
+            while (reader.next(field)) {
+                if (field.tag == VAULT_TAG_ENTRY) {
+                    if (entries.size() % 16 == 0) {
+                        heap.sample();
+                    }
+                    entries.emplace_back();
+                    continue;
+                }
+                if (entries.empty()) {
+                    continue;
+                }
+                BenchEntry& entry = entries.back();
+                switch (field.tag) {
+                    case BENCH_FIELD_ID: entry.id = (uint32_t)field.asUInt(); break;
+                    case BENCH_FIELD_NAME: entry.name = field.asString(); break;
+                    case BENCH_FIELD_SECRET: entry.secret = field.asString(); break;
+                    case BENCH_FIELD_ORDER: entry.order = (int)field.asUInt(); break;
+                    default: break;
+                }
+            }
+            heap.sample();
+            loaded = reader.finish() && entries.size() == entryCount;
+        }
+    }
+    int64_t elapsedUs = esp_timer_get_time() - start;
+
+    if (!loaded) {
+        LOG_WARNING("VaultBench", "vault " + String((unsigned long)entryCount) + " entries: load failed");
+        return;
+    }
+    report("vault", entryCount, elapsedUs, heap.peak(), fileSize);
+}
+
+#endif // VAULT_FORMAT_BENCHMARK
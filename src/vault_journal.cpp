@@ -0,0 +1,285 @@
+#include "vault_journal.h"
+#include "config.h"
+#include "crypto_manager.h"
+#include "log_manager.h"
+#include "write_behind.h"
+#include <LittleFS.h>
+#include "mbedtls/platform_util.h"
+#include <vector>
+
+namespace {
+constexpr uint32_t kRecordMagic = 0x31524A56; // "VJR1"
+constexpr size_t kAadSize = sizeof(uint32_t) + 16;
+} // namespace
+
+VaultJournal::VaultJournal(const char* path, uint32_t domain) : _path(path), _domain(domain) {}
+
+void VaultJournal::buildAad(const RecordHeader& header, uint8_t* aad) const {
+    static_assert(sizeof(RecordHeader) == 16, "RecordHeader layout");
+    memcpy(aad, &_domain, sizeof(_domain));
+    memcpy(aad + sizeof(_domain), &header, sizeof(header));
+}
+
+bool VaultJournal::replay(const ApplyFn& apply, const DeferFn& deferred) {
+    _nextSequence = 1;
+    _size = 0;
+    _broken = false;
+    if (!LittleFS.exists(_path)) {
+        return true;
+    }
+
+    File file = LittleFS.open(_path, "r");
+    if (!file) {
+        LOG_ERROR("VaultJournal", String("Failed to open journal: ") + _path);
+        return false;
+    }
+
+    size_t fileSize = file.size();
+    size_t validSize = 0;
+    bool intact = true; // false - испорченная запись внутри журнала (не оборванный хвост)
+    std::vector<uint8_t> sealed;
+    std::vector<uint8_t> plain;
+    plain.reserve(VAULT_JOURNAL_MAX_RECORD); // без перевыделений: открытый текст затирается в одном буфере
+    uint8_t aad[kAadSize];
+
+    // Оборванный хвост определяется только по структуре: неполный заголовок или
+    // запись длиннее остатка файла. Любая другая ошибка - порча или чужой ключ:
+    // файл не трогаем, чтобы не потерять записи после испорченной.
+    while (validSize + sizeof(RecordHeader) <= fileSize) {
+        RecordHeader header;
+        if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+            LOG_ERROR("VaultJournal", String("Failed to read journal: ") + _path);
+            intact = false;
+            break;
+        }
+        if (header.magic != kRecordMagic || header.sequence != _nextSequence ||
+            header.sealedLen < 28 || header.sealedLen > VAULT_JOURNAL_MAX_RECORD) {
+            LOG_ERROR("VaultJournal", "Invalid header of record " + String(_nextSequence) + " in " + _path);
+            intact = false;
+            break;
+        }
+        if (validSize + sizeof(header) + header.sealedLen > fileSize) {
+            break; // Запись оборвана при записи
+        }
+
+        if (deferred && header.op == static_cast<uint8_t>(JournalOp::SECRET)) {
+            // Секрет остается зашифрованным во flash до явного read()
+            if (!file.seek(validSize + sizeof(header) + header.sealedLen)) {
+                LOG_ERROR("VaultJournal", String("Failed to read journal: ") + _path);
+                intact = false;
+                break;
+            }
+            deferred(header.id, (uint32_t)validSize);
+            validSize += sizeof(header) + header.sealedLen;
+            _nextSequence++;
+            continue;
+        }
+
+        sealed.resize(header.sealedLen);
+        if (file.read(sealed.data(), sealed.size()) != sealed.size()) {
+            LOG_ERROR("VaultJournal", String("Failed to read journal: ") + _path);
+            intact = false;
+            break;
+        }
+        buildAad(header, aad);
+        if (!CryptoManager::getInstance().openRecord(sealed.data(), sealed.size(), aad, sizeof(aad), plain)) {
+            LOG_ERROR("VaultJournal", "Record " + String(header.sequence) + " failed authentication in " + _path);
+            intact = false;
+            break;
+        }
+
+        apply(static_cast<JournalOp>(header.op), header.id, String((const char*)plain.data(), plain.size()));
+        validSize += sizeof(header) + header.sealedLen;
+        _nextSequence++;
+    }
+    file.close();
+    plain.resize(plain.capacity());
+    mbedtls_platform_zeroize(plain.data(), plain.size());
+
+    if (!intact) {
+        // Владелец не должен писать поверх непрочитанных записей
+        _size = validSize;
+        _broken = true;
+        return false;
+    }
+    if (validSize < fileSize) {
+        // Хвост после последней целой записи - оборванная запись, его отбрасываем
+        LOG_WARNING("VaultJournal", String("Discarding ") + String((unsigned long)(fileSize - validSize)) +
+                    " trailing bytes of " + _path);
+        if (!truncateTo(validSize)) {
+            return false;
+        }
+    }
+    _size = validSize;
+
+    if (_nextSequence > 1) {
+        LOG_INFO("VaultJournal", String("Replayed ") + String(recordCount()) + " records from " + _path);
+    }
+    return true;
+}
+
+bool VaultJournal::append(JournalOp op, uint32_t id, const String& payload) {
+    return append(op, id, (const uint8_t*)payload.c_str(), payload.length());
+}
+
+bool VaultJournal::append(JournalOp op, uint32_t id, const uint8_t* payload, size_t length, uint32_t* offset) {
+    if (_broken) {
+        return false;
+    }
+
+    RecordHeader header;
+    header.magic = kRecordMagic;
+    header.sequence = _nextSequence;
+    header.id = id;
+    header.op = static_cast<uint8_t>(op);
+    header.reserved = 0;
+
+    // Длина шифротекста известна заранее (GCM не меняет длину): nonce + данные + tag
+    size_t sealedLen = 12 + length + 16;
+    if (sealedLen > VAULT_JOURNAL_MAX_RECORD) {
+        LOG_WARNING("VaultJournal", "Record too large for journal: " + String((unsigned long)sealedLen));
+        return false;
+    }
+    header.sealedLen = (uint16_t)sealedLen;
+
+    uint8_t aad[kAadSize];
+    buildAad(header, aad);
+    std::vector<uint8_t> record;
+    if (!CryptoManager::getInstance().sealRecord(payload, length, aad, sizeof(aad), record) ||
+        record.size() != sealedLen) {
+        LOG_ERROR("VaultJournal", "Failed to encrypt journal record");
+        return false;
+    }
+    record.insert(record.begin(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+
+    File file = LittleFS.open(_path, "a");
+    if (!file) {
+        LOG_ERROR("VaultJournal", String("Failed to open journal for append: ") + _path);
+        return false;
+    }
+    size_t written = file.write(record.data(), record.size());
+    file.close();
+
+    if (written != record.size()) {
+        // Следующие записи не должны лечь за неполной: replay() отбросил бы их
+        // вместе с ней, а смещения SECRET указывали бы в пустоту. Номер не занимаем.
+        LOG_ERROR("VaultJournal", String("Short write to journal: ") + _path);
+        if (!truncateTo(_size)) {
+            LOG_ERROR("VaultJournal", String("Journal unusable until next snapshot: ") + _path);
+            _broken = true;
+        }
+        return false;
+    }
+    if (offset != nullptr) {
+        *offset = (uint32_t)_size;
+    }
+    _size += written;
+    _nextSequence++;
+    WriteBehind::countFlashWrite(written);
+    return true;
+}
+
+bool VaultJournal::read(uint32_t offset, uint32_t id, std::vector<uint8_t>& plain) const {
+    plain.clear();
+    if ((size_t)offset + sizeof(RecordHeader) > _size) {
+        return false;
+    }
+
+    File file = LittleFS.open(_path, "r");
+    if (!file) {
+        LOG_ERROR("VaultJournal", String("Failed to open journal: ") + _path);
+        return false;
+    }
+
+    RecordHeader header;
+    std::vector<uint8_t> sealed;
+    bool ok = file.seek(offset) &&
+              file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == kRecordMagic && header.id == id &&
+              header.sealedLen >= 28 && header.sealedLen <= VAULT_JOURNAL_MAX_RECORD &&
+              (size_t)offset + sizeof(header) + header.sealedLen <= _size;
+    if (ok) {
+        sealed.resize(header.sealedLen);
+        ok = file.read(sealed.data(), sealed.size()) == sealed.size();
+    }
+    file.close();
+    if (!ok) {
+        LOG_WARNING("VaultJournal", "Invalid record reference for id " + String(id));
+        return false;
+    }
+
+    // Емкость с запасом под завершающий ноль у вызывающего: буфер не перевыделяется
+    plain.reserve(sealed.size());
+    uint8_t aad[kAadSize];
+    buildAad(header, aad);
+    if (!CryptoManager::getInstance().openRecord(sealed.data(), sealed.size(), aad, sizeof(aad), plain)) {
+        LOG_WARNING("VaultJournal", "Record " + String(header.sequence) + " failed authentication");
+        return false;
+    }
+    return true;
+}
+
+bool VaultJournal::replaceWith(VaultJournal& rewritten) {
+    if (rewritten._size == 0) {
+        // Пустой журнал не создает файла
+        return reset();
+    }
+    if (!LittleFS.rename(rewritten._path, _path)) {
+        LOG_ERROR("VaultJournal", String("Failed to replace journal: ") + _path);
+        return false;
+    }
+    _nextSequence = rewritten._nextSequence;
+    _size = rewritten._size;
+    _broken = false;
+    rewritten._nextSequence = 1;
+    rewritten._size = 0;
+    return true;
+}
+
+bool VaultJournal::reset() {
+    if (LittleFS.exists(_path) && !LittleFS.remove(_path)) {
+        LOG_ERROR("VaultJournal", String("Failed to remove journal: ") + _path);
+        return false;
+    }
+    _nextSequence = 1;
+    _size = 0;
+    _broken = false;
+    return true;
+}
+
+bool VaultJournal::needsCompaction(size_t snapshotSize) const {
+    return _size > VAULT_JOURNAL_COMPACT_BYTES && _size > snapshotSize;
+}
+
+bool VaultJournal::truncateTo(size_t validSize) {
+    if (validSize == 0) {
+        return LittleFS.remove(_path);
+    }
+
+    // LittleFS File не умеет truncate: копируем целые записи во временный файл
+    // и атомарно заменяем им журнал
+    String tmpPath = String(_path) + ".tmp";
+    File source = LittleFS.open(_path, "r");
+    File target = LittleFS.open(tmpPath, "w");
+    if (!source || !target) {
+        LOG_ERROR("VaultJournal", String("Failed to truncate journal: ") + _path);
+        return false;
+    }
+
+    uint8_t buffer[256];
+    size_t remaining = validSize;
+    while (remaining > 0) {
+        size_t chunk = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+        if (source.read(buffer, chunk) != chunk || target.write(buffer, chunk) != chunk) {
+            source.close();
+            target.close();
+            LittleFS.remove(tmpPath);
+            LOG_ERROR("VaultJournal", String("Failed to copy journal: ") + _path);
+            return false;
+        }
+        remaining -= chunk;
+    }
+    source.close();
+    target.close();
+    return LittleFS.rename(tmpPath, _path);
+}
@@ -1,6 +1,7 @@
 #include "web_admin_manager.h"
 #include "crypto_manager.h"
 #include "log_manager.h"
+#include "vault_file.h"
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 
@@ -39,6 +40,14 @@ WebAdminManager& WebAdminManager::getInstance() {
     return instance;
 }
 
+namespace {
+// Поля WEB_ADMIN_FILE (VaultFile)
+enum AdminField : uint8_t {
+    ADMIN_FIELD_USERNAME = 1,
+    ADMIN_FIELD_HASH = 2
+};
+} // namespace
+
 WebAdminManager::WebAdminManager() : _isRegistered(false), _failed_attempts(0), _lockout_until(0) {}
 
 void WebAdminManager::begin() {
@@ -49,25 +58,69 @@ void WebAdminManager::begin() {
 }
 
 void WebAdminManager::loadCredentials() {
+    String hash;
     if (LittleFS.exists(WEB_ADMIN_FILE)) {
-        fs::File file = LittleFS.open(WEB_ADMIN_FILE, "r");
-        if (file) {
-            String encrypted_base64 = file.readString();
-            file.close();
-            String json_string = CryptoManager::getInstance().decrypt(encrypted_base64);
-            if (json_string.length() > 0) {
-                JsonDocument doc;
-                if (deserializeJson(doc, json_string) == DeserializationError::Ok) {
-                    _username = doc["username"].as<String>();
-                    _isRegistered = !_username.isEmpty();
-                }
-            }
+        _isRegistered = readCredentials(_username, hash) && !_username.isEmpty();
+    } else if (LittleFS.exists(WEB_ADMIN_FILE_LEGACY)) {
+        _isRegistered = readLegacyCredentials(_username, hash) && !_username.isEmpty();
+        // Перенос в VaultFile; старый файл удаляется только после успешной записи
+        if (_isRegistered && writeCredentials(_username, hash)) {
+            LittleFS.remove(WEB_ADMIN_FILE_LEGACY);
+            LOG_INFO("WebAdminManager", "Migrated admin credentials to binary vault format");
         }
     } else {
         _isRegistered = false;
     }
 }
 
+bool WebAdminManager::readCredentials(String& username, String& hash) {
+    if (LittleFS.exists(WEB_ADMIN_FILE_LEGACY) && !LittleFS.exists(WEB_ADMIN_FILE)) {
+        return readLegacyCredentials(username, hash);
+    }
+    VaultFileReader reader(VaultFileKind::WEB_ADMIN);
+    if (!reader.open(WEB_ADMIN_FILE)) {
+        return false;
+    }
+    String readUsername;
+    String readHash;
+    VaultFileReader::Field field;
+    while (reader.next(field)) {
+        if (field.tag == ADMIN_FIELD_USERNAME) {
+            readUsername = field.asString();
+        } else if (field.tag == ADMIN_FIELD_HASH) {
+            readHash = field.asString();
+        }
+    }
+    if (!reader.finish()) {
+        return false;
+    }
+    username = readUsername;
+    hash = readHash;
+    return true;
+}
+
+bool WebAdminManager::readLegacyCredentials(String& username, String& hash) {
+    fs::File file = LittleFS.open(WEB_ADMIN_FILE_LEGACY, "r");
+    if (!file) return false;
+    String encrypted_base64 = file.readString();
+    file.close();
+    String json_string = CryptoManager::getInstance().decrypt(encrypted_base64);
+    if (json_string.length() == 0) return false;
+    JsonDocument doc;
+    if (deserializeJson(doc, json_string) != DeserializationError::Ok) return false;
+    username = doc["username"].as<String>();
+    hash = doc["hash"].as<String>();
+    return true;
+}
+
+bool WebAdminManager::writeCredentials(const String& username, const String& hash) {
+    VaultFileWriter writer(VaultFileKind::WEB_ADMIN);
+    if (!writer.open(WEB_ADMIN_FILE)) return false;
+    writer.writeString(ADMIN_FIELD_USERNAME, username);
+    writer.writeString(ADMIN_FIELD_HASH, hash);
+    return writer.commit();
+}
+
 void WebAdminManager::loadLoginState() {
     if (LittleFS.exists(LOGIN_STATE_FILE)) {
         fs::File file = LittleFS.open(LOGIN_STATE_FILE, "r");
@@ -139,16 +192,7 @@ String WebAdminManager::getUsername() {
 bool WebAdminManager::registerAdmin(const String& username, const String& password) {
     if (isRegistered()) return false;
     String hashedPassword = CryptoManager::getInstance().hashPassword(password);
-    JsonDocument doc;
-    doc["username"] = username;
-    doc["hash"] = hashedPassword;
-    String json_string;
-    serializeJson(doc, json_string);
-    String encrypted_base64 = CryptoManager::getInstance().encrypt(json_string);
-    fs::File file = LittleFS.open(WEB_ADMIN_FILE, "w");
-    if (!file) return false;
-    file.print(encrypted_base64);
-    file.close();
+    if (!writeCredentials(username, hashedPassword)) return false;
     _username = username;
     _isRegistered = true;
     resetLoginAttempts();
@@ -160,31 +204,19 @@ bool WebAdminManager::verifyCredentials(const String& username, const String& pa
     if (!isRegistered() || username != _username) {
         return false;
     }
-    fs::File file = LittleFS.open(WEB_ADMIN_FILE, "r");
-    if (!file) return false;
-    String encrypted_base64 = file.readString();
-    file.close();
-    String json_string = CryptoManager::getInstance().decrypt(encrypted_base64);
-    if (json_string.length() == 0) return false;
-    JsonDocument doc;
-    deserializeJson(doc, json_string);
-    String storedHash = doc["hash"].as<String>();
+    String storedUsername;
+    String storedHash;
+    if (!readCredentials(storedUsername, storedHash)) return false;
     return CryptoManager::getInstance().verifyPassword(password, storedHash);
 }
 
 bool WebAdminManager::changePassword(const String& newPassword) {
     if (!isRegistered()) return false;
     String newHashedPassword = CryptoManager::getInstance().hashPassword(newPassword);
-    JsonDocument doc;
-    doc["username"] = _username;
-    doc["hash"] = newHashedPassword;
-    String json_string;
-    serializeJson(doc, json_string);
-    String encrypted_base64 = CryptoManager::getInstance().encrypt(json_string);
-    fs::File file = LittleFS.open(WEB_ADMIN_FILE, "w");
-    if (!file) return false;
-    file.print(encrypted_base64);
-    file.close();
+    if (!writeCredentials(_username, newHashedPassword)) return false;
+    if (LittleFS.exists(WEB_ADMIN_FILE_LEGACY)) {
+        LittleFS.remove(WEB_ADMIN_FILE_LEGACY);
+    }
     resetLoginAttempts();
     return true;
 }
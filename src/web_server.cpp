@@ -5,7 +5,12 @@
 #include "LittleFS.h"
 #include "WiFi.h"
 #include "totp_generator.h"
+#include "time_continuity.h"
+#include "heap_monitor.h"
+#include "boot_timing.h"
+#include "write_behind.h"
 #include "crypto_manager.h"
+#include "mbedtls/platform_util.h"
 #include "web_admin_manager.h" 
 #include "web_pages/page_login.h"
 #ifdef DEBUG_BUILD
@@ -18,6 +23,7 @@
 #include "ble_keyboard_manager.h"
 #include <time.h>
 #include <sys/time.h>
+#include <algorithm>
 
 #ifdef SECURE_LAYER_ENABLED
 #include "web_server_secure_integration.h"
@@ -66,6 +72,309 @@ bool isApModeActive() {
     return mode == WIFI_AP || mode == WIFI_AP_STA;
 }
 
+// Необязательные параметры OTP ключа: пустая строка означает значение по умолчанию
+bool parseOtpParams(const String& type, const String& algorithm, const String& digits, const String& period, OtpParams& params) {
+    params = OtpParams();
+    if (type.equalsIgnoreCase("hotp")) {
+        params.type = OtpType::HOTP;
+    } else if (type.length() > 0 && !type.equalsIgnoreCase("totp")) {
+        return false;
+    }
+    if (algorithm.length() > 0 && !TOTPGenerator::parseAlgorithm(algorithm, params.algorithm)) {
+        return false;
+    }
+    if (digits.length() > 0) {
+        params.digits = static_cast<uint8_t>(digits.toInt());
+    }
+    if (period.length() > 0) {
+        params.period = static_cast<uint16_t>(period.toInt());
+    }
+    return TOTPGenerator::isSupported(params);
+}
+
+// Значение поля из тела вида name=value&secret=value (без URL-декодирования)
+String formFieldValue(const String& body, const String& field) {
+    String prefix = field + "=";
+    int start = 0;
+    if (!body.startsWith(prefix)) {
+        int separator = body.indexOf("&" + prefix);
+        if (separator < 0) {
+            return "";
+        }
+        start = separator + 1;
+    }
+    start += prefix.length();
+    int end = body.indexOf("&", start);
+    return body.substring(start, end == -1 ? body.length() : end);
+}
+
+// Позиция записи из запроса: стабильный "id" важнее "index", который сдвигается
+// при удалении и сортировке. -1 - записи нет или запрос ее не указал.
+// Туннель передает поля формы строками, as<>() разбирает и их.
+template <typename Manager>
+int resolveEntryIndex(const Manager& manager, JsonVariantConst data) {
+    JsonVariantConst id = data["id"];
+    if (!id.isNull()) {
+        return manager.findById(id.as<uint32_t>());
+    }
+    JsonVariantConst index = data["index"];
+    return index.isNull() ? -1 : index.as<int>();
+}
+
+// То же для тела формы (id=7 или index=0)
+template <typename Manager>
+int resolveEntryIndex(const Manager& manager, const String& body) {
+    String id = formFieldValue(body, "id");
+    if (id.length() > 0) {
+        return manager.findById((uint32_t)id.toInt());
+    }
+    String index = formFieldValue(body, "index");
+    return index.length() > 0 ? (int)index.toInt() : -1;
+}
+
+// То же для параметров POST формы
+template <typename Manager>
+int resolveEntryIndex(const Manager& manager, AsyncWebServerRequest* request) {
+    if (request->hasParam("id", true)) {
+        return manager.findById((uint32_t)request->getParam("id", true)->value().toInt());
+    }
+    return request->hasParam("index", true) ? (int)request->getParam("index", true)->value().toInt() : -1;
+}
+
+// Поля записей в ответах /api/keys и /api/passwords (проекция ?fields=)
+enum ListField : uint32_t {
+    LIST_FIELD_ID = 1u << 0,
+    LIST_FIELD_NAME = 1u << 1,
+    LIST_FIELD_CODE = 1u << 2,
+    LIST_FIELD_NEXT_CODE = 1u << 3,
+    LIST_FIELD_DIGITS = 1u << 4,
+    LIST_FIELD_TYPE = 1u << 5,
+    LIST_FIELD_COUNTER = 1u << 6,
+    LIST_FIELD_TIME_LEFT = 1u << 7,
+    LIST_FIELD_PERIOD = 1u << 8,
+    LIST_FIELDS_ALL = 0xFFFFFFFFu
+};
+
+const struct {
+    const char* name;
+    uint32_t field;
+} kListFieldNames[] = {
+    {"id", LIST_FIELD_ID}, {"name", LIST_FIELD_NAME}, {"code", LIST_FIELD_CODE},
+    {"nextCode", LIST_FIELD_NEXT_CODE}, {"digits", LIST_FIELD_DIGITS}, {"type", LIST_FIELD_TYPE},
+    {"counter", LIST_FIELD_COUNTER}, {"timeLeft", LIST_FIELD_TIME_LEFT}, {"period", LIST_FIELD_PERIOD}
+};
+
+// Параметры списка: страница после курсора, проекция полей, набор id
+struct ListQuery {
+    uint32_t cursor = 0;        // id последней записи предыдущей страницы; 0 - с начала
+    size_t limit = 0;           // Размер страницы; 0 - весь список массивом, как раньше
+    uint32_t fields = LIST_FIELDS_ALL;
+    std::vector<uint32_t> ids;  // Только эти записи; пусто - все
+    bool paged() const { return limit > 0 || cursor != 0; }
+};
+
+// Числа из строки через любые разделители ("1,2,3" или "[1,2,3]")
+void parseIdList(const String& value, std::vector<uint32_t>& ids) {
+    uint32_t current = 0;
+    bool inNumber = false;
+    for (size_t i = 0; i <= value.length(); i++) {
+        char c = i < value.length() ? value[i] : ',';
+        if (c >= '0' && c <= '9') {
+            current = current * 10 + (uint32_t)(c - '0');
+            inNumber = true;
+        } else if (inNumber) {
+            ids.push_back(current);
+            current = 0;
+            inNumber = false;
+        }
+    }
+}
+
+// false - неизвестное поле в fields или неверный limit
+bool parseListQuery(const WebServerManager::ListParamFn& param, uint32_t allowedFields, ListQuery& query) {
+    String limit = param("limit");
+    if (limit.length() > 0) {
+        long value = limit.toInt();
+        if (value <= 0) {
+            return false;
+        }
+        query.limit = value > LIST_MAX_PAGE_SIZE ? LIST_MAX_PAGE_SIZE : (size_t)value;
+    }
+    String cursor = param("cursor");
+    if (cursor.length() > 0) {
+        query.cursor = (uint32_t)cursor.toInt();
+        if (query.limit == 0) {
+            query.limit = LIST_MAX_PAGE_SIZE;
+        }
+    }
+    String ids = param("ids");
+    if (ids.length() > 0) {
+        parseIdList(ids, query.ids);
+    }
+    String fields = param("fields");
+    if (fields.length() > 0) {
+        query.fields = 0;
+        int start = 0;
+        while (start <= (int)fields.length()) {
+            int end = fields.indexOf(',', start);
+            if (end < 0) {
+                end = fields.length();
+            }
+            String name = fields.substring(start, end);
+            name.trim();
+            if (name.length() > 0) {
+                uint32_t field = 0;
+                for (const auto& entry : kListFieldNames) {
+                    if (name == entry.name) {
+                        field = entry.field;
+                        break;
+                    }
+                }
+                if ((field & allowedFields) == 0) {
+                    return false;
+                }
+                query.fields |= field;
+            }
+            start = end + 1;
+        }
+        if (query.fields == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Позиция записи id в снимке entries по индексу менеджера; -1 - записи нет или
+// снимок уже не совпадает с текущим набором (изменен после его взятия)
+template <typename Manager, typename Snapshot>
+int findInSnapshot(const Manager& manager, const Snapshot& entries, uint32_t id) {
+    int position = manager.findById(id);
+    if (position < 0 || position >= (int)entries.size() || entries[position].id != id) {
+        return -1;
+    }
+    return position;
+}
+
+// Позиции записей страницы в порядке списка (в снимке entries). next - id
+// последней записи, если после нее есть еще (курсор следующей страницы),
+// иначе 0. false - курсор указывает на удаленную запись.
+template <typename Manager, typename Snapshot>
+bool selectListPage(const Manager& manager, const Snapshot& entries, const ListQuery& query,
+                    std::vector<uint32_t>& page, uint32_t& next) {
+    size_t start = 0;
+    if (query.cursor != 0) {
+        int position = findInSnapshot(manager, entries, query.cursor);
+        if (position < 0) {
+            return false;
+        }
+        start = (size_t)position + 1;
+    }
+
+    std::vector<uint32_t> selected;
+    if (!query.ids.empty()) {
+        for (uint32_t id : query.ids) {
+            int position = findInSnapshot(manager, entries, id);
+            if (position >= (int)start) {
+                selected.push_back((uint32_t)position);
+            }
+        }
+        std::sort(selected.begin(), selected.end());
+        selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+    }
+
+    size_t available = query.ids.empty() ? entries.size() - std::min(start, entries.size()) : selected.size();
+    size_t count = query.limit > 0 ? std::min(query.limit, available) : available;
+    page.clear();
+    page.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        page.push_back(query.ids.empty() ? (uint32_t)(start + i) : selected[i]);
+    }
+    next = (count < available && count > 0) ? entries[page.back()].id : 0;
+    return true;
+}
+
+// Запись ключа в ответ /api/keys: код из кэша копируется в стековый буфер без String.
+// HOTP коды не зависят от времени, поэтому показываются и без синхронизации часов.
+// Код считается только если он попал в проекцию fields.
+void appendKeyCodeJson(JsonArray keysArray, const TOTPKey& key, size_t index, TOTPCodeCache& totpCodeCache, TOTPGenerator& totpGenerator,
+                       uint32_t fields = LIST_FIELDS_ALL) {
+    JsonObject keyObj = keysArray.add<JsonObject>();
+    if (fields & LIST_FIELD_ID) {
+        keyObj["id"] = key.id;
+    }
+    if (fields & LIST_FIELD_NAME) {
+        keyObj["name"] = key.name.c_str();
+    }
+    if (fields & LIST_FIELD_CODE) {
+        char code[OTP_CODE_BUFFER_SIZE];
+        OtpStatus status = totpCodeCache.getCode(index, code, sizeof(code));
+        keyObj["code"] = status == OtpStatus::OK ? code : TOTPGenerator::statusText(status);
+    }
+    if (fields & LIST_FIELD_DIGITS) {
+        keyObj["digits"] = key.params.digits;
+    }
+    if (key.params.isCounterBased()) {
+        if (fields & LIST_FIELD_TYPE) {
+            keyObj["type"] = "hotp";
+        }
+        if (fields & LIST_FIELD_COUNTER) {
+            keyObj["counter"] = String((unsigned long long)key.counter);
+        }
+        if (fields & LIST_FIELD_TIME_LEFT) {
+            keyObj["timeLeft"] = 0;
+        }
+        return;
+    }
+    if (fields & LIST_FIELD_TIME_LEFT) {
+        keyObj["timeLeft"] = totpGenerator.getTimeRemaining(key.material);
+    }
+    if (fields & LIST_FIELD_PERIOD) {
+        keyObj["period"] = key.params.period;
+    }
+    // Последние секунды окна: отдаем и следующий код, клиент переключится сам на границе
+    char nextCode[OTP_CODE_BUFFER_SIZE];
+    if ((fields & LIST_FIELD_NEXT_CODE) && totpCodeCache.getNextCode(index, nextCode, sizeof(nextCode))) {
+        keyObj["nextCode"] = nextCode;
+    }
+}
+
+// Параметры списка из строки запроса GET
+WebServerManager::ListParamFn queryListParams(AsyncWebServerRequest* request) {
+    return [request](const char* name) -> String {
+        return request->hasParam(name) ? request->getParam(name)->value() : String();
+    };
+}
+
+// Параметры списка из data туннеля: строки формы, числа или массив id
+WebServerManager::ListParamFn tunnelListParams(JsonObject data) {
+    return [data](const char* name) -> String {
+        JsonVariantConst value = data[name];
+        if (value.isNull()) {
+            return String();
+        }
+        if (value.is<const char*>()) {
+            return value.as<const char*>();
+        }
+        String text;
+        serializeJson(value, text);
+        return text;
+    };
+}
+
+// Источник и точность системных часов для /api/time_settings
+void appendTimeConfidenceJson(JsonDocument& doc) {
+    TimeConfidence confidence = TimeContinuity::getInstance().getConfidence();
+    doc["source"] = TimeContinuity::sourceName(confidence.source);
+    doc["bounded"] = confidence.bounded;
+    if (confidence.bounded) {
+        doc["uncertaintyMs"] = confidence.uncertaintyMs;
+    }
+    doc["sinceSync"] = confidence.secondsSinceSync;
+    if (confidence.driftKnown) {
+        doc["driftPpm"] = confidence.driftPpm;
+    }
+}
+
 void requestOfflineSleepAfterApLogout(DisplayManager& displayManager) {
     if (!isApModeActive()) {
         return;
@@ -78,8 +387,8 @@ void requestOfflineSleepAfterApLogout(DisplayManager& displayManager) {
 
 // WebServerManager Implementation
 
-WebServerManager::WebServerManager(KeyManager& keyManager, SplashScreenManager& splashManager, DisplayManager& displayManager, PinManager& pinManager, ConfigManager& configManager, PasswordManager& passwordManager, TOTPGenerator& totpGenerator)
-    : server(WEB_SERVER_PORT), keyManager(keyManager), splashManager(splashManager), displayManager(displayManager), pinManager(pinManager), configManager(configManager), passwordManager(passwordManager), totpGenerator(totpGenerator), _isRunning(false), _oneMinuteWarningShown(false) {}
+WebServerManager::WebServerManager(KeyManager& keyManager, SplashScreenManager& splashManager, DisplayManager& displayManager, PinManager& pinManager, ConfigManager& configManager, PasswordManager& passwordManager, TOTPGenerator& totpGenerator, TOTPCodeCache& totpCodeCache, TOTPVerifier& totpVerifier)
+    : server(WEB_SERVER_PORT), keyManager(keyManager), splashManager(splashManager), displayManager(displayManager), pinManager(pinManager), configManager(configManager), passwordManager(passwordManager), totpGenerator(totpGenerator), totpCodeCache(totpCodeCache), totpVerifier(totpVerifier), _isRunning(false), _oneMinuteWarningShown(false) {}
 
 void WebServerManager::setBleKeyboardManager(BleKeyboardManager* bleManager) {
     bleKeyboardManager = bleManager;
@@ -1141,25 +1450,9 @@ void WebServerManager::start() {
                 resetActivityTimer();
             }
             
-            // Ограничиваем размер JSON для TOTP ключей (max ~50 ключей)
-            JsonDocument doc;
-            JsonArray keysArray = doc.to<JsonArray>();
-            
-            auto keys = keyManager.getAllKeys();
-            
-            // Полагаемся только на валидность/синхронизацию системного времени.
-            // Это позволяет отображать TOTP и в AP/Offline сценариях, если часы уже корректны.
-            bool blockTOTP = !totpGenerator.isTimeSynced();
-            
-            for (size_t i = 0; i < keys.size(); i++) {
-                JsonObject keyObj = keysArray.add<JsonObject>();
-                keyObj["name"] = keys[i].name;
-                keyObj["code"] = blockTOTP ? "NOT SYNCED" : totpGenerator.generateTOTP(keys[i].secret);
-                keyObj["timeLeft"] = totpGenerator.getTimeRemaining();
-            }
-            
+            // Страница и проекция: ?limit=&cursor=&fields=&ids= (без параметров - все ключи)
             String response;
-            serializeJson(doc, response);
+            int statusCode = buildKeyList(queryListParams(request), response);
             
 #ifdef SECURE_LAYER_ENABLED
             // 🎭 HEADER OBFUSCATION: Используем деобфускацию заголовков
@@ -1187,7 +1480,7 @@ void WebServerManager::start() {
             // Гарантированная проверка secure session для TOTP (прямых и tunneled запросов)
             if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId)) {
                 LOG_INFO("WebServer", "🔐 TOTP ENCRYPTION: Securing keys data for client " + clientId.substring(0,8) + "..." + (isTunneled ? " [TUNNELED]" : " [DIRECT]"));
-                WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", response, secureLayer);
+                WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", response, secureLayer);
                 return;
             } else if (clientId.length() > 0) {
                 LOG_WARNING("WebServer", "🔐 TOTP FALLBACK: No valid secure session for " + clientId.substring(0,8) + "..., sending plaintext");
@@ -1200,7 +1493,7 @@ void WebServerManager::start() {
             }
 #endif
             
-            request->send(200, "application/json", response);
+            request->send(statusCode, "application/json", response);
         }, urlObfuscation);
 
     // API: Add key (🎭 HEADER OBFUSCATION + 🔗 URL OBFUSCATION + 🔐 XOR ENCRYPTION)
@@ -1215,6 +1508,7 @@ void WebServerManager::start() {
             if (!verifyCsrfToken(request)) return request->send(403, "text/plain", "CSRF 令牌不匹配");
             
             String name, secret;
+            String type, algorithm, digits, period, counter;
             
 #ifdef SECURE_LAYER_ENABLED
             // 🎭 HEADER OBFUSCATION: Деобфускация заголовков
@@ -1253,6 +1547,11 @@ void WebServerManager::start() {
                         // Full URL decode to properly restore UTF-8 names like 中文 (%E4%...)
                         name = urlDecode(name);
                         secret = urlDecode(secret);
+                        type = formFieldValue(decryptedBody, "type");
+                        algorithm = urlDecode(formFieldValue(decryptedBody, "algorithm"));
+                        digits = formFieldValue(decryptedBody, "digits");
+                        period = formFieldValue(decryptedBody, "period");
+                        counter = formFieldValue(decryptedBody, "counter");
 
                         LOG_DEBUG("WebServer", "🔐 Parsed: name=" + name + ", secret=" + secret.substring(0, 8) + "...");
                     } else {
@@ -1269,6 +1568,11 @@ void WebServerManager::start() {
                 if (request->hasParam("name", true) && request->hasParam("secret", true)) {
                     name = request->getParam("name", true)->value();
                     secret = request->getParam("secret", true)->value();
+                    if (request->hasParam("type", true)) type = request->getParam("type", true)->value();
+                    if (request->hasParam("algorithm", true)) algorithm = request->getParam("algorithm", true)->value();
+                    if (request->hasParam("digits", true)) digits = request->getParam("digits", true)->value();
+                    if (request->hasParam("period", true)) period = request->getParam("period", true)->value();
+                    if (request->hasParam("counter", true)) counter = request->getParam("counter", true)->value();
                 } else {
                     return request->send(400, "text/plain", "缺少必需参数");
                 }
@@ -1278,8 +1582,13 @@ void WebServerManager::start() {
                 return request->send(400, "text/plain", "名称和密钥不能为空");
             }
             
+            OtpParams params;
+            if (!parseOtpParams(type, algorithm, digits, period, params)) {
+                return request->send(400, "text/plain", "不支持的OTP参数");
+            }
+            
             LOG_INFO("WebServer", "Key add requested: " + name);
-            keyManager.addKey(name, secret);
+            keyManager.addKey(name, secret, params, strtoull(counter.c_str(), nullptr, 10));
             
             JsonDocument doc;
             doc["status"] = "success";
@@ -1377,14 +1686,9 @@ void WebServerManager::start() {
                 if (secureLayer.decryptRequest(clientId, encryptedBody, decryptedBody)) {
                     LOG_DEBUG("WebServer", "🔐 Decrypted key remove body: " + decryptedBody);
                     
-                    // Парсим расшифрованные данные (формат: index=0)
-                    int indexStart = decryptedBody.indexOf("index=");
-                    if (indexStart >= 0) {
-                        int indexEnd = decryptedBody.indexOf("&", indexStart);
-                        if (indexEnd == -1) indexEnd = decryptedBody.length();
-                        
-                        String indexStr = decryptedBody.substring(indexStart + 6, indexEnd); // skip "index="
-                        keyIndex = indexStr.toInt();
+                    // Парсим расшифрованные данные (формат: id=7 или index=0)
+                    if (decryptedBody.indexOf("id=") >= 0 || decryptedBody.indexOf("index=") >= 0) {
+                        keyIndex = resolveEntryIndex(keyManager, decryptedBody);
                         
                         LOG_DEBUG("WebServer", "🔐 Parsed key index: " + String(keyIndex));
                     } else {
@@ -1398,8 +1702,8 @@ void WebServerManager::start() {
 #endif
             {
                 // Обычный незашифрованный запрос - читаем параметры
-                if (request->hasParam("index", true)) {
-                    keyIndex = request->getParam("index", true)->value().toInt();
+                if (request->hasParam("id", true) || request->hasParam("index", true)) {
+                    keyIndex = resolveEntryIndex(keyManager, request);
                 } else {
                     return request->send(400, "text/plain", "缺少索引参数");
                 }
@@ -1533,6 +1837,113 @@ void WebServerManager::start() {
         LOG_DEBUG("WebServer", "🔗 Registered obfuscated /api/keys/reorder -> " + obfuscatedReorderPath);
     }
 
+    // API: HOTP - следующие коды для ресинхронизации и переход к следующему счетчику;
+    // ответ шифруется, если у клиента есть защищенная сессия
+    auto sendOtpResponse = [this](AsyncWebServerRequest *request, int statusCode, const String& output) {
+#ifdef SECURE_LAYER_ENABLED
+        String clientId = WebServerSecureIntegration::getClientId(request);
+        if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId)) {
+            WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+            return;
+        }
+#endif
+        request->send(statusCode, "application/json", output);
+    };
+
+    URLObfuscationIntegration::registerDualEndpoint(server, "/api/keys/hotp/lookahead", HTTP_POST,
+        [this, sendOtpResponse](AsyncWebServerRequest *request){
+            if (!isAuthenticated(request)) return request->send(401);
+            if (!request->hasParam("index", true)) {
+                return request->send(400, "text/plain", "必须提供索引参数");
+            }
+            int index = request->getParam("index", true)->value().toInt();
+            int count = request->hasParam("count", true) ? request->getParam("count", true)->value().toInt() : HOTP_MAX_LOOKAHEAD;
+
+            String output;
+            int statusCode = buildHotpLookahead(index, count, output);
+            sendOtpResponse(request, statusCode, output);
+        }, urlObfuscation);
+
+    URLObfuscationIntegration::registerDualEndpoint(server, "/api/keys/hotp/next", HTTP_POST,
+        [this, sendOtpResponse](AsyncWebServerRequest *request){
+            if (!isAuthenticated(request)) return request->send(401);
+            if (!verifyCsrfToken(request)) return request->send(403, "text/plain", "CSRF 令牌不匹配");
+            if (!request->hasParam("index", true)) {
+                return request->send(400, "text/plain", "必须提供索引参数");
+            }
+            int index = request->getParam("index", true)->value().toInt();
+            String counter = request->hasParam("counter", true) ? request->getParam("counter", true)->value() : String();
+
+            LOG_INFO("WebServer", "HOTP counter update requested for index " + String(index));
+            String output;
+            int statusCode = advanceHotpCounter(index, counter, output);
+            sendOtpResponse(request, statusCode, output);
+        }, urlObfuscation);
+
+    // API: поиск ключей по подстроке имени
+    URLObfuscationIntegration::registerDualEndpoint(server, "/api/keys/search", HTTP_GET,
+        [this, sendOtpResponse](AsyncWebServerRequest *request){
+            if (!isAuthenticated(request)) return request->send(401);
+            String query = request->hasParam("q") ? request->getParam("q")->value() : String();
+            String output;
+            int statusCode = buildKeySearch(query, output);
+            sendOtpResponse(request, statusCode, output);
+        }, urlObfuscation);
+
+    // API: проверка TOTP кода (устройство как второй фактор для своих сервисов)
+    URLObfuscationIntegration::registerDualEndpoint(server, "/api/totp/verify", HTTP_POST,
+        [this, sendOtpResponse](AsyncWebServerRequest *request){
+            if (!isAuthenticated(request)) return request->send(401);
+            if (!verifyCsrfToken(request)) return request->send(403, "text/plain", "CSRF 令牌不匹配");
+            if (!request->hasParam("code", true) || (!request->hasParam("name", true) && !request->hasParam("index", true))) {
+                return request->send(400, "text/plain", "必须提供验证码和密钥名称或索引");
+            }
+            String name = request->hasParam("name", true) ? request->getParam("name", true)->value() : String();
+            int index = request->hasParam("index", true) ? request->getParam("index", true)->value().toInt() : -1;
+            int skew = request->hasParam("skew", true) ? request->getParam("skew", true)->value().toInt() : TOTP_VERIFY_DEFAULT_SKEW;
+
+            String output;
+            int statusCode = verifyTotpCode(name, index, request->getParam("code", true)->value(), skew, output);
+            sendOtpResponse(request, statusCode, output);
+        }, urlObfuscation);
+
+    // API: пакетные изменения ключей и паролей - параметр ops (JSON массив операций),
+    // одна запись во flash на весь пакет
+    URLObfuscationIntegration::registerDualEndpoint(server, "/api/keys/batch", HTTP_POST,
+        [this, sendOtpResponse](AsyncWebServerRequest *request){
+            if (!isAuthenticated(request)) return request->send(401);
+            if (!verifyCsrfToken(request)) return request->send(403, "text/plain", "CSRF 令牌不匹配");
+            if (!request->hasParam("ops", true)) {
+                return request->send(400, "text/plain", "必须提供 ops 参数");
+            }
+            JsonDocument doc;
+            if (deserializeJson(doc, request->getParam("ops", true)->value())) {
+                return request->send(400, "text/plain", "JSON 无效");
+            }
+            String output;
+            int statusCode = applyKeyBatch(doc.as<JsonVariantConst>(), output);
+            sendOtpResponse(request, statusCode, output);
+        }, urlObfuscation);
+
+    URLObfuscationIntegration::registerDualEndpoint(server, "/api/passwords/batch", HTTP_POST,
+        [this, sendOtpResponse](AsyncWebServerRequest *request){
+            if (!isAuthenticated(request)) return request->send(401);
+            if (!verifyCsrfToken(request)) return request->send(403, "text/plain", "CSRF 令牌不匹配");
+            if (!request->hasParam("ops", true)) {
+                return request->send(400, "text/plain", "必须提供 ops 参数");
+            }
+            if (request->hasHeader("X-User-Activity")) {
+                resetActivityTimer();
+            }
+            JsonDocument doc;
+            if (deserializeJson(doc, request->getParam("ops", true)->value())) {
+                return request->send(400, "text/plain", "JSON 无效");
+            }
+            String output;
+            int statusCode = applyPasswordBatch(doc.as<JsonVariantConst>(), output);
+            sendOtpResponse(request, statusCode, output);
+        }, urlObfuscation);
+
     // API: Passwords (SECURE TESTING ENABLED + URL OBFUSCATION)
     URLObfuscationIntegration::registerDualEndpoint(server, "/api/passwords", HTTP_GET, 
         [this](AsyncWebServerRequest *request){
@@ -1543,17 +1954,9 @@ void WebServerManager::start() {
                 resetActivityTimer();
             }
             
-            auto passwords = passwordManager.getAllPasswords();
-            // Список паролей - увеличенный размер для 50 длинных паролей (до 70 символов каждый)
-            JsonDocument doc;
-            JsonArray array = doc.to<JsonArray>();
-            for (const auto& entry : passwords) {
-                JsonObject obj = array.add<JsonObject>();
-                obj["name"] = entry.name;
-                obj["password"] = entry.password; // Добавляем пароли для корректного отображения в веб-интерфейсе
-            }
+            // Пароль не передается: веб-интерфейс запрашивает его через /api/passwords/get
             String output;
-            serializeJson(doc, output);
+            int statusCode = buildPasswordList(queryListParams(request), output);
             
 #ifdef SECURE_LAYER_ENABLED
             // КРИТИЧНО: Принудительное шифрование паролей (аналогично TOTP)
@@ -1576,7 +1979,7 @@ void WebServerManager::start() {
             // Гарантированная проверка secure session для паролей (прямых и tunneled запросов)
             if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId)) {
                 LOG_INFO("WebServer", "🔐 PASSWORD ENCRYPTION: Securing passwords data for client " + clientId.substring(0,8) + "..." + (isTunneled ? " [TUNNELED]" : " [DIRECT]"));
-                WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", output, secureLayer);
+                WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
                 return;
             } else if (clientId.length() > 0) {
                 LOG_WARNING("WebServer", "🔐 PASSWORD FALLBACK: No valid secure session for " + clientId.substring(0,8) + "..., sending plaintext");
@@ -1588,7 +1991,20 @@ void WebServerManager::start() {
             }
 #endif
             
-            request->send(200, "application/json", output);
+            request->send(statusCode, "application/json", output);
+        }, urlObfuscation);
+
+    // API: поиск паролей по подстроке имени (пароли не расшифровываются)
+    URLObfuscationIntegration::registerDualEndpoint(server, "/api/passwords/search", HTTP_GET,
+        [this, sendOtpResponse](AsyncWebServerRequest *request){
+            if (!isAuthenticated(request)) return request->send(401);
+            if (request->hasHeader("X-User-Activity")) {
+                resetActivityTimer();
+            }
+            String query = request->hasParam("q") ? request->getParam("q")->value() : String();
+            String output;
+            int statusCode = buildPasswordSearch(query, output);
+            sendOtpResponse(request, statusCode, output);
         }, urlObfuscation);
 
     // API: Add password (SECURE TESTING ENABLED + URL OBFUSCATION + REQUEST DECRYPTION)
@@ -1710,14 +2126,9 @@ void WebServerManager::start() {
                 if (secureLayer.decryptRequest(clientId, encryptedBody, decryptedBody)) {
                     LOG_DEBUG("WebServer", "🔐 Decrypted password delete body: " + decryptedBody);
                     
-                    // Парсим расшифрованные данные (формат: index=0)
-                    int indexStart = decryptedBody.indexOf("index=");
-                    if (indexStart >= 0) {
-                        int indexEnd = decryptedBody.indexOf("&", indexStart);
-                        if (indexEnd == -1) indexEnd = decryptedBody.length();
-                        
-                        String indexStr = decryptedBody.substring(indexStart + 6, indexEnd); // skip "index="
-                        passwordIndex = indexStr.toInt();
+                    // Парсим расшифрованные данные (формат: id=7 или index=0)
+                    if (decryptedBody.indexOf("id=") >= 0 || decryptedBody.indexOf("index=") >= 0) {
+                        passwordIndex = resolveEntryIndex(passwordManager, decryptedBody);
                         
                         LOG_DEBUG("WebServer", "🔐 Parsed password index: " + String(passwordIndex));
                     } else {
@@ -1731,8 +2142,8 @@ void WebServerManager::start() {
 #endif
             {
                 // Обычный незашифрованный запрос - читаем параметры
-                if (request->hasParam("index", true)) {
-                    passwordIndex = request->getParam("index", true)->value().toInt();
+                if (request->hasParam("id", true) || request->hasParam("index", true)) {
+                    passwordIndex = resolveEntryIndex(passwordManager, request);
                 } else {
                     return request->send(400, "text/plain", "缺少索引参数");
                 }
@@ -1781,8 +2192,8 @@ void WebServerManager::start() {
             hasSecureSession = (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId));
 #endif
             
-            if (request->hasParam("index", true)) {
-                index = request->getParam("index", true)->value().toInt();
+            if (request->hasParam("id", true) || request->hasParam("index", true)) {
+                index = resolveEntryIndex(passwordManager, request);
             } else if (request->hasParam("index", false)) {
                 index = request->getParam("index", false)->value().toInt();
             } else if (isTunneled || hasSecureSession) {
@@ -1798,14 +2209,21 @@ void WebServerManager::start() {
                 return;
             }
             
-            auto passwords = passwordManager.getAllPasswords();
+            const auto& passwords = passwordManager.getAllPasswords();
             if (index >= 0 && index < passwords.size()) {
                     LOG_INFO("WebServer", "🔐 Password retrieved for editing: index " + String(index));
                     
+                    // Пароль расшифровывается из flash только для этого ответа (по id: индекс снимка мог устареть)
+                    RevealedPassword password;
+                    if (!passwordManager.revealPasswordById(passwords[index].id, password)) {
+                        request->send(500, "text/plain", "密码解密失败");
+                        return;
+                    }
+                    
                     // Формируем ответ с чувствительными данными
                     JsonDocument doc;
-                    doc["name"] = passwords[index].name;
-                    doc["password"] = passwords[index].password;
+                    doc["name"] = passwords[index].name.c_str();
+                    doc["password"] = password.c_str();
                     String output;
                     serializeJson(doc, output);
                     
@@ -1857,17 +2275,14 @@ void WebServerManager::start() {
                 if (secureLayer.decryptRequest(clientId, encryptedBody, decryptedBody)) {
                     LOG_DEBUG("WebServer", "🔐 Decrypted password update body: " + decryptedBody.substring(0, 50) + "...");
                     
-                    // Парсим расшифрованные данные (формат: index=0&name=test&password=pass)
-                    int indexStart = decryptedBody.indexOf("index=");
+                    // Парсим расшифрованные данные (формат: id=7&name=test&password=pass, вместо id - index=0)
+                    bool hasTarget = decryptedBody.indexOf("id=") >= 0 || decryptedBody.indexOf("index=") >= 0;
                     int nameStart = decryptedBody.indexOf("name=");
                     int passwordStart = decryptedBody.indexOf("password=");
                     
-                    if (indexStart >= 0 && nameStart >= 0 && passwordStart >= 0) {
-                        // Извлекаем index
-                        int indexEnd = decryptedBody.indexOf("&", indexStart);
-                        if (indexEnd == -1) indexEnd = decryptedBody.length();
-                        String indexStr = decryptedBody.substring(indexStart + 6, indexEnd);
-                        indexVal = indexStr.toInt();
+                    if (hasTarget && nameStart >= 0 && passwordStart >= 0) {
+                        // Извлекаем id или index
+                        indexVal = resolveEntryIndex(passwordManager, decryptedBody);
                         
                         // Извлекаем name
                         int nameEnd = decryptedBody.indexOf("&", nameStart);
@@ -1895,8 +2310,9 @@ void WebServerManager::start() {
 #endif
             {
                 // Обычный незашифрованный запрос
-                if (request->hasParam("index", true) && request->hasParam("name", true) && request->hasParam("password", true)) {
-                    indexVal = request->getParam("index", true)->value().toInt();
+                if ((request->hasParam("id", true) || request->hasParam("index", true)) &&
+                    request->hasParam("name", true) && request->hasParam("password", true)) {
+                    indexVal = resolveEntryIndex(passwordManager, request);
                     name = request->getParam("name", true)->value();
                     password = request->getParam("password", true)->value();
                 } else {
@@ -2106,25 +2522,7 @@ void WebServerManager::start() {
             }
 
             LOG_INFO("WebServer", "Password verified. Starting password export process.");
-            auto passwords = passwordManager.getAllPasswordsForExport();
-            
-            JsonDocument doc;
-            JsonArray array = doc.to<JsonArray>();
-            for (const auto& entry : passwords) {
-                JsonObject obj = array.add<JsonObject>();
-                obj["name"] = entry.name;
-                obj["password"] = entry.password;
-            }
-            String plaintext;
-            serializeJson(doc, plaintext);
-
-            String encryptedContent = CryptoManager::getInstance().encryptWithPassword(plaintext, password);
-
-            // 🔐 ВАЖНО: Не используем sendSecureResponse для файлов - контент уже зашифрован CryptoManager
-            LOG_INFO("WebServer", "🔐 PASSWORD EXPORT: Sending encrypted file (pre-encrypted by CryptoManager)");
-            AsyncWebServerResponse *response = request->beginResponse(200, "application/json", encryptedContent);
-            response->addHeader("Content-Disposition", "attachment; filename=\"encrypted_passwords_backup.json\"");
-            request->send(response);
+            sendExport(request, false, password);
         }
     };
     
@@ -2140,110 +2538,7 @@ void WebServerManager::start() {
         [this](AsyncWebServerRequest *request) {
             // Empty handler, body handler does the work
         }, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            if (!isAuthenticated(request)) {
-                if (index == 0) request->send(401);
-                return;
-            }
-            if (!WebAdminManager::getInstance().isApiEnabled()) {
-                if (index == 0) {
-                    LOG_WARNING("WebServer", "Blocked unauthorized attempt to import passwords (API disabled).");
-                    request->send(403, "text/plain", "导入/导出 API 访问已禁用。");
-                }
-                return;
-            }
-
-            static String body;
-            if (index == 0) body = "";
-            body.concat((char*)data, len);
-
-            if (index + len >= total) {
-                LOG_INFO("WebServer", "Received passwords import data.");
-                
-                String finalBody = body;
-                String clientId; // Объявляем заранее для использования в нескольких блоках
-                
-#ifdef SECURE_LAYER_ENABLED
-                // 🔐 Проверяем XOR зашифрованный запрос
-                clientId = WebServerSecureIntegration::getClientId(request);
-                if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId) && 
-                    (request->hasHeader("X-Secure-Request") || request->hasHeader("X-Security-Level"))) {
-                    
-                    LOG_INFO("WebServer", "🔐 PASSWORDS IMPORT: Decrypting XOR request body for " + clientId.substring(0,8) + "...");
-                    
-                    // Расшифровываем XOR тело запроса
-                    String decryptedBody;
-                    if (secureLayer.decryptRequest(clientId, body, decryptedBody)) {
-                        LOG_DEBUG("WebServer", "🔐 XOR decrypted passwords import body: " + decryptedBody.substring(0, 100) + "...");
-                        finalBody = decryptedBody;
-                    } else {
-                        LOG_ERROR("WebServer", "🔐 Failed to XOR decrypt passwords import request body");
-                        request->send(400, "text/plain", "密码导入 XOR 解密失败");
-                        return;
-                    }
-                }
-#endif
-                
-                JsonDocument doc;
-                if (deserializeJson(doc, finalBody) != DeserializationError::Ok) {
-                    request->send(400, "text/plain", "JSON 无效 body.");
-                    return;
-                }
-
-                String password = doc["password"];
-                String fileContent = doc["data"];
-
-                if (password.isEmpty() || fileContent.isEmpty()) {
-                    request->send(400, "text/plain", "缺少密码或文件数据。");
-                    return;
-                }
-
-                String decryptedContent = CryptoManager::getInstance().decryptWithPassword(fileContent, password);
-
-                if (decryptedContent.isEmpty()) {
-                    LOG_WARNING("WebServer", "Failed to decrypt imported passwords. Wrong password or corrupt file.");
-                    
-                    String errorResponse = "解密失败：密码错误或文件已损坏。";
-                    
-#ifdef SECURE_LAYER_ENABLED
-                    // КРИТИЧНО: Принудительное шифрование ошибок для password операций
-                    String clientId = WebServerSecureIntegration::getClientId(request);
-                    bool isTunneled = request->hasHeader("X-Real-Method");
-                    
-                    if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId)) {
-                        LOG_INFO("WebServer", "🔐 PASSWORD IMPORT ERROR ENCRYPTION: Securing error response for client " + clientId.substring(0,8) + "..." + (isTunneled ? " [TUNNELED]" : " [DIRECT]"));
-                        WebServerSecureIntegration::sendSecureResponse(request, 400, "text/plain", errorResponse, secureLayer);
-                        return;
-                    }
-#endif
-                    
-                    request->send(400, "text/plain", errorResponse);
-                    return;
-                }
-
-                String response;
-                int statusCode;
-                
-                if (passwordManager.replaceAllPasswords(decryptedContent)) {
-                    LOG_INFO("WebServer", "Passwords imported successfully.");
-                    response = "导入成功！";
-                    statusCode = 200;
-                } else {
-                    LOG_ERROR("WebServer", "Failed to process imported passwords after decryption.");
-                    response = "解密后处理密码数据失败。";
-                    statusCode = 500;
-                }
-                
-#ifdef SECURE_LAYER_ENABLED
-                // 🔐 Переиспользуем clientId из блока расшифровки выше
-                if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId)) {
-                    LOG_INFO("WebServer", "🔐 PASSWORD IMPORT ENCRYPTION: Securing response");
-                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "text/plain", response, secureLayer);
-                    return;
-                }
-#endif
-                
-                request->send(statusCode, "text/plain", response);
-            }
+            handleImportBody(request, data, len, index, total, false);
         }, urlObfuscation);
 
     // --- API для управления доступом к импорту/экспорту ---
@@ -2266,6 +2561,58 @@ void WebServerManager::start() {
         request->send(200, "application/json", output);
     });
     
+    // API: состояние кучи и блоков записей хранилищ (наблюдение за фрагментацией)
+    server.on("/api/memory", HTTP_GET, [this](AsyncWebServerRequest *request){
+        if (!isAuthenticated(request)) return request->send(401);
+        HeapStats heap = HeapMonitor::sample();
+        JsonDocument doc;
+        doc["freeHeap"] = heap.freeHeap;
+        doc["minFreeHeap"] = heap.minFreeHeap;
+        doc["largestFreeBlock"] = heap.largestFreeBlock;
+        doc["minLargestFreeBlock"] = heap.minLargestFreeBlock;
+        doc["fragmentation"] = heap.fragmentation;
+        JsonObject keysObj = doc["keys"].to<JsonObject>();
+        keysObj["count"] = keyManager.getAllKeys().size();
+        keysObj["capacity"] = keyManager.getCapacity();
+        keysObj["bytes"] = keyManager.getStorageBytes();
+        JsonObject passwordsObj = doc["passwords"].to<JsonObject>();
+        // Диагностика не должна загружать отложенное хранилище паролей
+        passwordsObj["loaded"] = passwordManager.isLoaded();
+        passwordsObj["loadFailed"] = passwordManager.loadHasFailed();
+        if (passwordManager.isLoaded()) {
+            passwordsObj["count"] = passwordManager.getAllPasswords().size();
+        }
+        passwordsObj["capacity"] = passwordManager.getCapacity();
+        passwordsObj["bytes"] = passwordManager.getStorageBytes();
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    });
+
+    // API: счетчики отложенной записи и записей во flash
+    server.on("/api/persistence", HTTP_GET, [this](AsyncWebServerRequest *request){
+        if (!isAuthenticated(request)) return request->send(401);
+        JsonDocument doc;
+        WriteBehind::getInstance().toJson(doc.to<JsonObject>());
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    });
+
+    // API: время этапов загрузки и отложенной загрузки паролей
+    server.on("/api/boot_timing", HTTP_GET, [this](AsyncWebServerRequest *request){
+        if (!isAuthenticated(request)) return request->send(401);
+        JsonDocument doc;
+        BootTiming::toJson(doc.to<JsonObject>());
+        JsonObject passwordsObj = doc["passwords"].to<JsonObject>();
+        passwordsObj["loaded"] = passwordManager.isLoaded();
+        passwordsObj["loadFailed"] = passwordManager.loadHasFailed();
+        passwordsObj["loadMs"] = passwordManager.getLoadTimeMs();
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    });
+    
     // API: Get URL obfuscation mappings
     // ⚠️ ВАЖНО: Этот endpoint ПУБЛИЧНЫЙ (без auth)
     // Mappings нужны ДО keyExchange, а keyExchange - ДО аутентификации
@@ -2288,12 +2635,19 @@ void WebServerManager::start() {
             "/api/add",
             "/api/remove",
             "/api/keys/reorder",
+            "/api/keys/hotp/lookahead",
+            "/api/keys/hotp/next",
+            "/api/keys/search",
+            "/api/totp/verify",
+            "/api/keys/batch",
             "/api/passwords",
             "/api/passwords/add",
             "/api/passwords/delete",
             "/api/passwords/update",
             "/api/passwords/get",
             "/api/passwords/reorder",
+            "/api/passwords/batch",
+            "/api/passwords/search",
             "/api/config",
             "/api/pincode_settings"
         };
@@ -2715,25 +3069,7 @@ void WebServerManager::start() {
             }
 
             LOG_INFO("WebServer", "Password verified. Starting TOTP keys export process.");
-            auto keys = keyManager.getAllKeys();
-            
-            JsonDocument doc;
-            JsonArray array = doc.to<JsonArray>();
-            for (const auto& key : keys) {
-                JsonObject obj = array.add<JsonObject>();
-                obj["name"] = key.name;
-                obj["secret"] = key.secret;
-            }
-            String plaintext;
-            serializeJson(doc, plaintext);
-
-            String encryptedContent = CryptoManager::getInstance().encryptWithPassword(plaintext, password);
-            
-            // 🔐 ВАЖНО: Не используем sendSecureResponse для файлов - контент уже зашифрован CryptoManager
-            LOG_INFO("WebServer", "🔐 TOTP EXPORT: Sending encrypted file (pre-encrypted by CryptoManager)");
-            AsyncWebServerResponse *response = request->beginResponse(200, "application/json", encryptedContent);
-            response->addHeader("Content-Disposition", "attachment; filename=\"encrypted_keys_backup.json\"");
-            request->send(response);
+            sendExport(request, true, password);
         }
     });
 
@@ -2741,119 +3077,7 @@ void WebServerManager::start() {
         // This handler is intentionally left empty because the body handler below does all the work.
         // We just need to ensure the endpoint exists.
     }, NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-        if (!isAuthenticated(request)) {
-            if (index == 0) request->send(401);
-            return;
-        }
-        if (!WebAdminManager::getInstance().isApiEnabled()) {
-            if (index == 0) {
-                LOG_WARNING("WebServer", "Blocked unauthorized attempt to import TOTP keys (API disabled).");
-                request->send(403, "text/plain", "导入/导出 API 访问已禁用。");
-            }
-            return;
-        }
-
-        static String body;
-        if (index == 0) body = "";
-        body.concat((char*)data, len);
-
-        if (index + len >= total) {
-            LOG_INFO("WebServer", "Received TOTP keys import data.");
-            
-            String finalBody = body;
-            
-#ifdef SECURE_LAYER_ENABLED
-            // 🔐 Проверяем XOR зашифрованный запрос
-            String clientId = WebServerSecureIntegration::getClientId(request);
-            if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId) && 
-                (request->hasHeader("X-Secure-Request") || request->hasHeader("X-Security-Level"))) {
-                
-                LOG_INFO("WebServer", "🔐 IMPORT: Decrypting XOR request body for " + clientId.substring(0,8) + "...");
-                
-                // Расшифровываем XOR тело запроса
-                String decryptedBody;
-                if (secureLayer.decryptRequest(clientId, body, decryptedBody)) {
-                    LOG_DEBUG("WebServer", "🔐 XOR decrypted import body: " + decryptedBody.substring(0, 100) + "...");
-                    finalBody = decryptedBody;
-                } else {
-                    LOG_ERROR("WebServer", "🔐 Failed to XOR decrypt import request body");
-                    request->send(400, "text/plain", "导入请求 XOR 解密失败");
-                    return;
-                }
-            }
-#endif
-            
-            JsonDocument doc;
-            if (deserializeJson(doc, finalBody) != DeserializationError::Ok) {
-                request->send(400, "text/plain", "JSON 无效 body.");
-                return;
-            }
-
-            String password = doc["password"];
-            String fileContent = doc["data"];
-
-            if (password.isEmpty() || fileContent.isEmpty()) {
-                request->send(400, "text/plain", "缺少密码或文件数据。");
-                return;
-            }
-
-            String decryptedContent = CryptoManager::getInstance().decryptWithPassword(fileContent, password);
-
-            if (decryptedContent.isEmpty()) {
-                LOG_WARNING("WebServer", "Failed to decrypt imported TOTP keys. Wrong password or corrupt file.");
-                request->send(400, "text/plain", "解密失败：密码错误或文件已损坏。");
-                return;
-            }
-
-            if (keyManager.replaceAllKeys(decryptedContent)) {
-                LOG_INFO("WebServer", "TOTP keys imported successfully.");
-                
-                // Формируем JSON ответ с подтверждением
-                JsonDocument responseDoc;
-                responseDoc["status"] = "success";
-                responseDoc["message"] = "导入成功！";
-                String jsonResponse;
-                serializeJson(responseDoc, jsonResponse);
-                
-#ifdef SECURE_LAYER_ENABLED
-                // КРИТИЧНО: Принудительное шифрование для import операций
-                String clientId = WebServerSecureIntegration::getClientId(request);
-                bool isTunneled = request->hasHeader("X-Real-Method");
-                
-                if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId)) {
-                    LOG_INFO("WebServer", "🔐 IMPORT ENCRYPTION: Securing import response for client " + clientId.substring(0,8) + "..." + (isTunneled ? " [TUNNELED]" : " [DIRECT]"));
-                    WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", jsonResponse, secureLayer);
-                    return;
-                } else if (clientId.length() > 0) {
-                    LOG_WARNING("WebServer", "🔐 IMPORT FALLBACK: No valid secure session for " + clientId.substring(0,8) + "..., sending plaintext");
-                } else if (isTunneled) {
-                    LOG_DEBUG("WebServer", "🔐 IMPORT FALLBACK: Missing clientId header [TUNNELED REQUEST]");
-                }
-#endif
-                
-                request->send(200, "application/json", jsonResponse);
-            } else {
-                LOG_ERROR("WebServer", "Failed to process imported TOTP keys after decryption.");
-                
-                // Формируем JSON ответ с ошибкой
-                JsonDocument errorDoc;
-                errorDoc["status"] = "error";
-                errorDoc["message"] = "解密后处理密钥失败。";
-                String errorResponse;
-                serializeJson(errorDoc, errorResponse);
-                
-#ifdef SECURE_LAYER_ENABLED
-                // Шифруем также ответы с ошибками
-                String clientId = WebServerSecureIntegration::getClientId(request);
-                if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId)) {
-                    WebServerSecureIntegration::sendSecureResponse(request, 500, "application/json", errorResponse, secureLayer);
-                    return;
-                }
-#endif
-                
-                request->send(500, "application/json", errorResponse);
-            }
-        }
+        handleImportBody(request, data, len, index, total, true);
     });
 
     server.on("/api/pincode_settings", HTTP_GET, [this](AsyncWebServerRequest *request){
@@ -3366,6 +3590,7 @@ void WebServerManager::start() {
         JsonDocument doc;
         doc["epoch"] = static_cast<unsigned long>(now);
         doc["synced"] = (now >= 1577836800);
+        appendTimeConfidenceJson(doc);
         String output;
         serializeJson(doc, output);
 
@@ -3460,7 +3685,7 @@ void WebServerManager::start() {
                 ts.tv_sec = tv.tv_sec;
                 ts.tv_nsec = 0;
                 clock_settime(CLOCK_REALTIME, &ts); // Best-effort RTC sync on supported targets
-                configManager.saveLastKnownEpoch(epoch);
+                TimeContinuity::getInstance().recordManualSync();
                 totpGenerator.markTimeSynchronized();
             }
 
@@ -4047,6 +4272,7 @@ void WebServerManager::start() {
                     if (secureLayer.encryptResponse(clientId, response, encryptedResponse)) {
                         request->send(200, "application/json", encryptedResponse);
                         delay(1000);
+                        WriteBehind::getInstance().sync();
                         ESP.restart();
                     } else {
                         request->send(500, "text/plain", "加密失败");
@@ -4059,6 +4285,7 @@ void WebServerManager::start() {
                 LOG_INFO("WebServer", "System reboot requested");
                 request->send(200, "text/plain", "正在重启...");
                 delay(1000);
+                WriteBehind::getInstance().sync();
                 ESP.restart();
             }
         });
@@ -4104,6 +4331,7 @@ void WebServerManager::start() {
                     if (secureLayer.encryptResponse(clientId, response, encryptedResponse)) {
                         request->send(200, "application/json", encryptedResponse);
                         delay(1000);
+                        WriteBehind::getInstance().sync();
                         ESP.restart();
                     } else {
                         request->send(500, "text/plain", "加密失败");
@@ -4118,6 +4346,7 @@ void WebServerManager::start() {
                 request->send(200, "text/plain", "正在重启（Web 服务已启用）...");
                 LOG_INFO("WebServer", "Web server auto-start flag set successfully");
                 delay(1000);
+                WriteBehind::getInstance().sync();
                 ESP.restart();
             }
         });
@@ -4372,26 +4601,66 @@ void WebServerManager::start() {
                         resetActivityTimer();
                     }
                     
-                    // ArduinoJson 7 автоматически управляет памятью
-                    JsonDocument doc;
-                    JsonArray keysArray = doc.to<JsonArray>();
-                    auto keys = keyManager.getAllKeys();
-                    
-                    // Опираемся только на состояние синхронизации времени.
-                    bool blockTOTP = !totpGenerator.isTimeSynced();
-                    
-                    for (size_t i = 0; i < keys.size(); i++) {
-                        JsonObject keyObj = keysArray.add<JsonObject>();
-                        keyObj["name"] = keys[i].name;
-                        keyObj["code"] = blockTOTP ? "NOT SYNCED" : totpGenerator.generateTOTP(keys[i].secret);
-                        keyObj["timeLeft"] = totpGenerator.getTimeRemaining();
-                    }
-                    
                     String response;
-                    serializeJson(doc, response);
+                    int statusCode = buildKeyList(tunnelListParams(targetData), response);
                     
                     LOG_INFO("WebServer", "🔐 TOTP ENCRYPTION: Securing tunneled keys data [TUNNELED]");
-                    WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", response, secureLayer);
+                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", response, secureLayer);
+                    return;
+                }
+                
+                // 🎯 МАРШРУТИЗАЦИЯ: /api/keys/search и /api/passwords/search GET
+                if ((targetEndpoint == "/api/keys/search" || targetEndpoint == "/api/passwords/search") && targetMethod == "GET") {
+                    if (request->hasHeader("X-User-Activity")) {
+                        resetActivityTimer();
+                    }
+                    String query = targetData["q"] | "";
+                    String output;
+                    int statusCode = targetEndpoint == "/api/keys/search" ? buildKeySearch(query, output)
+                                                                          : buildPasswordSearch(query, output);
+                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                    return;
+                }
+                
+                // 🎯 МАРШРУТИЗАЦИЯ: /api/keys/hotp/lookahead и /api/keys/hotp/next POST
+                if (targetEndpoint == "/api/keys/hotp/lookahead" && targetMethod == "POST") {
+                    String output;
+                    int statusCode = buildHotpLookahead(targetData["index"] | -1, targetData["count"] | HOTP_MAX_LOOKAHEAD, output);
+                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                    return;
+                }
+                if (targetEndpoint == "/api/keys/hotp/next" && targetMethod == "POST") {
+                    String counter = targetData["counter"].isNull() ? String() : targetData["counter"].as<String>();
+                    LOG_INFO("WebServer", "🚇 TUNNELED HOTP counter update");
+                    String output;
+                    int statusCode = advanceHotpCounter(targetData["index"] | -1, counter, output);
+                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                    return;
+                }
+                
+                // 🎯 МАРШРУТИЗАЦИЯ: /api/totp/verify POST
+                if (targetEndpoint == "/api/totp/verify" && targetMethod == "POST") {
+                    String output;
+                    int statusCode = verifyTotpCode(targetData["name"] | "", targetData["index"] | -1,
+                                                    targetData["code"] | "", targetData["skew"] | TOTP_VERIFY_DEFAULT_SKEW, output);
+                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                    return;
+                }
+                
+                // 🎯 МАРШРУТИЗАЦИЯ: /api/keys/batch и /api/passwords/batch POST
+                if (targetEndpoint == "/api/keys/batch" && targetMethod == "POST") {
+                    String output;
+                    int statusCode = applyKeyBatch(targetData["ops"], output);
+                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                    return;
+                }
+                if (targetEndpoint == "/api/passwords/batch" && targetMethod == "POST") {
+                    if (request->hasHeader("X-User-Activity")) {
+                        resetActivityTimer();
+                    }
+                    String output;
+                    int statusCode = applyPasswordBatch(targetData["ops"], output);
+                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
                     return;
                 }
                 
@@ -4404,8 +4673,13 @@ void WebServerManager::start() {
                         return request->send(400, "text/plain", "名称和密钥不能为空");
                     }
                     
+                    OtpParams params = KeyManager::readParams(targetData);
+                    if (!TOTPGenerator::isSupported(params)) {
+                        return request->send(400, "text/plain", "不支持的OTP参数");
+                    }
+                    
                     LOG_INFO("WebServer", "🚇 TUNNELED Key add: " + name);
-                    keyManager.addKey(name, secret);
+                    keyManager.addKey(name, secret, params, KeyManager::readCounter(targetData));
                     
                     // 🛡️ Ручное формирование JSON для экономии памяти
                     String output = "{\"status\":\"success\",\"message\":\"密钥添加成功\",\"name\":\"" + name + "\"}";
@@ -4418,7 +4692,7 @@ void WebServerManager::start() {
                 
                 // 🎯 МАРШРУТИЗАЦИЯ: /api/remove POST
                 if (targetEndpoint == "/api/remove" && targetMethod == "POST") {
-                    int index = targetData["index"].as<int>();
+                    int index = resolveEntryIndex(keyManager, targetData);
                     
                     LOG_INFO("WebServer", "🚇 TUNNELED Key remove: index=" + String(index));
                     keyManager.removeKey(index);
@@ -4489,33 +4763,15 @@ void WebServerManager::start() {
                     }
                     
                     LOG_INFO("WebServer", "🚇 TUNNELED TOTP export: Password verified");
-                    auto keys = keyManager.getAllKeys();
-                    
-                    // ArduinoJson 7 автоматически управляет памятью
-                    JsonDocument doc;
-                    JsonArray array = doc.to<JsonArray>();
-                    for (const auto& key : keys) {
-                        JsonObject obj = array.add<JsonObject>();
-                        obj["name"] = key.name;
-                        obj["secret"] = key.secret;
-                    }
-                    String plaintext;
-                    serializeJson(doc, plaintext);
-                    
-                    String encryptedContent = CryptoManager::getInstance().encryptWithPassword(plaintext, password);
-                    
                     LOG_INFO("WebServer", "💾 TOTP EXPORT: Wrapping encrypted file in JSON for tunnel [TUNNELED]");
                     // КРИТИЧНО: Для туннелирования отправляем JSON с fileContent
-                    // Файл уже зашифрован CryptoManager, НЕ нужно XOR!
-                    // ArduinoJson 7 автоматически управляет памятью
-                    JsonDocument responseDoc;
-                    responseDoc["status"] = "success";
-                    responseDoc["message"] = "Export successful";
-                    responseDoc["fileContent"] = encryptedContent;  // Зашифрованный файл
-                    responseDoc["filename"] = "encrypted_keys_backup.json";
-                    
-                    String jsonResponse;
-                    serializeJson(responseDoc, jsonResponse);
+                    // Файл уже зашифрован (ExportStream), НЕ нужно XOR! Конверт пишется сразу в ответ
+                    String jsonResponse = "{\"status\":\"success\",\"message\":\"Export successful\",\"filename\":\"encrypted_keys_backup.json\",\"fileContent\":\"";
+                    if (!exportToString(true, password, jsonResponse)) {
+                        LOG_ERROR("WebServer", "🚇 TUNNELED export failed: Could not build export file");
+                        return request->send(500, "text/plain", "导出失败。");
+                    }
+                    jsonResponse += "\"}";
                     
                     // Отправляем через XOR шифрование (только wrapper, не файл)
                     WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", jsonResponse, secureLayer);
@@ -4530,23 +4786,16 @@ void WebServerManager::start() {
                         return request->send(403, "text/plain", "导入/导出 API 访问已禁用。");
                     }
                     
-                    String password = targetData["password"].as<String>();
-                    String fileContent = targetData["data"].as<String>();
-                    
-                    if (password.isEmpty() || fileContent.isEmpty()) {
-                        LOG_ERROR("WebServer", "❌ TUNNELED import: Missing data (pwd:" + String(password.length()) + ", file:" + String(fileContent.length()) + ")");
-                        return request->send(400, "text/plain", "缺少密码或文件数据。");
-                    }
-                    
-                    LOG_INFO("WebServer", "🚇 TUNNELED TOTP import: Decrypting file content");
-                    String decryptedContent = CryptoManager::getInstance().decryptWithPassword(fileContent, password);
-                    
-                    if (decryptedContent.isEmpty()) {
-                        LOG_WARNING("WebServer", "🚇 TUNNELED import failed: 解密失败");
-                        return request->send(400, "text/plain", "解密失败：密码错误或文件已损坏。");
+                    // Файл расшифровывается и разбирается потоково, по записи
+                    LOG_INFO("WebServer", "🚇 TUNNELED TOTP import: Streaming file content");
+                    String message;
+                    int statusCode = importFromEnvelope(true, targetData["password"] | "", targetData["data"] | "", message);
+                    if (statusCode != 200 && statusCode != 500) {
+                        LOG_WARNING("WebServer", "🚇 TUNNELED import failed: " + message);
+                        return request->send(statusCode, "text/plain", message);
                     }
                     
-                    if (keyManager.replaceAllKeys(decryptedContent)) {
+                    if (statusCode == 200) {
                         LOG_INFO("WebServer", "🚇 TUNNELED TOTP import: Keys imported successfully");
                         
                         // 🛡️ Ручное формирование JSON
@@ -4573,22 +4822,13 @@ void WebServerManager::start() {
                     }
                     
                     LOG_INFO("WebServer", "🚇 TUNNELED passwords list request");
-                    auto passwords = passwordManager.getAllPasswords();
                     
-                    // Создаем JSON в том же формате что и прямой endpoint
-                    // ArduinoJson 7 автоматически управляет памятью
-                    JsonDocument doc;
-                    JsonArray array = doc.to<JsonArray>();
-                    for (const auto& entry : passwords) {
-                        JsonObject obj = array.add<JsonObject>();
-                        obj["name"] = entry.name;
-                        obj["password"] = entry.password;  // Только name и password в PasswordEntry
-                    }
+                    // Тот же формат что и у прямого endpoint; пароли - только через /api/passwords/get
                     String output;
-                    serializeJson(doc, output);
+                    int statusCode = buildPasswordList(tunnelListParams(targetData), output);
                     
                     LOG_INFO("WebServer", "🔐 PASSWORD ENCRYPTION: Securing tunneled passwords data [TUNNELED]");
-                    WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", output, secureLayer);
+                    WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
                     return;
                 }
                 
@@ -4613,30 +4853,14 @@ void WebServerManager::start() {
                     }
                     
                     LOG_INFO("WebServer", "🚇 TUNNELED passwords export: Password verified");
-                    auto passwords = passwordManager.getAllPasswords();
-                    
-                    JsonDocument doc;
-                    JsonArray array = doc.to<JsonArray>();
-                    for (const auto& entry : passwords) {
-                        JsonObject obj = array.add<JsonObject>();
-                        obj["name"] = entry.name;
-                        obj["password"] = entry.password;  // Только name и password в PasswordEntry
-                    }
-                    String plaintext;
-                    serializeJson(doc, plaintext);
-                    
-                    String encryptedContent = CryptoManager::getInstance().encryptWithPassword(plaintext, password);
-                    
                     LOG_INFO("WebServer", "💾 PASSWORDS EXPORT: Wrapping encrypted file in JSON for tunnel [TUNNELED]");
-                    // КРИТИЧНО: Для туннелирования отправляем JSON с fileContent
-                    JsonDocument responseDoc;
-                    responseDoc["status"] = "success";
-                    responseDoc["message"] = "Export successful";
-                    responseDoc["fileContent"] = encryptedContent;
-                    responseDoc["filename"] = "encrypted_passwords_backup.json";
-                    
-                    String jsonResponse;
-                    serializeJson(responseDoc, jsonResponse);
+                    // КРИТИЧНО: Для туннелирования отправляем JSON с fileContent (конверт пишется сразу в ответ)
+                    String jsonResponse = "{\"status\":\"success\",\"message\":\"Export successful\",\"filename\":\"encrypted_passwords_backup.json\",\"fileContent\":\"";
+                    if (!exportToString(false, password, jsonResponse)) {
+                        LOG_ERROR("WebServer", "🚇 TUNNELED passwords export failed: vault record could not be decrypted");
+                        return request->send(500, "text/plain", "密码解密失败，导出已取消。");
+                    }
+                    jsonResponse += "\"}";
                     
                     // Отправляем через XOR шифрование
                     WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", jsonResponse, secureLayer);
@@ -4651,23 +4875,16 @@ void WebServerManager::start() {
                         return request->send(403, "text/plain", "导入/导出 API 访问已禁用。");
                     }
                     
-                    String password = targetData["password"].as<String>();
-                    String fileContent = targetData["data"].as<String>();
-                    
-                    if (password.isEmpty() || fileContent.isEmpty()) {
-                        LOG_ERROR("WebServer", "❌ TUNNELED passwords import: Missing data (pwd:" + String(password.length()) + ", file:" + String(fileContent.length()) + ")");
-                        return request->send(400, "text/plain", "缺少密码或文件数据。");
-                    }
-                    
-                    LOG_INFO("WebServer", "🚇 TUNNELED passwords import: Decrypting file content");
-                    String decryptedContent = CryptoManager::getInstance().decryptWithPassword(fileContent, password);
-                    
-                    if (decryptedContent.isEmpty()) {
-                        LOG_WARNING("WebServer", "🚇 TUNNELED passwords import failed: 解密失败");
-                        return request->send(400, "text/plain", "解密失败：密码错误或文件已损坏。");
+                    // Файл расшифровывается и разбирается потоково, по записи
+                    LOG_INFO("WebServer", "🚇 TUNNELED passwords import: Streaming file content");
+                    String message;
+                    int statusCode = importFromEnvelope(false, targetData["password"] | "", targetData["data"] | "", message);
+                    if (statusCode != 200 && statusCode != 500) {
+                        LOG_WARNING("WebServer", "🚇 TUNNELED passwords import failed: " + message);
+                        return request->send(statusCode, "text/plain", message);
                     }
                     
-                    if (passwordManager.replaceAllPasswords(decryptedContent)) {
+                    if (statusCode == 200) {
                         LOG_INFO("WebServer", "🚇 TUNNELED passwords import: Passwords imported successfully");
                         
                         JsonDocument responseDoc;
@@ -4734,7 +4951,7 @@ void WebServerManager::start() {
                         resetActivityTimer();
                     }
                     
-                    int index = targetData["index"].as<int>();
+                    int index = resolveEntryIndex(passwordManager, targetData);
                     
                     LOG_INFO("WebServer", "🚇 TUNNELED Password delete: index " + String(index));
                     
@@ -4768,17 +4985,27 @@ void WebServerManager::start() {
                         resetActivityTimer();
                     }
                     
-                    int index = targetData["index"].as<int>();
+                    int index = resolveEntryIndex(passwordManager, targetData);
                     
                     LOG_INFO("WebServer", "🚇 TUNNELED Password get: index " + String(index));
                     
-                    auto passwords = passwordManager.getAllPasswords();
+                    const auto& passwords = passwordManager.getAllPasswords();
                     if (index >= 0 && index < passwords.size()) {
                         const auto& pwd = passwords[index];
+                        RevealedPassword password;
+                        if (!passwordManager.revealPasswordById(pwd.id, password)) {
+                            JsonDocument errorDoc;
+                            errorDoc["status"] = "error";
+                            errorDoc["message"] = "密码解密失败";
+                            String errorResponse;
+                            serializeJson(errorDoc, errorResponse);
+                            WebServerSecureIntegration::sendSecureResponse(request, 500, "application/json", errorResponse, secureLayer);
+                            return;
+                        }
                         
                         JsonDocument responseDoc;
-                        responseDoc["name"] = pwd.name;
-                        responseDoc["password"] = pwd.password;
+                        responseDoc["name"] = pwd.name.c_str();
+                        responseDoc["password"] = password.c_str();
                         String jsonResponse;
                         serializeJson(responseDoc, jsonResponse);
                         
@@ -4803,7 +5030,7 @@ void WebServerManager::start() {
                         resetActivityTimer();
                     }
                     
-                    int index = targetData["index"].as<int>();
+                    int index = resolveEntryIndex(passwordManager, targetData);
                     String name = targetData["name"].as<String>();
                     String password = targetData["password"].as<String>();
                     
@@ -4983,6 +5210,7 @@ void WebServerManager::start() {
                     JsonDocument doc;
                     doc["epoch"] = static_cast<unsigned long>(now);
                     doc["synced"] = totpGenerator.isTimeSynced();
+                    appendTimeConfidenceJson(doc);
                     String output;
                     serializeJson(doc, output);
 
@@ -5033,7 +5261,7 @@ void WebServerManager::start() {
                         ts.tv_sec = tv.tv_sec;
                         ts.tv_nsec = 0;
                         clock_settime(CLOCK_REALTIME, &ts); // Best-effort RTC sync on supported targets
-                        configManager.saveLastKnownEpoch(epoch);
+                        TimeContinuity::getInstance().recordManualSync();
                         totpGenerator.markTimeSynchronized();
                     }
 
@@ -5478,6 +5706,7 @@ void WebServerManager::start() {
                     WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", output, secureLayer);
                     
                     delay(1000);
+                    WriteBehind::getInstance().sync();
                     ESP.restart();
                     return;
                 }
@@ -5494,6 +5723,7 @@ void WebServerManager::start() {
                     WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", output, secureLayer);
                     
                     delay(1000);
+                    WriteBehind::getInstance().sync();
                     ESP.restart();
                     return;
                 }
@@ -5621,22 +5851,9 @@ void WebServerManager::start() {
                     // /api/keys GET
                     if (targetEndpoint == "/api/keys" && targetMethod == "GET") {
                         if (request->hasHeader("X-User-Activity")) resetActivityTimer();
-                        JsonDocument doc;
-                        JsonArray keysArray = doc.to<JsonArray>();
-                        auto keys = keyManager.getAllKeys();
-                        
-                        // Опираемся только на состояние синхронизации времени.
-                        bool blockTOTP = !totpGenerator.isTimeSynced();
-                        
-                        for (size_t i = 0; i < keys.size(); i++) {
-                            JsonObject keyObj = keysArray.add<JsonObject>();
-                            keyObj["name"] = keys[i].name;
-                            keyObj["code"] = blockTOTP ? "NOT SYNCED" : totpGenerator.generateTOTP(keys[i].secret);
-                            keyObj["timeLeft"] = totpGenerator.getTimeRemaining();
-                        }
                         String response;
-                        serializeJson(doc, response);
-                        WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", response, secureLayer);
+                        int statusCode = buildKeyList(tunnelListParams(targetData), response);
+                        WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", response, secureLayer);
                         if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
                         return;
                     }
@@ -5679,14 +5896,73 @@ void WebServerManager::start() {
                         return;
                     }
                     
+                    // /api/keys/search и /api/passwords/search GET
+                    if ((targetEndpoint == "/api/keys/search" || targetEndpoint == "/api/passwords/search") && targetMethod == "GET") {
+                        if (request->hasHeader("X-User-Activity")) resetActivityTimer();
+                        String query = targetData["q"] | "";
+                        String output;
+                        int statusCode = targetEndpoint == "/api/keys/search" ? buildKeySearch(query, output)
+                                                                              : buildPasswordSearch(query, output);
+                        WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                        if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                        return;
+                    }
+                    
+                    // /api/keys/hotp/lookahead и /api/keys/hotp/next POST
+                    if (targetEndpoint == "/api/keys/hotp/lookahead" && targetMethod == "POST") {
+                        String output;
+                        int statusCode = buildHotpLookahead(targetData["index"] | -1, targetData["count"] | HOTP_MAX_LOOKAHEAD, output);
+                        WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                        if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                        return;
+                    }
+                    if (targetEndpoint == "/api/keys/hotp/next" && targetMethod == "POST") {
+                        String counter = targetData["counter"].isNull() ? String() : targetData["counter"].as<String>();
+                        LOG_INFO("WebServer", "🚇 OBFUSCATED HOTP counter update");
+                        String output;
+                        int statusCode = advanceHotpCounter(targetData["index"] | -1, counter, output);
+                        WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                        if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                        return;
+                    }
+                    
+                    // /api/totp/verify POST
+                    if (targetEndpoint == "/api/totp/verify" && targetMethod == "POST") {
+                        String output;
+                        int statusCode = verifyTotpCode(targetData["name"] | "", targetData["index"] | -1,
+                                                        targetData["code"] | "", targetData["skew"] | TOTP_VERIFY_DEFAULT_SKEW, output);
+                        WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                        if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                        return;
+                    }
+                    
+                    // /api/keys/batch, /api/passwords/batch POST
+                    if (targetEndpoint == "/api/keys/batch" && targetMethod == "POST") {
+                        String output;
+                        int statusCode = applyKeyBatch(targetData["ops"], output);
+                        WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                        if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                        return;
+                    }
+                    if (targetEndpoint == "/api/passwords/batch" && targetMethod == "POST") {
+                        if (request->hasHeader("X-User-Activity")) resetActivityTimer();
+                        String output;
+                        int statusCode = applyPasswordBatch(targetData["ops"], output);
+                        WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
+                        if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                        return;
+                    }
+                    
                     // /api/add POST
                     if (targetEndpoint == "/api/add" && targetMethod == "POST") {
                         String name = targetData["name"].as<String>();
                         String secret = targetData["secret"].as<String>();
                         
+                        OtpParams params = KeyManager::readParams(targetData);
+                        
                         LOG_INFO("WebServer", "🚇 OBFUSCATED Key add: " + name);
                         
-                        if (keyManager.addKey(name, secret)) {
+                        if (keyManager.addKey(name, secret, params, KeyManager::readCounter(targetData))) {
                             LOG_INFO("WebServer", "🚇 OBFUSCATED 密钥添加成功: " + name);
                             String output = "{\"status\":\"success\",\"message\":\"密钥添加成功\"}";
                             WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", output, secureLayer);
@@ -5701,7 +5977,7 @@ void WebServerManager::start() {
                     
                     // /api/remove POST
                     if (targetEndpoint == "/api/remove" && targetMethod == "POST") {
-                        int index = targetData["index"].as<int>();
+                        int index = resolveEntryIndex(keyManager, targetData);
                         
                         LOG_INFO("WebServer", "🚇 OBFUSCATED Key remove: index=" + String(index));
                         keyManager.removeKey(index);
@@ -5723,6 +5999,7 @@ void WebServerManager::start() {
                         JsonDocument doc;
                         doc["epoch"] = static_cast<unsigned long>(now);
                         doc["synced"] = totpGenerator.isTimeSynced();
+                        appendTimeConfidenceJson(doc);
                         String response;
                         serializeJson(doc, response);
                         WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", response, secureLayer);
@@ -5766,7 +6043,7 @@ void WebServerManager::start() {
                             ts.tv_sec = tv.tv_sec;
                             ts.tv_nsec = 0;
                             clock_settime(CLOCK_REALTIME, &ts); // Best-effort RTC sync on supported targets
-                            configManager.saveLastKnownEpoch(epoch);
+                            TimeContinuity::getInstance().recordManualSync();
                             totpGenerator.markTimeSynchronized();
                         }
 
@@ -6456,20 +6733,12 @@ void WebServerManager::start() {
                         }
                         
                         LOG_INFO("WebServer", "🔗 Obfuscated passwords list request");
-                        auto passwords = passwordManager.getAllPasswords();
                         
-                        JsonDocument doc;
-                        JsonArray array = doc.to<JsonArray>();
-                        for (const auto& entry : passwords) {
-                            JsonObject obj = array.add<JsonObject>();
-                            obj["name"] = entry.name;
-                            obj["password"] = entry.password;
-                        }
                         String output;
-                        serializeJson(doc, output);
+                        int statusCode = buildPasswordList(tunnelListParams(targetData), output);
                         
                         LOG_INFO("WebServer", "🔐 OBFUSCATED PASSWORDS: Securing passwords list");
-                        WebServerSecureIntegration::sendSecureResponse(request, 200, "application/json", output, secureLayer);
+                        WebServerSecureIntegration::sendSecureResponse(request, statusCode, "application/json", output, secureLayer);
                         if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
                         return;
                     }
@@ -6517,7 +6786,7 @@ void WebServerManager::start() {
                             resetActivityTimer();
                         }
                         
-                        int index = targetData["index"].as<int>();
+                        int index = resolveEntryIndex(passwordManager, targetData);
                         
                         LOG_INFO("WebServer", "🔗 Obfuscated Password delete: index " + String(index));
                         
@@ -6553,17 +6822,28 @@ void WebServerManager::start() {
                             resetActivityTimer();
                         }
                         
-                        int index = targetData["index"].as<int>();
+                        int index = resolveEntryIndex(passwordManager, targetData);
                         
                         LOG_INFO("WebServer", "🔗 Obfuscated Password get: index " + String(index));
                         
-                        auto passwords = passwordManager.getAllPasswords();
+                        const auto& passwords = passwordManager.getAllPasswords();
                         if (index >= 0 && index < passwords.size()) {
                             const auto& pwd = passwords[index];
+                            RevealedPassword password;
+                            if (!passwordManager.revealPasswordById(pwd.id, password)) {
+                                JsonDocument errorDoc;
+                                errorDoc["status"] = "error";
+                                errorDoc["message"] = "密码解密失败";
+                                String errorResponse;
+                                serializeJson(errorDoc, errorResponse);
+                                WebServerSecureIntegration::sendSecureResponse(request, 500, "application/json", errorResponse, secureLayer);
+                                if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                                return;
+                            }
                             
                             JsonDocument responseDoc;
-                            responseDoc["name"] = pwd.name;
-                            responseDoc["password"] = pwd.password;
+                            responseDoc["name"] = pwd.name.c_str();
+                            responseDoc["password"] = password.c_str();
                             String jsonResponse;
                             serializeJson(responseDoc, jsonResponse);
                             
@@ -6590,7 +6870,7 @@ void WebServerManager::start() {
                             resetActivityTimer();
                         }
                         
-                        int index = targetData["index"].as<int>();
+                        int index = resolveEntryIndex(passwordManager, targetData);
                         String name = targetData["name"].as<String>();
                         String password = targetData["password"].as<String>();
                         
@@ -6644,42 +6924,18 @@ void WebServerManager::start() {
                         }
                         
                         LOG_INFO("WebServer", "🔗 Obfuscated passwords export: Password verified");
-                        auto passwords = passwordManager.getAllPasswords();
-                        
-                        // 🛡️ Шаг 1: Сериализация паролей
-                        String plaintext;
-                        {
-                            JsonDocument doc;
-                            JsonArray array = doc.to<JsonArray>();
-                            for (const auto& entry : passwords) {
-                                JsonObject obj = array.add<JsonObject>();
-                                obj["name"] = entry.name;
-                                obj["password"] = entry.password;
-                            }
-                            serializeJson(doc, plaintext);
-                            // JsonDocument автоматически освобождается здесь
-                        }
-                        
-                        LOG_DEBUG("WebServer", "📏 Passwords plaintext size: " + String(plaintext.length()) + " bytes");
-                        
-                        // 🛡️ Шаг 2: Шифрование
-                        String encryptedContent = CryptoManager::getInstance().encryptWithPassword(plaintext, password);
-                        plaintext.clear(); // Освобождаем память
-                        plaintext = String(); // Полная очистка
-                        
-                        LOG_DEBUG("WebServer", "🔐 Encrypted size: " + String(encryptedContent.length()) + " bytes");
                         LOG_INFO("WebServer", "💾 OBFUSCATED PASSWORDS EXPORT: Wrapping encrypted file in JSON");
                         
-                        // 🛡️ Шаг 3: Формирование response (ручное создание JSON для экономии памяти)
-                        String jsonResponse;
-                        jsonResponse.reserve(encryptedContent.length() + 200);
-                        jsonResponse = "{\"status\":\"success\",\"message\":\"Export successful\",\"filename\":\"encrypted_passwords_backup.json\",\"fileContent\":\"";
-                        jsonResponse += encryptedContent;
+                        // 🛡️ Ручное формирование JSON: зашифрованный конверт (ExportStream) пишется
+                        // прямо в ответ, без промежуточных строк открытого текста и шифротекста
+                        String jsonResponse = "{\"status\":\"success\",\"message\":\"Export successful\",\"filename\":\"encrypted_passwords_backup.json\",\"fileContent\":\"";
+                        if (!exportToString(false, password, jsonResponse)) {
+                            LOG_ERROR("WebServer", "🔗 Obfuscated passwords export failed: vault record could not be decrypted");
+                            if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                            return request->send(500, "text/plain", "密码解密失败，导出已取消。");
+                        }
                         jsonResponse += "\"}";
                         
-                        encryptedContent.clear(); // Освобождаем память перед отправкой
-                        encryptedContent = String();
-                        
                         LOG_DEBUG("WebServer", "📦 Response JSON size: " + String(jsonResponse.length()) + " bytes");
                         LOG_DEBUG("WebServer", "💾 Free heap before send: " + String(ESP.getFreeHeap()) + " bytes");
                         
@@ -6696,29 +6952,17 @@ void WebServerManager::start() {
                             return request->send(403, "text/plain", "导入/导出 API 访问已禁用。");
                         }
                         
-                        String password = targetData["password"].as<String>();
-                        String fileContent = targetData["data"].as<String>();
-                        
-                        LOG_DEBUG("WebServer", "🔍 Obfuscated passwords import received:");
-                        LOG_DEBUG("WebServer", "  - Password length: " + String(password.length()));
-                        LOG_DEBUG("WebServer", "  - FileContent length: " + String(fileContent.length()));
-                        
-                        if (password.isEmpty() || fileContent.isEmpty()) {
-                            LOG_ERROR("WebServer", "❌ Obfuscated passwords import: Missing data");
-                            if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
-                            return request->send(400, "text/plain", "缺少密码或文件数据。");
-                        }
-                        
-                        LOG_INFO("WebServer", "🔗 Obfuscated passwords import: Decrypting file content");
-                        String decryptedContent = CryptoManager::getInstance().decryptWithPassword(fileContent, password);
-                        
-                        if (decryptedContent.isEmpty()) {
-                            LOG_WARNING("WebServer", "🔗 Obfuscated passwords import failed: 解密失败");
+                        // Файл расшифровывается и разбирается потоково, по записи
+                        LOG_INFO("WebServer", "🔗 Obfuscated passwords import: Streaming file content");
+                        String message;
+                        int statusCode = importFromEnvelope(false, targetData["password"] | "", targetData["data"] | "", message);
+                        if (statusCode != 200 && statusCode != 500) {
+                            LOG_WARNING("WebServer", "🔗 Obfuscated passwords import failed: " + message);
                             if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
-                            return request->send(400, "text/plain", "解密失败：密码错误或文件已损坏。");
+                            return request->send(statusCode, "text/plain", message);
                         }
                         
-                        if (passwordManager.replaceAllPasswords(decryptedContent)) {
+                        if (statusCode == 200) {
                             LOG_INFO("WebServer", "🔗 Obfuscated passwords import: Passwords imported successfully");
                             
                             JsonDocument responseDoc;
@@ -6768,42 +7012,17 @@ void WebServerManager::start() {
                         }
                         
                         LOG_INFO("WebServer", "🔗 Obfuscated TOTP export: Password verified");
-                        auto keys = keyManager.getAllKeys();
-                        
-                        // 🛡️ Шаг 1: Сериализация TOTP ключей
-                        String plaintext;
-                        {
-                            JsonDocument doc;
-                            JsonArray array = doc.to<JsonArray>();
-                            for (const auto& key : keys) {
-                                JsonObject obj = array.add<JsonObject>();
-                                obj["name"] = key.name;
-                                obj["secret"] = key.secret;
-                            }
-                            serializeJson(doc, plaintext);
-                            // JsonDocument автоматически освобождается здесь
-                        }
-                        
-                        LOG_DEBUG("WebServer", "📏 TOTP keys plaintext size: " + String(plaintext.length()) + " bytes");
-                        
-                        // 🛡️ Шаг 2: Шифрование
-                        String encryptedContent = CryptoManager::getInstance().encryptWithPassword(plaintext, password);
-                        plaintext.clear();
-                        plaintext = String();
-                        
-                        LOG_DEBUG("WebServer", "🔐 Encrypted size: " + String(encryptedContent.length()) + " bytes");
                         LOG_INFO("WebServer", "💾 OBFUSCATED TOTP EXPORT: Wrapping encrypted file in JSON");
                         
-                        // 🛡️ Шаг 3: Ручное формирование JSON
-                        String jsonResponse;
-                        jsonResponse.reserve(encryptedContent.length() + 200);
-                        jsonResponse = "{\"status\":\"success\",\"message\":\"Export successful\",\"filename\":\"encrypted_keys_backup.json\",\"fileContent\":\"";
-                        jsonResponse += encryptedContent;
+                        // 🛡️ Ручное формирование JSON: конверт пишется прямо в ответ
+                        String jsonResponse = "{\"status\":\"success\",\"message\":\"Export successful\",\"filename\":\"encrypted_keys_backup.json\",\"fileContent\":\"";
+                        if (!exportToString(true, password, jsonResponse)) {
+                            LOG_ERROR("WebServer", "🔗 Obfuscated export failed: Could not build export file");
+                            if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
+                            return request->send(500, "text/plain", "导出失败。");
+                        }
                         jsonResponse += "\"}";
                         
-                        encryptedContent.clear();
-                        encryptedContent = String();
-                        
                         LOG_DEBUG("WebServer", "📦 Response JSON size: " + String(jsonResponse.length()) + " bytes");
                         LOG_DEBUG("WebServer", "💾 Free heap before send: " + String(ESP.getFreeHeap()) + " bytes");
                         
@@ -6820,29 +7039,17 @@ void WebServerManager::start() {
                             return request->send(403, "text/plain", "导入/导出 API 访问已禁用。");
                         }
                         
-                        String password = targetData["password"].as<String>();
-                        String fileContent = targetData["data"].as<String>();
-                        
-                        LOG_DEBUG("WebServer", "🔍 Obfuscated import received:");
-                        LOG_DEBUG("WebServer", "  - Password length: " + String(password.length()));
-                        LOG_DEBUG("WebServer", "  - FileContent length: " + String(fileContent.length()));
-                        
-                        if (password.isEmpty() || fileContent.isEmpty()) {
-                            LOG_ERROR("WebServer", "❌ Obfuscated import: Missing data");
-                            if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
-                            return request->send(400, "text/plain", "缺少密码或文件数据。");
-                        }
-                        
-                        LOG_INFO("WebServer", "🔗 Obfuscated TOTP import: Decrypting file content");
-                        String decryptedContent = CryptoManager::getInstance().decryptWithPassword(fileContent, password);
-                        
-                        if (decryptedContent.isEmpty()) {
-                            LOG_WARNING("WebServer", "🔗 Obfuscated import failed: 解密失败");
+                        // Файл расшифровывается и разбирается потоково, по записи
+                        LOG_INFO("WebServer", "🔗 Obfuscated TOTP import: Streaming file content");
+                        String message;
+                        int statusCode = importFromEnvelope(true, targetData["password"] | "", targetData["data"] | "", message);
+                        if (statusCode != 200 && statusCode != 500) {
+                            LOG_WARNING("WebServer", "🔗 Obfuscated import failed: " + message);
                             if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
-                            return request->send(400, "text/plain", "解密失败：密码错误或文件已损坏。");
+                            return request->send(statusCode, "text/plain", message);
                         }
                         
-                        if (keyManager.replaceAllKeys(decryptedContent)) {
+                        if (statusCode == 200) {
                             LOG_INFO("WebServer", "🔗 Obfuscated TOTP import: Keys imported successfully");
                             
                             String jsonResponse = "{\"status\":\"success\",\"message\":\"导入成功！\"}";
@@ -6871,6 +7078,7 @@ void WebServerManager::start() {
                         if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
                         
                         delay(1000);
+                        WriteBehind::getInstance().sync();
                         ESP.restart();
                         return;
                     }
@@ -6888,6 +7096,7 @@ void WebServerManager::start() {
                         if (bufferPtr) { delete bufferPtr; request->_tempObject = nullptr; }
                         
                         delay(1000);
+                        WriteBehind::getInstance().sync();
                         ESP.restart();
                         return;
                     }
@@ -7101,6 +7310,7 @@ void WebServerManager::startConfigServer() {
                     LOG_INFO("WebServer", "WiFi credentials saved successfully (encrypted)");
                     request->send(200, "text/plain", "凭据保存成功，正在重启...");
                     delay(1000);
+                    WriteBehind::getInstance().sync();
                     ESP.restart();
                 } else {
                     LOG_ERROR("WebServer", "Failed to save WiFi credentials");
@@ -7250,3 +7460,670 @@ void WebServerManager::resetActivityTimer() {
 // Note: generateKeysTable and generatePasswordsTable are no longer needed as the frontend is now JS-based.
 String WebServerManager::generateKeysTable() { return ""; }
 String WebServerManager::generatePasswordsTable() { return ""; }
+
+// Список без limit/cursor - массив записей, как раньше; со страницами -
+// {"items":[...],"next":id}, где next - курсор следующей страницы (нет - конец)
+int WebServerManager::buildKeyList(const ListParamFn& param, String& output) {
+    ListQuery query;
+    if (!parseListQuery(param, LIST_FIELDS_ALL, query)) {
+        output = "{\"status\":\"error\",\"message\":\"列表参数无效\"}";
+        return 400;
+    }
+    KeySnapshot keys = keyManager.getAllKeys();
+    std::vector<uint32_t> page;
+    uint32_t next = 0;
+    if (!selectListPage(keyManager, keys, query, page, next)) {
+        output = "{\"status\":\"error\",\"message\":\"列表已变化，请重新加载\"}";
+        return 409;
+    }
+
+    JsonDocument doc;
+    JsonArray items = query.paged() ? doc["items"].to<JsonArray>() : doc.to<JsonArray>();
+    for (uint32_t index : page) {
+        appendKeyCodeJson(items, keys[index], index, totpCodeCache, totpGenerator, query.fields);
+    }
+    if (query.paged() && next != 0) {
+        doc["next"] = next;
+    }
+    serializeJson(doc, output);
+    return 200;
+}
+
+int WebServerManager::buildPasswordList(const ListParamFn& param, String& output) {
+    ListQuery query;
+    if (!parseListQuery(param, LIST_FIELD_ID | LIST_FIELD_NAME, query)) {
+        output = "{\"status\":\"error\",\"message\":\"列表参数无效\"}";
+        return 400;
+    }
+    PasswordSnapshot passwords = passwordManager.getAllPasswords();
+    std::vector<uint32_t> page;
+    uint32_t next = 0;
+    if (!selectListPage(passwordManager, passwords, query, page, next)) {
+        output = "{\"status\":\"error\",\"message\":\"列表已变化，请重新加载\"}";
+        return 409;
+    }
+
+    JsonDocument doc;
+    JsonArray items = query.paged() ? doc["items"].to<JsonArray>() : doc.to<JsonArray>();
+    for (uint32_t index : page) {
+        JsonObject obj = items.add<JsonObject>();
+        if (query.fields & LIST_FIELD_ID) {
+            obj["id"] = passwords[index].id;
+        }
+        if (query.fields & LIST_FIELD_NAME) {
+            obj["name"] = passwords[index].name.c_str();
+        }
+    }
+    if (query.paged() && next != 0) {
+        doc["next"] = next;
+    }
+    serializeJson(doc, output);
+    return 200;
+}
+
+// Ответ поиска: {"status","total","results"}; results - не больше SEARCH_MAX_RESULTS
+// записей в формате списка (/api/keys или /api/passwords)
+int WebServerManager::buildKeySearch(const String& query, String& output) {
+    if (query.length() == 0 || query.length() > VAULT_MAX_NAME_LENGTH) {
+        output = "{\"status\":\"error\",\"message\":\"搜索关键字无效\"}";
+        return 400;
+    }
+    std::vector<uint32_t> indices;
+    size_t total = keyManager.searchKeys(query, indices, SEARCH_MAX_RESULTS);
+
+    KeySnapshot keys = keyManager.getAllKeys();
+    JsonDocument doc;
+    doc["status"] = "success";
+    doc["total"] = total;
+    JsonArray results = doc["results"].to<JsonArray>();
+    for (uint32_t index : indices) {
+        if (index >= keys.size()) {
+            continue; // Набор изменился после поиска
+        }
+        appendKeyCodeJson(results, keys[index], index, totpCodeCache, totpGenerator);
+    }
+    serializeJson(doc, output);
+    return 200;
+}
+
+int WebServerManager::buildPasswordSearch(const String& query, String& output) {
+    if (query.length() == 0 || query.length() > VAULT_MAX_NAME_LENGTH) {
+        output = "{\"status\":\"error\",\"message\":\"搜索关键字无效\"}";
+        return 400;
+    }
+    std::vector<uint32_t> indices;
+    size_t total = passwordManager.searchPasswords(query, indices, SEARCH_MAX_RESULTS);
+
+    PasswordSnapshot passwords = passwordManager.getAllPasswords();
+    JsonDocument doc;
+    doc["status"] = "success";
+    doc["total"] = total;
+    JsonArray results = doc["results"].to<JsonArray>();
+    for (uint32_t index : indices) {
+        if (index >= passwords.size()) {
+            continue; // Набор изменился после поиска
+        }
+        JsonObject obj = results.add<JsonObject>();
+        obj["id"] = passwords[index].id;
+        obj["name"] = passwords[index].name.c_str(); // Пароль - только через /api/passwords/get
+    }
+    serializeJson(doc, output);
+    return 200;
+}
+
+int WebServerManager::buildHotpLookahead(int index, int count, String& output) {
+    KeySnapshot keys = keyManager.getAllKeys();
+    if (index < 0 || index >= (int)keys.size() || !keys[index].params.isCounterBased()) {
+        output = "{\"status\":\"error\",\"message\":\"不是HOTP密钥\"}";
+        return 400;
+    }
+    if (count <= 0 || count > HOTP_MAX_LOOKAHEAD) {
+        count = HOTP_MAX_LOOKAHEAD;
+    }
+
+    const TOTPKey& key = keys[index];
+    uint32_t codes[HOTP_MAX_LOOKAHEAD];
+    size_t generated = TOTPGenerator::generateCodes(key.material, key.counter, codes, count);
+    if (generated == 0) {
+        output = "{\"status\":\"error\",\"message\":\"密钥无效\"}";
+        return 500;
+    }
+
+    JsonDocument doc;
+    doc["status"] = "success";
+    doc["counter"] = String((unsigned long long)key.counter);
+    JsonArray codesArray = doc["codes"].to<JsonArray>();
+    char codeStr[OTP_CODE_BUFFER_SIZE];
+    for (size_t i = 0; i < generated; i++) {
+        TOTPGenerator::formatCode(codes[i], key.params.digits, codeStr);
+        codesArray.add(codeStr);
+    }
+    serializeJson(doc, output);
+    return 200;
+}
+
+int WebServerManager::advanceHotpCounter(int index, const String& counter, String& output) {
+    bool success = counter.length() > 0
+        ? keyManager.setCounter(index, strtoull(counter.c_str(), nullptr, 10))
+        : keyManager.advanceCounter(index);
+    if (!success) {
+        output = "{\"status\":\"error\",\"message\":\"更新HOTP计数器失败\"}";
+        return 400;
+    }
+
+    KeySnapshot keys = keyManager.getAllKeys();
+    if (index >= (int)keys.size()) {
+        output = "{\"status\":\"error\",\"message\":\"更新HOTP计数器失败\"}";
+        return 409;
+    }
+    JsonDocument doc;
+    doc["status"] = "success";
+    doc["counter"] = String((unsigned long long)keys[index].counter);
+    doc["code"] = totpCodeCache.getCode(index);
+    serializeJson(doc, output);
+    return 200;
+}
+
+int WebServerManager::verifyTotpCode(const String& name, int index, const String& code, int skew, String& output) {
+    if (skew < 0) {
+        skew = 0;
+    }
+    String trimmedCode = code;
+    trimmedCode.trim();
+
+    TotpVerifyResult result = name.length() > 0
+        ? totpVerifier.verify(name, trimmedCode.c_str(), (uint8_t)min(skew, TOTP_VERIFY_MAX_SKEW))
+        : totpVerifier.verify(index, trimmedCode.c_str(), (uint8_t)min(skew, TOTP_VERIFY_MAX_SKEW));
+
+    switch (result.status) {
+        case TotpVerifyStatus::INVALID_KEY:
+            output = "{\"status\":\"error\",\"message\":\"未找到TOTP密钥\"}";
+            return 404;
+        case TotpVerifyStatus::MALFORMED:
+            output = "{\"status\":\"error\",\"message\":\"验证码格式无效\"}";
+            return 400;
+        case TotpVerifyStatus::NOT_SYNCED:
+            output = "{\"status\":\"error\",\"message\":\"时间未同步\"}";
+            return 503;
+        default:
+            break;
+    }
+
+    JsonDocument doc;
+    doc["status"] = "success";
+    doc["valid"] = result.status == TotpVerifyStatus::ACCEPTED;
+    doc["result"] = TOTPVerifier::statusText(result.status);
+    if (result.status == TotpVerifyStatus::ACCEPTED) {
+        doc["offset"] = result.offset;
+    }
+    serializeJson(doc, output);
+
+    if (result.status != TotpVerifyStatus::ACCEPTED) {
+        LOG_WARNING("WebServer", "TOTP verification failed: " + String(TOTPVerifier::statusText(result.status)));
+    }
+    return result.status == TotpVerifyStatus::THROTTLED ? 429 : 200;
+}
+
+namespace {
+// Разбор {"name": ..., "order": ...} из операции reorder пакета
+std::vector<std::pair<String, int>> readBatchOrder(JsonVariantConst order) {
+    std::vector<std::pair<String, int>> newOrder;
+    for (JsonObjectConst item : order.as<JsonArrayConst>()) {
+        newOrder.push_back(std::make_pair(item["name"].as<String>(), item["order"] | 0));
+    }
+    return newOrder;
+}
+
+void batchError(String& output, const char* message, size_t failedIndex) {
+    JsonDocument doc;
+    doc["status"] = "error";
+    doc["message"] = message;
+    doc["failed"] = failedIndex;
+    serializeJson(doc, output);
+}
+} // namespace
+
+int WebServerManager::applyKeyBatch(JsonVariantConst ops, String& output) {
+    JsonArrayConst operations = ops.as<JsonArrayConst>();
+    if (operations.isNull() || operations.size() == 0 || operations.size() > BATCH_MAX_OPERATIONS) {
+        output = "{\"status\":\"error\",\"message\":\"批量操作列表无效\"}";
+        return 400;
+    }
+    if (!keyManager.beginBatch()) {
+        output = "{\"status\":\"error\",\"message\":\"另一个批量操作正在进行\"}";
+        return 409;
+    }
+
+    // Цель операции: по имени ("target"), по стабильному id ("id") или по индексу на момент этой операции ("index")
+    size_t position = 0;
+    for (JsonObjectConst op : operations) {
+        String type = op["op"].as<String>();
+        int index = op["target"].is<const char*>() ? keyManager.findByName(op["target"].as<String>()) : resolveEntryIndex(keyManager, op);
+        bool applied = false;
+        if (type == "add") {
+            applied = keyManager.addKey(op["name"].as<String>(), op["secret"].as<String>(),
+                                        KeyManager::readParams(op), KeyManager::readCounter(op));
+        } else if (type == "update") {
+            // Снимок до конца пакета прежний: текущие поля - из набора пакета
+            String name;
+            String secret;
+            if (keyManager.getKeyFields(index, name, secret)) {
+                if (op["name"].is<const char*>()) {
+                    name = op["name"].as<String>();
+                }
+                if (op["secret"].is<const char*>()) {
+                    secret = op["secret"].as<String>();
+                }
+                applied = keyManager.updateKey(index, name, secret);
+            }
+        } else if (type == "remove") {
+            applied = keyManager.removeKey(index);
+        } else if (type == "reorder" && op["order"].is<JsonArrayConst>()) {
+            applied = keyManager.reorderKeys(readBatchOrder(op["order"]));
+        } else if (type == "counter" && !op["counter"].isNull()) {
+            applied = keyManager.setCounter(index, KeyManager::readCounter(op));
+        }
+        if (!applied) {
+            keyManager.abortBatch();
+            LOG_WARNING("WebServer", "Key batch rejected at operation " + String((unsigned long)position) + " (" + type + ")");
+            batchError(output, "批量操作失败，未做任何更改", position);
+            return 400;
+        }
+        position++;
+    }
+
+    if (!keyManager.commitBatch()) {
+        output = "{\"status\":\"error\",\"message\":\"批量保存失败\"}";
+        return 500;
+    }
+    LOG_INFO("WebServer", "Key batch applied: " + String((unsigned long)position) + " operations");
+    output = "{\"status\":\"success\",\"applied\":" + String((unsigned long)position) + "}";
+    return 200;
+}
+
+int WebServerManager::applyPasswordBatch(JsonVariantConst ops, String& output) {
+    JsonArrayConst operations = ops.as<JsonArrayConst>();
+    if (operations.isNull() || operations.size() == 0 || operations.size() > BATCH_MAX_OPERATIONS) {
+        output = "{\"status\":\"error\",\"message\":\"批量操作列表无效\"}";
+        return 400;
+    }
+    if (!passwordManager.beginBatch()) {
+        output = "{\"status\":\"error\",\"message\":\"另一个批量操作正在进行\"}";
+        return 409;
+    }
+
+    size_t position = 0;
+    for (JsonObjectConst op : operations) {
+        String type = op["op"].as<String>();
+        int index = op["target"].is<const char*>() ? passwordManager.findByName(op["target"].as<String>()) : resolveEntryIndex(passwordManager, op);
+        bool applied = false;
+        if (type == "add") {
+            applied = passwordManager.addPassword(op["name"].as<String>(), op["password"].as<String>());
+        } else if (type == "update") {
+            String name;
+            if (passwordManager.getPasswordName(index, name)) {
+                if (op["name"].is<const char*>()) {
+                    name = op["name"].as<String>();
+                }
+                // Без password - только переименование, пароль остается прежним
+                applied = op["password"].is<const char*>()
+                    ? passwordManager.updatePassword(index, name, op["password"].as<String>())
+                    : passwordManager.renamePassword(index, name);
+            }
+        } else if (type == "delete") {
+            applied = passwordManager.deletePassword(index);
+        } else if (type == "reorder" && op["order"].is<JsonArrayConst>()) {
+            applied = passwordManager.reorderPasswords(readBatchOrder(op["order"]));
+        }
+        if (!applied) {
+            passwordManager.abortBatch();
+            LOG_WARNING("WebServer", "Password batch rejected at operation " + String((unsigned long)position) + " (" + type + ")");
+            batchError(output, "批量操作失败，未做任何更改", position);
+            return 400;
+        }
+        position++;
+    }
+
+    if (!passwordManager.commitBatch()) {
+        output = "{\"status\":\"error\",\"message\":\"批量保存失败\"}";
+        return 500;
+    }
+    LOG_INFO("WebServer", "Password batch applied: " + String((unsigned long)position) + " operations");
+    output = "{\"status\":\"success\",\"applied\":" + String((unsigned long)position) + "}";
+    return 200;
+}
+
+namespace {
+#ifdef SECURE_LAYER_ENABLED
+// Защищенное тело импорта {"type","iv","tag","counter","data"} без сборки целиком:
+// поля перед data разбираются отдельным JSON, hex шифротекста расшифровывается
+// порциями и сразу уходит в ImportStream. Старый порядок (data перед iv) отклоняется.
+class SecureImportDecoder {
+public:
+    enum class Status { HEADER, DATA, DONE, FAILED };
+
+    ~SecureImportDecoder() {
+        mbedtls_platform_zeroize(_chunk, sizeof(_chunk));
+    }
+
+    void feed(SecureLayerManager& layer, const String& clientId, const uint8_t* data, size_t len, ImportStream& stream) {
+        for (size_t i = 0; i < len && _status != Status::FAILED; i++) {
+            char c = (char)data[i];
+            switch (_status) {
+                case Status::HEADER:
+                    _header += c;
+                    if (_header.length() > kMaxHeader) {
+                        _status = Status::FAILED;
+                    } else if (_header.endsWith("\"data\":\"")) {
+                        _status = parseHeader(layer, clientId) ? Status::DATA : Status::FAILED;
+                        _header = String();
+                    }
+                    break;
+                case Status::DATA:
+                    if (c == '"') {
+                        _status = (_nibble < 0 && flush(layer, clientId, stream)) ? Status::DONE : Status::FAILED;
+                        break;
+                    }
+                    if (!pushHex(c) || (_chunkLen == sizeof(_chunk) && !flush(layer, clientId, stream))) {
+                        _status = Status::FAILED;
+                    }
+                    break;
+                case Status::DONE:
+                    if (c != '}' && c != ' ' && c != '\r' && c != '\n') {
+                        _status = Status::FAILED;
+                    }
+                    break;
+                case Status::FAILED:
+                    break;
+            }
+        }
+    }
+
+    bool finished() const { return _status == Status::DONE; }
+
+private:
+    static const size_t kMaxHeader = 256;
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool parseHeader(SecureLayerManager& layer, const String& clientId) {
+        // {"type":"secure","iv":"..","tag":"..","counter":N,"data":" -> {...,"counter":N}
+        String head = _header.substring(0, _header.length() - 8);
+        if (head.endsWith(",")) {
+            head.remove(head.length() - 1);
+        }
+        head += '}';
+        JsonDocument doc;
+        if (deserializeJson(doc, head) || !doc["iv"].is<const char*>() || !doc["counter"].is<uint64_t>()) {
+            LOG_WARNING("WebServer", "Secure import header is missing iv/counter");
+            return false;
+        }
+        const char* ivHex = doc["iv"];
+        if (strlen(ivHex) != SECURE_GCM_IV_SIZE * 2) {
+            return false;
+        }
+        for (size_t i = 0; i < SECURE_GCM_IV_SIZE; i++) {
+            int high = hexValue(ivHex[i * 2]);
+            int low = hexValue(ivHex[i * 2 + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            _iv[i] = (uint8_t)((high << 4) | low);
+        }
+        return layer.acceptRequestCounter(clientId, doc["counter"].as<uint64_t>());
+    }
+
+    bool pushHex(char c) {
+        int value = hexValue(c);
+        if (value < 0) {
+            return false;
+        }
+        if (_nibble < 0) {
+            _nibble = value;
+        } else {
+            _chunk[_chunkLen++] = (uint8_t)((_nibble << 4) | value);
+            _nibble = -1;
+        }
+        return true;
+    }
+
+    bool flush(SecureLayerManager& layer, const String& clientId, ImportStream& stream) {
+        if (_chunkLen == 0) {
+            return true;
+        }
+        if (!layer.decryptRequestChunk(clientId, _iv, _offset, _chunk, _chunkLen)) {
+            return false;
+        }
+        stream.feed(_chunk, _chunkLen); // Ошибка разбора сообщается в finishImport()
+        _offset += _chunkLen;
+        _chunkLen = 0;
+        return true;
+    }
+
+    Status _status = Status::HEADER;
+    String _header;
+    uint8_t _iv[SECURE_GCM_IV_SIZE] = {};
+    uint8_t _chunk[256];
+    size_t _chunkLen = 0;
+    size_t _offset = 0;
+    int _nibble = -1;
+};
+#endif
+
+// Состояние прямого запроса импорта (request->_tempObject). Обычное тело
+// разбирается по мере поступления, защищенное (XOR) расшифровывается порциями.
+struct ImportRequest {
+    explicit ImportRequest(ImportStream::EntryFn onEntry) : stream(onEntry) {}
+
+    ImportStream stream;
+#ifdef SECURE_LAYER_ENABLED
+    SecureImportDecoder secureBody;
+#endif
+    bool secure = false;
+};
+} // namespace
+
+bool WebServerManager::startImport(bool keys) {
+    return keys ? keyManager.beginImport() : passwordManager.beginImport();
+}
+
+void WebServerManager::abortImport(bool keys) {
+    if (keys) {
+        keyManager.abortImport();
+    } else {
+        passwordManager.abortImport();
+    }
+}
+
+ImportStream::EntryFn WebServerManager::importEntryHandler(bool keys) {
+    return [this, keys](JsonObjectConst entry) {
+        return keys ? keyManager.stageImport(entry) : passwordManager.stageImport(entry);
+    };
+}
+
+int WebServerManager::finishImport(ImportStream& stream, bool keys, String& message) {
+    if (!stream.finish()) {
+        abortImport(keys);
+        if (stream.status() == ImportStream::Status::REJECTED) {
+            message = "导入文件包含无效或重复的条目，未做任何更改。";
+        } else {
+            message = "解密失败：密码错误或文件已损坏。";
+        }
+        LOG_WARNING("WebServer", "Import failed, status " + String((int)stream.status()));
+        return 400;
+    }
+    bool committed = keys ? keyManager.commitImport() : passwordManager.commitImport();
+    if (!committed) {
+        message = keys ? "解密后处理密钥失败。" : "解密后处理密码数据失败。";
+        return 500;
+    }
+    LOG_INFO("WebServer", String(keys ? "TOTP keys" : "Passwords") + " imported: " +
+             String((unsigned long)stream.entryCount()) + " entries");
+    message = "导入成功！";
+    return 200;
+}
+
+int WebServerManager::importFromEnvelope(bool keys, const char* password, const char* envelope, String& message) {
+    if (*password == '\0' || *envelope == '\0') {
+        message = "缺少密码或文件数据。";
+        return 400;
+    }
+    if (!startImport(keys)) {
+        message = "另一个导入正在进行中，请稍后重试。";
+        return 409;
+    }
+    ImportStream stream(importEntryHandler(keys));
+    stream.feedEnvelope(password, envelope, strlen(envelope));
+    return finishImport(stream, keys, message);
+}
+
+void WebServerManager::handleImportBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total, bool keys) {
+    if (!isAuthenticated(request)) {
+        if (index == 0) request->send(401);
+        return;
+    }
+    if (!WebAdminManager::getInstance().isApiEnabled()) {
+        if (index == 0) {
+            LOG_WARNING("WebServer", String("Blocked unauthorized attempt to import ") + (keys ? "TOTP keys" : "passwords") + " (API disabled).");
+            request->send(403, "text/plain", "导入/导出 API 访问已禁用。");
+        }
+        return;
+    }
+
+    ImportRequest* state = (ImportRequest*)request->_tempObject;
+    if (index == 0) {
+        if (!startImport(keys)) {
+            request->send(409, "text/plain", "另一个导入正在进行中，请稍后重试。");
+            return;
+        }
+        state = new ImportRequest(importEntryHandler(keys));
+        request->_tempObject = state;
+        // Оборванный запрос: импорт отменяется, состояние удаляется раньше free() в деструкторе запроса
+        request->onDisconnect([this, request, keys]() {
+            ImportRequest* pending = (ImportRequest*)request->_tempObject;
+            if (pending) {
+                abortImport(keys);
+                delete pending;
+                request->_tempObject = nullptr;
+            }
+        });
+#ifdef SECURE_LAYER_ENABLED
+        String clientId = WebServerSecureIntegration::getClientId(request);
+        state->secure = clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId) &&
+                        (request->hasHeader("X-Secure-Request") || request->hasHeader("X-Security-Level"));
+#endif
+    }
+    if (!state) {
+        return; // Импорт не начат, ответ уже отправлен
+    }
+
+#ifdef SECURE_LAYER_ENABLED
+    if (state->secure) {
+        state->secureBody.feed(secureLayer, WebServerSecureIntegration::getClientId(request), data, len, state->stream);
+    } else
+#endif
+    {
+        state->stream.feed(data, len); // Ошибка разбора сообщается в finishImport()
+    }
+    if (index + len < total) {
+        return;
+    }
+
+    LOG_INFO("WebServer", String("Received ") + (keys ? "TOTP keys" : "passwords") + " import data.");
+    String message;
+    int statusCode = 0;
+    String clientId;
+#ifdef SECURE_LAYER_ENABLED
+    clientId = WebServerSecureIntegration::getClientId(request);
+    if (state->secure && !state->secureBody.finished()) {
+        LOG_ERROR("WebServer", "🔐 Failed to XOR decrypt import request body");
+        abortImport(keys);
+        message = "导入请求 XOR 解密失败";
+        statusCode = 400;
+    }
+#endif
+    if (statusCode == 0) {
+        statusCode = finishImport(state->stream, keys, message);
+    }
+    delete state;
+    request->_tempObject = nullptr;
+
+    // Ключи отвечают JSON {"status","message"} (кроме ошибок запроса), пароли - текстом
+    bool json = keys && (statusCode == 200 || statusCode == 500);
+    String contentType = json ? "application/json" : "text/plain";
+    String response = message;
+    if (json) {
+        JsonDocument doc;
+        doc["status"] = statusCode == 200 ? "success" : "error";
+        doc["message"] = message;
+        response = "";
+        serializeJson(doc, response);
+    }
+#ifdef SECURE_LAYER_ENABLED
+    if (clientId.length() > 0 && secureLayer.isSecureSessionValid(clientId)) {
+        WebServerSecureIntegration::sendSecureResponse(request, statusCode, contentType, response, secureLayer);
+        return;
+    }
+#endif
+    request->send(statusCode, contentType, response);
+}
+
+std::shared_ptr<ExportStream> WebServerManager::createExport(bool keys, const String& password) {
+    // Ключи экспортируются из снимка, взятого сейчас: изменения во время
+    // отправки на файл не влияют. Пароли расшифровываются из текущего набора.
+    KeySnapshot keySnapshot;
+    if (keys) {
+        keySnapshot = keyManager.getAllKeys();
+    }
+    size_t count = keys ? keySnapshot.size() : passwordManager.getAllPasswords().size();
+    uint32_t generation = keys ? 0 : passwordManager.getGeneration();
+    std::shared_ptr<ExportStream> stream = std::make_shared<ExportStream>(count,
+        [this, keys, keySnapshot, generation](size_t index, JsonObject entry) {
+            if (!keys) {
+                // Записи запрашиваются между порциями ответа: индексы действительны, пока набор не менялся
+                if (passwordManager.getGeneration() != generation) {
+                    LOG_WARNING("WebServer", "Export aborted: entries changed during export");
+                    return false;
+                }
+                return passwordManager.exportEntry(index, entry);
+            }
+            const TOTPKey& key = keySnapshot[index];
+            entry["name"] = key.name.c_str();
+            entry["secret"] = key.secret.c_str();
+            KeyManager::writeParams(entry, key);
+            return true;
+        });
+    if (!stream->begin(password)) {
+        return nullptr;
+    }
+    return stream;
+}
+
+bool WebServerManager::exportToString(bool keys, const String& password, String& output) {
+    std::shared_ptr<ExportStream> stream = createExport(keys, password);
+    return stream && stream->readAll(output, true);
+}
+
+void WebServerManager::sendExport(AsyncWebServerRequest* request, bool keys, const String& password) {
+    std::shared_ptr<ExportStream> stream = createExport(keys, password);
+    if (!stream) {
+        request->send(500, "text/plain", "导出失败。");
+        return;
+    }
+
+    // 🔐 ВАЖНО: Не используем sendSecureResponse для файлов - контент уже зашифрован ExportStream.
+    // Поток живет, пока жив ответ (захвачен функцией заполнения).
+    LOG_INFO("WebServer", String("🔐 ") + (keys ? "TOTP" : "PASSWORD") + " EXPORT: Streaming encrypted file");
+    AsyncWebServerResponse* response = request->beginChunkedResponse("application/json",
+        [stream](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            return stream->read(buffer, maxLen);
+        });
+    response->addHeader("Content-Disposition", keys ? "attachment; filename=\"encrypted_keys_backup.json\""
+                                                    : "attachment; filename=\"encrypted_passwords_backup.json\"");
+    request->send(response);
+}
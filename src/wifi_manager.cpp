@@ -6,6 +6,15 @@
 #include "log_manager.h"
 #include "crypto_manager.h"  // Для шифрования WiFi credentials
 #include "config.h"  // Для WIFI_CONFIG_FILE
+#include "vault_file.h"
+
+namespace {
+// Поля WIFI_CONFIG_FILE (VaultFile)
+enum WifiField : uint8_t {
+    WIFI_FIELD_SSID = 1,
+    WIFI_FIELD_PASSWORD = 2
+};
+} // namespace
 
 WifiManager::WifiManager(DisplayManager& display, ConfigManager& configManager) 
     : _display(display), _configManager(configManager) {}
@@ -16,7 +25,28 @@ bool WifiManager::loadCredentials(String& ssid, String& password) {
     // 🔒 Проверяем зашифрованный файл
     if (LittleFS.exists(WIFI_CONFIG_FILE)) {
         LOG_DEBUG("WifiManager", "Loading encrypted WiFi config");
-        File file = LittleFS.open(WIFI_CONFIG_FILE, "r");
+        std::vector<WifiCredentials> records;
+        if (!SecureStore<WifiCredentials>::readVault(WIFI_CONFIG_FILE, records)) {
+            LOG_ERROR("WifiManager", "Failed to read or decrypt WiFi config");
+            return false;
+        }
+        String readSsid = records.empty() ? String() : records[0].ssid;
+        String readPassword = records.empty() ? String() : records[0].password;
+        if (readSsid.length() == 0) {
+            LOG_WARNING("WifiManager", "Empty SSID in WiFi config");
+            return false;
+        }
+
+        ssid = readSsid;
+        password = readPassword;
+        LOG_INFO("WifiManager", "WiFi credentials loaded (encrypted) for SSID: " + ssid);
+        return true;
+    }
+
+    // 🔄 Миграция: прежний формат JSON + AES-CBC + Base64
+    if (LittleFS.exists(WIFI_CONFIG_FILE_ENC_LEGACY)) {
+        LOG_INFO("WifiManager", "Migrating encrypted WiFi config to binary vault format");
+        File file = LittleFS.open(WIFI_CONFIG_FILE_ENC_LEGACY, "r");
         if (!file) {
             LOG_ERROR("WifiManager", "Failed to open encrypted WiFi config file");
             return false;
@@ -52,8 +82,14 @@ bool WifiManager::loadCredentials(String& ssid, String& password) {
             LOG_WARNING("WifiManager", "Empty SSID in WiFi config");
             return false;
         }
-        
-        LOG_INFO("WifiManager", "WiFi credentials loaded (encrypted) for SSID: " + ssid);
+
+        if (saveCredentials(ssid, password)) {
+            LittleFS.remove(WIFI_CONFIG_FILE_ENC_LEGACY);
+        } else {
+            LOG_ERROR("WifiManager", "Failed to migrate WiFi credentials");
+        }
+
+        LOG_INFO("WifiManager", "WiFi credentials loaded (migrated) for SSID: " + ssid);
         return true;
     }
     
@@ -270,40 +306,28 @@ void WifiManager::startMdnsService() {
 bool WifiManager::saveCredentials(const String& ssid, const String& password) {
     LOG_DEBUG("WifiManager", "Saving encrypted WiFi credentials");
     
-    // Создаём JSON с credentials
-    JsonDocument doc;
-    doc["ssid"] = ssid;
-    doc["password"] = password;
-    
-    String json_string;
-    size_t jsonSize = serializeJson(doc, json_string);
-    if (jsonSize == 0) {
-        LOG_ERROR("WifiManager", "Failed to serialize WiFi credentials to JSON");
-        return false;
-    }
-
-    // Шифруем данные
-    String encrypted_base64 = CryptoManager::getInstance().encrypt(json_string);
-    if (encrypted_base64.length() == 0) {
-        LOG_ERROR("WifiManager", "Failed to encrypt WiFi credentials");
-        return false;
-    }
-
-    // Сохраняем в файл
-    File file = LittleFS.open(WIFI_CONFIG_FILE, "w");
-    if (!file) {
-        LOG_ERROR("WifiManager", "Failed to open WiFi config file for writing");
-        return false;
-    }
-    
-    size_t bytesWritten = file.print(encrypted_base64);
-    file.close();
-    
-    if (bytesWritten > 0) {
+    WifiCredentials credentials;
+    credentials.ssid = ssid;
+    credentials.password = password;
+    std::vector<WifiCredentials> records(1, credentials);
+    if (SecureStore<WifiCredentials>::writeVault(WIFI_CONFIG_FILE, records)) {
         LOG_INFO("WifiManager", "WiFi credentials saved successfully (encrypted) for SSID: " + ssid);
         return true;
     } else {
         LOG_ERROR("WifiManager", "Failed to write encrypted WiFi credentials");
         return false;
     }
-}
\ No newline at end of file
+}
+
+void RecordSchema<WifiCredentials>::readField(WifiCredentials& credentials, const VaultFileReader::Field& field) {
+    if (field.tag == WIFI_FIELD_SSID) {
+        credentials.ssid = field.asString();
+    } else if (field.tag == WIFI_FIELD_PASSWORD) {
+        credentials.password = field.asString();
+    }
+}
+
+void RecordSchema<WifiCredentials>::writeFields(VaultFileWriter& writer, const WifiCredentials& credentials) {
+    writer.writeString(WIFI_FIELD_SSID, credentials.ssid);
+    writer.writeString(WIFI_FIELD_PASSWORD, credentials.password);
+}
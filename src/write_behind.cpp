@@ -0,0 +1,144 @@
+#include "write_behind.h"
+#include "config.h"
+#include "log_manager.h"
+
+std::atomic<uint32_t> WriteBehind::_flashWrites(0);
+std::atomic<uint32_t> WriteBehind::_flashBytes(0);
+
+WriteBehind& WriteBehind::getInstance() {
+    static WriteBehind instance;
+    return instance;
+}
+
+WriteBehind::WriteBehind() {
+    _mutex = xSemaphoreCreateMutex();
+}
+
+int WriteBehind::add(const char* name, FlushFn flush) {
+    Sink sink;
+    sink.name = name;
+    sink.flush = flush;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _sinks.push_back(sink);
+    int index = (int)_sinks.size() - 1;
+    xSemaphoreGive(_mutex);
+    return index;
+}
+
+void WriteBehind::markDirty(int sink) {
+    if (sink < 0 || sink >= (int)_sinks.size()) {
+        return;
+    }
+    uint32_t now = millis();
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    Sink& entry = _sinks[sink];
+    if (!entry.dirty) {
+        entry.dirty = true;
+        entry.firstDirtyAt = now;
+    }
+    entry.lastDirtyAt = now;
+    entry.changes++;
+    xSemaphoreGive(_mutex);
+}
+
+bool WriteBehind::isDirty(int sink) const {
+    return sink >= 0 && sink < (int)_sinks.size() && _sinks[sink].dirty;
+}
+
+bool WriteBehind::due(const Sink& sink, uint32_t now) const {
+    return sink.dirty && !sink.flushing &&
+           (now - sink.lastDirtyAt >= WRITE_BEHIND_QUIET_MS || now - sink.firstDirtyAt >= WRITE_BEHIND_MAX_DELAY_MS);
+}
+
+void WriteBehind::loop() {
+    uint32_t now = millis();
+    for (size_t i = 0; i < _sinks.size(); i++) {
+        if (due(_sinks[i], now)) {
+            flush((int)i);
+        }
+    }
+}
+
+bool WriteBehind::flush(int sink) {
+    if (sink < 0 || sink >= (int)_sinks.size()) {
+        return false;
+    }
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    Sink& entry = _sinks[sink];
+    // Запись уже идет в другой задаче: дожидаемся ее, затем пишем то, что изменилось за это время
+    while (entry.flushing) {
+        xSemaphoreGive(_mutex);
+        delay(5);
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+    }
+    if (!entry.dirty) {
+        xSemaphoreGive(_mutex);
+        return true;
+    }
+    entry.dirty = false;
+    entry.flushing = true;
+    xSemaphoreGive(_mutex);
+
+    // Функция записи вызывается без блокировки: изменения во время записи снова отмечают состояние
+    uint32_t startedAt = millis();
+    bool success = entry.flush();
+    uint32_t elapsed = millis() - startedAt;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    entry.flushing = false;
+    entry.flushMsTotal += elapsed;
+    if (elapsed > entry.flushMsMax) {
+        entry.flushMsMax = elapsed;
+    }
+    if (success) {
+        entry.flushes++;
+    } else {
+        entry.failures++;
+        if (!entry.dirty) {
+            entry.dirty = true;
+            entry.firstDirtyAt = millis();
+        }
+        entry.lastDirtyAt = millis(); // Повтор после следующей паузы
+    }
+    xSemaphoreGive(_mutex);
+
+    if (!success) {
+        LOG_ERROR("WriteBehind", String("Failed to flush ") + entry.name + ", will retry");
+    }
+    return success;
+}
+
+bool WriteBehind::sync() {
+    bool success = true;
+    for (size_t i = 0; i < _sinks.size(); i++) {
+        if (!flush((int)i)) {
+            success = false;
+        }
+    }
+    return success;
+}
+
+void WriteBehind::countFlashWrite(size_t bytes) {
+    _flashWrites++;
+    _flashBytes += (uint32_t)bytes;
+}
+
+void WriteBehind::toJson(JsonObject obj) const {
+    obj["flashWrites"] = _flashWrites.load();
+    obj["flashBytes"] = _flashBytes.load();
+    JsonArray sinks = obj["sinks"].to<JsonArray>();
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    for (const Sink& sink : _sinks) {
+        JsonObject item = sinks.add<JsonObject>();
+        item["name"] = sink.name;
+        item["dirty"] = sink.dirty;
+        item["changes"] = sink.changes;
+        item["flushes"] = sink.flushes;
+        // Изменения, записанные вместе с другими (без отложенной записи каждое было бы записью)
+        item["coalesced"] = sink.changes > sink.flushes ? sink.changes - sink.flushes : 0;
+        item["failures"] = sink.failures;
+        item["flushMsTotal"] = sink.flushMsTotal;
+        item["flushMsMax"] = sink.flushMsMax;
+    }
+    xSemaphoreGive(_mutex);
+}
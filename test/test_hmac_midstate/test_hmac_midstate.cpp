@@ -0,0 +1,117 @@
+// HMAC с предвычисленными контекстами совпадает с полным HMAC на каждый код:
+// pio test -e native -f test_hmac_midstate
+// На хосте SHA - программная заглушка mbedtls, поэтому скорость здесь не
+// сравнивается; время на код на устройстве - флаг OTP_HMAC_BENCHMARK.
+#include <unity.h>
+#include "otp_hash.h"
+
+namespace {
+// HMAC как до midstate (и как mbedtls_md_hmac): блоки K ^ ipad и K ^ opad
+// хешируются заново на каждый код тем же SHA, что и в HmacMidstate
+template <typename Hash>
+void fullHmac(const uint8_t* key, size_t keyLen, const uint8_t message[8], uint8_t digest[Hash::kDigestSize]) {
+    uint8_t block[Hash::kBlockSize];
+    uint8_t innerDigest[Hash::kDigestSize];
+    typename Hash::Context ctx;
+    Hash::init(&ctx);
+
+    memset(block, 0x36, sizeof(block));
+    for (size_t i = 0; i < keyLen; i++) {
+        block[i] ^= key[i];
+    }
+    Hash::starts(&ctx);
+    Hash::update(&ctx, block, sizeof(block));
+    Hash::update(&ctx, message, 8);
+    Hash::finish(&ctx, innerDigest);
+
+    memset(block, 0x5C, sizeof(block));
+    for (size_t i = 0; i < keyLen; i++) {
+        block[i] ^= key[i];
+    }
+    Hash::starts(&ctx);
+    Hash::update(&ctx, block, sizeof(block));
+    Hash::update(&ctx, innerDigest, sizeof(innerDigest));
+    Hash::finish(&ctx, digest);
+    Hash::free(&ctx);
+}
+
+void counterMessage(uint64_t counter, uint8_t message[8]) {
+    for (int i = 7; i >= 0; i--) {
+        message[i] = counter & 0xFF;
+        counter >>= 8;
+    }
+}
+
+void hexToBytes(const char* hex, uint8_t* out) {
+    for (size_t i = 0; hex[2 * i] != '\0'; i++) {
+        unsigned value = 0;
+        sscanf(hex + 2 * i, "%2x", &value);
+        out[i] = (uint8_t)value;
+    }
+}
+
+// RFC 2202 / RFC 4231, тест 1: ключ 0x0b x 20, сообщение "Hi There" (8 байт)
+template <typename Hash>
+void assertRfcVector(const char* expectedHex) {
+    uint8_t key[20];
+    memset(key, 0x0b, sizeof(key));
+    uint8_t expected[Hash::kDigestSize];
+    hexToBytes(expectedHex, expected);
+
+    HmacMidstate<Hash> midstate;
+    midstate.prepare(key, sizeof(key));
+    uint8_t digest[Hash::kDigestSize];
+    midstate.compute((const uint8_t*)"Hi There", digest);
+    TEST_ASSERT_EQUAL_MEMORY(expected, digest, Hash::kDigestSize);
+
+    fullHmac<Hash>(key, sizeof(key), (const uint8_t*)"Hi There", digest);
+    TEST_ASSERT_EQUAL_MEMORY(expected, digest, Hash::kDigestSize);
+}
+
+template <typename Hash>
+void assertMidstateMatchesFullHmac(size_t keyLen) {
+    uint8_t key[Hash::kBlockSize];
+    for (size_t i = 0; i < keyLen; i++) {
+        key[i] = (uint8_t)(i * 37 + keyLen);
+    }
+    HmacMidstate<Hash> midstate;
+    midstate.prepare(key, keyLen);
+
+    uint8_t message[8];
+    uint8_t expected[Hash::kDigestSize];
+    uint8_t digest[Hash::kDigestSize];
+    for (uint64_t counter = 0; counter < 64; counter++) {
+        counterMessage(counter * 0x9E3779B97F4A7C15ULL, message);
+        fullHmac<Hash>(key, keyLen, message, expected);
+        midstate.compute(message, digest);
+        TEST_ASSERT_EQUAL_MEMORY(expected, digest, Hash::kDigestSize);
+    }
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_rfc_hmac_vectors() {
+    assertRfcVector<Sha1>("b617318655057264e28bc0b6fb378c8ef146be00");
+    assertRfcVector<Sha256>("b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+    assertRfcVector<Sha512>("87aa7cdea5ef619d4ff0b4241a1d6cb02379f4e2ce4ec2787ad0b30545e17cde"
+                            "daa833b7d6b8a702038b274eaea3f4e4be9d914eeb61f1702e696c203a126854");
+}
+
+void test_midstate_matches_full_hmac() {
+    const size_t keyLengths[] = { 1, 10, 20, 32, 64 };
+    for (size_t keyLen : keyLengths) {
+        assertMidstateMatchesFullHmac<Sha1>(keyLen);
+        assertMidstateMatchesFullHmac<Sha256>(keyLen);
+        assertMidstateMatchesFullHmac<Sha512>(keyLen);
+    }
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rfc_hmac_vectors);
+    RUN_TEST(test_midstate_matches_full_hmac);
+    return UNITY_END();
+}
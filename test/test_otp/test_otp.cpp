@@ -0,0 +1,225 @@
+// Векторы RFC 4226/6238 и замер производительности OTP ядра на хосте:
+// pio test -e native -f test_otp
+#include <unity.h>
+#include <chrono>
+#include <vector>
+#include "totp_generator.h"
+
+namespace {
+// ASCII "12345678901234567890" и его удлинения до размера ключа SHA-256/SHA-512 (RFC 6238, приложение B)
+const char* const kSecretSha1 = "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ";
+const char* const kSecretSha256 = "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZA====";
+const char* const kSecretSha512 = "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNA=";
+
+// RFC 4226, приложение D: счетчики 0..9
+const char* const kHotpCodes[] = {
+    "755224", "287082", "359152", "969429", "338314",
+    "254676", "287922", "162583", "399871", "520489"
+};
+const size_t kHotpCount = sizeof(kHotpCodes) / sizeof(kHotpCodes[0]);
+
+struct TotpVector {
+    int64_t time;
+    const char* sha1;
+    const char* sha256;
+    const char* sha512;
+};
+
+// RFC 6238, приложение B: 8 цифр, период 30 секунд
+const TotpVector kTotpVectors[] = {
+    { 59,            "94287082", "46119246", "90693936" },
+    { 1111111109,    "07081804", "68084774", "25091201" },
+    { 1111111111,    "14050471", "67062674", "99943326" },
+    { 1234567890,    "89005924", "91819424", "93441116" },
+    { 2000000000,    "69279037", "90698825", "38618901" },
+    { 20000000000LL, "65353130", "77737706", "47863826" }
+};
+
+const uint32_t kBenchmarkCodesPerRun = 50000;
+
+void assertCode(const TOTPKeyMaterial& material, uint64_t counter, const char* expected) {
+    char code[OTP_CODE_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL(OtpStatus::OK, TOTPGenerator::generateCode(material, counter, code, sizeof(code)));
+    TEST_ASSERT_EQUAL_STRING(expected, code);
+}
+
+void prepare(const char* secret, const OtpParams& params, TOTPKeyMaterial& material) {
+    TEST_ASSERT_TRUE(TOTPGenerator::prepareKey(secret, params, material));
+}
+
+void benchmarkKeys(size_t keyCount) {
+    // Разные секреты и алгоритмы, чтобы у каждого ключа были свои midstate
+    const char* const secrets[] = { kSecretSha1, kSecretSha256, kSecretSha512 };
+    const OtpAlgorithm algorithms[] = { OtpAlgorithm::SHA1, OtpAlgorithm::SHA256, OtpAlgorithm::SHA512 };
+    std::vector<TOTPKeyMaterial> materials(keyCount);
+    for (size_t i = 0; i < keyCount; i++) {
+        OtpParams params;
+        params.algorithm = algorithms[i % 3];
+        prepare(secrets[i % 3], params, materials[i]);
+    }
+
+    uint32_t rounds = kBenchmarkCodesPerRun / keyCount;
+    if (rounds == 0) {
+        rounds = 1;
+    }
+    char code[OTP_CODE_BUFFER_SIZE];
+    uint32_t checksum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < keyCount; i++) {
+            TEST_ASSERT_EQUAL(OtpStatus::OK, TOTPGenerator::generateCode(materials[i], round, code, sizeof(code)));
+            checksum += (uint8_t)code[0];
+        }
+    }
+    int64_t elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    if (elapsedUs <= 0) {
+        elapsedUs = 1;
+    }
+
+    uint64_t codes = (uint64_t)rounds * keyCount;
+    char message[160];
+    snprintf(message, sizeof(message), "%u keys: %llu codes/s, %llu us per full refresh (checksum %u)",
+             (unsigned)keyCount, (unsigned long long)(codes * 1000000ULL / elapsedUs),
+             (unsigned long long)(elapsedUs / rounds), (unsigned)checksum);
+    TEST_MESSAGE(message);
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_base32_canonical_secret() {
+    TOTPKeyMaterial material;
+    TEST_ASSERT_TRUE(TOTPGenerator::prepareKey(kSecretSha1, material));
+    TEST_ASSERT_EQUAL_UINT8(20, material.secretLen);
+    TEST_ASSERT_EQUAL_MEMORY("12345678901234567890", material.secret, 20);
+}
+
+void test_base32_variants_decode_to_same_secret() {
+    // Строчные буквы, пробелы, дефисы и padding не меняют декодированный секрет
+    const char* const variants[] = {
+        "gezdgnbvgy3tqojqgezdgnbvgy3tqojq",
+        "GEZD GNBV GY3T QOJQ GEZD GNBV GY3T QOJQ",
+        "GEZD-GNBV-GY3T-QOJQ-GEZD-GNBV-GY3T-QOJQ",
+        "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ===="
+    };
+    for (const char* secret : variants) {
+        TOTPKeyMaterial material;
+        TEST_ASSERT_TRUE_MESSAGE(TOTPGenerator::prepareKey(secret, material), secret);
+        TEST_ASSERT_EQUAL_UINT8(20, material.secretLen);
+        TEST_ASSERT_EQUAL_MEMORY("12345678901234567890", material.secret, 20);
+    }
+}
+
+void test_base32_rejects_oversized_and_invalid_secret() {
+    // Секрет длиннее TOTP_MAX_SECRET_BYTES отклоняется, а не обрезается
+    String tooLong;
+    for (int i = 0; i < 4; i++) {
+        tooLong += kSecretSha1; // 4 x 20 байт
+    }
+    TOTPKeyMaterial material;
+    TEST_ASSERT_FALSE(TOTPGenerator::prepareKey(tooLong, material));
+    TEST_ASSERT_FALSE(TOTPGenerator::prepareKey("", material));
+    TEST_ASSERT_FALSE(material.isValid());
+}
+
+void test_hotp_rfc4226_vectors() {
+    OtpParams params;
+    params.type = OtpType::HOTP;
+    TOTPKeyMaterial material;
+    prepare(kSecretSha1, params, material);
+    for (uint64_t counter = 0; counter < kHotpCount; counter++) {
+        assertCode(material, counter, kHotpCodes[counter]);
+    }
+}
+
+void test_hotp_batch_matches_single_codes() {
+    OtpParams params;
+    params.type = OtpType::HOTP;
+    TOTPKeyMaterial material;
+    prepare(kSecretSha1, params, material);
+
+    uint32_t codes[kHotpCount];
+    TEST_ASSERT_EQUAL(kHotpCount, TOTPGenerator::generateCodes(material, 0, codes, kHotpCount));
+    char code[OTP_CODE_BUFFER_SIZE];
+    for (size_t i = 0; i < kHotpCount; i++) {
+        TOTPGenerator::formatCode(codes[i], params.digits, code);
+        TEST_ASSERT_EQUAL_STRING(kHotpCodes[i], code);
+    }
+}
+
+void test_totp_rfc6238_vectors() {
+    struct Engine {
+        OtpAlgorithm algorithm;
+        const char* secret;
+    };
+    const Engine engines[] = {
+        { OtpAlgorithm::SHA1, kSecretSha1 },
+        { OtpAlgorithm::SHA256, kSecretSha256 },
+        { OtpAlgorithm::SHA512, kSecretSha512 }
+    };
+
+    for (const Engine& engine : engines) {
+        OtpParams params;
+        params.algorithm = engine.algorithm;
+        params.digits = 8;
+        TOTPKeyMaterial material;
+        prepare(engine.secret, params, material);
+
+        for (const TotpVector& vector : kTotpVectors) {
+            if ((int64_t)(time_t)vector.time != vector.time) {
+                continue; // 32-битный time_t не представляет время после 2038 года
+            }
+            uint64_t timeStep = material.counterFn((time_t)vector.time, params.period);
+            TEST_ASSERT_EQUAL_UINT64((uint64_t)vector.time / params.period, timeStep);
+            const char* expected = engine.algorithm == OtpAlgorithm::SHA1 ? vector.sha1
+                                 : engine.algorithm == OtpAlgorithm::SHA256 ? vector.sha256 : vector.sha512;
+            assertCode(material, timeStep, expected);
+        }
+    }
+}
+
+void test_totp_custom_period_time_step() {
+    // Нестандартный период проходит через общий (не специализированный) расчет окна
+    const uint16_t periods[] = { 60, 45 };
+    for (uint16_t period : periods) {
+        OtpParams params;
+        params.period = period;
+        TOTPKeyMaterial material;
+        prepare(kSecretSha1, params, material);
+        TEST_ASSERT_EQUAL_UINT64(1111111109ULL / period, material.counterFn(1111111109, period));
+    }
+}
+
+void test_generate_code_reports_errors() {
+    char code[OTP_CODE_BUFFER_SIZE];
+    TOTPKeyMaterial invalid;
+    TEST_ASSERT_EQUAL(OtpStatus::INVALID_KEY, TOTPGenerator::generateCode(invalid, 0, code, sizeof(code)));
+    TEST_ASSERT_EQUAL_STRING("", code);
+
+    TOTPKeyMaterial material;
+    prepare(kSecretSha1, OtpParams(), material);
+    TEST_ASSERT_EQUAL(OtpStatus::BUFFER_TOO_SMALL, TOTPGenerator::generateCode(material, 0, code, 6));
+    TEST_ASSERT_EQUAL_STRING("", code);
+}
+
+void test_benchmark_1_50_500_keys() {
+    benchmarkKeys(1);
+    benchmarkKeys(50);
+    benchmarkKeys(500);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_base32_canonical_secret);
+    RUN_TEST(test_base32_variants_decode_to_same_secret);
+    RUN_TEST(test_base32_rejects_oversized_and_invalid_secret);
+    RUN_TEST(test_hotp_rfc4226_vectors);
+    RUN_TEST(test_hotp_batch_matches_single_codes);
+    RUN_TEST(test_totp_rfc6238_vectors);
+    RUN_TEST(test_totp_custom_period_time_step);
+    RUN_TEST(test_generate_code_reports_errors);
+    RUN_TEST(test_benchmark_1_50_500_keys);
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+// Горячий путь кодов не обращается к куче: счетчик operator new вокруг
+// TOTPGenerator::generateCode и TOTPCodeCache::getCode
+// pio test -e native -f test_otp_heap
+#include <unity.h>
+#include <LittleFS.h>
+#include <new>
+#include <stdlib.h>
+#include "key_manager.h"
+#include "totp_code_cache.h"
+#include "totp_generator.h"
+
+namespace {
+size_t s_allocations = 0;
+
+const char* const kSecrets[] = {
+    "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ",
+    "JBSWY3DPEHPK3PXP",
+    "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZA===="
+};
+const size_t kKeyCount = 20;
+const size_t kRounds = 100;
+} // namespace
+
+void* operator new(size_t size) {
+    s_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+KeyManager keyManager;
+TOTPGenerator totpGenerator;
+TOTPCodeCache totpCodeCache(keyManager, totpGenerator);
+
+void setUp() {}
+void tearDown() {}
+
+void test_generate_code_does_not_allocate() {
+    OtpParams params;
+    params.algorithm = OtpAlgorithm::SHA256;
+    params.digits = 8;
+    TOTPKeyMaterial materials[2];
+    TEST_ASSERT_TRUE(TOTPGenerator::prepareKey(kSecrets[0], materials[0]));
+    TEST_ASSERT_TRUE(TOTPGenerator::prepareKey(kSecrets[2], params, materials[1]));
+
+    char code[OTP_CODE_BUFFER_SIZE];
+    uint32_t codes[HOTP_MAX_LOOKAHEAD];
+    size_t before = s_allocations;
+    for (uint64_t counter = 0; counter < kRounds; counter++) {
+        TEST_ASSERT_EQUAL(OtpStatus::OK, TOTPGenerator::generateCode(materials[counter % 2], counter, code, sizeof(code)));
+        TEST_ASSERT_EQUAL(HOTP_MAX_LOOKAHEAD, TOTPGenerator::generateCodes(materials[0], counter, codes, HOTP_MAX_LOOKAHEAD));
+        TOTPGenerator::formatCode(codes[0], 6, code);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, s_allocations - before);
+}
+
+void test_code_cache_get_code_does_not_allocate() {
+    TEST_ASSERT_TRUE(LittleFS.begin(true));
+    TEST_ASSERT_TRUE(LittleFS.format());
+    TEST_ASSERT_TRUE(keyManager.begin());
+    for (size_t i = 0; i < kKeyCount; i++) {
+        OtpParams params;
+        params.type = i % 4 == 3 ? OtpType::HOTP : OtpType::TOTP;
+        TEST_ASSERT_TRUE(keyManager.addKey(String("key ") + String((unsigned)i), kSecrets[i % 3], params));
+    }
+    totpCodeCache.begin();
+
+    // Первый проход заполняет кэш (выделение записей кэша после смены набора ключей)
+    char code[OTP_CODE_BUFFER_SIZE];
+    for (size_t i = 0; i < kKeyCount; i++) {
+        TEST_ASSERT_EQUAL(OtpStatus::OK, totpCodeCache.getCode(i, code, sizeof(code)));
+    }
+
+    size_t before = s_allocations;
+    for (size_t round = 0; round < kRounds; round++) {
+        for (size_t i = 0; i < kKeyCount; i++) {
+            TEST_ASSERT_EQUAL(OtpStatus::OK, totpCodeCache.getCode(i, code, sizeof(code)));
+            totpCodeCache.getNextCode(i, code, sizeof(code));
+        }
+        TEST_ASSERT_EQUAL(OtpStatus::INVALID_KEY, totpCodeCache.getCode(kKeyCount, code, sizeof(code)));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, s_allocations - before);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_generate_code_does_not_allocate);
+    RUN_TEST(test_code_cache_get_code_does_not_allocate);
+    return UNITY_END();
+}
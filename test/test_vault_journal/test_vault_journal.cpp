@@ -0,0 +1,129 @@
+// Журнал хранилища при неполной записи (заполненная flash):
+// pio test -e native -f test_vault_journal
+#include <unity.h>
+#include <LittleFS.h>
+#include <stdint.h>
+#include "vault_journal.h"
+
+namespace {
+const char* const kPath = "/test.journal";
+const uint32_t kDomain = 0x54534554; // "TEST"
+
+struct Replayed {
+    std::vector<uint32_t> ids;
+    std::vector<String> payloads;
+};
+
+void replayAll(VaultJournal& journal, Replayed& result) {
+    TEST_ASSERT_TRUE(journal.replay([&result](JournalOp, uint32_t id, const String& payload) {
+        result.ids.push_back(id);
+        result.payloads.push_back(payload);
+    }));
+}
+} // namespace
+
+void setUp() {
+    TEST_ASSERT_TRUE(LittleFS.begin(true));
+    TEST_ASSERT_TRUE(LittleFS.format());
+}
+
+void tearDown() {
+    LittleFS.failWritesAfter(SIZE_MAX);
+}
+
+void test_short_write_is_truncated_before_next_append() {
+    VaultJournal journal(kPath, kDomain);
+    TEST_ASSERT_TRUE(journal.append(JournalOp::UPSERT, 1, String("first")));
+    uint32_t offset = 0;
+    const char secret[] = "secret";
+    TEST_ASSERT_TRUE(journal.append(JournalOp::SECRET, 2, (const uint8_t*)secret, strlen(secret), &offset));
+    size_t validSize = journal.size();
+
+    // Запись оборвалась на 10 байтах; копия целых записей при обрезке помещается
+    LittleFS.failOneWriteAfter(10);
+    TEST_ASSERT_FALSE(journal.append(JournalOp::UPSERT, 3, String("lost")));
+    TEST_ASSERT_TRUE(journal.usable());
+    TEST_ASSERT_EQUAL_UINT32(validSize, journal.size());
+
+    TEST_ASSERT_TRUE(journal.append(JournalOp::UPSERT, 4, String("after")));
+
+    VaultJournal reopened(kPath, kDomain);
+    Replayed replayed;
+    replayAll(reopened, replayed);
+    TEST_ASSERT_EQUAL_UINT32(3, replayed.ids.size());
+    TEST_ASSERT_EQUAL_UINT32(4, replayed.ids[2]);
+    TEST_ASSERT_EQUAL_STRING("after", replayed.payloads[2].c_str());
+
+    std::vector<uint8_t> plain;
+    TEST_ASSERT_TRUE(reopened.read(offset, 2, plain));
+    TEST_ASSERT_EQUAL_MEMORY(secret, plain.data(), strlen(secret));
+}
+
+void test_corrupted_middle_record_keeps_file() {
+    VaultJournal journal(kPath, kDomain);
+    TEST_ASSERT_TRUE(journal.append(JournalOp::UPSERT, 1, String("first")));
+    size_t firstSize = journal.size();
+    TEST_ASSERT_TRUE(journal.append(JournalOp::UPSERT, 2, String("second")));
+    TEST_ASSERT_TRUE(journal.append(JournalOp::UPSERT, 3, String("third")));
+    size_t fileSize = journal.size();
+
+    // Бит в шифротексте второй записи (заголовок 16 байт, nonce 12 байт)
+    File file = LittleFS.open(kPath, "r");
+    std::vector<uint8_t> bytes(file.size());
+    TEST_ASSERT_EQUAL_UINT32(bytes.size(), file.read(bytes.data(), bytes.size()));
+    file.close();
+    bytes[firstSize + 16 + 12] ^= 0x01;
+    file = LittleFS.open(kPath, "w");
+    TEST_ASSERT_EQUAL_UINT32(bytes.size(), file.write(bytes.data(), bytes.size()));
+    file.close();
+
+    VaultJournal reopened(kPath, kDomain);
+    Replayed replayed;
+    TEST_ASSERT_FALSE(reopened.replay([&replayed](JournalOp, uint32_t id, const String& payload) {
+        replayed.ids.push_back(id);
+        replayed.payloads.push_back(payload);
+    }));
+    TEST_ASSERT_EQUAL_UINT32(1, replayed.ids.size());
+    TEST_ASSERT_FALSE(reopened.usable());
+    TEST_ASSERT_FALSE(reopened.append(JournalOp::UPSERT, 4, String("refused")));
+
+    // Третья запись и испорченная вторая остаются в файле
+    file = LittleFS.open(kPath, "r");
+    TEST_ASSERT_EQUAL_UINT32(fileSize, file.size());
+    file.close();
+}
+
+void test_failed_truncate_marks_journal_unusable() {
+    VaultJournal journal(kPath, kDomain);
+    TEST_ASSERT_TRUE(journal.append(JournalOp::UPSERT, 1, String("first")));
+    TEST_ASSERT_TRUE(journal.append(JournalOp::UPSERT, 2, String("second")));
+
+    // Flash заполнена: не удается ни дописать запись, ни переписать журнал
+    LittleFS.failWritesAfter(10);
+    TEST_ASSERT_FALSE(journal.append(JournalOp::UPSERT, 3, String("lost")));
+    TEST_ASSERT_FALSE(journal.usable());
+    LittleFS.failWritesAfter(SIZE_MAX);
+
+    // Дописывать за мусором нельзя до нового снимка
+    TEST_ASSERT_FALSE(journal.append(JournalOp::UPSERT, 4, String("refused")));
+
+    // Целые записи по-прежнему читаются, мусор отбрасывается
+    VaultJournal reopened(kPath, kDomain);
+    Replayed replayed;
+    replayAll(reopened, replayed);
+    TEST_ASSERT_EQUAL_UINT32(2, replayed.ids.size());
+    TEST_ASSERT_TRUE(reopened.usable());
+
+    // Снимок владельца сбрасывает журнал, после чего запись снова возможна
+    TEST_ASSERT_TRUE(journal.reset());
+    TEST_ASSERT_TRUE(journal.usable());
+    TEST_ASSERT_TRUE(journal.append(JournalOp::UPSERT, 5, String("fresh")));
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_short_write_is_truncated_before_next_append);
+    RUN_TEST(test_corrupted_middle_record_keeps_file);
+    RUN_TEST(test_failed_truncate_marks_journal_unusable);
+    return UNITY_END();
+}